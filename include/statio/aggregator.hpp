@@ -0,0 +1,132 @@
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace statio {
+
+// Host-level values the fleet can be ranked by.
+enum class FleetMetric : std::uint8_t { Cpu, Memory, Rx, Tx };
+constexpr std::size_t kFleetMetricCount = 4;
+
+const char* fleetMetricName(FleetMetric metric);
+// Accepts cpu, memory, rx and tx.
+bool parseFleetMetric(const std::string& text, FleetMetric& metric);
+
+// Latest derived state of one host, recomputed from each snapshot it sends.
+struct HostSummary {
+    std::string host;
+    std::string peer;
+    bool connected = false;
+    std::int64_t timestampMs = 0; // agent clock of the last snapshot
+    std::uint64_t frames = 0;
+    std::uint64_t bytes = 0;
+    double cpuPercent = 0.0;         // busy share of all cores since the previous snapshot
+    double memoryUsedPercent = 0.0;  // 100 * (1 - available / total)
+    double rxBytesPerSec = 0.0;      // all interfaces but lo
+    double txBytesPerSec = 0.0;
+    // Physical links that are down, or saw errors or carrier changes in the
+    // last minute, e.g. "eth1 down".
+    std::vector<std::string> degradedLinks;
+
+    double metric(FleetMetric metric) const;
+};
+
+struct FleetTotals {
+    std::size_t hosts = 0;
+    std::size_t connected = 0;
+    std::size_t degraded = 0;
+    std::uint64_t frames = 0;
+    std::uint64_t bytes = 0;
+};
+
+// Latest HostSummary per host, sharded by host name so decoder threads
+// rarely contend. Every shard keeps an ordered index per FleetMetric and
+// the set of hosts with degraded links; top() reads N entries per shard and
+// degraded() only the flagged hosts, never every host.
+class FleetState {
+public:
+    explicit FleetState(std::size_t shards);
+
+    void update(const HostSummary& summary);
+    // A connection starts or stops feeding `host`. The host shows as
+    // disconnected only once the last connection feeding it has closed, so
+    // an agent that reconnects before its old socket is torn down, or two
+    // agents reporting the same name, keep it connected.
+    void attached(const std::string& host);
+    void disconnected(const std::string& host);
+
+    std::vector<HostSummary> top(FleetMetric metric, std::size_t count) const;
+    std::vector<HostSummary> degraded() const;
+    std::optional<HostSummary> host(const std::string& name) const;
+    FleetTotals totals() const;
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, HostSummary> hosts;
+        std::set<std::pair<double, std::string>> index[kFleetMetricCount];
+        std::set<std::string> degraded;
+        std::unordered_map<std::string, std::size_t> live; // connections per host
+    };
+
+    Shard& shardFor(const std::string& host);
+    const Shard& shardFor(const std::string& host) const;
+
+    std::vector<Shard> shards_;
+};
+
+struct AggregatorOptions {
+    std::string listen = ":7411";          // agent snapshots
+    std::string queryListen = "127.0.0.1:7412"; // text queries
+    std::size_t workers = 0;               // 0: one per CPU
+    std::size_t shards = 64;
+    bool quiet = false;
+};
+
+// Receives wire snapshots (see wire.hpp) from many agents. The accept loop
+// hands connections round-robin to decoder threads; each thread owns an
+// epoll set and its connections outright, decodes frames as they complete
+// and publishes one HostSummary per snapshot into the FleetState.
+class Aggregator {
+public:
+    explicit Aggregator(AggregatorOptions options);
+    ~Aggregator();
+
+    Aggregator(const Aggregator&) = delete;
+    Aggregator& operator=(const Aggregator&) = delete;
+
+    // Accepts agents and answers queries until `stop` becomes non-zero.
+    void run(const volatile std::sig_atomic_t& stop);
+
+    // Text query protocol, one request line per connection:
+    //   top cpu|memory|rx|tx [N]   degraded   host NAME   hosts
+    // Query connections are served from the accept loop without blocking;
+    // one that has not sent its line and read the answer within 2 s is
+    // dropped.
+    std::string answer(const std::string& query) const;
+
+    const FleetState& state() const { return state_; }
+
+private:
+    struct Worker;
+
+    AggregatorOptions options_;
+    FleetState state_;
+    int listenFd_ = -1;
+    int queryFd_ = -1;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::size_t nextWorker_ = 0;
+};
+
+// Sends one query to an aggregator and returns the response text.
+std::string queryFleet(const std::string& address, const std::string& query);
+
+} // namespace statio
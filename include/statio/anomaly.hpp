@@ -0,0 +1,108 @@
+#pragma once
+
+#include "statio/history.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace statio {
+
+enum class AnomalyKind : std::uint8_t {
+    ZScore,      // deviation from an exponentially weighted mean/variance
+    Seasonal,    // deviation from the same time slot of previous seasons
+    ChangePoint, // sustained level shift (two-sided CUSUM)
+};
+
+const char* anomalyKindName(AnomalyKind kind);
+
+struct AnomalyOptions {
+    double alpha = 0.05;      // EWMA weight of each new sample
+    double threshold = 4.0;   // |z| that flags a sample
+    std::size_t warmup = 30;  // samples before a baseline is trusted
+    std::int64_t seasonMs = 24LL * 3600LL * 1000LL; // 0 disables the seasonal detector
+    std::size_t seasonSlots = 24;
+    double cusumDrift = 0.5;  // k, in standard deviations
+    double cusumLimit = 8.0;  // h, in standard deviations
+};
+
+struct AnomalyEvent {
+    std::int64_t timestampMs = 0;
+    std::string_view name;
+    std::string_view entity;
+    AnomalyKind kind = AnomalyKind::ZScore;
+    double value = 0.0;    // per-second rate for counters
+    double baseline = 0.0; // expected value
+    double score = 0.0;    // z-score, or the CUSUM sum for change points
+};
+
+std::string formatAnomaly(const AnomalyEvent& event);
+
+// Online detectors over many series. Every sample updates each detector in
+// O(1) time and fixed memory per series (the seasonal baseline keeps
+// `seasonSlots` slots). Counters are scored on their per-second rate and
+// distributions on their mean. An event is reported when a detector starts
+// flagging a series; the flag clears once its score falls below half the
+// threshold.
+class AnomalyDetector {
+public:
+    using Emit = std::function<void(const AnomalyEvent&)>;
+
+    explicit AnomalyDetector(AnomalyOptions options = {});
+
+    // Index of (name, entity), created on first use.
+    std::size_t series(std::string_view name, std::string_view entity, MetricKind kind);
+    void observe(std::size_t series, std::int64_t timestampMs, double value, const Emit& emit);
+    void observe(std::int64_t timestampMs, const std::vector<MetricSample>& samples, const Emit& emit);
+
+    bool anomalous(std::size_t series) const;
+    // Whether any series of this entity (e.g. an interface) is flagged.
+    bool entityAnomalous(std::string_view entity) const;
+    std::size_t seriesCount() const { return series_.size(); }
+
+    // Latest event of every currently flagged series.
+    std::vector<AnomalyEvent> active() const;
+
+private:
+    struct Baseline {
+        double mean = 0.0;
+        double variance = 0.0;
+        std::size_t count = 0;
+
+        void add(double x, double alpha);
+    };
+
+    struct SeasonSlot {
+        std::int64_t season = -1; // which season `current` belongs to
+        Baseline current;         // plain running mean/variance of that season
+        Baseline previous;        // blend of earlier seasons, used for scoring
+    };
+
+    struct Series {
+        std::string name;
+        std::string entity;
+        MetricKind kind = MetricKind::Gauge;
+        double prevValue = 0.0;
+        std::int64_t prevMs = 0;
+        bool havePrev = false;
+        Baseline ewma;
+        double cusumHigh = 0.0;
+        double cusumLow = 0.0;
+        std::vector<SeasonSlot> season;
+        bool flagged[3] = {false, false, false};
+        AnomalyEvent last;
+    };
+
+    double scale(const Baseline& baseline, double x) const;
+    void flag(Series& series, AnomalyKind kind, bool raise, bool clear, const AnomalyEvent& event, const Emit& emit);
+
+    AnomalyOptions options_;
+    std::vector<Series> series_;
+    std::unordered_map<std::string, std::size_t> index_;
+    std::string key_;
+};
+
+} // namespace statio
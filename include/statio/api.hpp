@@ -0,0 +1,189 @@
+#pragma once
+
+#include "statio/history.hpp"
+#include "statio/system_info.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace statio {
+
+// Local query API of a running daemon, served on a Unix stream socket.
+// Requests are single text lines; every response is
+//   u32 body bytes | u8 status (0 ok, 1 error) | body
+// with integers little-endian and the body JSON unless noted:
+//   snapshot [COLLECTOR,...]   latest snapshot, optionally only some collectors;
+//                              its timestamp_ms and the daemon's interval_ms
+//                              always lead
+//   report                     latest snapshot as the text report
+//   history METRIC [--entity E] [--from T] [--to T] [--agg LIST]
+//           [--bucket D] [--group-by G] [--tier T]
+//                              rows as `statio query --format json` prints them
+//   subscribe [COLLECTOR,...]  the latest snapshot, then one per sample until
+//                              the client disconnects
+//   watch [FIELD,...] [--every DUR]
+//                              field-level diffs, at most one per DUR:
+//                              {"timestamp_ms":T,"seq":N,"full":B,"fields":
+//                              {"cpu.user{cpu0}":V,...}} with only the
+//                              fields changed since this subscriber's last
+//                              diff (all of them in the first, full one);
+//                              null marks a field that disappeared
+// Collectors are os, cpu, memory, disks, network, gpus and distributions;
+// the field names match tools/statio_py.py. FIELD is a glob over series
+// labels or names as `statio query` shows them ("network.*{eth0}",
+// "memory.available_mb"), or a prefix such as cpu or disk.
+constexpr std::size_t kApiResponseHeaderBytes = 5;
+
+// $STATIO_SOCKET, else $XDG_RUNTIME_DIR/statio.sock, else /tmp/statio-<uid>.sock.
+std::string defaultApiSocket();
+
+struct ApiOptions {
+    std::string socketPath;
+    std::string historyDirectory; // answers history requests; empty: refused
+    std::int64_t intervalMs = 0;  // sampling interval, sent with every snapshot
+};
+
+struct ApiStats {
+    std::uint64_t connections = 0;
+    std::uint64_t requests = 0;
+    std::uint64_t responses = 0;
+    std::uint64_t bytesSent = 0;
+    std::uint64_t coalesced = 0; // updates a busy subscriber skipped
+    std::uint64_t diffsEncoded = 0; // watch diffs built; shared by every subscriber
+    std::uint64_t diffsSent = 0;    // with the same fields and last delivery
+};
+
+// Serves the API from one epoll thread. publish() encodes each snapshot
+// once, collector by collector, into an immutable buffer; responses and
+// subscriber updates are gathered from slices of that buffer with sendmsg
+// and never copied per client. A subscriber that still has an update in
+// flight skips newer ones and receives the latest once it has drained.
+// Watch diffs come from one field table that records the sample each value
+// last changed in; a diff depends only on the field selection and the
+// subscriber's last delivered sample, so subscribers that agree on both
+// share one encoded buffer.
+//
+// History requests read segment files, which can take seconds on a large
+// store, so one worker thread answers them and posts each response back to
+// the serving thread. A connection takes no further request until its
+// history response is queued, and none while more than kMaxQueuedBytes of
+// responses wait to be sent; its socket is not read meanwhile.
+class ApiServer {
+public:
+    static constexpr std::size_t kMaxQueuedBytes = 1U << 20;
+
+    // Throws std::runtime_error when the socket cannot be bound, including
+    // when another daemon already answers on it.
+    explicit ApiServer(ApiOptions options);
+    ~ApiServer();
+
+    ApiServer(const ApiServer&) = delete;
+    ApiServer& operator=(const ApiServer&) = delete;
+
+    void publish(std::int64_t timestampMs, const SystemSnapshot& snapshot, const std::vector<MetricSample>& samples);
+    ApiStats stats() const;
+
+private:
+    struct Encoded;
+    struct Chunk;
+    struct Connection;
+    struct Selection;
+
+    // A history request, and then its response, tagged with the connection
+    // that asked: its descriptor may be reused by the time the answer comes.
+    struct HistoryJob {
+        int fd = -1;
+        std::uint64_t serial = 0;
+        std::vector<std::string> words;
+        bool ok = false;
+        std::string body;
+    };
+
+    // Latest value of every series, owned by the serving thread.
+    struct FieldTable {
+        std::unordered_map<std::string, std::uint32_t> ids; // by series label
+        std::vector<std::string> labels;
+        std::vector<std::string> names;
+        std::vector<std::string> keys;  // `"label":` as it appears in a diff
+        std::vector<std::uint64_t> bits;
+        std::vector<std::uint64_t> changedSeq;
+        std::vector<std::uint64_t> seenSeq;
+        std::uint64_t seq = 0; // samples applied
+        std::int64_t timestampMs = 0;
+    };
+
+    void run();
+    void accept();
+    void receive(Connection& connection);
+    void process(Connection& connection);
+    void handle(Connection& connection, const std::string& line);
+    void respond(Connection& connection, bool ok, std::string body);
+    void sendSnapshot(Connection& connection, const std::shared_ptr<const Encoded>& encoded);
+    void deliverUpdates();
+    void applyFields(const Encoded& encoded);
+    std::shared_ptr<Selection> selection(std::vector<std::string> selectors);
+    bool watchDue(const Connection& connection) const;
+    void sendDiff(Connection& connection);
+    bool flush(Connection& connection);
+    void close(int fd);
+    void runHistory();
+    void deliverHistory();
+
+    ApiOptions options_;
+    int listenFd_ = -1;
+    int epollFd_ = -1;
+    int wakeFd_ = -1;
+    int historyFd_ = -1; // signalled when the worker finished a job
+
+    mutable std::mutex mutex_;
+    std::shared_ptr<const Encoded> latest_;
+    ApiStats stats_;
+
+    // Owned by the serving thread.
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    std::shared_ptr<const Encoded> delivered_;
+    FieldTable fields_;
+    std::map<std::string, std::weak_ptr<Selection>> selections_;
+    // Diffs encoded for the current sample, by selection and starting sample.
+    std::map<std::pair<std::uint64_t, std::uint64_t>, std::shared_ptr<const std::string>> diffs_;
+    std::uint64_t nextSelection_ = 1;
+    std::uint64_t nextSerial_ = 1;
+
+    // Shared with the history worker.
+    std::mutex historyMutex_;
+    std::condition_variable historyReady_;
+    std::deque<HistoryJob> historyJobs_;
+    std::vector<HistoryJob> historyDone_;
+
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+    std::thread historyThread_;
+};
+
+// A snapshot older than this many daemon intervals is stale: its sampler
+// has stalled, and clients collect for themselves instead.
+constexpr std::int64_t kApiStaleIntervals = 3;
+
+// Connects to a daemon API socket; returns -1 when no daemon listens there
+// or when it runs as neither this user nor root.
+int connectApi(const std::string& path);
+// True when a snapshot response body is younger than kApiStaleIntervals of
+// the interval it reports.
+bool apiSnapshotFresh(const std::string& body, std::int64_t nowMs);
+// Sends one request line and returns the response body. Throws
+// std::runtime_error on transport errors and on error responses.
+std::string apiRequest(int fd, const std::string& request);
+// Reads the next response, e.g. of a subscription. Returns false at end of
+// stream; throws like apiRequest().
+bool readApiResponse(int fd, std::string& body);
+
+} // namespace statio
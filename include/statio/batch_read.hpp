@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/uio.h>
+#include <vector>
+
+namespace statio {
+
+enum class IoBackend { Auto, Pread, IoUring };
+
+// Parses "auto", "pread" or "uring".
+IoBackend parseIoBackend(const std::string& text);
+const char* ioBackendName(IoBackend backend);
+
+// Re-reads a set of small files (procfs, sysfs) through descriptors held
+// open, each into its own fixed-size buffer. With io_uring every read() is
+// one submission per ring-full of reads on registered files into one
+// registered buffer, so a sample of thousands of files costs a few
+// syscalls. Without it (kernel older than 5.1, io_uring disabled by sysctl
+// or seccomp, or IoBackend::Pread) each file is one pread(). Registration
+// is an optimization only: when the kernel refuses it (RLIMIT_MEMLOCK,
+// descriptor limits) the ring reads through plain descriptors and iovecs.
+class BatchReader {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // `fileBytes` bounds what is read of each file; longer files are cut.
+    explicit BatchReader(IoBackend backend = IoBackend::Auto, std::size_t fileBytes = 1024);
+    ~BatchReader();
+
+    BatchReader(const BatchReader&) = delete;
+    BatchReader& operator=(const BatchReader&) = delete;
+
+    // Opens `path` and returns its slot, or npos (errno set) when it cannot
+    // be opened. Slots of removed files are reused.
+    std::size_t add(const char* path);
+    // Like add() for a descriptor the caller opened; the reader closes it.
+    std::size_t adopt(int fd);
+    void remove(std::size_t slot);
+
+    // Reads every file from offset 0 and returns how many read without
+    // error.
+    std::size_t read();
+    // The bytes the last read() got for `slot`; empty after an error.
+    std::string_view data(std::size_t slot) const;
+    // errno of the last read of `slot`, 0 after a successful one.
+    int error(std::size_t slot) const { return slots_[slot].error; }
+    // The descriptor held for `slot`, e.g. to read past `fileBytes`.
+    int fd(std::size_t slot) const { return slots_[slot].fd; }
+
+    std::size_t size() const { return live_.size(); }
+    // Pread or IoUring: what read() uses, after any fallback.
+    IoBackend backend() const { return ring_ != nullptr ? IoBackend::IoUring : IoBackend::Pread; }
+    bool registeredFiles() const;
+    bool registeredBuffers() const;
+
+private:
+    struct Slot {
+        int fd = -1;
+        std::uint32_t length = 0;
+        int error = 0;
+        std::size_t live = npos; // index in live_
+    };
+    struct Ring;
+
+    void readPread();
+    bool readRing(); // false: the kernel cannot do these reads, fall back
+    void growBuffers(std::size_t slots);
+
+    std::size_t fileBytes_;
+    std::vector<Slot> slots_;
+    std::vector<std::size_t> live_; // slots holding a file
+    std::vector<std::size_t> free_;
+    std::vector<char> buffer_;      // fileBytes_ per slot
+    std::vector<iovec> iovecs_;     // per slot, for unregistered buffers
+    std::size_t capacity_ = 0;      // slots buffer_ has room for
+    std::unique_ptr<Ring> ring_;
+};
+
+} // namespace statio
@@ -0,0 +1,468 @@
+#pragma once
+
+#include "statio/system_info.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace statio {
+
+// One logical CPU as described by /sys/devices/system/cpu. `core` is unique
+// across packages (SMT siblings share it); `llc` is the lowest-numbered CPU
+// sharing this CPU's last-level cache, i.e. the CCX on chiplet parts.
+struct CpuPlacement {
+    int cpu = 0;
+    int package = 0;
+    int core = 0;
+    int llc = 0;
+};
+
+// Online CPUs this process may run on, in id order.
+std::vector<CpuPlacement> readCpuTopology();
+// Parses a kernel CPU list such as "0-3,8,10-11".
+std::vector<int> parseCpuList(const std::string& text);
+// Pins the calling thread to `cpu`; false when that is not allowed.
+bool pinCurrentThread(int cpu);
+
+// How two CPUs relate, from closest to farthest.
+enum class CpuRelation : std::uint8_t { Same, SmtSibling, SharedCache, SamePackage, CrossPackage };
+constexpr std::size_t kCpuRelationCount = 5;
+
+CpuRelation cpuRelation(const CpuPlacement& a, const CpuPlacement& b);
+const char* cpuRelationName(CpuRelation relation);
+
+// Fixed-size log-linear histogram of nanosecond values: 64 buckets per power
+// of two (1/64 relative resolution) over the whole 64-bit range in 30 KB.
+// record() never allocates or locks; give every writer thread its own and
+// merge() them afterwards.
+class LatencyHistogram {
+public:
+    void record(std::uint64_t ns);
+    void merge(const LatencyHistogram& other);
+
+    std::uint64_t count() const { return count_; }
+    std::uint64_t min() const { return count_ == 0 ? 0 : min_; }
+    std::uint64_t max() const { return max_; }
+    double mean() const { return count_ == 0 ? 0.0 : static_cast<double>(sum_) / static_cast<double>(count_); }
+    // The bucket midpoint holding rank ceil(q * count), clamped to min..max.
+    double quantile(double q) const;
+
+private:
+    static constexpr int kSubBits = 6;
+    static constexpr std::size_t kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+    std::array<std::uint64_t, kBuckets> buckets_ {};
+    std::uint64_t count_ = 0;
+    std::uint64_t sum_ = 0;
+    std::uint64_t min_ = ~0ULL;
+    std::uint64_t max_ = 0;
+};
+
+// Synthetic background load: one busy thread per CPU running a compute
+// kernel (dependent integer and floating-point chains) or a memory kernel
+// (read-modify-write sweeps over a 64 MB buffer per thread, past any LLC).
+enum class LoadKind : std::uint8_t { None, Cpu, Memory };
+
+// Accepts none, cpu and memory.
+LoadKind parseLoadKind(const std::string& text);
+
+class BackgroundLoad {
+public:
+    BackgroundLoad(LoadKind kind, const std::vector<int>& cpus);
+    ~BackgroundLoad();
+
+    BackgroundLoad(const BackgroundLoad&) = delete;
+    BackgroundLoad& operator=(const BackgroundLoad&) = delete;
+
+private:
+    std::atomic<bool> stopping_{false};
+    std::vector<std::thread> threads_;
+};
+
+// A directory made with mkdtemp() under `parent` (empty: the temporary
+// directory) and removed with everything in it. Throws std::runtime_error
+// when it cannot be made.
+class ScratchDirectory {
+public:
+    ScratchDirectory(const std::string& parent, const char* prefix);
+    ~ScratchDirectory();
+
+    ScratchDirectory(const ScratchDirectory&) = delete;
+    ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+// Core-to-core latency: two threads pinned to a CPU pair pass a counter
+// back and forth through one cache line. Every pair of the list is
+// measured; rounds of disjoint pairs run in parallel, with no physical
+// core busy twice in a round, so a 256-CPU matrix takes seconds.
+struct C2cOptions {
+    std::vector<int> cpus;          // empty: every CPU in readCpuTopology()
+    std::size_t roundTrips = 1000;  // per sample
+    std::size_t samples = 5;        // the median sample is reported
+    bool serial = false;            // one pair at a time
+};
+
+struct C2cResult {
+    std::vector<CpuPlacement> cpus;
+    // One-way latency in ns, row-major cpus x cpus, NaN on the diagonal.
+    std::vector<double> oneWayNs;
+    double elapsedSeconds = 0.0;
+
+    double at(std::size_t row, std::size_t col) const { return oneWayNs[row * cpus.size() + col]; }
+};
+
+// Throws std::runtime_error for fewer than two CPUs or a CPU that cannot be
+// pinned. `progress` is called after each round with pairs done and total.
+C2cResult runCoreToCore(const C2cOptions& options,
+                        const std::function<void(std::size_t done, std::size_t total)>& progress = {});
+
+// Scheduler wake-up latency, cyclictest style: one thread per CPU sleeps
+// with clock_nanosleep() to absolute deadlines `intervalUs` apart and
+// records how late it woke into its own preallocated histogram.
+struct WakeupOptions {
+    std::vector<int> cpus;            // empty: every CPU in readCpuTopology()
+    std::int64_t intervalUs = 1000;
+    std::int64_t durationMs = 10000;
+    int priority = 0;                 // SCHED_FIFO priority; 0 keeps SCHED_OTHER
+    LoadKind load = LoadKind::None;
+};
+
+// Latencies in microseconds. Percentiles come from a LatencyHistogram;
+// min, max and avg are exact.
+struct WakeupStats {
+    int cpu = -1; // -1 for the all-CPU row
+    std::uint64_t samples = 0;
+    double minUs = 0.0;
+    double avgUs = 0.0;
+    double p50Us = 0.0;
+    double p99Us = 0.0;
+    double p9999Us = 0.0;
+    double maxUs = 0.0;
+};
+
+struct WakeupResult {
+    std::vector<WakeupStats> perCpu;
+    WakeupStats all;
+    bool realtime = false; // false when SCHED_FIFO was asked for but refused
+};
+
+// Throws std::runtime_error for bad options or a CPU that cannot be pinned.
+WakeupResult runWakeupLatency(const WakeupOptions& options);
+
+// Contended synchronization throughput: every thread of a point hammers the
+// same primitive for `durationMs`. Threads are added in placement order, so
+// each curve shows how a primitive scales as the coherence domain widens.
+enum class SyncPrimitive : std::uint8_t { FetchAdd, Cas, Mutex, Spinlock, Sharded };
+constexpr std::size_t kSyncPrimitiveCount = 5;
+
+const char* syncPrimitiveName(SyncPrimitive primitive);
+
+// Placements: "smt" packs SMT siblings of one package first, "socket"
+// spreads over the physical cores of one package, "cross" alternates
+// between packages. A host without SMT or with one package skips the
+// placement that needs it.
+struct ContentionOptions {
+    std::vector<std::string> placements; // empty: smt, socket and cross
+    std::vector<int> cpus;               // explicit thread order; replaces the placements
+    std::vector<std::size_t> threads;    // empty: 1..4, then doubling, then the placement size
+    std::int64_t durationMs = 200;       // per primitive and point
+};
+
+struct ContentionPoint {
+    std::string placement;
+    std::size_t threads = 0;
+    CpuRelation widest = CpuRelation::Same; // farthest pair among the threads
+    std::array<double, kSyncPrimitiveCount> mopsPerSec {};
+    // Slowest thread's operations over the fastest's: 1 is perfectly fair.
+    std::array<double, kSyncPrimitiveCount> fairness {};
+};
+
+struct ContentionResult {
+    std::vector<ContentionPoint> points;
+    std::vector<std::string> skipped; // "cross: single package"
+};
+
+// Throws std::runtime_error for an unknown placement, a bad thread count
+// or a CPU that cannot be pinned. `progress` is called after each point.
+ContentionResult runContention(const ContentionOptions& options,
+                               const std::function<void(std::size_t done, std::size_t total)>& progress = {});
+
+// Loopback network stack cost: TCP, UDP and Unix socket flows between
+// epoll client and server threads of this process. Stream tests count what
+// the servers receive; rr keeps one request per connection in flight and
+// times every echo.
+struct NetOptions {
+    std::vector<std::string> transports; // tcp, udp, unix; empty: all three
+    std::vector<std::size_t> sizes;      // message bytes; empty: 64, 1024, 16384
+    std::size_t connections = 4;
+    std::size_t threads = 0;             // epoll threads per side; 0: min(connections, 4)
+    std::size_t batch = 32;              // datagrams per sendmmsg/recvmmsg call
+    std::int64_t durationMs = 1000;      // per case
+};
+
+struct NetCase {
+    std::string transport;
+    std::string test; // stream, stream-mmsg (udp), stream-zerocopy (tcp), rr
+    std::size_t size = 0;
+    double gbitPerSec = 0.0;     // payload received; NaN for rr and skipped cases
+    double messagesPerSec = 0.0; // messages received, or completed rr transactions
+    double p50Us = 0.0;          // rr round trip; NaN for stream tests
+    double p99Us = 0.0;
+    std::string note;
+};
+
+// Throws std::runtime_error for bad options or when loopback sockets cannot
+// be created. `progress` is called after each case.
+std::vector<NetCase> runNetBench(const NetOptions& options,
+                                 const std::function<void(std::size_t done, std::size_t total)>& progress = {});
+
+// Compression and crypto throughput: AES-128-CTR, SHA-256, CRC32C and the
+// history store's LZ codec over 1 MiB buffers. Every implementation this
+// CPU can run is measured (the hardware one is chosen from CpuInfo::flags,
+// the portable one always runs) after a known-answer self-test.
+struct CryptoOptions {
+    std::vector<std::string> algorithms; // aes, sha256, crc32c, lz; empty: all
+    std::size_t threads = 0;             // multi-threaded run; 0: every usable CPU
+    std::int64_t durationMs = 500;       // per implementation and thread count
+};
+
+struct CryptoResult {
+    std::string algorithm;      // aes-128-ctr, sha-256, crc32c, lz-compress, lz-decompress
+    std::string implementation; // aes-ni, armv8-aes, sha-ni, sse4.2, armv8-crc, portable
+    std::string flag;           // the cpuinfo flag it needs; empty for portable code
+    bool supported = true;      // false when the flag is missing or the build lacks the kernel
+    double singleGBps = 0.0;    // input bytes per second, 1e9 units
+    double multiGBps = 0.0;
+    std::size_t threads = 0;    // of the multi-threaded run
+    std::string note;
+};
+
+// Throws std::runtime_error for an unknown algorithm or when a kernel
+// fails its self-test. `progress` is called after each implementation.
+std::vector<CryptoResult> runCryptoBench(const CryptoOptions& options,
+                                         const std::function<void(std::size_t done, std::size_t total)>& progress = {});
+
+// Memory allocator throughput with whatever malloc the process runs on:
+// the linked one or an LD_PRELOADed jemalloc, tcmalloc or mimalloc.
+// "small", "medium" and "large" churn a per-thread set of live blocks,
+// freeing a random one and allocating a random size in its place;
+// "cross-free" passes every block to the next thread, which frees it;
+// "handoff" pairs producers that only allocate with consumers that only
+// free. Memory growth comes from VmRSS and VmHWM in /proc/self/status,
+// with the peak reset through /proc/self/clear_refs before every case.
+struct AllocOptions {
+    std::vector<std::string> patterns; // small, medium, large, cross-free, handoff; empty: all
+    std::vector<std::size_t> threads;  // empty: 1..4, then doubling, then every usable CPU
+    std::int64_t durationMs = 500;     // per pattern and thread count
+};
+
+struct AllocCase {
+    std::string pattern;
+    std::size_t threads = 0;
+    double opsPerSec = 0.0;    // allocations (each with its free) per second, all threads; NaN when skipped
+    double peakGrowthMB = 0.0; // VmHWM during the case over VmRSS before it; NaN when unknown
+    double retainedMB = 0.0;   // VmRSS after every block was freed, over VmRSS before
+    std::string note;
+};
+
+struct AllocResult {
+    std::string allocator; // "glibc 2.39", "jemalloc (LD_PRELOAD)", ...
+    std::vector<AllocCase> cases;
+};
+
+// Throws std::runtime_error for an unknown pattern, a zero thread count or
+// when malloc fails. `progress` is called after each case.
+AllocResult runAllocBench(const AllocOptions& options,
+                          const std::function<void(std::size_t done, std::size_t total)>& progress = {});
+
+// TLB reach: random access over one buffer backed by 4 KiB pages
+// (MADV_NOHUGEPAGE), transparent huge pages (MADV_HUGEPAGE), or 2 MiB
+// and 1 GiB hugetlb pages (MAP_HUGETLB). "chase" follows a random cycle
+// through every cache line, one dependent load at a time; "gather" issues
+// independent random loads, so many misses overlap. Both miss the caches
+// alike, and the difference between page sizes is the page walks.
+struct TlbOptions {
+    std::vector<std::string> pages; // 4k, thp, 2m, 1g; empty: all
+    std::size_t sizeMB = 1024;      // rounded up to whole pages of each size
+    std::size_t accesses = 1U << 24;
+};
+
+struct TlbCase {
+    std::string page;
+    std::size_t bytes = 0;
+    double chaseNs = 0.0;  // per access; NaN when the pages were unavailable
+    double gatherNs = 0.0;
+    double hugeFraction = 0.0; // share of the buffer the kernel backed with huge pages
+    std::string note;
+};
+
+struct TlbResult {
+    HugePageInfo hugepages; // before the run
+    std::vector<TlbCase> cases;
+};
+
+// Throws std::runtime_error for an unknown page size or a buffer larger
+// than half of the available memory. `progress` is called after each case.
+TlbResult runTlbBench(const TlbOptions& options,
+                      const std::function<void(std::size_t done, std::size_t total)>& progress = {});
+
+// Re-reading many small files per sample, as collectors do with procfs
+// and sysfs: open, getline and close through std::ifstream every time
+// (how the one-shot collectors read), pread() on descriptors held open,
+// and a BatchReader on io_uring. "cpufreq" and "netdev" are synthetic
+// trees of regular files under `directory`, shaped like
+// /sys/devices/system/cpu/cpuN/cpufreq/scaling_cur_freq for `cpus` CPUs
+// and like the five files readLinkState() reads for each of `interfaces`
+// interfaces; "proc" and "sysfs" re-read this host's /proc/<pid>/stat and
+// /sys/class/net/*/statistics/* files.
+struct FilesOptions {
+    std::vector<std::string> trees; // cpufreq, netdev, proc, sysfs; empty: all
+    std::size_t cpus = 512;
+    std::size_t interfaces = 5000;
+    std::size_t samples = 20;
+    std::string directory; // empty: a temporary directory, removed afterwards
+};
+
+struct FilesCase {
+    std::string tree;
+    std::size_t files = 0; // read per sample; fewer than the tree under a low descriptor limit
+    double ifstreamUs = 0.0; // median time of one sample
+    double preadUs = 0.0;
+    double uringUs = 0.0; // NaN when io_uring is unavailable
+    std::string note;
+};
+
+struct FilesResult {
+    std::string uring; // how the ring reads: registered files and buffers, or why it cannot
+    std::vector<FilesCase> cases;
+};
+
+// Throws std::runtime_error for an unknown tree or when the synthetic
+// trees cannot be written. `progress` is called after each tree.
+FilesResult runFilesBench(const FilesOptions& options,
+                          const std::function<void(std::size_t done, std::size_t total)>& progress = {});
+
+// ProcScanner over a synthetic /proc of `tasks` processes (a directory of
+// <pid>/stat files like the kernel's) or this host's /proc, once per
+// worker count in `workers` and once with the count the scanner picks.
+struct ProcScanOptions {
+    std::vector<std::size_t> workers = {1, 2, 4, 8};
+    std::size_t tasks = 200000;
+    bool host = false;     // scan /proc instead of a synthetic tree
+    std::size_t samples = 5;
+    std::string directory; // empty: a temporary directory, removed afterwards
+};
+
+struct ProcScanCase {
+    std::size_t workers = 0; // 0: chosen by the scanner
+    std::size_t used = 0;    // workers the scan ran on, after the small-host cut
+    std::size_t rows = 0;
+    double scanMs = 0.0;     // median time of one scan
+};
+
+struct ProcScanResult {
+    std::string root;
+    std::size_t cpus = 0; // usable by this process
+    std::vector<ProcScanCase> cases;
+};
+
+// Throws std::runtime_error when the synthetic tree cannot be written.
+// `progress` is called after each case.
+ProcScanResult runProcScanBench(const ProcScanOptions& options,
+                                const std::function<void(std::size_t done, std::size_t total)>& progress = {});
+
+// Filesystem metadata rates and sync latency, per mount. Each mount gets a
+// scratch directory in its root (removed afterwards): `threads` workers
+// create, stat, rename and unlink `files` files each in their own
+// subdirectory, one phase at a time, then a single writer appends
+// `appendBytes` and calls fsync() or fdatasync() `syncs` times each.
+struct FsBenchOptions {
+    std::vector<std::string> mounts; // empty: every mount collectDiskInfo() reports
+    std::string directory;           // benchmark this directory instead of the mounts
+    std::size_t threads = 4;
+    std::size_t files = 1000;        // per thread
+    std::size_t syncs = 200;         // per sync call
+    std::size_t appendBytes = 4096;
+};
+
+struct SyncLatency {
+    std::uint64_t samples = 0;
+    double p50Us = 0.0;
+    double p99Us = 0.0;
+    double maxUs = 0.0;
+};
+
+struct FsResult {
+    std::string path; // mount point, or FsBenchOptions::directory
+    std::string filesystem;
+    std::string device;
+    std::string writeCache; // /sys/block/<dev>/queue/write_cache, empty when unknown
+    double createPerSec = 0.0;
+    double statPerSec = 0.0;
+    double renamePerSec = 0.0;
+    double unlinkPerSec = 0.0;
+    SyncLatency fsync;
+    SyncLatency fdatasync;
+    std::vector<std::string> warnings; // suspiciously fast or slow syncs
+    std::string error;                 // set when the path could not be benchmarked
+};
+
+// Throws std::runtime_error for bad options. `progress` is called after
+// each path.
+std::vector<FsResult> runFsBench(const FsBenchOptions& options,
+                                 const std::function<void(std::size_t done, std::size_t total)>& progress = {});
+
+// Basic OS operation costs: syscall, context switch, thread creation, page
+// faults, mmap/munmap with and without TLB shootdowns. Every test runs
+// `repeats` times on pinned threads; the median and the best repeat are
+// reported per operation.
+struct OsBenchOptions {
+    std::vector<std::string> tests; // empty: every name in osBenchTests()
+    std::size_t repeats = 5;
+    // Context-switch pair. One entry (or none: the first usable CPU) pins
+    // both threads to the same CPU, which measures a real switch; two
+    // entries measure a cross-CPU wake-up instead.
+    std::vector<int> cpus;
+    std::string directory; // scratch file for major faults; empty: $TMPDIR, else /var/tmp
+};
+
+struct OsCost {
+    std::string test;
+    double medianNs = 0.0; // NaN when the test could not run here
+    double minNs = 0.0;
+    std::uint64_t operations = 0; // per repeat
+    std::string note;
+};
+
+struct OsBenchResult {
+    OsInfo os;
+    std::string hypervisor; // empty on bare metal
+    // /sys/devices/system/cpu/vulnerabilities, e.g. {"meltdown", "Mitigation: PTI"}.
+    std::vector<std::pair<std::string, std::string>> mitigations;
+    std::vector<OsCost> costs;
+};
+
+// Test names in run order.
+const std::vector<std::string>& osBenchTests();
+
+// Names the hypervisor when the CPU reports running under one; empty on
+// bare metal.
+std::string detectHypervisor();
+
+// Throws std::runtime_error for an unknown test or a CPU that cannot be
+// pinned. `progress` is called after each test.
+OsBenchResult runOsCosts(const OsBenchOptions& options,
+                         const std::function<void(std::size_t done, std::size_t total)>& progress = {});
+
+} // namespace statio
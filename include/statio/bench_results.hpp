@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace statio {
+
+// What a result was measured on. Two runs only compare cleanly when these
+// match; compareBenchRuns() lists the fields that differ.
+struct HostInventory {
+    std::string hostname;
+    std::string cpuModel;
+    unsigned int logicalThreads = 0;
+    unsigned int physicalCores = 0;
+    std::string architecture;
+    std::string kernel;
+    std::string distro;
+    std::string hypervisor; // empty on bare metal
+    std::uint64_t memoryMB = 0;
+    std::uint64_t swapMB = 0;
+    unsigned int numaNodes = 0;
+    std::string transparentHugepages; // always, madvise or never
+};
+
+HostInventory collectHostInventory();
+
+// One metric of a recorded run, with one sample per repetition.
+struct BenchMetric {
+    std::string name;     // e.g. "crypto.aes-128-ctr.aes-ni"
+    std::string category; // cpu, coherence, os, network, storage
+    std::string unit;
+    bool higherIsBetter = true;
+    std::vector<double> samples;
+};
+
+struct BenchRun {
+    std::int64_t timestampMs = 0;
+    std::string label;
+    HostInventory host;
+    std::vector<BenchMetric> metrics;
+};
+
+// Results file: the 8-byte magic "STATIOB1", then one record per run,
+//   u32 magic "RUN1" | u32 raw bytes | u32 stored bytes | LZ payload
+// where the payload is varint-length strings, varints and f64s in host
+// byte order, like the history store. Runs are only ever appended, so a
+// file accumulates a host's history and can be copied to compare hosts.
+void appendBenchRun(const std::string& path, const BenchRun& run);
+// Throws std::runtime_error for a missing, foreign or corrupt file.
+std::vector<BenchRun> readBenchRuns(const std::string& path);
+
+// The record suite: short versions of the crypto, contention, c2c, os,
+// wakeup, net and fs benchmarks, repeated `runs` times so that every
+// metric carries enough samples for a confidence interval.
+struct RecordOptions {
+    std::size_t runs = 5;
+    std::vector<std::string> categories; // empty: every category
+    std::string directory = ".";         // scratch space for the storage tests
+    std::string label;
+};
+
+// Category names in suite order.
+const std::vector<std::string>& benchCategories();
+
+// Throws std::runtime_error for an unknown category. `progress` is called
+// after each benchmark of each repetition.
+BenchRun recordBenchSuite(const RecordOptions& options,
+                          const std::function<void(std::size_t done, std::size_t total)>& progress = {});
+
+enum class BenchChange : std::uint8_t { Noise, Better, Worse };
+
+// Candidate against baseline for one metric. The delta and its 95%
+// confidence interval (Welch's t) are percentages of the baseline mean; a
+// change is significant when the interval excludes zero.
+struct MetricComparison {
+    std::string name;
+    std::string category;
+    std::string unit;
+    bool higherIsBetter = true;
+    double baselineMean = 0.0;
+    double candidateMean = 0.0;
+    double deltaPct = 0.0;
+    double ciLowPct = 0.0; // NaN with fewer than two samples on a side
+    double ciHighPct = 0.0;
+    BenchChange change = BenchChange::Noise;
+};
+
+// Geometric mean of the per-metric ratios, oriented so that higher is
+// better, times 100: the baseline scores 100 in every category.
+struct CategoryScore {
+    std::string category;
+    double score = 0.0;
+    std::size_t metrics = 0;
+};
+
+struct BenchComparison {
+    std::vector<MetricComparison> metrics; // present in both runs
+    std::vector<CategoryScore> scores;
+    std::vector<std::string> missing;          // metrics only one run has
+    std::vector<std::string> hostDifferences;  // "kernel: 6.8.0 -> 6.11.2"
+};
+
+BenchComparison compareBenchRuns(const BenchRun& baseline, const BenchRun& candidate);
+
+} // namespace statio
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "statio/batch_read.hpp"
+#include "statio/history.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace statio {
+
+// Collectors that can run at burst rate, combinable as a bit mask.
+enum BurstCollector : unsigned {
+    BurstCpu = 1u << 0,     // per-core jiffies from /proc/stat
+    BurstNetwork = 1u << 1, // interface byte counters from /proc/net/dev
+    BurstDisk = 1u << 2,    // whole-device counters from /proc/diskstats
+    BurstAll = BurstCpu | BurstNetwork | BurstDisk,
+};
+
+// Parses "cpu,net,disk" (or "all") into a BurstCollector mask.
+unsigned parseBurstCollectors(const std::string& list);
+
+// Bounded single-producer/single-consumer queue. Slots are allocated once and
+// written in place, so values that own memory (vectors) keep their capacity
+// from lap to lap and the steady state does not allocate.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(std::size_t capacity) : slots_(roundUp(capacity)), mask_(slots_.size() - 1) {}
+
+    // Producer side: the next free slot, or nullptr when the ring is full.
+    T* claim() {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+            return nullptr;
+        }
+        return &slots_[tail & mask_];
+    }
+    void publish() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer side: the oldest published slot, or nullptr when empty.
+    T* front() {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots_[head & mask_];
+    }
+    void pop() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    std::size_t capacity() const { return slots_.size(); }
+
+private:
+    static std::size_t roundUp(std::size_t n) {
+        std::size_t size = 2;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    std::vector<T> slots_;
+    std::size_t mask_;
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+// Reads the burst collectors through file descriptors opened once and re-read
+// with pread(), parsing the text in place. Every value lands in a slot of a
+// flat vector; slots are assigned as cores, interfaces or devices first
+// appear and never move.
+class BurstSampler {
+public:
+    // Files up to this size are read in the batch; longer ones (/proc/stat
+    // with thousands of CPUs) are re-read with pread() until they fit.
+    static constexpr std::size_t kBatchFileBytes = 64U << 10;
+
+    // `io` selects how the held descriptors are re-read; see BatchReader.
+    explicit BurstSampler(unsigned collectors, IoBackend io = IoBackend::Pread);
+    ~BurstSampler();
+
+    BurstSampler(const BurstSampler&) = delete;
+    BurstSampler& operator=(const BurstSampler&) = delete;
+
+    // Fills `values` (resized to seriesCount(), NaN for series not seen this
+    // time) and returns false when no source could be read.
+    bool sample(std::vector<double>& values);
+
+    std::size_t seriesCount() const { return series_.size(); }
+    // Series description for slot `index`; safe against concurrent sample()
+    // calls, which may append slots.
+    MetricSample describe(std::size_t index) const;
+
+private:
+    struct Source {
+        std::size_t slot = BatchReader::npos; // in reader_
+        unsigned collector = 0;
+        std::vector<std::string> lineNames;  // entity seen on each line last time
+        std::vector<std::size_t> lineSlots;  // first slot of that entity, npos if skipped
+    };
+
+    bool read(Source& source);
+    std::size_t slotsFor(Source& source, std::size_t line, std::string_view entity);
+    void parseStat(Source& source, std::vector<double>& values);
+    void parseNetDev(Source& source, std::vector<double>& values);
+    void parseDiskstats(Source& source, std::vector<double>& values);
+
+    std::vector<Source> sources_;
+    BatchReader reader_;
+    std::string buffer_;   // for files longer than kBatchFileBytes
+    std::string_view text_; // what read() got
+    std::map<std::string, std::size_t> slotIndex_;
+    mutable std::mutex seriesMutex_;
+    std::vector<MetricSample> series_;
+};
+
+// A PSI trigger such as "cpu:some:150ms/1s": fire when tasks stalled on the
+// resource for more than 150 ms within any 1 s window.
+struct PsiTriggerSpec {
+    std::string resource; // cpu, memory or io
+    std::string line;     // what is written to /proc/pressure/<resource>
+};
+
+PsiTriggerSpec parsePsiTrigger(const std::string& text);
+
+struct BurstOptions {
+    unsigned collectors = BurstAll;
+    std::int64_t intervalMs = 100;
+    std::int64_t windowMs = 30000;  // used by triggers that do not name a window
+    std::int64_t maxWindowMs = 300000; // no trigger extends a burst further than this from now
+    std::size_t ringFrames = 4096;
+    std::vector<PsiTriggerSpec> psi;
+    std::string controlSocket; // unix datagram socket accepting "burst [duration]"
+    IoBackend io = IoBackend::Pread;
+    bool quiet = false;
+};
+
+struct BurstStats {
+    std::uint64_t bursts = 0;
+    std::uint64_t frames = 0;
+    std::uint64_t dropped = 0; // ring full: the history writer fell behind
+    std::uint64_t late = 0;    // published after a newer row was written
+};
+
+// Samples the selected collectors every `intervalMs` on its own thread while a
+// burst is active, and sleeps in poll() otherwise. Bursts start through
+// trigger() (rules, anomalies), SIGUSR1, a PSI trigger or a "burst" message on
+// the control socket; a trigger during a burst extends it. Frames go through
+// an SpscRing, so the sampling thread never waits for the history writer and
+// a stalled writer costs dropped frames, not memory.
+class BurstController {
+public:
+    explicit BurstController(BurstOptions options);
+    ~BurstController();
+
+    BurstController(const BurstController&) = delete;
+    BurstController& operator=(const BurstController&) = delete;
+
+    // Thread-safe; durationMs <= 0 uses the configured window.
+    void trigger(std::int64_t durationMs, const std::string& reason);
+    bool active() const;
+
+    // Hands frames stamped before `beforeMs` to `append`, oldest first. The
+    // sample vector only carries the burst series and is reused between calls.
+    void drain(std::int64_t beforeMs,
+               const std::function<void(std::int64_t, const std::vector<MetricSample>&)>& append);
+
+    BurstStats stats() const;
+
+    // Routes SIGUSR1 to the most recently created controller.
+    static void installSignalHandler();
+
+private:
+    struct Frame {
+        std::int64_t timestampMs = 0;
+        std::vector<double> values;
+    };
+
+    void run();
+    void wake();
+    void handleControlMessage();
+    void log(const std::string& message) const;
+
+    BurstOptions options_;
+    BurstSampler sampler_;
+    SpscRing<Frame> ring_;
+    int wakeFd_ = -1;
+    int controlFd_ = -1;
+    std::vector<int> psiFds_;
+
+    std::atomic<std::int64_t> deadlineMs_{0}; // steady clock
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::uint64_t> bursts_{0};
+    std::atomic<std::uint64_t> frames_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+    std::uint64_t late_ = 0;
+
+    // Consumer-side state.
+    std::vector<MetricSample> samples_;
+    std::int64_t drainedBeforeMs_ = 0;
+
+    std::thread thread_;
+};
+
+// Sends a "burst" message to a daemon's control socket.
+void sendBurstRequest(const std::string& socketPath, std::int64_t durationMs);
+
+} // namespace statio
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace statio {
+
+// Parsed `--key value` / `--key=value` options, boolean flags and positionals
+// for one subcommand. Unknown options raise std::runtime_error.
+class CommandLine {
+public:
+    CommandLine(const std::vector<std::string>& args,
+                const std::set<std::string>& valueOptions,
+                const std::set<std::string>& flagOptions = {});
+
+    bool has(const std::string& name) const;
+    std::string value(const std::string& name, const std::string& fallback = {}) const;
+    double number(const std::string& name, double fallback) const;
+    std::int64_t integer(const std::string& name, std::int64_t fallback) const;
+    const std::vector<std::string>& positional() const { return positional_; }
+
+private:
+    std::map<std::string, std::string> values_;
+    std::set<std::string> flags_;
+    std::vector<std::string> positional_;
+};
+
+// Parses durations such as "500ms", "10s", "5m", "2h", "1d" (bare numbers are seconds).
+// Negative, non-finite and out-of-range durations throw std::runtime_error.
+std::int64_t parseDurationMs(const std::string& text);
+
+// Splits a comma-separated option value, dropping empty items.
+std::vector<std::string> splitList(const std::string& text);
+
+} // namespace statio
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace statio {
+
+// Subcommand entry points for the `statio` CLI. Each receives the arguments
+// after the subcommand name and returns the process exit code.
+int runDaemonCommand(const std::vector<std::string>& args);
+int runCompactCommand(const std::vector<std::string>& args);
+int runBurstCommand(const std::vector<std::string>& args);
+int runQueryCommand(const std::vector<std::string>& args);
+int runRulesCommand(const std::vector<std::string>& args);
+int runAnomaliesCommand(const std::vector<std::string>& args);
+int runAgentCommand(const std::vector<std::string>& args);
+int runFleetCommand(const std::vector<std::string>& args);
+int runReceiveCommand(const std::vector<std::string>& args);
+int runApiCommand(const std::vector<std::string>& args);
+int runBenchCommand(const std::vector<std::string>& args);
+int runTopCommand(const std::vector<std::string>& args);
+// `statio --fields LIST ...`: receives every argument, --fields included.
+int runFieldsCommand(const std::vector<std::string>& args);
+
+} // namespace statio
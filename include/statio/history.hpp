@@ -0,0 +1,215 @@
+#pragma once
+
+#include "statio/sketch.hpp"
+#include "statio/system_info.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace statio {
+
+// How a series is interpreted. Counters are cumulative and only meaningful
+// through rate(); distributions carry a sketch of the observations made since
+// the previous sample, with `value` holding their mean.
+enum class MetricKind : std::uint8_t { Gauge = 0, Counter = 1, Distribution = 2 };
+
+// One flattened metric value. `entity` names the core, mount or interface the
+// value belongs to and is empty for host-wide metrics.
+struct MetricSample {
+    std::string name;
+    std::string entity;
+    double value = 0.0;
+    MetricKind kind = MetricKind::Gauge;
+    QuantileSketch sketch; // distributions only
+};
+
+// (name, entity) identifying one series.
+using SeriesKey = std::pair<std::string, std::string>;
+
+std::vector<MetricSample> flattenSnapshot(const SystemSnapshot& snapshot);
+std::string seriesLabel(std::string_view name, std::string_view entity);
+
+// Field selectors pick series by a glob over their label
+// ("network.rx_bytes{eth0}") or name ("memory.*"), or by a name prefix that
+// ends at a dot ("cpu"). An empty list picks every series.
+bool fieldSelected(const std::vector<std::string>& selectors, std::string_view name, std::string_view label);
+// The snapshot sources the picked series are flattened from. Throws
+// std::runtime_error for a selector that can match no series.
+unsigned fieldSources(const std::vector<std::string>& selectors);
+// Drops the series the selectors do not pick.
+void retainFields(std::vector<MetricSample>& samples, const std::vector<std::string>& selectors);
+// Collects only what the selectors need and returns the picked series.
+std::vector<MetricSample> collectFields(const std::vector<std::string>& selectors);
+std::int64_t currentTimeMs();
+
+struct HistoryOptions {
+    std::string directory;
+    std::size_t blockRows = 300;
+    std::int64_t segmentMs = 3600LL * 1000LL;
+};
+
+// Owns the currently open segment file of a history directory. Segments are
+// named `segment-<first-ms>.sts` and rotate every `segmentMs`.
+class SegmentAppender {
+public:
+    SegmentAppender(std::string directory, std::int64_t segmentMs, std::string fileHeader);
+
+    bool needsRotation(std::int64_t timestampMs) const;
+    void open(std::int64_t timestampMs);
+    std::ofstream& stream() { return segment_; }
+    bool isOpen() const { return segment_.is_open(); }
+
+private:
+    std::string directory_;
+    std::int64_t segmentMs_;
+    std::string fileHeader_;
+    std::ofstream segment_;
+    std::int64_t segmentStartMs_ = 0;
+};
+
+// Appends samples to raw segment files. Rows are buffered in memory and
+// written as one columnar block every `blockRows` samples; the block header
+// carries the min/max timestamp so readers can skip it unread. Distribution
+// samples additionally store their encoded sketch per row.
+class HistoryWriter {
+public:
+    explicit HistoryWriter(HistoryOptions options);
+    ~HistoryWriter();
+
+    HistoryWriter(const HistoryWriter&) = delete;
+    HistoryWriter& operator=(const HistoryWriter&) = delete;
+
+    void append(std::int64_t timestampMs, const std::vector<MetricSample>& samples);
+    void flush();
+
+private:
+    HistoryOptions options_;
+    SegmentAppender appender_;
+    std::vector<std::int64_t> timestamps_;
+    std::vector<SeriesKey> series_;
+    std::vector<MetricKind> kinds_;
+    std::unordered_map<std::string, std::size_t> seriesIndex_;
+    std::vector<std::vector<double>> columns_;
+    std::vector<std::vector<std::string>> sketches_; // empty unless a distribution
+};
+
+// Aggregate of one series over one rollup bucket. For distributions the
+// statistics describe the underlying observations, not the per-sample means.
+// Counters keep no sketch: their percentiles carry no meaning.
+struct RollupCell {
+    MetricKind kind = MetricKind::Gauge;
+    double min = 0.0;
+    double max = 0.0;
+    double sum = 0.0;
+    std::uint64_t count = 0;
+    double last = 0.0;
+    std::int64_t lastMs = 0;
+    QuantileSketch sketch;
+
+    void add(std::int64_t timestampMs, double value);
+    // Folds in one distribution sample: its observations and its mean.
+    void addDistribution(std::int64_t timestampMs, double mean, const QuantileSketch& observations);
+    void merge(const RollupCell& other);
+};
+
+// Appends rollup rows (one per bucket) to the segment files of a tier
+// directory. Segments record the tier resolution in their file header.
+class RollupWriter {
+public:
+    RollupWriter(HistoryOptions options, std::int64_t resolutionMs);
+    ~RollupWriter();
+
+    RollupWriter(const RollupWriter&) = delete;
+    RollupWriter& operator=(const RollupWriter&) = delete;
+
+    void append(std::int64_t bucketMs, const std::map<SeriesKey, RollupCell>& cells);
+    void flush();
+
+private:
+    HistoryOptions options_;
+    std::int64_t resolutionMs_;
+    SegmentAppender appender_;
+    std::vector<std::int64_t> timestamps_;
+    std::vector<std::map<SeriesKey, RollupCell>> rows_;
+};
+
+// A decoded view into one mapped block. Only columns accepted by the scan
+// predicate are present; missing samples are stored as NaN.
+struct HistoryBlock {
+    struct Column {
+        std::string_view name;
+        std::string_view entity;
+        MetricKind kind = MetricKind::Gauge;
+        // Raw blocks: one value per row (the mean for distributions).
+        const double* values = nullptr;
+        // Rollup blocks: per-bucket statistics (count 0 = no samples).
+        // Rollup and raw distribution columns keep the encoded sketch of row i
+        // at sketchBytes[sketchOffsets[i]..[i + 1]]; use columnSketch() to
+        // read it. Rollup buckets with min == max and counters store none.
+        const double* min = nullptr;
+        const double* max = nullptr;
+        const double* sum = nullptr;
+        const double* count = nullptr;
+        const double* last = nullptr;
+        const std::uint32_t* sketchOffsets = nullptr;
+        const unsigned char* sketchBytes = nullptr;
+        std::size_t sketchByteCount = 0; // bytes readable at sketchBytes
+    };
+
+    // Zero for raw samples, otherwise the bucket width of a rollup tier.
+    std::int64_t resolutionMs = 0;
+    std::int64_t minMs = 0;
+    std::int64_t maxMs = 0;
+    std::size_t rows = 0;
+    const std::int64_t* timestamps = nullptr;
+    std::vector<Column> columns;
+};
+
+// Decodes the sketch of row `row` of a rollup or raw distribution column,
+// rebuilding it from min/count when a rollup bucket stored none. Returns an
+// empty sketch for plain raw columns.
+QuantileSketch columnSketch(const HistoryBlock::Column& column, std::size_t row);
+
+struct HistoryScanStats {
+    std::size_t segmentsOpened = 0;
+    std::size_t blocksRead = 0;
+    std::size_t blocksSkipped = 0;
+};
+
+struct HistoryRange {
+    bool empty = true;
+    std::int64_t firstMs = 0;
+    std::int64_t lastMs = 0;
+};
+
+using SeriesPredicate = std::function<bool(std::string_view name, std::string_view entity)>;
+
+class HistoryReader {
+public:
+    explicit HistoryReader(std::string directory);
+
+    // Visits blocks overlapping [fromMs, toMs] in time order. Segments and
+    // blocks outside the range are skipped from their index headers alone.
+    HistoryScanStats scan(std::int64_t fromMs,
+                          std::int64_t toMs,
+                          const SeriesPredicate& select,
+                          const std::function<void(const HistoryBlock&)>& visit) const;
+
+    // Oldest and newest timestamps of all complete blocks on disk.
+    HistoryRange range() const;
+
+private:
+    std::string directory_;
+};
+
+// Deletes segments whose successor starts at or before `cutoffMs`, i.e.
+// whose samples are all older than the cutoff. The newest segment is kept.
+std::size_t removeSegmentsBefore(const std::string& directory, std::int64_t cutoffMs);
+
+} // namespace statio
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "statio/history.hpp"
+#include "statio/system_info.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace statio {
+
+// Whether a /proc/diskstats name is a whole disk worth reporting (not a
+// partition, loop or ram device).
+bool isWholeBlockDevice(const std::string& name);
+
+// Gathers latency observations between two snapshots into one sketch per
+// series. poll() may run many times per snapshot interval; each call turns
+// the counter deltas since the previous call into observations of
+//   disk.await_ms{device}  mean time per completed I/O (/proc/diskstats)
+//   sched.delay_us{cpuN}   mean runqueue wait per timeslice (/proc/schedstat)
+// Other latencies (e.g. the collector's own) are fed through record().
+class LatencySampler {
+public:
+    void poll();
+    void record(const std::string& name, const std::string& entity, double value);
+    // Returns the non-empty sketches gathered since the previous call and
+    // starts new ones. Sketch memory is reused, so steady-state polling does
+    // not grow.
+    std::vector<DistributionInfo> drain();
+
+private:
+    struct IoCounters {
+        std::uint64_t completed = 0;
+        std::uint64_t busyMs = 0;
+    };
+    struct SchedCounters {
+        std::uint64_t waitNs = 0;
+        std::uint64_t timeslices = 0;
+    };
+
+    void pollDisks();
+    void pollScheduler();
+
+    std::map<std::string, IoCounters> disks_;
+    std::map<std::string, SchedCounters> cpus_;
+    std::map<SeriesKey, QuantileSketch> sketches_;
+};
+
+} // namespace statio
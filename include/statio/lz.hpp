@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace statio {
+
+// Byte-oriented LZ77 block codec in the LZ4 block layout: each sequence is
+// a token (literal length << 4 | match length - 4), the literals and a
+// 16-bit back reference, with lengths of 15 or more continued in 255-steps.
+// Compression is a single greedy pass over a 4096-entry hash of 4-byte
+// prefixes, fast enough to run on every batch of snapshots; repetitive text
+// such as metric names shrinks several times over.
+void lzCompress(std::string_view input, std::string& out);
+
+// Appends exactly `rawSize` bytes to `out`; throws std::runtime_error on
+// corrupt input.
+void lzDecompress(std::string_view input, std::size_t rawSize, std::string& out);
+
+} // namespace statio
@@ -1,7 +1,16 @@
 #pragma once
 
+#include "statio/bench.hpp"
+
 #include <QMainWindow>
 
+#include <future>
+#include <memory>
+
+namespace statio {
+class AnomalyDetector;
+}
+
 class QLabel;
 class QPushButton;
 class QTabWidget;
@@ -14,12 +23,15 @@ class MainWindow : public QMainWindow {
 
 public:
     explicit MainWindow(QWidget* parent = nullptr);
+    ~MainWindow() override;
 
 private slots:
     void refreshReport();
     void showAboutDialog();
     void setLightTheme();
     void setDarkTheme();
+    void runCoreToCore();
+    void checkCoreToCore();
 
 private:
     void setupTabs();
@@ -29,6 +41,9 @@ private:
     QWidget* buildDisksTab();
     QWidget* buildNetworkTab();
     QWidget* buildGpuTab();
+    QWidget* buildAnomaliesTab();
+    QWidget* buildCoreToCoreTab();
+    void showCoreToCore(const statio::C2cResult& result);
     void applyTheme(bool dark);
 
     QTabWidget* tabs_ = nullptr;
@@ -47,9 +62,22 @@ private:
     QTableWidget* diskTable_ = nullptr;
     QTableWidget* networkTable_ = nullptr;
     QTableWidget* gpuTable_ = nullptr;
+    QTableWidget* anomalyTable_ = nullptr;
 
     QLabel* statusLabel_ = nullptr;
     QPushButton* refreshButton_ = nullptr;
     QTimer* refreshTimer_ = nullptr;
     bool darkThemeEnabled_ = false;
+
+    // Fed with every refresh; flagged series are listed on the Anomalies
+    // tab and their disk/interface rows highlighted.
+    std::unique_ptr<statio::AnomalyDetector> anomalies_;
+
+    // The core-to-core benchmark runs on a worker thread; c2cPoll_ picks up
+    // its result and paints the matrix as a heatmap.
+    QTableWidget* c2cTable_ = nullptr;
+    QLabel* c2cStatus_ = nullptr;
+    QPushButton* c2cRunButton_ = nullptr;
+    QTimer* c2cPoll_ = nullptr;
+    std::future<statio::C2cResult> c2cRun_;
 };
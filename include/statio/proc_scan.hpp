@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace statio {
+
+// The fields of /proc/<pid>/stat that statio uses.
+struct ProcStat {
+    std::string_view name; // comm, into the parsed text
+    char state = '?';
+    int ppid = 0;
+    std::uint64_t ticks = 0;    // utime + stime
+    std::uint64_t rssPages = 0;
+    unsigned threads = 0;
+};
+
+// Parses the text of /proc/<pid>/stat, which need not be terminated.
+bool parseProcStat(std::string_view text, ProcStat& out);
+
+// Appends the numeric entries of the procfs directory `dirFd` (a pid
+// namespace root, or /proc/<pid>/task) to `pids`, in directory order, with
+// getdents64() straight into one buffer. Throws std::runtime_error when the
+// directory cannot be read.
+void listPids(int dirFd, std::vector<int>& pids);
+
+// One scan, column by column: row i of every vector is the same process.
+struct ProcessColumns {
+    static constexpr std::size_t kNameBytes = 16; // comm and its terminator
+
+    std::vector<int> pid;
+    std::vector<int> ppid;
+    std::vector<char> state;
+    std::vector<std::uint64_t> ticks; // utime + stime
+    std::vector<std::uint64_t> rssKB;
+    std::vector<unsigned> threads;
+    std::vector<std::array<char, kNameBytes>> name;
+
+    std::size_t size() const { return pid.size(); }
+    std::string_view nameOf(std::size_t row) const;
+    void resize(std::size_t rows);
+};
+
+// Reads /proc/<pid>/stat for every process of one /proc listing. The pids
+// of the listing are cut into chunks and spread over a pool of workers;
+// each worker pops chunks from the front of its own range and, once that
+// is empty, takes the back half of another worker's range. Workers read
+// into their own buffers and write each process to the row of its pid in
+// the listing, so the merge is one pass that drops the pids that exited.
+//
+// Threads cost more than they save on small hosts: a listing of fewer than
+// kPidsPerWorker pids per worker uses fewer workers, down to the calling
+// thread alone.
+class ProcScanner {
+public:
+    static constexpr std::size_t kPidsPerWorker = 1024;
+    static constexpr std::size_t kChunkPids = 128;
+    static constexpr std::size_t kMaxAutoWorkers = 8;
+
+    // `workers` 0: one per usable CPU, at most kMaxAutoWorkers. `root` is
+    // the procfs mount, or a directory laid out like one.
+    explicit ProcScanner(std::size_t workers = 0, const std::string& root = "/proc");
+    ~ProcScanner();
+
+    ProcScanner(const ProcScanner&) = delete;
+    ProcScanner& operator=(const ProcScanner&) = delete;
+
+    // Lists the root and reads every process in it.
+    void scan(ProcessColumns& out);
+    // Reads only `pids`, e.g. the ones a caller could not hold open; rows
+    // keep their order, less the pids that exited.
+    void read(const std::vector<int>& pids, ProcessColumns& out);
+
+    std::size_t workers() const { return workers_.size(); }
+    // Workers the last scan() used, after the small-host cut.
+    std::size_t lastWorkers() const { return lastWorkers_; }
+    std::size_t lastListed() const { return pids_.size(); }
+
+private:
+    struct Worker {
+        // Chunk indices [begin, end) still to read, as begin << 32 | end, so
+        // that popping the front and stealing the back are each one CAS.
+        alignas(64) std::atomic<std::uint64_t> range{0};
+        std::string buffer;
+        std::thread thread;
+    };
+
+    void stopWorkers();
+    void readListed(ProcessColumns& out);
+    void runWorker(std::size_t self);
+    void work(std::size_t self);
+    bool steal(std::size_t self, std::uint32_t& chunk);
+    void readChunk(Worker& worker, std::uint32_t chunk);
+
+    int rootFd_ = -1;
+    std::uint64_t pageKB_ = 4;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<int> pids_;
+    std::vector<std::uint8_t> found_; // per listed pid: its row was read
+    ProcessColumns* out_ = nullptr;
+    std::size_t lastWorkers_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    std::uint64_t round_ = 0;
+    std::size_t active_ = 0;  // workers taking part in this round
+    std::size_t running_ = 0; // of those, still working
+    bool stopping_ = false;
+};
+
+} // namespace statio
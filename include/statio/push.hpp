@@ -0,0 +1,117 @@
+#pragma once
+
+#include "statio/history.hpp"
+#include "statio/wire.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace statio {
+
+struct PushOptions {
+    std::string address;                  // HOST:PORT or unix:PATH
+    std::string host;                     // name announced in the Hello frame
+    std::size_t batchSnapshots = 10;
+    std::int64_t batchMaxMs = 30000;      // a partial batch is sent after this long
+    std::size_t queueBytes = 8U << 20;    // batches held in memory, sent or not
+    std::string spillDirectory;           // empty: drop the oldest batch when full
+    std::uint64_t spillBytes = 256ULL << 20;
+    std::size_t window = 8;               // batches sent ahead of the receiver's ack
+    std::int64_t backoffMinMs = 500;
+    std::int64_t backoffMaxMs = 60000;
+    bool compress = true;
+    bool quiet = false;
+};
+
+struct PushStats {
+    std::uint64_t snapshots = 0;
+    std::uint64_t batches = 0;
+    std::uint64_t acked = 0;
+    std::uint64_t spilled = 0;
+    std::uint64_t dropped = 0;
+    std::uint64_t reconnects = 0;
+    std::uint64_t rawBytes = 0;  // encoded snapshots before compression
+    std::uint64_t wireBytes = 0; // batch frames as sent
+};
+
+// Pushes snapshots to an aggregator or receiver. push() delta-encodes into
+// the current batch; a full batch is LZ-compressed, numbered and queued,
+// and a sender thread streams queued batches over one persistent
+// connection, keeping up to `window` unacknowledged. Batches leave the
+// queue only once acked and are resent after a reconnect, so a receiver may
+// see a batch twice (same sequence) but never miss one. Reconnects back
+// off exponentially with jitter. Past `queueBytes` the oldest batches move to
+// `spillDirectory` (or are dropped without one); spilled batches survive
+// restarts and are replayed first. Memory stays bounded by `queueBytes`
+// plus one batch.
+class PushTransport {
+public:
+    explicit PushTransport(PushOptions options);
+    ~PushTransport();
+
+    PushTransport(const PushTransport&) = delete;
+    PushTransport& operator=(const PushTransport&) = delete;
+
+    void push(std::int64_t timestampMs, const std::vector<MetricSample>& samples);
+    void flush();
+    // Seals the partial batch, allows the sender a moment to deliver, and
+    // spills what is left when a spill directory is configured. Called by
+    // the destructor; push() must not follow.
+    void close();
+    PushStats stats() const;
+
+private:
+    struct Batch {
+        std::uint64_t sequence = 0;
+        std::shared_ptr<const std::string> bytes; // null once spilled
+        std::string spillPath;                    // set while the batch lives on disk
+        std::size_t size = 0;
+    };
+    // A batch on its way to disk, written without mutex_ held.
+    struct Spill {
+        std::uint64_t sequence = 0;
+        std::shared_ptr<const std::string> bytes;
+        std::string path; // once written
+    };
+
+    void seal();
+    void enforceLimits(std::vector<Spill>& spills, std::vector<std::string>& removals);
+    void trimSpilled(std::vector<std::string>& removals);
+    void spill(std::vector<Spill>& spills);
+    bool writeSpill(Spill& spill) const;
+    void loadSpilled();
+    bool batchBytes(std::uint64_t sequence, std::string& out);
+    void acknowledge(std::uint64_t sequence);
+    void run();
+    void log(const std::string& message) const;
+    void wake();
+
+    PushOptions options_;
+
+    // Producer side.
+    SnapshotEncoder encoder_;
+    std::string frames_;
+    std::size_t batchCount_ = 0;
+    std::int64_t batchStartMs_ = 0;
+
+    mutable std::mutex mutex_;
+    std::deque<Batch> queue_;       // ordered by sequence
+    std::uint64_t nextSequence_ = 1;
+    std::uint64_t nextSend_ = 1;    // first sequence not yet sent on this connection
+    std::size_t memoryBytes_ = 0;
+    std::uint64_t spillBytes_ = 0;
+    PushStats stats_;
+
+    int wakeFd_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::int64_t> stopDeadlineMs_{0};
+    std::thread thread_;
+};
+
+} // namespace statio
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "statio/history.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace statio {
+
+enum class AggregationKind { Min, Max, Avg, Sum, Count, Last, Rate, Quantile };
+
+struct Aggregation {
+    AggregationKind kind = AggregationKind::Avg;
+    double quantile = 0.0;
+    std::string label;
+};
+
+// Accepts min, max, avg, sum, count, last, rate and pNN[.N] (e.g. p99, p99.9).
+Aggregation parseAggregation(const std::string& text);
+
+enum class GroupBy { Series, Metric, Entity, None };
+
+GroupBy parseGroupBy(const std::string& text);
+
+struct QuerySpec {
+    std::string metric = "*";
+    std::string entity = "*";
+    bool perSecond = false;
+    std::int64_t fromMs = 0;
+    std::int64_t toMs = 0;
+    std::int64_t bucketMs = 0;
+    GroupBy groupBy = GroupBy::Series;
+    std::vector<Aggregation> aggregations;
+    // "auto" picks the coarsest rollup tier that satisfies bucketMs.
+    std::string tier = "auto";
+};
+
+// Parses a metric expression: a name glob optionally wrapped in `rate(...)`
+// to turn cumulative counters into per-second values before aggregation.
+void parseMetricExpression(const std::string& text, QuerySpec& spec);
+
+struct QueryRow {
+    std::int64_t bucketMs = 0;
+    std::string group;
+    std::vector<double> values;
+};
+
+// Scans history and emits one row per (bucket, group) as soon as the bucket
+// can no longer receive samples, so output streams in time order. Rollup
+// tiers are mixed in transparently; percentiles over them and over
+// distribution series come from merged sketches and are accurate to the
+// sketch's relative error. Several directories (e.g. histories gathered from
+// different hosts) are merged into the same groups; rows are then emitted
+// once every directory has been read.
+HistoryScanStats runQuery(const std::vector<std::string>& historyDirectories,
+                          const QuerySpec& spec,
+                          const std::function<void(const QueryRow&)>& emit);
+
+class QueryFormatter {
+public:
+    virtual ~QueryFormatter() = default;
+    virtual void begin(const QuerySpec& spec) = 0;
+    virtual void row(const QueryRow& row) = 0;
+    virtual void end() = 0;
+};
+
+// `format` is one of "table", "csv" or "json".
+std::unique_ptr<QueryFormatter> makeQueryFormatter(const std::string& format, std::ostream& out);
+
+bool globMatch(std::string_view pattern, std::string_view text);
+
+// Accepts "now", relative offsets ("-10m"), epoch seconds or milliseconds,
+// "HH:MM[:SS]" (today, local time) and "YYYY-MM-DD[ HH:MM[:SS]]".
+std::int64_t parseTimePoint(const std::string& text, std::int64_t nowMs);
+std::string formatTimestamp(std::int64_t timestampMs);
+// Escapes `text` for use inside a JSON string literal.
+std::string jsonEscape(const std::string& text);
+
+} // namespace statio
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "statio/history.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace statio {
+
+// One downsampling tier stored under `<history>/tier-<name>`.
+struct TierSpec {
+    std::string name;
+    std::int64_t resolutionMs = 0;
+    std::int64_t retentionMs = 0; // 0 keeps data forever
+};
+
+struct RetentionPolicy {
+    std::int64_t rawMs = 0;
+    std::vector<TierSpec> tiers;
+};
+
+// Parses "10s,1m,1h" (or "none") into tiers ordered from finest to coarsest.
+std::vector<TierSpec> parseTiers(const std::string& text);
+// Applies "raw=2d,10s=30d,1h=0" to the policy; unknown tier names throw.
+void parseRetention(const std::string& text, RetentionPolicy& policy);
+RetentionPolicy defaultRetentionPolicy();
+
+std::string tierDirectory(const std::string& historyDirectory, const TierSpec& tier);
+// Tiers present on disk, finest first.
+std::vector<TierSpec> discoverTiers(const std::string& historyDirectory);
+
+struct CompactionStats {
+    std::size_t bucketsWritten = 0;
+    std::size_t segmentsRemoved = 0;
+};
+
+// Rolls raw samples into each tier (each tier is built from the next finer
+// one, so the cost is proportional to new data only) and then drops segments
+// that fell out of their tier's retention window. Only buckets the source has
+// moved past are written, so a bucket is never emitted twice.
+class Compactor {
+public:
+    Compactor(std::string historyDirectory, RetentionPolicy policy);
+
+    CompactionStats runOnce(std::int64_t nowMs);
+
+private:
+    std::size_t compactTier(const std::string& sourceDirectory, const TierSpec& tier);
+
+    std::string historyDirectory_;
+    RetentionPolicy policy_;
+};
+
+// A time range to read from one tier (resolutionMs 0 = raw samples).
+struct TierScan {
+    std::string directory;
+    std::int64_t resolutionMs = 0;
+    std::int64_t fromMs = 0;
+    std::int64_t toMs = 0;
+};
+
+// Splits [fromMs, toMs] across tiers, serving each part from the coarsest
+// tier whose resolution divides `bucketMs` (any tier when bucketMs is 0) and
+// whose whole buckets fit inside the range. Edges and the not-yet-compacted
+// tail fall through to finer tiers and finally raw samples. `tier` forces a
+// single tier by name ("raw", "10s", ...) unless it is "auto".
+std::vector<TierScan> planTierScans(const std::string& historyDirectory,
+                                    std::int64_t fromMs,
+                                    std::int64_t toMs,
+                                    std::int64_t bucketMs,
+                                    const std::string& tier = "auto");
+
+} // namespace statio
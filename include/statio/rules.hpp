@@ -0,0 +1,106 @@
+#pragma once
+
+#include "statio/history.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace statio {
+
+// One alerting rule. Rule files hold one rule per line,
+//   name: expression [for: duration]
+// with `#` comments, e.g.
+//   disk_full: 100 * (1 - disk.free_gb / disk.total_gb) > 90 for: 5m
+//   swap_used: memory.swap_total_mb{} - memory.swap_free_mb{} > 0
+//   rx_burst:  rate(network.rx_bytes, 1m) > 100e6
+// A metric written without braces refers to the entity the rule is being
+// evaluated for, so the first rule above fires per mount point; `name{}`
+// and `name{entity}` pin a host-wide or specific series. Functions over the
+// in-memory sample history are rate, delta, avg, min and max, each taking a
+// metric and an optional window (default: since the previous sample).
+struct RuleSpec {
+    std::string name;
+    std::string expression;
+    std::int64_t forMs = 0;
+};
+
+// Parses rule file text; errors name the offending line.
+std::vector<RuleSpec> parseRules(const std::string& text);
+std::vector<RuleSpec> loadRules(const std::string& path);
+
+struct AlertEvent {
+    std::int64_t timestampMs = 0;
+    std::string_view rule;
+    std::string_view entity;
+    bool firing = false;
+    // Left-hand side of the comparison that decided the result, e.g. the
+    // disk usage in `usage > 90`. For `a && b` that held it is a's; for
+    // `a || b` it is the operand that held. The expression's own result
+    // when no comparison decided it.
+    double value = 0.0;
+};
+
+std::string formatAlert(const AlertEvent& event);
+
+// Compiles rules to stack bytecode once and evaluates them against every
+// sample. Series slots, per-series sample rings and rule instances are
+// created as new series show up; after that, observe() does not allocate.
+class RuleEngine {
+public:
+    // `intervalMs` is the expected sample period and sizes the sample rings
+    // behind windowed functions. Compile errors throw std::runtime_error.
+    RuleEngine(const std::vector<RuleSpec>& rules, std::int64_t intervalMs);
+    ~RuleEngine();
+
+    RuleEngine(const RuleEngine&) = delete;
+    RuleEngine& operator=(const RuleEngine&) = delete;
+
+    // Ingests one sample set, then evaluates every rule instance and reports
+    // state changes (pending -> firing after `for`, firing -> resolved).
+    void observe(std::int64_t timestampMs,
+                 const std::vector<MetricSample>& samples,
+                 const std::function<void(const AlertEvent&)>& emit);
+
+    std::size_t ruleCount() const;
+    std::size_t instanceCount() const;
+    // Human-readable bytecode listing of every rule.
+    std::string describe() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// Fans alert events out to stdout, an append-only log file and a hook
+// command. The hook runs through /bin/sh without being waited for, with the
+// event in STATIO_ALERT_{RULE,ENTITY,STATE,VALUE,TIME}.
+class AlertDispatcher {
+public:
+    explicit AlertDispatcher(bool toStdout = true);
+    ~AlertDispatcher();
+
+    void setLogFile(const std::string& path);
+    void setHook(std::string command);
+    void publish(const AlertEvent& event);
+    // Writes a preformatted line (e.g. an anomaly) to stdout and the log;
+    // hooks only run for rule events.
+    void publishLine(const std::string& line);
+
+private:
+    void runHook(const AlertEvent& event);
+    void reapHooks();
+
+    bool toStdout_;
+    std::ofstream log_;
+    std::string hook_;
+    std::vector<pid_t> hooks_; // spawned and not reaped yet
+};
+
+} // namespace statio
@@ -0,0 +1,713 @@
+#pragma once
+
+#include "statio/history.hpp"
+#include "statio/query.hpp"
+#include "statio/system_info.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace statio {
+
+// The snapshot schema: every field of every SystemSnapshot record, declared
+// once below and expanded by template instantiation into the API JSON, the
+// flattened series (history, wire batches, --fields, OpenMetrics) and the
+// GUI tables. Adding a metric means adding one field() line to its
+// record's Schema. The text report predates the schema and scripts parse
+// it, so each Schema also spells out its report line by line.
+
+// One field of `Record`: how it is named in each output, and how to read
+// it, either through a data member or a computed accessor.
+template <typename Record, typename Value>
+struct Field {
+    using RecordType = Record;
+    using ValueType = Value;
+
+    const char* key;   // JSON key
+    const char* label; // GUI caption
+    const char* unit;  // "" for none; values in "B" are shown humanized
+    const char* help;  // OpenMetrics HELP text
+    Value Record::*member;
+    Value (*compute)(const Record&);
+    bool (*present)(const Record&) = nullptr; // nullptr: always present
+    const char* metric = nullptr;             // series name, nullptr when not flattened
+    MetricKind kind = MetricKind::Gauge;
+    unsigned sources = 0; // SnapshotSource bits; 0 uses the record's
+
+    Value get(const Record& record) const { return member != nullptr ? record.*member : compute(record); }
+    bool presentIn(const Record& record) const { return present == nullptr || present(record); }
+
+    // Also flattened into the series `name`.
+    constexpr Field series(const char* name, MetricKind seriesKind = MetricKind::Gauge) const {
+        Field copy = *this;
+        copy.metric = name;
+        copy.kind = seriesKind;
+        return copy;
+    }
+    // Read from other sources than the rest of the record.
+    constexpr Field from(unsigned bits) const {
+        Field copy = *this;
+        copy.sources = bits;
+        return copy;
+    }
+    // Left out of every output for records where `predicate` is false.
+    constexpr Field when(bool (*predicate)(const Record&)) const {
+        Field copy = *this;
+        copy.present = predicate;
+        return copy;
+    }
+};
+
+template <typename Record, typename Value>
+constexpr Field<Record, Value> field(const char* key, const char* label, const char* unit, const char* help,
+                                     Value Record::*member) {
+    return {key, label, unit, help, member, nullptr};
+}
+
+template <typename Record, typename Value>
+constexpr Field<Record, Value> computed(const char* key, const char* label, const char* unit, const char* help,
+                                        Value (*compute)(const Record&)) {
+    return {key, label, unit, help, nullptr, compute};
+}
+
+// A list of nested records, e.g. the per-core times of CpuInfo.
+template <typename Parent, typename Child>
+struct Children {
+    using ChildType = Child;
+
+    const char* key; // JSON array key
+    std::vector<Child> Parent::*member;
+};
+
+template <typename Parent, typename Child>
+constexpr Children<Parent, Child> nested(const char* key, std::vector<Child> Parent::*member) {
+    return {key, member};
+}
+
+// One piece of a record's text report: `prefix`, the text of the value,
+// then `suffix`. Pieces whose `when` is false are left out. The parts of a
+// record in a list make one line, ended by the report.
+template <typename Record>
+struct ReportPart {
+    const char* prefix;
+    std::string (*text)(const Record&);
+    const char* suffix = "";
+    bool (*when)(const Record&) = nullptr;
+};
+
+template <typename Pointer>
+struct MemberOf;
+
+template <typename Record, typename Value>
+struct MemberOf<Value Record::*> {
+    using RecordType = Record;
+};
+
+template <auto Member>
+using MemberRecord = typename MemberOf<decltype(Member)>::RecordType;
+
+// ReportPart texts: a member as fieldText() writes it, a string member as
+// it is, and a list member one line per record.
+template <auto Member>
+std::string reportText(const MemberRecord<Member>& record);
+template <auto Member>
+std::string reportRaw(const MemberRecord<Member>& record);
+template <auto Member>
+std::string reportList(const MemberRecord<Member>& record);
+
+// Specialized for every record type. Members:
+//   sources     - SnapshotSource bits the record is collected from
+//   fields      - tuple of Field, in JSON order
+//   children    - tuple of Children
+//   report      - array of ReportPart, the record's lines in the report
+// and for records that appear in lists:
+//   entityLabel - what the series entity names (OpenMetrics label name)
+//   entity()    - the series entity of one record; the first field holds it
+template <typename Record>
+struct Schema;
+
+namespace schema_detail {
+
+inline bool isPhysical(const NetworkInfo& net) {
+    return net.physical;
+}
+
+inline bool hasSpeed(const NetworkInfo& net) {
+    return net.physical && net.speedMbps >= 0;
+}
+
+inline std::uint64_t usedGB(const DiskInfo& disk) {
+    return disk.totalGB >= disk.freeGB ? disk.totalGB - disk.freeGB : 0;
+}
+
+inline bool hasSpeedText(const NetworkInfo& net) {
+    return net.physical && net.speedMbps > 0;
+}
+
+inline std::string linkText(const NetworkInfo& net) {
+    return net.linkUp ? "up" : "down";
+}
+
+} // namespace schema_detail
+
+template <>
+struct Schema<OsInfo> {
+    static constexpr unsigned sources = SourceOs;
+    static constexpr auto fields = std::make_tuple(
+        field("distro", "Distro", "", "Distribution name", &OsInfo::distro),
+        field("version", "Version", "", "Distribution version", &OsInfo::version),
+        field("kernel", "Kernel", "", "Kernel release", &OsInfo::kernel),
+        field("architecture", "Arch", "", "Machine architecture", &OsInfo::architecture),
+        field("hostname", "Host", "", "Host name", &OsInfo::hostname));
+    static constexpr auto children = std::make_tuple();
+    static constexpr ReportPart<OsInfo> report[] = {
+        {"Distro: ", &reportText<&OsInfo::distro>, "\n"},
+        {"Version: ", &reportText<&OsInfo::version>, "\n"},
+        {"Kernel: ", &reportText<&OsInfo::kernel>, "\n"},
+        {"Arch: ", &reportText<&OsInfo::architecture>, "\n"},
+        {"Host: ", &reportText<&OsInfo::hostname>, "\n"},
+    };
+};
+
+template <>
+struct Schema<CpuTimes> {
+    static constexpr unsigned sources = SourceCpuTimes;
+    static constexpr const char* entityLabel = "cpu";
+    static constexpr auto fields = std::make_tuple(
+        field("name", "CPU", "", "CPU line of /proc/stat", &CpuTimes::name),
+        field("user", "User", "ticks", "Time in user mode", &CpuTimes::user).series("cpu.user", MetricKind::Counter),
+        field("nice", "Nice", "ticks", "Time in user mode at low priority", &CpuTimes::nice)
+            .series("cpu.nice", MetricKind::Counter),
+        field("system", "System", "ticks", "Time in kernel mode", &CpuTimes::system)
+            .series("cpu.system", MetricKind::Counter),
+        field("idle", "Idle", "ticks", "Idle time", &CpuTimes::idle).series("cpu.idle", MetricKind::Counter),
+        field("iowait", "I/O wait", "ticks", "Idle time with I/O outstanding", &CpuTimes::iowait)
+            .series("cpu.iowait", MetricKind::Counter),
+        field("irq", "IRQ", "ticks", "Time servicing interrupts", &CpuTimes::irq).series("cpu.irq", MetricKind::Counter),
+        field("softirq", "Soft IRQ", "ticks", "Time servicing softirqs", &CpuTimes::softirq)
+            .series("cpu.softirq", MetricKind::Counter),
+        field("steal", "Steal", "ticks", "Time taken by the hypervisor", &CpuTimes::steal)
+            .series("cpu.steal", MetricKind::Counter));
+    static constexpr auto children = std::make_tuple();
+
+    static std::string entity(const CpuTimes& times) { return times.name; }
+};
+
+template <>
+struct Schema<CpuInfo> {
+    static constexpr unsigned sources = SourceCpuInfo;
+    static constexpr auto fields = std::make_tuple(
+        field("model", "Model", "", "CPU model name", &CpuInfo::model),
+        field("logical_threads", "Logical threads", "", "Online hardware threads", &CpuInfo::logicalThreads),
+        field("physical_cores", "Physical cores", "", "Physical cores", &CpuInfo::physicalCores),
+        field("current_mhz", "Current frequency", "MHz", "Mean current core frequency", &CpuInfo::currentMHz)
+            .series("cpu.mhz"));
+    static constexpr auto children = std::make_tuple(nested("times", &CpuInfo::times));
+    static constexpr ReportPart<CpuInfo> report[] = {
+        {"Model: ", &reportText<&CpuInfo::model>, "\n"},
+        {"Physical cores: ", &reportText<&CpuInfo::physicalCores>, "\n"},
+        {"Logical threads: ", &reportText<&CpuInfo::logicalThreads>, "\n"},
+        {"Current MHz: ", &reportText<&CpuInfo::currentMHz>, "\n"},
+    };
+};
+
+template <>
+struct Schema<MemoryInfo> {
+    static constexpr unsigned sources = SourceMemory;
+    static constexpr auto fields = std::make_tuple(
+        field("total_mb", "Total RAM", "MB", "Installed memory", &MemoryInfo::totalMB).series("memory.total_mb"),
+        field("free_mb", "Free RAM", "MB", "Unused memory", &MemoryInfo::freeMB).series("memory.free_mb"),
+        field("available_mb", "Available RAM", "MB", "Memory available without swapping", &MemoryInfo::availableMB)
+            .series("memory.available_mb"),
+        field("swap_total_mb", "Total Swap", "MB", "Swap space", &MemoryInfo::swapTotalMB)
+            .series("memory.swap_total_mb"),
+        field("swap_free_mb", "Free Swap", "MB", "Unused swap space", &MemoryInfo::swapFreeMB)
+            .series("memory.swap_free_mb"));
+    static constexpr auto children = std::make_tuple();
+    // The report's footnote explains the asterisk.
+    static constexpr ReportPart<MemoryInfo> report[] = {
+        {"Total RAM: ", &reportText<&MemoryInfo::totalMB>, " MB\n"},
+        {"Free RAM: ", &reportText<&MemoryInfo::freeMB>, " MB\n"},
+        {"Available RAM*: ", &reportText<&MemoryInfo::availableMB>, " MB\n"},
+        {"Total Swap: ", &reportText<&MemoryInfo::swapTotalMB>, " MB\n"},
+        {"Free Swap: ", &reportText<&MemoryInfo::swapFreeMB>, " MB\n"},
+    };
+};
+
+template <>
+struct Schema<HugePagePool> {
+    static constexpr unsigned sources = SourceHugePages;
+    static constexpr const char* entityLabel = "page_size";
+    static constexpr auto fields = std::make_tuple(
+        field("page_kb", "Page size", "kB", "Huge page size", &HugePagePool::pageKB),
+        field("total", "Total", "", "Persistent huge pages in the pool", &HugePagePool::total)
+            .series("hugepages.total"),
+        field("free", "Free", "", "Huge pages not mapped", &HugePagePool::free).series("hugepages.free"),
+        field("reserved", "Reserved", "", "Huge pages promised to mappings, not yet faulted in",
+              &HugePagePool::reserved)
+            .series("hugepages.reserved"),
+        field("surplus", "Surplus", "", "Huge pages allocated past the pool size", &HugePagePool::surplus)
+            .series("hugepages.surplus"));
+    static constexpr auto children = std::make_tuple();
+    static constexpr ReportPart<HugePagePool> report[] = {
+        {"hugetlb ", &reportText<&HugePagePool::pageKB>, " kB:"},
+        {" total=", &reportText<&HugePagePool::total>},
+        {" free=", &reportText<&HugePagePool::free>},
+        {" reserved=", &reportText<&HugePagePool::reserved>},
+        {" surplus=", &reportText<&HugePagePool::surplus>},
+    };
+
+    static std::string entity(const HugePagePool& pool) { return std::to_string(pool.pageKB) + "kB"; }
+};
+
+template <>
+struct Schema<HugePageInfo> {
+    static constexpr unsigned sources = SourceHugePages;
+    static constexpr auto fields = std::make_tuple(
+        field("thp_enabled", "THP", "", "Transparent huge page mode", &HugePageInfo::thpEnabled),
+        field("thp_defrag", "THP defrag", "", "Transparent huge page defrag mode", &HugePageInfo::thpDefrag),
+        field("anon_huge_mb", "THP-backed anonymous", "MB", "Anonymous memory backed by transparent huge pages",
+              &HugePageInfo::anonHugeMB)
+            .series("hugepages.anon_mb"),
+        field("free_mb", "Free", "MB", "Free memory over all zones", &HugePageInfo::freeMB),
+        field("free_2m_block_mb", "Free in 2 MB+ blocks", "MB", "Free memory contiguous enough for a 2 MiB page",
+              &HugePageInfo::free2MBlockMB)
+            .series("hugepages.free_2m_block_mb"),
+        field("free_blocks", "Free blocks by order", "", "Free runs of 2^order pages", &HugePageInfo::freeBlocks));
+    static constexpr auto children = std::make_tuple(nested("pools", &HugePageInfo::pools));
+    static constexpr ReportPart<HugePageInfo> report[] = {
+        {"THP: ", &reportText<&HugePageInfo::thpEnabled>},
+        {" defrag=", &reportText<&HugePageInfo::thpDefrag>},
+        {" anon=", &reportText<&HugePageInfo::anonHugeMB>, " MB\n"},
+        {"", &reportList<&HugePageInfo::pools>},
+        {"Free in 2 MB+ blocks: ", &reportText<&HugePageInfo::free2MBlockMB>},
+        {" of ", &reportText<&HugePageInfo::freeMB>, " MB\n"},
+    };
+};
+
+template <>
+struct Schema<DiskInfo> {
+    static constexpr unsigned sources = SourceDisks;
+    static constexpr const char* entityLabel = "mount";
+    static constexpr auto fields = std::make_tuple(
+        field("mount_point", "Mount", "", "Mount point", &DiskInfo::mountPoint),
+        field("filesystem", "Filesystem", "", "Filesystem type", &DiskInfo::filesystem),
+        field("device", "Device", "", "Mount source", &DiskInfo::device),
+        field("total_gb", "Total", "GB", "Filesystem size", &DiskInfo::totalGB).series("disk.total_gb"),
+        computed("used_gb", "Used", "GB", "Space in use", &schema_detail::usedGB),
+        field("free_gb", "Free", "GB", "Space available to unprivileged users", &DiskInfo::freeGB)
+            .series("disk.free_gb"));
+    static constexpr auto children = std::make_tuple();
+    static constexpr ReportPart<DiskInfo> report[] = {
+        {"", &reportRaw<&DiskInfo::mountPoint>},
+        {" (", &reportRaw<&DiskInfo::filesystem>, ")"},
+        {" total=", &reportText<&DiskInfo::totalGB>, "GB"},
+        {" free=", &reportText<&DiskInfo::freeGB>, "GB"},
+    };
+
+    static std::string entity(const DiskInfo& disk) { return disk.mountPoint; }
+};
+
+template <>
+struct Schema<NetworkInfo> {
+    static constexpr unsigned sources = SourceNetCounters;
+    static constexpr const char* entityLabel = "interface";
+    static constexpr auto fields = std::make_tuple(
+        field("name", "Interface", "", "Interface name", &NetworkInfo::name),
+        field("ipv4", "IPv4", "", "First IPv4 address", &NetworkInfo::ipv4).from(SourceNetAddresses),
+        field("mac", "MAC", "", "Hardware address", &NetworkInfo::mac).from(SourceNetAddresses),
+        field("rx_bytes", "Received", "B", "Bytes received", &NetworkInfo::rxBytes)
+            .series("network.rx_bytes", MetricKind::Counter),
+        field("tx_bytes", "Sent", "B", "Bytes sent", &NetworkInfo::txBytes)
+            .series("network.tx_bytes", MetricKind::Counter),
+        field("physical", "Physical", "", "Backed by a device", &NetworkInfo::physical).from(SourceNetLink),
+        field("link_up", "Link", "", "Carrier detected", &NetworkInfo::linkUp)
+            .series("network.link_up")
+            .from(SourceNetLink)
+            .when(&schema_detail::isPhysical),
+        field("speed_mbps", "Speed", "Mb/s", "Negotiated link speed", &NetworkInfo::speedMbps)
+            .series("network.speed_mbps")
+            .from(SourceNetLink)
+            .when(&schema_detail::hasSpeed),
+        field("errors", "Errors", "", "Receive and transmit errors", &NetworkInfo::errors)
+            .series("network.errors", MetricKind::Counter)
+            .from(SourceNetLink)
+            .when(&schema_detail::isPhysical),
+        field("carrier_changes", "Carrier changes", "", "Link state changes", &NetworkInfo::carrierChanges)
+            .series("network.carrier_changes", MetricKind::Counter)
+            .from(SourceNetLink)
+            .when(&schema_detail::isPhysical));
+    static constexpr auto children = std::make_tuple();
+    static constexpr ReportPart<NetworkInfo> report[] = {
+        {"", &reportRaw<&NetworkInfo::name>},
+        {" ipv4=", &reportText<&NetworkInfo::ipv4>},
+        {" mac=", &reportText<&NetworkInfo::mac>},
+        {" rx=", &reportText<&NetworkInfo::rxBytes>},
+        {" tx=", &reportText<&NetworkInfo::txBytes>},
+        {" link=", &schema_detail::linkText, "", &schema_detail::isPhysical},
+        {" ", &reportText<&NetworkInfo::speedMbps>, "Mb/s", &schema_detail::hasSpeedText},
+        {" errors=", &reportText<&NetworkInfo::errors>, "", &schema_detail::isPhysical},
+    };
+
+    static std::string entity(const NetworkInfo& net) { return net.name; }
+};
+
+template <>
+struct Schema<GpuInfo> {
+    static constexpr unsigned sources = SourceGpus;
+    static constexpr const char* entityLabel = "adapter";
+    static constexpr auto fields = std::make_tuple(
+        field("adapter", "Adapter", "", "Display adapter", &GpuInfo::adapter),
+        field("detected", "Detected", "", "Found through /sys/class/drm", &GpuInfo::detected));
+    static constexpr auto children = std::make_tuple();
+    static constexpr ReportPart<GpuInfo> report[] = {
+        {"", &reportRaw<&GpuInfo::adapter>},
+    };
+
+    static std::string entity(const GpuInfo& gpu) { return gpu.adapter; }
+};
+
+// One part of SystemSnapshot: a single record or a list of them.
+template <typename Member>
+struct Section {
+    using MemberType = Member;
+
+    const char* key;   // API collector name
+    const char* title; // report heading
+    Member SystemSnapshot::*member;
+    const char* empty; // report line for an empty list
+};
+
+template <typename Member>
+constexpr Section<Member> section(const char* key, const char* title, Member SystemSnapshot::*member,
+                                  const char* empty = nullptr) {
+    return {key, title, member, empty};
+}
+
+// In API collector order. Distributions come from stateful samplers and are
+// written by hand where they are output.
+inline constexpr auto kSnapshotSections = std::make_tuple(
+    section("os", "OS", &SystemSnapshot::os),
+    section("cpu", "CPU", &SystemSnapshot::cpu),
+    section("memory", "Memory", &SystemSnapshot::memory),
+    section("disks", "Disks", &SystemSnapshot::disks, "No mounted disks detected"),
+    section("network", "Network", &SystemSnapshot::network, "No network interfaces detected"),
+    section("gpus", "GPU", &SystemSnapshot::gpus),
+    section("hugepages", "Huge pages", &SystemSnapshot::hugepages));
+
+constexpr std::size_t kSnapshotSectionCount = std::tuple_size<decltype(kSnapshotSections)>::value;
+
+// A flattened series as the schema declares it.
+struct MetricInfo {
+    const char* name;
+    const char* help;
+    const char* unit;
+    MetricKind kind;
+    unsigned sources;        // 0 for distributions, which no snapshot source fills
+    const char* entityLabel; // nullptr for host-wide series
+};
+
+// Every series flattenSnapshot() can produce, then the distribution series
+// of the stateful samplers.
+const std::vector<MetricInfo>& metricCatalog();
+const MetricInfo* findMetric(std::string_view name);
+
+// OpenMetrics text exposition of flattened samples: one family per series
+// name, prefixed "statio_", counters suffixed "_total" and distributions
+// as summaries. Ends with "# EOF".
+std::string renderOpenMetrics(const std::vector<MetricSample>& samples);
+
+std::string humanBytes(double bytes);
+
+// Appends a finite number: integers below 2^53 exactly, so counters keep
+// every digit, anything else as %.10g.
+void appendExactNumber(std::string& out, double value);
+
+template <typename Tuple, typename Visitor>
+void forEach(const Tuple& tuple, Visitor&& visit) {
+    std::apply([&visit](const auto&... element) { (visit(element), ...); }, tuple);
+}
+
+template <typename Visitor>
+void forEachSection(Visitor&& visit) {
+    forEach(kSnapshotSections, visit);
+}
+
+template <typename T>
+struct ListOf {
+    static constexpr bool isList = false;
+    using Record = T;
+};
+
+template <typename T>
+struct ListOf<std::vector<T>> {
+    static constexpr bool isList = true;
+    using Record = T;
+};
+
+template <typename FieldType>
+using FieldValue = typename std::decay_t<FieldType>::ValueType;
+
+// Plain text of one value: N/A for an empty string, two decimals for a
+// double, yes/no for a bool.
+inline std::string fieldText(const std::string& value) {
+    return value.empty() ? "N/A" : value;
+}
+
+inline std::string fieldText(bool value) {
+    return value ? "yes" : "no";
+}
+
+inline std::string fieldText(double value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.2f", value);
+    return text;
+}
+
+template <typename T, std::enable_if_t<std::is_integral<T>::value, int> = 0>
+std::string fieldText(T value) {
+    return std::to_string(value);
+}
+
+template <typename T>
+std::string fieldText(const std::vector<T>& values) {
+    std::string text;
+    for (const auto& value : values) {
+        text += text.empty() ? "" : " ";
+        text += fieldText(value);
+    }
+    return text.empty() ? "N/A" : text;
+}
+
+// fieldText() followed by the unit, for people.
+template <typename Record, typename Value>
+std::string displayText(const Field<Record, Value>& f, const Record& record) {
+    const Value value = f.get(record);
+    if constexpr (std::is_arithmetic<Value>::value && !std::is_same<Value, bool>::value) {
+        if (std::strcmp(f.unit, "B") == 0) {
+            return humanBytes(static_cast<double>(value));
+        }
+    }
+    std::string text = fieldText(value);
+    if (f.unit[0] != '\0') {
+        text += ' ';
+        text += f.unit;
+    }
+    return text;
+}
+
+// ---- JSON ----
+
+inline void appendJsonValue(std::string& out, const std::string& value) {
+    out += '"';
+    out += jsonEscape(value);
+    out += '"';
+}
+
+inline void appendJsonValue(std::string& out, bool value) {
+    out += value ? "true" : "false";
+}
+
+inline void appendJsonValue(std::string& out, double value) {
+    if (!std::isfinite(value)) {
+        out += "null";
+        return;
+    }
+    appendExactNumber(out, value);
+}
+
+template <typename T, std::enable_if_t<std::is_integral<T>::value, int> = 0>
+void appendJsonValue(std::string& out, T value) {
+    out += std::to_string(value);
+}
+
+template <typename T>
+void appendJsonValue(std::string& out, const std::vector<T>& values) {
+    out += '[';
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        out += i == 0 ? "" : ",";
+        appendJsonValue(out, values[i]);
+    }
+    out += ']';
+}
+
+template <typename Record>
+void appendJsonList(std::string& out, const std::vector<Record>& records);
+
+template <typename Record>
+void appendJsonRecord(std::string& out, const Record& record) {
+    char separator = '{';
+    forEach(Schema<Record>::fields, [&](const auto& f) {
+        if (!f.presentIn(record)) {
+            return;
+        }
+        out += separator;
+        separator = ',';
+        out += '"';
+        out += f.key;
+        out += "\":";
+        appendJsonValue(out, f.get(record));
+    });
+    forEach(Schema<Record>::children, [&](const auto& c) {
+        out += separator;
+        separator = ',';
+        out += '"';
+        out += c.key;
+        out += "\":";
+        appendJsonList(out, record.*c.member);
+    });
+    out += separator == '{' ? "{}" : "}";
+}
+
+template <typename Record>
+void appendJsonList(std::string& out, const std::vector<Record>& records) {
+    out += '[';
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        out += i == 0 ? "" : ",";
+        appendJsonRecord(out, records[i]);
+    }
+    out += ']';
+}
+
+// The JSON of one section, as the API returns it for the collector.
+template <typename Member>
+void appendJsonSection(std::string& out, const Member& value) {
+    if constexpr (ListOf<Member>::isList) {
+        appendJsonList(out, value);
+    } else {
+        appendJsonRecord(out, value);
+    }
+}
+
+// ---- series ----
+
+template <typename Record>
+void flattenRecord(std::vector<MetricSample>& out, const Record& record, const std::string& entity) {
+    forEach(Schema<Record>::fields, [&](const auto& f) {
+        if constexpr (std::is_arithmetic<FieldValue<decltype(f)>>::value) {
+            if (f.metric != nullptr && f.presentIn(record)) {
+                MetricSample sample;
+                sample.name = f.metric;
+                sample.entity = entity;
+                sample.value = static_cast<double>(f.get(record));
+                sample.kind = f.kind;
+                out.push_back(std::move(sample));
+            }
+        }
+    });
+    forEach(Schema<Record>::children, [&](const auto& c) {
+        using Child = typename std::decay_t<decltype(c)>::ChildType;
+        for (const auto& child : record.*c.member) {
+            flattenRecord(out, child, Schema<Child>::entity(child));
+        }
+    });
+}
+
+template <typename Member>
+void flattenSection(std::vector<MetricSample>& out, const Member& value) {
+    if constexpr (ListOf<Member>::isList) {
+        using Record = typename ListOf<Member>::Record;
+        for (const auto& record : value) {
+            flattenRecord(out, record, Schema<Record>::entity(record));
+        }
+    } else {
+        flattenRecord(out, value, std::string());
+    }
+}
+
+// ---- text report ----
+
+template <typename Record>
+void appendReportRecord(std::string& out, const Record& record) {
+    for (const auto& part : Schema<Record>::report) {
+        if (part.when == nullptr || part.when(record)) {
+            out += part.prefix;
+            out += part.text(record);
+            out += part.suffix;
+        }
+    }
+}
+
+template <typename Record>
+void appendReportList(std::string& out, const std::vector<Record>& records) {
+    for (const auto& record : records) {
+        appendReportRecord(out, record);
+        out += '\n';
+    }
+}
+
+template <auto Member>
+std::string reportText(const MemberRecord<Member>& record) {
+    return fieldText(record.*Member);
+}
+
+template <auto Member>
+std::string reportRaw(const MemberRecord<Member>& record) {
+    return record.*Member;
+}
+
+template <auto Member>
+std::string reportList(const MemberRecord<Member>& record) {
+    std::string out;
+    appendReportList(out, record.*Member);
+    return out;
+}
+
+template <typename Member>
+void appendReportSection(std::string& out, const Section<Member>& s, const SystemSnapshot& snapshot) {
+    out += '[';
+    out += s.title;
+    out += "]\n";
+    const Member& value = snapshot.*s.member;
+    if constexpr (ListOf<Member>::isList) {
+        appendReportList(out, value);
+        if (value.empty() && s.empty != nullptr) {
+            out += s.empty;
+            out += '\n';
+        }
+    } else {
+        appendReportRecord(out, value);
+    }
+}
+
+// ---- GUI tables ----
+
+// (caption, value) rows of a single record, for two-column tables.
+template <typename Record>
+std::vector<std::pair<std::string, std::string>> fieldRows(const Record& record) {
+    std::vector<std::pair<std::string, std::string>> rows;
+    forEach(Schema<Record>::fields, [&](const auto& f) {
+        if (f.presentIn(record)) {
+            rows.emplace_back(f.label, displayText(f, record));
+        }
+    });
+    return rows;
+}
+
+// Column captions for a table with one row per record.
+template <typename Record>
+std::vector<std::string> fieldCaptions() {
+    std::vector<std::string> captions;
+    forEach(Schema<Record>::fields, [&](const auto& f) { captions.emplace_back(f.label); });
+    return captions;
+}
+
+// One row of such a table; fields absent from the record are blank.
+template <typename Record>
+std::vector<std::string> fieldCells(const Record& record) {
+    std::vector<std::string> cells;
+    forEach(Schema<Record>::fields, [&](const auto& f) {
+        cells.push_back(f.presentIn(record) ? displayText(f, record) : std::string());
+    });
+    return cells;
+}
+
+} // namespace statio
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace statio {
+
+// Mergeable relative-error quantile sketch (DDSketch with collapsing dense
+// stores). Values land in logarithmic bins of width `relativeAccuracy`, so any
+// quantile is reported within that relative error of the true value. The bin
+// count is capped, which bounds memory; beyond the cap the lowest bins are
+// collapsed, trading accuracy on the smallest values for fixed size.
+class QuantileSketch {
+public:
+    static constexpr double kDefaultAccuracy = 0.01;
+    static constexpr std::size_t kDefaultMaxBins = 1024;
+
+    QuantileSketch()
+        : QuantileSketch(kDefaultAccuracy, kDefaultMaxBins) {}
+    QuantileSketch(double relativeAccuracy, std::size_t maxBins);
+
+    void add(double value, std::uint64_t count = 1);
+    // Both sketches must share the same accuracy; throws std::invalid_argument otherwise.
+    void merge(const QuantileSketch& other);
+    void clear();
+
+    double quantile(double q) const;
+    std::uint64_t count() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+    double sum() const { return sum_; }
+    double relativeAccuracy() const { return accuracy_; }
+
+    void encode(std::string& out) const;
+    // Returns false (leaving the sketch cleared) on malformed input.
+    bool decode(const unsigned char* data, std::size_t size);
+
+private:
+    struct Store {
+        std::int32_t offset = 0;
+        std::vector<std::uint64_t> bins;
+
+        void add(std::int32_t index, std::uint64_t count, std::size_t maxBins);
+        void merge(const Store& other, std::size_t maxBins);
+        std::uint64_t total() const;
+    };
+
+    std::int32_t indexOf(double value) const;
+    double valueOf(std::int32_t index) const;
+
+    double accuracy_;
+    double gamma_;
+    double logGamma_;
+    std::size_t maxBins_;
+    Store positive_;
+    Store negative_;
+    std::uint64_t zeroCount_ = 0;
+    std::uint64_t count_ = 0;
+    double min_ = 0.0;
+    double max_ = 0.0;
+    double sum_ = 0.0;
+};
+
+} // namespace statio
@@ -1,16 +1,34 @@
 #pragma once
 
+#include "statio/sketch.hpp"
+
 #include <cstdint>
 #include <string>
 #include <vector>
 
 namespace statio {
 
+// Cumulative jiffies from one `cpu*` line of /proc/stat ("cpu" is the total).
+struct CpuTimes {
+    std::string name;
+    std::uint64_t user = 0;
+    std::uint64_t nice = 0;
+    std::uint64_t system = 0;
+    std::uint64_t idle = 0;
+    std::uint64_t iowait = 0;
+    std::uint64_t irq = 0;
+    std::uint64_t softirq = 0;
+    std::uint64_t steal = 0;
+};
+
 struct CpuInfo {
     std::string model;
     unsigned int logicalThreads = 0;
     unsigned int physicalCores = 0;
     double currentMHz = 0.0;
+    std::vector<CpuTimes> times;
+    // ISA features from /proc/cpuinfo ("flags" on x86, "Features" on ARM), sorted.
+    std::vector<std::string> flags;
 };
 
 struct MemoryInfo {
@@ -21,6 +39,35 @@ struct MemoryInfo {
     std::uint64_t swapFreeMB = 0;
 };
 
+// One persistent hugetlb pool, /sys/kernel/mm/hugepages/hugepages-<size>kB.
+struct HugePagePool {
+    std::uint64_t pageKB = 0;
+    std::uint64_t total = 0;
+    std::uint64_t free = 0;
+    std::uint64_t reserved = 0; // promised to mappings, not yet faulted in
+    std::uint64_t surplus = 0;  // allocated past `total` through overcommit
+};
+
+// Huge page availability. The HugePages_* counters of /proc/meminfo cover
+// the default size only; `pools` has every size. `freeBlocks[order]`
+// counts free runs of 2^order base pages over all zones of
+// /proc/buddyinfo, so `free2MBlockMB` is the free memory still contiguous
+// enough to back a 2 MiB page without compaction.
+struct HugePageInfo {
+    std::uint64_t defaultPageKB = 0;
+    std::uint64_t total = 0;
+    std::uint64_t free = 0;
+    std::uint64_t reserved = 0;
+    std::uint64_t surplus = 0;
+    std::uint64_t anonHugeMB = 0; // THP-backed anonymous memory
+    std::vector<HugePagePool> pools;
+    std::string thpEnabled; // always, madvise or never
+    std::string thpDefrag;  // always, defer, defer+madvise, madvise or never
+    std::vector<std::uint64_t> freeBlocks;
+    std::uint64_t freeMB = 0;
+    std::uint64_t free2MBlockMB = 0;
+};
+
 struct OsInfo {
     std::string distro;
     std::string version;
@@ -32,6 +79,7 @@ struct OsInfo {
 struct DiskInfo {
     std::string mountPoint;
     std::string filesystem;
+    std::string device; // mount source, e.g. /dev/nvme0n1p2
     std::uint64_t totalGB = 0;
     std::uint64_t freeGB = 0;
 };
@@ -42,6 +90,12 @@ struct NetworkInfo {
     std::string mac;
     std::uint64_t rxBytes = 0;
     std::uint64_t txBytes = 0;
+    // Link health, read for physical NICs only (/sys/class/net/<if>/device).
+    bool physical = false;
+    bool linkUp = false;
+    std::int64_t speedMbps = -1; // -1 when the driver does not report it
+    std::uint64_t errors = 0;    // rx_errors + tx_errors
+    std::uint64_t carrierChanges = 0;
 };
 
 struct GpuInfo {
@@ -49,16 +103,52 @@ struct GpuInfo {
     bool detected = false;
 };
 
+// Latency-type observations gathered between two snapshots (disk await,
+// runqueue delay, collector latency). The sketch keeps the full distribution
+// so it merges across time buckets and hosts at a fixed memory cost.
+struct DistributionInfo {
+    std::string name;
+    std::string entity;
+    QuantileSketch sketch;
+};
+
 struct SystemSnapshot {
     CpuInfo cpu;
     MemoryInfo memory;
+    HugePageInfo hugepages;
     OsInfo os;
     std::vector<DiskInfo> disks;
     std::vector<NetworkInfo> network;
     std::vector<GpuInfo> gpus;
+    // Filled by stateful samplers (see LatencySampler); empty for a one-shot
+    // collection.
+    std::vector<DistributionInfo> distributions;
+};
+
+// What a snapshot is collected from, combinable as a bit mask. A source
+// left out is never read and its part of the snapshot stays empty, so a
+// caller that needs a few fields only pays for their files.
+enum SnapshotSource : unsigned {
+    SourceOs = 1u << 0,           // uname, /etc/os-release
+    SourceCpuInfo = 1u << 1,      // /proc/cpuinfo: model, cores, MHz, flags
+    SourceCpuTimes = 1u << 2,     // /proc/stat cpu lines
+    SourceMemory = 1u << 3,       // sysinfo(), /proc/meminfo
+    SourceHugePages = 1u << 4,    // /proc/meminfo, /sys/kernel/mm, /proc/buddyinfo
+    SourceDisks = 1u << 5,        // /proc/mounts, statvfs() per mount
+    SourceNetCounters = 1u << 6,  // /proc/net/dev byte counters
+    SourceNetLink = 1u << 7,      // /sys/class/net/<if>: physical, link state, speed, errors
+    SourceNetAddresses = 1u << 8, // getifaddrs() IPv4, MAC address
+    SourceGpus = 1u << 9,         // /sys/class/drm
+    SourceAll = (1u << 10) - 1,
 };
 
-SystemSnapshot collectSystemSnapshot();
+SystemSnapshot collectSystemSnapshot(unsigned sources = SourceAll);
+CpuInfo collectCpuInfo(unsigned sources = SourceCpuInfo | SourceCpuTimes);
+bool cpuHasFlag(const CpuInfo& cpu, const std::string& flag);
+MemoryInfo collectMemoryInfo();
+HugePageInfo collectHugePageInfo();
+OsInfo collectOsInfo();
+std::vector<DiskInfo> collectDiskInfo();
 std::string renderReport(const SystemSnapshot& snapshot);
 
 } // namespace statio
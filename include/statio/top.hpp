@@ -0,0 +1,172 @@
+#pragma once
+
+#include "statio/batch_read.hpp"
+#include "statio/burst.hpp"
+#include "statio/proc_scan.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace statio {
+
+enum class CellStyle : std::uint8_t { Normal, Bold, Dim, Inverse, Green, Yellow, Red };
+
+// A character grid drawn in full every frame. flush() compares it with what
+// the terminal already shows and emits cursor moves and bytes for the
+// changed cells only, so an idle screen costs nothing to redraw.
+class ScreenBuffer {
+public:
+    // Resizing discards what the terminal shows: the next flush() repaints.
+    void resize(int rows, int cols);
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+
+    // Blanks the frame being drawn.
+    void clear();
+    // Writes `text` at (row, col), clipped to the screen. Bytes outside
+    // printable ASCII are drawn as '?'.
+    void text(int row, int col, std::string_view text, CellStyle style = CellStyle::Normal);
+    // Fills the rest of `row` from `col` with `style` (e.g. an inverse header bar).
+    void fill(int row, int col, CellStyle style);
+
+    // Appends the ANSI sequences that bring the terminal up to date to `out`
+    // and returns the number of cells that changed.
+    std::size_t flush(std::string& out);
+    // Forgets what the terminal shows, e.g. after another program wrote to it.
+    void invalidate() { repaint_ = true; }
+
+private:
+    struct Cell {
+        char ch = ' ';
+        CellStyle style = CellStyle::Normal;
+        bool operator==(const Cell& other) const { return ch == other.ch && style == other.style; }
+        bool operator!=(const Cell& other) const { return !(*this == other); }
+    };
+
+    int rows_ = 0;
+    int cols_ = 0;
+    bool repaint_ = true;
+    std::vector<Cell> shown_; // what the terminal has
+    std::vector<Cell> frame_; // what the next flush() should leave there
+};
+
+struct ProcessSample {
+    int pid = 0;
+    std::string name; // comm, at most 15 bytes
+    char state = '?';
+    double cpuPct = 0.0; // of one core, since the previous sample
+    std::uint64_t rssKB = 0;
+    unsigned threads = 0;
+};
+
+// Per-process CPU and memory from /proc/<pid>/stat. Each process's file is
+// opened once and held in a BatchReader, which re-reads all of them in one
+// batch per sample (one pread() each, or a few io_uring submissions); only
+// the /proc directory is listed every time, with getdents64() on a held
+// descriptor, to find new processes. A pid that is reused reads as an error
+// on the old descriptor, so it is dropped and reopened like a new process.
+// Processes beyond the descriptor budget are read by a ProcScanner, in
+// parallel once there are enough of them.
+class ProcessTable {
+public:
+    explicit ProcessTable(IoBackend io = IoBackend::Pread);
+    ~ProcessTable();
+
+    ProcessTable(const ProcessTable&) = delete;
+    ProcessTable& operator=(const ProcessTable&) = delete;
+
+    // Re-reads every process; CPU% covers the time since the previous call
+    // (0 on the first).
+    const std::vector<ProcessSample>& sample();
+    const std::vector<ProcessSample>& rows() const { return rows_; }
+    IoBackend backend() const { return reader_.backend(); }
+
+private:
+    struct Tracked {
+        std::size_t slot = BatchReader::npos; // in reader_, when held open
+        std::uint64_t ticks = 0;              // utime + stime
+        std::uint64_t generation = 0;         // last listing that saw the pid
+        bool fresh = true;                    // no ticks from a previous sample
+    };
+
+    bool parseStat(std::string_view text, ProcessSample& out, std::uint64_t& ticks) const;
+    bool readOnce(int pid, Tracked& tracked, ProcessSample& out, std::uint64_t& ticks);
+    void release(Tracked& tracked);
+    void record(Tracked& tracked, ProcessSample& row, std::uint64_t ticks, double seconds);
+
+    BatchReader reader_;
+    std::unique_ptr<ProcScanner> scanner_; // made once processes overflow
+    ProcessColumns scanned_;
+    int procFd_ = -1;
+    std::unordered_map<int, Tracked> tracked_;
+    std::vector<int> pids_;     // this listing, in /proc order
+    std::vector<int> overflow_; // of those, the ones left to scanner_
+    std::vector<ProcessSample> rows_;
+    std::string buffer_;
+    std::uint64_t generation_ = 0;
+    std::int64_t lastMs_ = 0;
+    std::size_t maxOpen_ = 0; // processes beyond this are read by scanner_
+    double ticksPerSecond_ = 100.0;
+    std::uint64_t pageKB_ = 4;
+};
+
+// One refresh of `statio top`. Rates are per second over the time since the
+// previous frame; the first frame has no rates.
+struct TopFrame {
+    double seconds = 0.0;
+    std::vector<double> coreBusy; // 0-1 per cpuN, in /proc/stat order
+    double cpuBusy = 0.0;
+    double loadAvg[3] = {0.0, 0.0, 0.0};
+    std::uint64_t memTotalKB = 0;
+    std::uint64_t memAvailableKB = 0;
+    std::uint64_t swapTotalKB = 0;
+    std::uint64_t swapFreeKB = 0;
+
+    struct DiskRate {
+        std::string name;
+        double readBytes = 0.0;
+        double writeBytes = 0.0;
+        double busy = 0.0; // 0-1
+    };
+    struct NetRate {
+        std::string name;
+        double rxBytes = 0.0;
+        double txBytes = 0.0;
+    };
+    std::vector<DiskRate> disks;
+    std::vector<NetRate> network;
+};
+
+// Samples everything `statio top` shows through descriptors held open for
+// its lifetime: the burst collectors for CPU, network and disk counters,
+// plus /proc/meminfo and /proc/loadavg.
+class TopSampler {
+public:
+    explicit TopSampler(IoBackend io = IoBackend::Pread);
+    ~TopSampler();
+
+    TopSampler(const TopSampler&) = delete;
+    TopSampler& operator=(const TopSampler&) = delete;
+
+    void sample(TopFrame& frame);
+
+private:
+    bool readFile(int fd);
+    void readMemory(TopFrame& frame);
+    void readLoad(TopFrame& frame);
+
+    BurstSampler counters_;
+    std::vector<MetricSample> series_; // descriptions of counters_'s slots
+    std::vector<double> values_;
+    std::vector<double> previous_;
+    std::int64_t previousMs_ = 0;
+    int meminfoFd_ = -1;
+    int loadavgFd_ = -1;
+    std::string buffer_;
+};
+
+} // namespace statio
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "statio/history.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace statio {
+
+// Agent -> aggregator stream format. Every frame is
+//   u32 magic "STW1" | u32 payload bytes | payload
+// and every payload starts with a one-byte WireFrameType:
+//   Hello     varint host length, host name
+//   Batch     varint sequence, u8 codec (0 none, 1 LZ), varint raw size,
+//             then Hello/Snapshot frames, compressed as a whole
+//   Ack       varint sequence (receiver -> sender: every batch up to and
+//             including it is processed)
+//   Snapshot  u8 full, zigzag varint timestamp delta,
+//             varint new series, each: varint id, u8 kind, varint name
+//               length, name, varint entity length, entity
+//             varint changed values, each: varint id gap, varint (bits XOR
+//               previous bits) of the double
+// Series ids and previous values are connection state: a value that did not
+// change costs nothing, and a counter that moved a little mostly flips low
+// mantissa bits, so the XOR encodes in a few bytes. A full snapshot restarts
+// the state and is sent first on every connection; a batch starts with one
+// so that it decodes on its own, whenever and wherever it is replayed.
+// Integers are little-endian, like the history store.
+enum class WireFrameType : std::uint8_t { Hello = 1, Snapshot = 2, Batch = 3, Ack = 4 };
+
+constexpr std::uint32_t kWireMagic = 0x31575453; // "STW1"
+constexpr std::size_t kWireHeaderBytes = 8;
+constexpr std::size_t kWireMaxPayload = 64U << 20;
+
+class SnapshotEncoder {
+public:
+    void hello(const std::string& host, std::string& out) const;
+    // Appends one Snapshot frame for `samples`. Distributions travel as
+    // their mean; sketches stay in the local history.
+    void encode(std::int64_t timestampMs, const std::vector<MetricSample>& samples, std::string& out);
+    // Forgets the connection state so the next frame is a full snapshot.
+    void reset();
+
+private:
+    std::unordered_map<std::string, std::uint32_t> ids_;
+    std::vector<std::uint64_t> bits_;
+    std::int64_t lastMs_ = 0;
+    bool full_ = true;
+    std::string key_;
+    std::vector<std::uint32_t> order_;
+    std::vector<std::pair<std::uint32_t, std::uint64_t>> changed_;
+};
+
+struct WireSeries {
+    std::string name;
+    std::string entity;
+    MetricKind kind = MetricKind::Gauge;
+    double value = 0.0;
+    std::uint64_t bits = 0;
+};
+
+// Decodes the frames of one connection. Throws std::runtime_error on
+// malformed input, after which the connection should be dropped.
+class SnapshotDecoder {
+public:
+    WireFrameType decode(std::string_view payload);
+
+    const std::string& host() const { return host_; }
+    std::int64_t timestampMs() const { return timestampMs_; }
+    // Whether the last snapshot restarted the series table.
+    bool full() const { return full_; }
+    const std::vector<WireSeries>& series() const { return series_; }
+    // Ids whose value changed in the last snapshot, and ids first defined there.
+    const std::vector<std::uint32_t>& changed() const { return changed_; }
+    const std::vector<std::uint32_t>& added() const { return added_; }
+
+private:
+    std::string host_;
+    std::int64_t timestampMs_ = 0;
+    bool full_ = false;
+    std::vector<WireSeries> series_;
+    std::vector<std::uint32_t> changed_;
+    std::vector<std::uint32_t> added_;
+};
+
+enum class WireCodec : std::uint8_t { None = 0, Lz = 1 };
+
+// Wraps already encoded frames into a Batch frame.
+void appendWireBatch(std::string& out, std::uint64_t sequence, std::string_view frames, WireCodec codec);
+// Unpacks a Batch payload (type byte included), appending its frames to
+// `frames`. Throws std::runtime_error on corrupt input.
+std::uint64_t unpackWireBatch(std::string_view payload, std::string& frames);
+void appendWireAck(std::string& out, std::uint64_t sequence);
+std::uint64_t parseWireAck(std::string_view payload);
+WireFrameType wireFrameType(std::string_view payload);
+
+// Splits the next complete frame off the front of `buffer`. Returns false
+// when more bytes are needed; throws on a bad magic or oversized frame.
+bool nextWireFrame(std::string_view& buffer, std::string_view& payload);
+
+// Stream socket helpers. Addresses are HOST:PORT (`:PORT` binds every
+// interface) or unix:PATH. Both throw std::runtime_error; the returned
+// descriptors are blocking and close-on-exec.
+int connectStream(const std::string& address);
+// Gives up after `timeoutMs`, or as soon as `cancelled` returns true; it is
+// polled every 100 ms while the connection is pending.
+int connectStream(const std::string& address, std::int64_t timeoutMs, const std::function<bool()>& cancelled = {});
+int listenStream(const std::string& address, int backlog = 1024);
+// Writes all of `data` to a blocking descriptor; false on error.
+bool sendAll(int fd, std::string_view data);
+
+} // namespace statio
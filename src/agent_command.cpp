@@ -0,0 +1,236 @@
+#include "statio/commands.hpp"
+
+#include "statio/aggregator.hpp"
+#include "statio/cli_options.hpp"
+#include "statio/history.hpp"
+#include "statio/system_info.hpp"
+#include "statio/wire.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+// One simulated host for load tests: the local snapshot with its own CPU
+// load, memory use, traffic and link faults, so the aggregator sees
+// thousands of distinct hosts from one process.
+struct SimulatedHost {
+    std::string name;
+    int fd = -1;
+    SnapshotEncoder encoder;
+    std::mt19937_64 random;
+    double load = 0.0;
+    double busy = 0.0;
+    double idle = 0.0;
+    double rx = 0.0;
+    double tx = 0.0;
+    double errors = 0.0;
+    bool linkDown = false;
+
+    void step(std::vector<MetricSample>& samples, double elapsedSec) {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        load = std::clamp(load + (unit(random) - 0.5) * 0.1, 0.0, 1.0);
+        const double ticks = 100.0 * elapsedSec;
+        busy += ticks * load;
+        idle += ticks * (1.0 - load);
+        rx += 1e6 * elapsedSec * unit(random);
+        tx += 1e5 * elapsedSec * unit(random);
+        if (unit(random) < 0.001) {
+            errors += 1.0;
+        }
+        for (auto& s : samples) {
+            if (s.entity == "cpu" && s.name == "cpu.user") {
+                s.value = busy;
+            } else if (s.entity == "cpu" && s.name == "cpu.idle") {
+                s.value = idle;
+            } else if (s.name == "network.rx_bytes") {
+                s.value = rx;
+            } else if (s.name == "network.tx_bytes") {
+                s.value = tx;
+            } else if (s.name == "network.link_up") {
+                s.value = linkDown ? 0.0 : 1.0;
+            } else if (s.name == "network.errors") {
+                s.value = errors;
+            } else if (s.name == "memory.available_mb") {
+                s.value = std::floor(unit(random) * 1024.0) + 512.0;
+            }
+        }
+    }
+};
+
+// Zeroes the cpu-total counters the simulation does not drive, so
+// simulated load is all the busy time an aggregator sees, and gives
+// snapshots without a physical NIC one.
+void prepareTemplate(std::vector<MetricSample>& samples) {
+    bool haveLink = false;
+    for (auto& s : samples) {
+        if (s.entity == "cpu" && s.kind == MetricKind::Counter) {
+            s.value = 0.0;
+        }
+        haveLink = haveLink || s.name == "network.link_up";
+    }
+    if (!haveLink) {
+        for (const char* name : {"network.rx_bytes", "network.tx_bytes", "network.link_up", "network.errors"}) {
+            MetricSample sample;
+            sample.name = name;
+            sample.entity = "sim0";
+            sample.kind = std::string(name) == "network.link_up" ? MetricKind::Gauge : MetricKind::Counter;
+            samples.push_back(std::move(sample));
+        }
+    }
+}
+
+std::string localHostName() {
+    char name[256] = {};
+    if (::gethostname(name, sizeof(name) - 1) != 0 || name[0] == '\0') {
+        return "localhost";
+    }
+    return name;
+}
+
+} // namespace
+
+int runAgentCommand(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"aggregator", "interval", "samples", "host", "simulate"}, {"quiet"});
+    const std::string address = cli.value("aggregator");
+    if (address.empty()) {
+        throw std::runtime_error("agent requires --aggregator HOST:PORT");
+    }
+    const std::int64_t intervalMs = parseDurationMs(cli.value("interval", "1s"));
+    const std::int64_t maxSamples = cli.integer("samples", 0);
+    const std::int64_t simulated = cli.integer("simulate", 0);
+    if (intervalMs <= 0) {
+        throw std::runtime_error("--interval must be positive");
+    }
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<SimulatedHost> hosts(static_cast<std::size_t>(std::max<std::int64_t>(simulated, 1)));
+    for (std::size_t i = 0; i < hosts.size(); ++i) {
+        auto& host = hosts[i];
+        if (simulated > 0) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "sim-%05zu", i);
+            host.name = name;
+            host.random.seed(i + 1);
+            host.load = std::uniform_real_distribution<double>(0.0, 1.0)(host.random);
+            host.linkDown = i % 50 == 49;
+        } else {
+            host.name = cli.value("host", localHostName());
+        }
+    }
+
+    std::uint64_t frames = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t fullBytes = 0;
+    std::string out;
+    auto next = std::chrono::steady_clock::now();
+    std::int64_t previousMs = 0;
+    for (std::int64_t taken = 0; !stopRequested && (maxSamples <= 0 || taken < maxSamples); ++taken) {
+        std::vector<MetricSample> base = flattenSnapshot(collectSystemSnapshot());
+        const std::int64_t now = currentTimeMs();
+        if (simulated > 0) {
+            prepareTemplate(base);
+        }
+        const double elapsedSec = previousMs > 0 ? static_cast<double>(now - previousMs) / 1000.0 : 1.0;
+        previousMs = now;
+
+        for (auto& host : hosts) {
+            if (host.fd < 0) {
+                try {
+                    host.fd = connectStream(address);
+                } catch (const std::exception& e) {
+                    if (!cli.has("quiet") && &host == &hosts.front()) {
+                        std::cerr << "statio agent: " << e.what() << ", retrying\n";
+                    }
+                    continue;
+                }
+                host.encoder.reset();
+                out.clear();
+                host.encoder.hello(host.name, out);
+                if (!sendAll(host.fd, out)) {
+                    ::close(host.fd);
+                    host.fd = -1;
+                    continue;
+                }
+            }
+
+            std::vector<MetricSample>* samples = &base;
+            std::vector<MetricSample> own;
+            if (simulated > 0) {
+                own = base;
+                host.step(own, elapsedSec);
+                samples = &own;
+            }
+            out.clear();
+            const bool full = frames < hosts.size();
+            host.encoder.encode(now, *samples, out);
+            if (!sendAll(host.fd, out)) {
+                ::close(host.fd);
+                host.fd = -1;
+                continue;
+            }
+            ++frames;
+            bytes += out.size();
+            if (full) {
+                fullBytes += out.size();
+            }
+        }
+
+        next += std::chrono::milliseconds(intervalMs);
+        while (!stopRequested && std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_until(std::min(next, std::chrono::steady_clock::now() + std::chrono::milliseconds(200)));
+        }
+    }
+
+    for (auto& host : hosts) {
+        if (host.fd >= 0) {
+            ::close(host.fd);
+        }
+    }
+    if (!cli.has("quiet")) {
+        const std::uint64_t deltas = frames > hosts.size() ? frames - hosts.size() : 0;
+        std::cerr << "statio agent: " << frames << " frames, " << bytes << " bytes";
+        if (frames > 0) {
+            std::cerr << " (first " << fullBytes / std::min<std::uint64_t>(frames, hosts.size()) << " B/frame";
+            if (deltas > 0) {
+                std::cerr << ", then " << (bytes - fullBytes) / deltas << " B/frame";
+            }
+            std::cerr << ')';
+        }
+        std::cerr << '\n';
+    }
+    return 0;
+}
+
+int runFleetCommand(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"aggregator"});
+    std::string query;
+    for (const auto& word : cli.positional()) {
+        query += (query.empty() ? "" : " ") + word;
+    }
+    if (query.empty()) {
+        query = "hosts";
+    }
+    std::cout << queryFleet(cli.value("aggregator", "127.0.0.1:7412"), query);
+    return 0;
+}
+
+} // namespace statio
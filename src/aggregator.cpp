@@ -0,0 +1,790 @@
+#include "statio/aggregator.hpp"
+
+#include "statio/wire.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+// Errors and carrier changes keep a link degraded for this long.
+constexpr std::int64_t kDegradedHoldMs = 60000;
+// Bytes read from one connection per wakeup before moving on to the others.
+constexpr std::size_t kReadBudget = 256 * 1024;
+// A query client must send its line and read the answer within this.
+constexpr std::int64_t kQueryTimeoutMs = 2000;
+constexpr std::size_t kMaxQueryBytes = 4096;
+
+std::int64_t steadyMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+std::string peerName(int fd) {
+    sockaddr_storage address {};
+    socklen_t length = sizeof(address);
+    if (::getpeername(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        return "?";
+    }
+    char host[INET6_ADDRSTRLEN] = {};
+    int port = 0;
+    if (address.ss_family == AF_INET) {
+        const auto* in = reinterpret_cast<const sockaddr_in*>(&address);
+        ::inet_ntop(AF_INET, &in->sin_addr, host, sizeof(host));
+        port = ntohs(in->sin_port);
+    } else if (address.ss_family == AF_INET6) {
+        const auto* in6 = reinterpret_cast<const sockaddr_in6*>(&address);
+        ::inet_ntop(AF_INET6, &in6->sin6_addr, host, sizeof(host));
+        port = ntohs(in6->sin6_port);
+    }
+    return std::string(host) + ':' + std::to_string(port);
+}
+
+// Turns one host's decoded snapshots into HostSummary values. Series are
+// classified once when they are defined; each snapshot then only visits the
+// handful of series a summary needs.
+class HostTracker {
+public:
+    void apply(const SnapshotDecoder& decoder, HostSummary& summary) {
+        const auto& series = decoder.series();
+        if (decoder.full()) {
+            renumber(series);
+        }
+        for (std::uint32_t id : decoder.added()) {
+            classify(id, series[id]);
+            keys_.resize(std::max<std::size_t>(keys_.size(), id + 1));
+            keys_[id] = seriesKey(series[id]);
+        }
+        if (decoder.full()) {
+            links_.erase(std::remove_if(links_.begin(), links_.end(),
+                                        [](const Link& l) {
+                                            return l.up == kNone && l.errors == kNone && l.carrier == kNone;
+                                        }),
+                         links_.end());
+        }
+
+        const std::int64_t now = decoder.timestampMs();
+        const double elapsedSec = previousMs_ > 0 && now > previousMs_ ? static_cast<double>(now - previousMs_) / 1000.0 : 0.0;
+        previous_.resize(series.size(), 0.0);
+
+        const double busy = sum(series, cpuBusy_);
+        const double idle = sum(series, cpuIdle_);
+        const double busyDelta = busy - sum(previous_, cpuBusy_);
+        const double totalDelta = busyDelta + idle - sum(previous_, cpuIdle_);
+        if (elapsedSec > 0.0 && totalDelta > 0.0 && busyDelta >= 0.0) {
+            summary.cpuPercent = 100.0 * busyDelta / totalDelta;
+        }
+        if (memTotal_ != kNone && memAvailable_ != kNone && series[memTotal_].value > 0.0) {
+            summary.memoryUsedPercent = 100.0 * (1.0 - series[memAvailable_].value / series[memTotal_].value);
+        }
+        if (elapsedSec > 0.0) {
+            summary.rxBytesPerSec = std::max(0.0, sum(series, rx_) - sum(previous_, rx_)) / elapsedSec;
+            summary.txBytesPerSec = std::max(0.0, sum(series, tx_) - sum(previous_, tx_)) / elapsedSec;
+        }
+
+        summary.degradedLinks.clear();
+        for (auto& link : links_) {
+            if (elapsedSec > 0.0) {
+                if (link.errors != kNone && series[link.errors].value > previous_[link.errors]) {
+                    link.lastErrorMs = now;
+                }
+                if (link.carrier != kNone && series[link.carrier].value > previous_[link.carrier]) {
+                    link.lastFlapMs = now;
+                }
+            }
+            if (link.up != kNone && series[link.up].value == 0.0) {
+                summary.degradedLinks.push_back(link.entity + " down");
+            } else if (link.lastFlapMs > 0 && now - link.lastFlapMs < kDegradedHoldMs) {
+                summary.degradedLinks.push_back(link.entity + " flapping");
+            } else if (link.lastErrorMs > 0 && now - link.lastErrorMs < kDegradedHoldMs) {
+                summary.degradedLinks.push_back(link.entity + " errors");
+            }
+        }
+
+        for (std::size_t i = 0; i < series.size(); ++i) {
+            previous_[i] = series[i].value;
+        }
+        previousMs_ = now;
+        summary.timestampMs = now;
+    }
+
+private:
+    static constexpr std::uint32_t kNone = static_cast<std::uint32_t>(-1);
+
+    struct Link {
+        std::string entity;
+        std::uint32_t up = kNone;
+        std::uint32_t errors = kNone;
+        std::uint32_t carrier = kNone;
+        std::int64_t lastErrorMs = 0;
+        std::int64_t lastFlapMs = 0;
+    };
+
+    static double sum(const std::vector<WireSeries>& series, const std::vector<std::uint32_t>& ids) {
+        double total = 0.0;
+        for (std::uint32_t id : ids) {
+            total += series[id].value;
+        }
+        return total;
+    }
+
+    static double sum(const std::vector<double>& values, const std::vector<std::uint32_t>& ids) {
+        double total = 0.0;
+        for (std::uint32_t id : ids) {
+            total += values[id];
+        }
+        return total;
+    }
+
+    static std::string seriesKey(const WireSeries& s) {
+        return s.name + '\0' + s.entity;
+    }
+
+    // A full frame restarts the series table; a pushing daemon starts every
+    // batch with one. The ids change but the series mostly do not, so the
+    // previous values move to the new ids by name and entity, and links keep
+    // their error and flap times: rates and hold times carry on across it.
+    // A series new in the frame starts from its own value.
+    void renumber(const std::vector<WireSeries>& series) {
+        std::unordered_map<std::string, double> carried;
+        carried.reserve(keys_.size());
+        for (std::size_t i = 0; i < keys_.size() && i < previous_.size(); ++i) {
+            carried.emplace(std::move(keys_[i]), previous_[i]);
+        }
+        keys_.clear();
+        previous_.assign(series.size(), 0.0);
+        for (std::size_t i = 0; i < series.size(); ++i) {
+            const auto it = carried.find(seriesKey(series[i]));
+            previous_[i] = it != carried.end() ? it->second : series[i].value;
+        }
+        cpuBusy_.clear();
+        cpuIdle_.clear();
+        rx_.clear();
+        tx_.clear();
+        memTotal_ = memAvailable_ = kNone;
+        for (auto& l : links_) {
+            l.up = l.errors = l.carrier = kNone;
+        }
+    }
+
+    Link& link(const std::string& entity) {
+        for (auto& l : links_) {
+            if (l.entity == entity) {
+                return l;
+            }
+        }
+        links_.push_back(Link{entity});
+        return links_.back();
+    }
+
+    void classify(std::uint32_t id, const WireSeries& s) {
+        const std::string& name = s.name;
+        if (name.rfind("cpu.", 0) == 0 && s.entity == "cpu") {
+            if (name == "cpu.idle" || name == "cpu.iowait") {
+                cpuIdle_.push_back(id);
+            } else if (name != "cpu.mhz") {
+                cpuBusy_.push_back(id);
+            }
+        } else if (name == "memory.total_mb") {
+            memTotal_ = id;
+        } else if (name == "memory.available_mb") {
+            memAvailable_ = id;
+        } else if (name == "network.rx_bytes" && s.entity != "lo") {
+            rx_.push_back(id);
+        } else if (name == "network.tx_bytes" && s.entity != "lo") {
+            tx_.push_back(id);
+        } else if (name == "network.link_up") {
+            link(s.entity).up = id;
+        } else if (name == "network.errors") {
+            link(s.entity).errors = id;
+        } else if (name == "network.carrier_changes") {
+            link(s.entity).carrier = id;
+        }
+    }
+
+    std::vector<std::uint32_t> cpuBusy_;
+    std::vector<std::uint32_t> cpuIdle_;
+    std::vector<std::uint32_t> rx_;
+    std::vector<std::uint32_t> tx_;
+    std::vector<Link> links_;
+    std::uint32_t memTotal_ = kNone;
+    std::uint32_t memAvailable_ = kNone;
+    std::vector<double> previous_;
+    std::vector<std::string> keys_; // seriesKey() per id, for renumber()
+    std::int64_t previousMs_ = 0;
+};
+
+void appendHostRow(std::ostringstream& out, const HostSummary& h) {
+    out << std::left << std::setw(24) << h.host << std::right << std::fixed << std::setprecision(1) << std::setw(8)
+        << h.cpuPercent << std::setw(8) << h.memoryUsedPercent << std::setprecision(0) << std::setw(14)
+        << h.rxBytesPerSec << std::setw(14) << h.txBytesPerSec << "  " << (h.connected ? "up" : "gone");
+    for (const auto& link : h.degradedLinks) {
+        out << "  " << link;
+    }
+    out << '\n';
+}
+
+void appendHostHeader(std::ostringstream& out) {
+    out << std::left << std::setw(24) << "host" << std::right << std::setw(8) << "cpu%" << std::setw(8) << "mem%"
+        << std::setw(14) << "rx B/s" << std::setw(14) << "tx B/s" << "  state\n";
+}
+
+// One query connection, served by the accept loop: read a request line,
+// then write the answer.
+struct QueryClient {
+    int fd = -1;
+    std::string request;
+    std::string response;
+    std::size_t sent = 0;
+    bool answered = false;
+    bool watchingOut = false; // epoll waits for EPOLLOUT instead of EPOLLIN
+    std::int64_t deadlineMs = 0;
+};
+
+// Moves one query along as far as the socket allows without blocking.
+// Returns false once the connection should be closed.
+bool pumpQuery(const Aggregator& aggregator, QueryClient& client) {
+    if (!client.answered) {
+        char chunk[512];
+        bool complete = false;
+        while (!complete) {
+            const ssize_t n = ::recv(client.fd, chunk, sizeof(chunk), 0);
+            if (n > 0) {
+                client.request.append(chunk, static_cast<std::size_t>(n));
+                complete = client.request.find('\n') != std::string::npos || client.request.size() >= kMaxQueryBytes;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                complete = true; // EOF: answer what arrived
+            }
+        }
+        client.response = aggregator.answer(client.request.substr(0, client.request.find('\n')));
+        client.answered = true;
+    }
+    while (client.sent < client.response.size()) {
+        const ssize_t n = ::send(client.fd, client.response.data() + client.sent, client.response.size() - client.sent,
+                                 MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            client.sent += static_cast<std::size_t>(n);
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        } else if (!(n < 0 && errno == EINTR)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+const char* fleetMetricName(FleetMetric metric) {
+    switch (metric) {
+    case FleetMetric::Cpu:
+        return "cpu";
+    case FleetMetric::Memory:
+        return "memory";
+    case FleetMetric::Rx:
+        return "rx";
+    case FleetMetric::Tx:
+        return "tx";
+    }
+    return "?";
+}
+
+bool parseFleetMetric(const std::string& text, FleetMetric& metric) {
+    for (std::size_t i = 0; i < kFleetMetricCount; ++i) {
+        if (text == fleetMetricName(static_cast<FleetMetric>(i))) {
+            metric = static_cast<FleetMetric>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+double HostSummary::metric(FleetMetric which) const {
+    double value = 0.0;
+    switch (which) {
+    case FleetMetric::Cpu:
+        value = cpuPercent;
+        break;
+    case FleetMetric::Memory:
+        value = memoryUsedPercent;
+        break;
+    case FleetMetric::Rx:
+        value = rxBytesPerSec;
+        break;
+    case FleetMetric::Tx:
+        value = txBytesPerSec;
+        break;
+    }
+    // NaN would break the ordering of the per-shard indexes.
+    return std::isnan(value) ? 0.0 : value;
+}
+
+FleetState::FleetState(std::size_t shards) : shards_(std::max<std::size_t>(shards, 1)) {}
+
+FleetState::Shard& FleetState::shardFor(const std::string& host) {
+    return shards_[std::hash<std::string>{}(host) % shards_.size()];
+}
+
+const FleetState::Shard& FleetState::shardFor(const std::string& host) const {
+    return shards_[std::hash<std::string>{}(host) % shards_.size()];
+}
+
+void FleetState::update(const HostSummary& summary) {
+    Shard& shard = shardFor(summary.host);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto [it, inserted] = shard.hosts.try_emplace(summary.host);
+    for (std::size_t m = 0; m < kFleetMetricCount; ++m) {
+        const auto metric = static_cast<FleetMetric>(m);
+        if (!inserted) {
+            shard.index[m].erase({it->second.metric(metric), summary.host});
+        }
+        shard.index[m].emplace(summary.metric(metric), summary.host);
+    }
+    if (summary.degradedLinks.empty()) {
+        shard.degraded.erase(summary.host);
+    } else {
+        shard.degraded.insert(summary.host);
+    }
+    it->second = summary;
+}
+
+void FleetState::attached(const std::string& host) {
+    Shard& shard = shardFor(host);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.live[host];
+}
+
+void FleetState::disconnected(const std::string& host) {
+    Shard& shard = shardFor(host);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto live = shard.live.find(host);
+    if (live != shard.live.end() && --live->second > 0) {
+        return; // another connection still feeds it
+    }
+    if (live != shard.live.end()) {
+        shard.live.erase(live);
+    }
+    auto it = shard.hosts.find(host);
+    if (it != shard.hosts.end()) {
+        it->second.connected = false;
+    }
+}
+
+std::vector<HostSummary> FleetState::top(FleetMetric metric, std::size_t count) const {
+    std::vector<HostSummary> out;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const auto& index = shard.index[static_cast<std::size_t>(metric)];
+        std::size_t taken = 0;
+        for (auto it = index.rbegin(); it != index.rend() && taken < count; ++it, ++taken) {
+            out.push_back(shard.hosts.at(it->second));
+        }
+    }
+    const auto byMetric = [metric](const HostSummary& a, const HostSummary& b) {
+        return a.metric(metric) > b.metric(metric);
+    };
+    const std::size_t keep = std::min(count, out.size());
+    std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(keep), out.end(), byMetric);
+    out.resize(keep);
+    return out;
+}
+
+std::vector<HostSummary> FleetState::degraded() const {
+    std::vector<HostSummary> out;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& host : shard.degraded) {
+            out.push_back(shard.hosts.at(host));
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const HostSummary& a, const HostSummary& b) { return a.host < b.host; });
+    return out;
+}
+
+std::optional<HostSummary> FleetState::host(const std::string& name) const {
+    const Shard& shard = shardFor(name);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.hosts.find(name);
+    if (it == shard.hosts.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+FleetTotals FleetState::totals() const {
+    FleetTotals totals;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        totals.hosts += shard.hosts.size();
+        totals.degraded += shard.degraded.size();
+        for (const auto& [name, host] : shard.hosts) {
+            totals.connected += host.connected ? 1 : 0;
+            totals.frames += host.frames;
+            totals.bytes += host.bytes;
+        }
+    }
+    return totals;
+}
+
+struct Aggregator::Worker {
+    struct Connection {
+        int fd = -1;
+        std::string buffer;
+        SnapshotDecoder decoder;
+        HostTracker tracker;
+        HostSummary summary;
+        std::string attachedHost; // the host this connection feeds, once it sent a snapshot
+    };
+
+    Worker(FleetState& state, bool quiet) : state(state), quiet(quiet) {
+        epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (epollFd < 0 || wakeFd < 0) {
+            throw std::runtime_error(std::string("cannot create decoder thread: ") + std::strerror(errno));
+        }
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+        thread = std::thread([this] { run(); });
+    }
+
+    ~Worker() {
+        stopping = true;
+        wake();
+        thread.join();
+        for (auto& [fd, connection] : connections) {
+            ::close(fd);
+        }
+        ::close(wakeFd);
+        ::close(epollFd);
+    }
+
+    void adopt(int fd) {
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            pending.push_back(fd);
+        }
+        wake();
+    }
+
+    void wake() {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] const ssize_t n = ::write(wakeFd, &one, sizeof(one));
+    }
+
+    void run() {
+        epoll_event events[128];
+        while (!stopping) {
+            const int ready = ::epoll_wait(epollFd, events, 128, 500);
+            for (int i = 0; i < ready; ++i) {
+                if (events[i].data.ptr == nullptr) {
+                    std::uint64_t count = 0;
+                    [[maybe_unused]] const ssize_t n = ::read(wakeFd, &count, sizeof(count));
+                    registerPending();
+                } else {
+                    service(*static_cast<Connection*>(events[i].data.ptr));
+                }
+            }
+        }
+    }
+
+    void registerPending() {
+        std::vector<int> fds;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            fds.swap(pending);
+        }
+        for (int fd : fds) {
+            auto connection = std::make_unique<Connection>();
+            connection->fd = fd;
+            connection->summary.peer = peerName(fd);
+            connection->summary.host = connection->summary.peer; // until its Hello arrives
+            epoll_event event {};
+            event.events = EPOLLIN | EPOLLRDHUP;
+            event.data.ptr = connection.get();
+            if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                ::close(fd);
+                continue;
+            }
+            connections.emplace(fd, std::move(connection));
+        }
+    }
+
+    void service(Connection& c) {
+        bool open = true;
+        std::size_t budget = kReadBudget;
+        char chunk[65536];
+        while (budget > 0) {
+            const ssize_t n = ::recv(c.fd, chunk, std::min(sizeof(chunk), budget), 0);
+            if (n > 0) {
+                c.buffer.append(chunk, static_cast<std::size_t>(n));
+                budget -= static_cast<std::size_t>(n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            open = false; // EOF or error
+            break;
+        }
+
+        try {
+            std::string_view view(c.buffer);
+            std::string_view payload;
+            while (nextWireFrame(view, payload)) {
+                c.summary.bytes += payload.size() + kWireHeaderBytes;
+                if (wireFrameType(payload) != WireFrameType::Batch) {
+                    handleFrame(c, payload);
+                    continue;
+                }
+                batch.clear();
+                const std::uint64_t sequence = unpackWireBatch(payload, batch);
+                std::string_view inner(batch);
+                while (nextWireFrame(inner, payload)) {
+                    handleFrame(c, payload);
+                }
+                // Acks are cumulative, so one that does not fit into the
+                // socket buffer is simply covered by the next.
+                ack.clear();
+                appendWireAck(ack, sequence);
+                [[maybe_unused]] const ssize_t n = ::send(c.fd, ack.data(), ack.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            }
+            c.buffer.erase(0, c.buffer.size() - view.size());
+        } catch (const std::exception& e) {
+            if (!quiet) {
+                std::cerr << "statio-aggregator: dropping " << c.summary.peer << ": " << e.what() << '\n';
+            }
+            open = false;
+        }
+
+        if (!open) {
+            if (!c.attachedHost.empty()) {
+                state.disconnected(c.attachedHost);
+            }
+            const int fd = c.fd;
+            ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            ::close(fd);
+            connections.erase(fd); // destroys `c`
+        }
+    }
+
+    void handleFrame(Connection& c, std::string_view payload) {
+        if (c.decoder.decode(payload) == WireFrameType::Hello) {
+            if (!quiet) {
+                std::cerr << "statio-aggregator: " << c.decoder.host() << " connected from " << c.summary.peer << '\n';
+            }
+            c.summary.host = c.decoder.host();
+            return;
+        }
+        if (c.attachedHost != c.summary.host) {
+            // First snapshot, or the first after a Hello with a new name.
+            if (!c.attachedHost.empty()) {
+                state.disconnected(c.attachedHost);
+            }
+            state.attached(c.summary.host);
+            c.attachedHost = c.summary.host;
+        }
+        ++c.summary.frames;
+        c.tracker.apply(c.decoder, c.summary);
+        c.summary.connected = true;
+        state.update(c.summary);
+    }
+
+    FleetState& state;
+    bool quiet;
+    std::string batch;
+    std::string ack;
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> stopping{false};
+    std::mutex pendingMutex;
+    std::vector<int> pending;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::thread thread;
+};
+
+Aggregator::Aggregator(AggregatorOptions options) : options_(std::move(options)), state_(options_.shards) {
+    listenFd_ = listenStream(options_.listen);
+    try {
+        queryFd_ = listenStream(options_.queryListen, 64);
+    } catch (...) {
+        ::close(listenFd_);
+        throw;
+    }
+    std::size_t workers = options_.workers;
+    if (workers == 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (std::size_t i = 0; i < workers; ++i) {
+        workers_.push_back(std::make_unique<Worker>(state_, options_.quiet));
+    }
+}
+
+Aggregator::~Aggregator() {
+    workers_.clear();
+    ::close(listenFd_);
+    ::close(queryFd_);
+}
+
+void Aggregator::run(const volatile std::sig_atomic_t& stop) {
+    const int epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        throw std::runtime_error(std::string("epoll_create1 failed: ") + std::strerror(errno));
+    }
+    for (int fd : {listenFd_, queryFd_}) {
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    std::unordered_map<int, QueryClient> queries;
+    const auto finish = [&](int fd) {
+        ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        queries.erase(fd);
+    };
+
+    epoll_event events[64];
+    while (!stop) {
+        const int ready = ::epoll_wait(epollFd, events, 64, 200);
+        const std::int64_t nowMs = steadyMs();
+        for (int i = 0; i < ready; ++i) {
+            const int readyFd = events[i].data.fd;
+            if (readyFd != listenFd_ && readyFd != queryFd_) {
+                auto it = queries.find(readyFd);
+                if (it != queries.end() && !pumpQuery(*this, it->second)) {
+                    finish(readyFd);
+                }
+                continue;
+            }
+            const int fd = ::accept4(readyFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (fd < 0) {
+                continue;
+            }
+            if (readyFd == listenFd_) {
+                workers_[nextWorker_++ % workers_.size()]->adopt(fd);
+                continue;
+            }
+            epoll_event event {};
+            event.events = EPOLLIN | EPOLLRDHUP;
+            event.data.fd = fd;
+            if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                ::close(fd);
+                continue;
+            }
+            QueryClient& client = queries[fd];
+            client.fd = fd;
+            client.deadlineMs = nowMs + kQueryTimeoutMs;
+        }
+
+        // A client that neither finishes its line nor reads its answer
+        // in time is dropped.
+        for (auto it = queries.begin(); it != queries.end();) {
+            const int fd = it->first;
+            ++it;
+            if (queries.at(fd).deadlineMs <= nowMs) {
+                finish(fd);
+            }
+        }
+        for (auto& [fd, client] : queries) {
+            if (client.answered && !client.watchingOut) {
+                epoll_event event {};
+                event.events = EPOLLOUT | EPOLLRDHUP;
+                event.data.fd = fd;
+                ::epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+                client.watchingOut = true;
+            }
+        }
+    }
+    for (const auto& entry : queries) {
+        ::close(entry.first);
+    }
+    ::close(epollFd);
+}
+
+std::string Aggregator::answer(const std::string& query) const {
+    std::istringstream words(query);
+    std::string verb;
+    words >> verb;
+    std::ostringstream out;
+
+    if (verb == "top") {
+        std::string name;
+        std::size_t count = 10;
+        words >> name >> count;
+        FleetMetric metric = FleetMetric::Cpu;
+        if (!parseFleetMetric(name, metric)) {
+            return "error: top expects cpu, memory, rx or tx\n";
+        }
+        appendHostHeader(out);
+        for (const auto& host : state_.top(metric, count)) {
+            appendHostRow(out, host);
+        }
+    } else if (verb == "degraded") {
+        appendHostHeader(out);
+        for (const auto& host : state_.degraded()) {
+            appendHostRow(out, host);
+        }
+    } else if (verb == "host") {
+        std::string name;
+        words >> name;
+        const auto host = state_.host(name);
+        if (!host) {
+            return "error: unknown host " + name + '\n';
+        }
+        appendHostHeader(out);
+        appendHostRow(out, *host);
+        out << "peer " << host->peer << ", " << host->frames << " frames, " << host->bytes << " bytes\n";
+    } else if (verb == "hosts") {
+        const FleetTotals totals = state_.totals();
+        out << "hosts " << totals.hosts << "\nconnected " << totals.connected << "\ndegraded " << totals.degraded
+            << "\nframes " << totals.frames << "\nbytes " << totals.bytes << '\n';
+    } else {
+        return "error: unknown query '" + query + "' (top, degraded, host, hosts)\n";
+    }
+    return out.str();
+}
+
+std::string queryFleet(const std::string& address, const std::string& query) {
+    const int fd = connectStream(address);
+    if (!sendAll(fd, query + '\n')) {
+        ::close(fd);
+        throw std::runtime_error("cannot send query to " + address);
+    }
+    ::shutdown(fd, SHUT_WR);
+    std::string response;
+    char chunk[65536];
+    ssize_t n = 0;
+    while ((n = ::recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+        response.append(chunk, static_cast<std::size_t>(n));
+    }
+    ::close(fd);
+    return response;
+}
+
+} // namespace statio
@@ -0,0 +1,57 @@
+#include "statio/aggregator.hpp"
+#include "statio/cli_options.hpp"
+
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+void printUsage() {
+    std::cerr << "usage: statio-aggregator [--listen HOST:PORT] [--query-listen HOST:PORT]\n"
+                 "                         [--workers N] [--shards N] [--quiet]\n"
+                 "\n"
+                 "Receives snapshots from `statio agent` and answers `statio fleet` queries.\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const std::vector<std::string> args(argv + 1, argv + argc);
+        if (!args.empty() && (args.front() == "help" || args.front() == "--help")) {
+            printUsage();
+            return 0;
+        }
+        const statio::CommandLine cli(args, {"listen", "query-listen", "workers", "shards"}, {"quiet"});
+
+        statio::AggregatorOptions options;
+        options.listen = cli.value("listen", options.listen);
+        options.queryListen = cli.value("query-listen", options.queryListen);
+        options.workers = static_cast<std::size_t>(cli.integer("workers", 0));
+        options.shards = static_cast<std::size_t>(cli.integer("shards", 64));
+        options.quiet = cli.has("quiet");
+
+        std::signal(SIGINT, requestStop);
+        std::signal(SIGTERM, requestStop);
+        std::signal(SIGPIPE, SIG_IGN);
+
+        statio::Aggregator aggregator(options);
+        if (!options.quiet) {
+            std::cerr << "statio-aggregator: agents on " << options.listen << ", queries on " << options.queryListen
+                      << '\n';
+        }
+        aggregator.run(stopRequested);
+    } catch (const std::exception& e) {
+        std::cerr << "statio-aggregator error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
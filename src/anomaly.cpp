@@ -0,0 +1,228 @@
+#include "statio/anomaly.hpp"
+
+#include "statio/query.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace statio {
+namespace {
+
+// Single outliers are capped before they enter the CUSUM so that only a
+// run of deviating samples adds up to a change point.
+constexpr double kCusumClamp = 3.0;
+
+// Relative floor on the standard deviation: flat series would otherwise
+// flag any change at all, such as a disk losing one GB of free space. It is
+// taken against the larger of baseline and sample, which also caps scores
+// at 100 when a series leaves a flat zero.
+constexpr double kRelativeScaleFloor = 0.01;
+
+} // namespace
+
+const char* anomalyKindName(AnomalyKind kind) {
+    switch (kind) {
+    case AnomalyKind::ZScore:
+        return "zscore";
+    case AnomalyKind::Seasonal:
+        return "seasonal";
+    case AnomalyKind::ChangePoint:
+        return "changepoint";
+    }
+    return "?";
+}
+
+std::string formatAnomaly(const AnomalyEvent& event) {
+    std::ostringstream out;
+    out << formatTimestamp(event.timestampMs) << " ANOMALY " << anomalyKindName(event.kind) << ' '
+        << seriesLabel(event.name, event.entity) << " value=" << event.value << " baseline=" << event.baseline
+        << " score=" << event.score;
+    return out.str();
+}
+
+void AnomalyDetector::Baseline::add(double x, double alpha) {
+    ++count;
+    if (count == 1) {
+        mean = x;
+        variance = 0.0;
+        return;
+    }
+    // Exponentially weighted mean and variance (West's incremental form);
+    // alpha 0 means a plain running mean and variance.
+    const double weight = alpha > 0.0 ? alpha : 1.0 / static_cast<double>(count);
+    const double diff = x - mean;
+    const double increment = weight * diff;
+    mean += increment;
+    variance = (1.0 - weight) * (variance + diff * increment);
+}
+
+AnomalyDetector::AnomalyDetector(AnomalyOptions options)
+    : options_(options) {
+    if (options_.seasonSlots == 0) {
+        options_.seasonMs = 0;
+    }
+}
+
+std::size_t AnomalyDetector::series(std::string_view name, std::string_view entity, MetricKind kind) {
+    key_.assign(name);
+    key_ += '\0';
+    key_ += entity;
+    auto it = index_.find(key_);
+    if (it != index_.end()) {
+        return it->second;
+    }
+    Series s;
+    s.name = std::string(name);
+    s.entity = std::string(entity);
+    s.kind = kind;
+    if (options_.seasonMs > 0) {
+        s.season.resize(options_.seasonSlots);
+    }
+    series_.push_back(std::move(s));
+    index_.emplace(key_, series_.size() - 1);
+    return series_.size() - 1;
+}
+
+double AnomalyDetector::scale(const Baseline& baseline, double x) const {
+    const double level = std::max(std::fabs(baseline.mean), std::fabs(x));
+    return std::max({std::sqrt(baseline.variance), kRelativeScaleFloor * level, 1e-9});
+}
+
+void AnomalyDetector::flag(Series& series,
+                           AnomalyKind kind,
+                           bool raise,
+                           bool clear,
+                           const AnomalyEvent& event,
+                           const Emit& emit) {
+    bool& flagged = series.flagged[static_cast<std::size_t>(kind)];
+    if (raise && !flagged) {
+        flagged = true;
+        series.last = event;
+        series.last.name = series.name;
+        series.last.entity = series.entity;
+        if (emit) {
+            emit(series.last);
+        }
+    } else if (clear) {
+        flagged = false;
+    }
+}
+
+void AnomalyDetector::observe(std::size_t index, std::int64_t timestampMs, double value, const Emit& emit) {
+    if (std::isnan(value)) {
+        return;
+    }
+    Series& s = series_[index];
+
+    double x = value;
+    if (s.kind == MetricKind::Counter) {
+        const bool ready = s.havePrev && timestampMs > s.prevMs;
+        const double delta = value >= s.prevValue ? value - s.prevValue : value;
+        x = ready ? delta * 1000.0 / static_cast<double>(timestampMs - s.prevMs) : 0.0;
+        s.prevValue = value;
+        s.prevMs = timestampMs;
+        s.havePrev = true;
+        if (!ready) {
+            return;
+        }
+    }
+
+    const double threshold = options_.threshold;
+    AnomalyEvent event;
+    event.timestampMs = timestampMs;
+    event.value = x;
+
+    // EWMA z-score, scored against the baseline before this sample joins it.
+    if (s.ewma.count >= options_.warmup) {
+        const double z = (x - s.ewma.mean) / scale(s.ewma, x);
+        event.kind = AnomalyKind::ZScore;
+        event.baseline = s.ewma.mean;
+        event.score = z;
+        flag(s, AnomalyKind::ZScore, std::fabs(z) > threshold, std::fabs(z) < threshold / 2.0, event, emit);
+
+        // Two-sided CUSUM over the same standardized residual.
+        const double clamped = std::clamp(z, -kCusumClamp, kCusumClamp);
+        s.cusumHigh = std::max(0.0, s.cusumHigh + clamped - options_.cusumDrift);
+        s.cusumLow = std::max(0.0, s.cusumLow - clamped - options_.cusumDrift);
+        const double cusum = std::max(s.cusumHigh, s.cusumLow);
+        event.kind = AnomalyKind::ChangePoint;
+        event.score = s.cusumHigh >= s.cusumLow ? cusum : -cusum;
+        const bool shifted = cusum > options_.cusumLimit;
+        flag(s, AnomalyKind::ChangePoint, shifted, std::fabs(z) < threshold / 2.0 && cusum == 0.0, event, emit);
+        if (shifted) {
+            s.cusumHigh = 0.0;
+            s.cusumLow = 0.0;
+        }
+    }
+    s.ewma.add(x, options_.alpha);
+
+    // Seasonal baseline: slot = position within the season; each slot
+    // compares against a blend of the same slot in earlier seasons.
+    if (options_.seasonMs > 0) {
+        const std::int64_t slotMs = std::max<std::int64_t>(options_.seasonMs / static_cast<std::int64_t>(options_.seasonSlots), 1);
+        std::int64_t season = timestampMs / options_.seasonMs;
+        std::int64_t offset = timestampMs % options_.seasonMs;
+        if (offset < 0) {
+            offset += options_.seasonMs;
+            --season;
+        }
+        SeasonSlot& slot = s.season[std::min<std::size_t>(static_cast<std::size_t>(offset / slotMs), s.season.size() - 1)];
+        if (slot.season != season) {
+            if (slot.current.count >= options_.warmup) {
+                if (slot.previous.count == 0) {
+                    slot.previous = slot.current;
+                } else {
+                    slot.previous.mean = 0.5 * (slot.previous.mean + slot.current.mean);
+                    slot.previous.variance = 0.5 * (slot.previous.variance + slot.current.variance);
+                    slot.previous.count += slot.current.count;
+                }
+            }
+            slot.current = Baseline{};
+            slot.season = season;
+        }
+        if (slot.previous.count >= options_.warmup) {
+            const double z = (x - slot.previous.mean) / scale(slot.previous, x);
+            event.kind = AnomalyKind::Seasonal;
+            event.baseline = slot.previous.mean;
+            event.score = z;
+            flag(s, AnomalyKind::Seasonal, std::fabs(z) > threshold, std::fabs(z) < threshold / 2.0, event, emit);
+        }
+        slot.current.add(x, 0.0);
+    }
+}
+
+void AnomalyDetector::observe(std::int64_t timestampMs, const std::vector<MetricSample>& samples, const Emit& emit) {
+    for (const auto& sample : samples) {
+        observe(series(sample.name, sample.entity, sample.kind), timestampMs, sample.value, emit);
+    }
+}
+
+bool AnomalyDetector::anomalous(std::size_t index) const {
+    const Series& s = series_[index];
+    return s.flagged[0] || s.flagged[1] || s.flagged[2];
+}
+
+bool AnomalyDetector::entityAnomalous(std::string_view entity) const {
+    for (std::size_t i = 0; i < series_.size(); ++i) {
+        if (series_[i].entity == entity && anomalous(i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<AnomalyEvent> AnomalyDetector::active() const {
+    std::vector<AnomalyEvent> out;
+    for (std::size_t i = 0; i < series_.size(); ++i) {
+        if (anomalous(i)) {
+            // Views are re-pointed here: series_ may have moved since.
+            out.push_back(series_[i].last);
+            out.back().name = series_[i].name;
+            out.back().entity = series_[i].entity;
+        }
+    }
+    return out;
+}
+
+} // namespace statio
@@ -0,0 +1,982 @@
+#include "statio/api.hpp"
+
+#include "statio/cli_options.hpp"
+#include "statio/history.hpp"
+#include "statio/query.hpp"
+#include "statio/schema.hpp"
+#include "statio/wire.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string_view>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+// The schema's sections, then the sampler distributions.
+constexpr auto kCollectors = std::apply(
+    [](const auto&... section) { return std::array<const char*, kSnapshotSectionCount + 1>{section.key..., "distributions"}; },
+    kSnapshotSections);
+constexpr std::size_t kCollectorCount = kCollectors.size();
+constexpr std::uint32_t kAllCollectors = (1U << kCollectorCount) - 1;
+
+constexpr std::size_t kMaxRequestBytes = 64U << 10;
+constexpr std::size_t kMaxResponseBytes = 64U << 20;
+constexpr int kMaxIov = 64;
+
+std::uint32_t parseCollectors(const std::string& text) {
+    std::uint32_t mask = 0;
+    for (const auto& name : splitList(text)) {
+        std::size_t i = 0;
+        while (i < kCollectorCount && name != kCollectors[i]) {
+            ++i;
+        }
+        if (i == kCollectorCount) {
+            std::string known;
+            for (const char* collector : kCollectors) {
+                known += known.empty() ? collector : std::string(", ") + collector;
+            }
+            throw std::runtime_error("unknown collector '" + name + "' (" + known + ")");
+        }
+        mask |= 1U << i;
+    }
+    return mask == 0 ? kAllCollectors : mask;
+}
+
+void appendKey(std::string& out, const char* key) {
+    out += '"';
+    out += key;
+    out += "\":";
+}
+
+void appendString(std::string& out, const char* key, const std::string& value) {
+    appendKey(out, key);
+    out += '"';
+    out += jsonEscape(value);
+    out += '"';
+}
+
+void appendInteger(std::string& out, const char* key, std::int64_t value) {
+    appendKey(out, key);
+    out += std::to_string(value);
+}
+
+void appendNumber(std::string& out, const char* key, double value) {
+    appendKey(out, key);
+    if (!std::isfinite(value)) {
+        out += "null";
+        return;
+    }
+    appendExactNumber(out, value);
+}
+
+void appendCollector(std::string& out, std::size_t collector, const SystemSnapshot& snapshot) {
+    if (collector < kSnapshotSectionCount) {
+        std::size_t index = 0;
+        forEachSection([&](const auto& section) {
+            if (index++ == collector) {
+                appendJsonSection(out, snapshot.*section.member);
+            }
+        });
+        return;
+    }
+    out += '[';
+    for (std::size_t i = 0; i < snapshot.distributions.size(); ++i) {
+        const DistributionInfo& dist = snapshot.distributions[i];
+        const QuantileSketch& sketch = dist.sketch;
+        const double count = static_cast<double>(sketch.count());
+        out += i == 0 ? "{" : ",{";
+        appendString(out, "name", dist.name);
+        out += ',';
+        appendString(out, "entity", dist.entity);
+        out += ',';
+        appendInteger(out, "count", static_cast<std::int64_t>(sketch.count()));
+        if (!sketch.empty()) {
+            out += ',';
+            appendNumber(out, "mean", sketch.sum() / count);
+            out += ',';
+            appendNumber(out, "min", sketch.min());
+            out += ',';
+            appendNumber(out, "max", sketch.max());
+            out += ',';
+            appendNumber(out, "p50", sketch.quantile(0.5));
+            out += ',';
+            appendNumber(out, "p90", sketch.quantile(0.9));
+            out += ',';
+            appendNumber(out, "p99", sketch.quantile(0.99));
+        }
+        out += '}';
+    }
+    out += ']';
+}
+std::vector<std::string> splitWords(const std::string& line) {
+    std::vector<std::string> words;
+    std::istringstream in(line);
+    std::string word;
+    while (in >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+// Mirrors the options of `statio query`.
+std::string answerHistory(const std::string& directory, const std::vector<std::string>& words) {
+    if (directory.empty()) {
+        throw std::runtime_error("the daemon records no history");
+    }
+    const CommandLine cli(std::vector<std::string>(words.begin() + 1, words.end()),
+                          {"metric", "entity", "from", "to", "agg", "bucket", "group-by", "tier"});
+    QuerySpec spec;
+    std::string metric = cli.value("metric");
+    if (metric.empty() && !cli.positional().empty()) {
+        metric = cli.positional().front();
+    }
+    if (metric.empty()) {
+        throw std::runtime_error("history requires a metric, e.g. history rate(cpu.user) --from -10m");
+    }
+    parseMetricExpression(metric, spec);
+    spec.entity = cli.value("entity", "*");
+    const std::int64_t now = currentTimeMs();
+    spec.fromMs = parseTimePoint(cli.value("from", "-1h"), now);
+    spec.toMs = parseTimePoint(cli.value("to", "now"), now);
+    if (spec.toMs < spec.fromMs) {
+        throw std::runtime_error("--to is earlier than --from");
+    }
+    spec.bucketMs = cli.has("bucket") ? parseDurationMs(cli.value("bucket")) : 0;
+    spec.groupBy = parseGroupBy(cli.value("group-by", "series"));
+    spec.tier = cli.value("tier", "auto");
+    for (const auto& name : splitList(cli.value("agg", "min,avg,max"))) {
+        spec.aggregations.push_back(parseAggregation(name));
+    }
+    if (spec.aggregations.empty()) {
+        throw std::runtime_error("--agg needs at least one aggregation");
+    }
+
+    std::ostringstream out;
+    auto formatter = makeQueryFormatter("json", out);
+    formatter->begin(spec);
+    // Stop formatting once the body outgrows what a client accepts.
+    const auto checkSize = [&out] {
+        if (static_cast<std::size_t>(out.tellp()) > kMaxResponseBytes) {
+            throw std::runtime_error("result too large, narrow --from/--to or add --bucket");
+        }
+    };
+    runQuery({directory}, spec, [&formatter, &checkSize](const QueryRow& row) {
+        formatter->row(row);
+        checkSize();
+    });
+    formatter->end();
+    checkSize();
+    return out.str();
+}
+
+std::string responseHeader(bool ok, std::size_t bodyBytes) {
+    if (bodyBytes > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::runtime_error("response of " + std::to_string(bodyBytes) + " bytes exceeds the length field");
+    }
+    const std::uint32_t length = static_cast<std::uint32_t>(bodyBytes);
+    std::string header(kApiResponseHeaderBytes, '\0');
+    std::memcpy(&header[0], &length, sizeof(length));
+    header[4] = ok ? 0 : 1;
+    return header;
+}
+
+// Reads exactly `size` bytes. False on a clean end of stream before the
+// first byte; throws on a stream cut short.
+bool readExact(int fd, char* data, std::size_t size) {
+    std::size_t done = 0;
+    while (done < size) {
+        const ssize_t n = ::read(fd, data + done, size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error(std::string("daemon read failed: ") + std::strerror(errno));
+        }
+        if (n == 0) {
+            if (done == 0) {
+                return false;
+            }
+            throw std::runtime_error("daemon closed the connection mid-response");
+        }
+        done += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+// One published snapshot: `json` is the header, then one `,"name":value`
+// section per collector, then the closing brace. A subset response is the
+// header, its sections and the last byte, all slices of the same buffer.
+struct ApiServer::Encoded {
+    std::int64_t timestampMs = 0;
+    std::string json;
+    std::size_t headerBytes = 0;
+    std::array<std::pair<std::size_t, std::size_t>, kCollectorCount> sections {};
+    SystemSnapshot snapshot; // for report requests
+    std::vector<std::pair<std::string, std::string>> fieldNames; // (label, name)
+    std::vector<double> fieldValues;
+};
+
+// Fields a group of watch subscribers asked for. `ids` grows as new series
+// show up in the field table; `scanned` is how much of it was matched.
+struct ApiServer::Selection {
+    std::uint64_t id = 0;
+    std::vector<std::string> selectors;
+    std::vector<std::uint32_t> ids;
+    std::size_t scanned = 0;
+};
+
+// A slice of an immutable buffer that `owner` keeps alive until sent.
+struct ApiServer::Chunk {
+    std::shared_ptr<const void> owner;
+    const char* data = nullptr;
+    std::size_t size = 0;
+};
+
+struct ApiServer::Connection {
+    int fd = -1;
+    std::uint64_t serial = 0;
+    std::string input;
+    std::deque<Chunk> output;
+    std::size_t pending = 0;
+    std::uint32_t events = EPOLLIN;
+    bool closing = false;     // close once the queued output is sent
+    bool waiting = false;     // a history request is with the worker
+    bool subscribed = false;
+    bool stale = false;       // skipped an update while busy
+    std::uint32_t collectors = kAllCollectors;
+    // Watch subscribers.
+    std::shared_ptr<Selection> selection;
+    std::int64_t everyMs = 0;
+    std::int64_t lastSentMs = 0;
+    std::uint64_t deliveredSeq = 0; // field table sample the last diff reached
+};
+
+std::string defaultApiSocket() {
+    if (const char* path = std::getenv("STATIO_SOCKET"); path != nullptr && *path != '\0') {
+        return path;
+    }
+    if (const char* runtime = std::getenv("XDG_RUNTIME_DIR"); runtime != nullptr && *runtime != '\0') {
+        return std::string(runtime) + "/statio.sock";
+    }
+    return "/tmp/statio-" + std::to_string(::getuid()) + ".sock";
+}
+
+ApiServer::ApiServer(ApiOptions options)
+    : options_(std::move(options)) {
+    // Binding unlinks the path, so make sure it is not a live daemon's first.
+    const int probe = connectApi(options_.socketPath);
+    if (probe >= 0) {
+        ::close(probe);
+        throw std::runtime_error("another daemon already serves " + options_.socketPath);
+    }
+    listenFd_ = listenStream("unix:" + options_.socketPath, 64);
+    ::fcntl(listenFd_, F_SETFL, ::fcntl(listenFd_, F_GETFL) | O_NONBLOCK);
+    epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    historyFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd_ < 0 || wakeFd_ < 0 || historyFd_ < 0) {
+        const int error = errno;
+        ::close(listenFd_);
+        for (const int fd : {epollFd_, wakeFd_, historyFd_}) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+        throw std::runtime_error(std::string("cannot start api: ") + std::strerror(error));
+    }
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd_;
+    ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &event);
+    event.data.fd = wakeFd_;
+    ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &event);
+    event.data.fd = historyFd_;
+    ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, historyFd_, &event);
+    historyThread_ = std::thread([this] { runHistory(); });
+    thread_ = std::thread([this] { run(); });
+}
+
+ApiServer::~ApiServer() {
+    stopping_ = true;
+    const std::uint64_t one = 1;
+    (void)!::write(wakeFd_, &one, sizeof(one));
+    thread_.join();
+    {
+        std::lock_guard<std::mutex> lock(historyMutex_);
+        historyJobs_.clear();
+    }
+    historyReady_.notify_all();
+    historyThread_.join();
+    for (auto& entry : connections_) {
+        ::close(entry.first);
+    }
+    ::close(listenFd_);
+    ::close(epollFd_);
+    ::close(wakeFd_);
+    ::close(historyFd_);
+    ::unlink(options_.socketPath.c_str());
+}
+
+void ApiServer::publish(std::int64_t timestampMs, const SystemSnapshot& snapshot, const std::vector<MetricSample>& samples) {
+    auto encoded = std::make_shared<Encoded>();
+    encoded->timestampMs = timestampMs;
+    std::string& json = encoded->json;
+    json.reserve(4096);
+    json += "{\"timestamp\":";
+    json += std::to_string(timestampMs / 1000);
+    json += ",\"timestamp_ms\":";
+    json += std::to_string(timestampMs);
+    json += ",\"interval_ms\":";
+    json += std::to_string(options_.intervalMs);
+    encoded->headerBytes = json.size();
+    for (std::size_t i = 0; i < kCollectorCount; ++i) {
+        const std::size_t start = json.size();
+        json += ",\"";
+        json += kCollectors[i];
+        json += "\":";
+        appendCollector(json, i, snapshot);
+        encoded->sections[i] = {start, json.size() - start};
+    }
+    json += '}';
+    encoded->snapshot = snapshot;
+    encoded->fieldNames.reserve(samples.size());
+    encoded->fieldValues.reserve(samples.size());
+    for (const auto& sample : samples) {
+        encoded->fieldNames.emplace_back(seriesLabel(sample.name, sample.entity), sample.name);
+        encoded->fieldValues.push_back(sample.value);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        latest_ = std::move(encoded);
+    }
+    const std::uint64_t one = 1;
+    (void)!::write(wakeFd_, &one, sizeof(one));
+}
+
+ApiStats ApiServer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void ApiServer::run() {
+    epoll_event events[64];
+    while (!stopping_) {
+        const int ready = ::epoll_wait(epollFd_, events, 64, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "statio daemon: api epoll failed: " << std::strerror(errno) << '\n';
+            return;
+        }
+        for (int i = 0; i < ready; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == wakeFd_) {
+                std::uint64_t count = 0;
+                (void)!::read(wakeFd_, &count, sizeof(count));
+                if (stopping_) {
+                    return;
+                }
+                deliverUpdates();
+                continue;
+            }
+            if (fd == historyFd_) {
+                std::uint64_t count = 0;
+                (void)!::read(historyFd_, &count, sizeof(count));
+                deliverHistory();
+                continue;
+            }
+            if (fd == listenFd_) {
+                accept();
+                continue;
+            }
+            auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& connection = *it->second;
+            // Its answer has nowhere to go, and the hangup would be reported
+            // again on every wait until it comes.
+            if (connection.waiting && (events[i].events & (EPOLLHUP | EPOLLERR))) {
+                close(fd);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && !flush(connection)) {
+                close(fd);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                receive(connection);
+            }
+        }
+    }
+}
+
+void ApiServer::accept() {
+    for (;;) {
+        const int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // EAGAIN, or out of descriptors until a client leaves
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connection->serial = nextSerial_++;
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event);
+        connections_[fd] = std::move(connection);
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.connections;
+    }
+}
+
+void ApiServer::receive(Connection& connection) {
+    const int fd = connection.fd;
+    char buffer[16384];
+    for (;;) {
+        const ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n < 0) {
+            close(fd);
+            return;
+        }
+        if (n == 0) {
+            // Half-closed after the last request: answer it, then close.
+            connection.closing = true;
+            break;
+        }
+        connection.input.append(buffer, static_cast<std::size_t>(n));
+    }
+    if (!flush(connection)) {
+        close(fd);
+    }
+}
+
+// Handles the complete request lines read so far, up to the first history
+// request or until kMaxQueuedBytes of output wait; flush() resumes.
+void ApiServer::process(Connection& connection) {
+    std::size_t start = 0;
+    for (std::size_t end; !connection.waiting && connection.pending < kMaxQueuedBytes &&
+                          (end = connection.input.find('\n', start)) != std::string::npos;
+         start = end + 1) {
+        std::string line = connection.input.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        handle(connection, line);
+    }
+    connection.input.erase(0, start);
+    if (connection.input.size() > kMaxRequestBytes && !connection.closing &&
+        connection.input.find('\n') == std::string::npos) {
+        respond(connection, false, "request line too long");
+        connection.input.clear();
+        connection.closing = true;
+    }
+}
+
+void ApiServer::handle(Connection& connection, const std::string& line) {
+    const std::vector<std::string> words = splitWords(line);
+    if (words.empty()) {
+        return;
+    }
+    std::shared_ptr<const Encoded> latest;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.requests;
+        latest = latest_;
+    }
+
+    try {
+        const std::string& verb = words.front();
+        if (connection.subscribed || connection.selection) {
+            throw std::runtime_error("a subscribed connection takes no further requests");
+        }
+        if (verb == "snapshot" || verb == "subscribe") {
+            connection.collectors = parseCollectors(words.size() > 1 ? words[1] : std::string());
+            connection.subscribed = verb == "subscribe";
+            if (latest) {
+                sendSnapshot(connection, latest);
+            } else if (!connection.subscribed) {
+                throw std::runtime_error("no snapshot collected yet");
+            }
+        } else if (verb == "watch") {
+            const CommandLine cli(std::vector<std::string>(words.begin() + 1, words.end()), {"every"});
+            std::vector<std::string> selectors;
+            for (const auto& word : cli.positional()) {
+                for (auto& item : splitList(word)) {
+                    selectors.push_back(std::move(item));
+                }
+            }
+            connection.everyMs = parseDurationMs(cli.value("every", "0"));
+            if (connection.everyMs < 0) {
+                throw std::runtime_error("--every must not be negative");
+            }
+            connection.selection = selection(std::move(selectors));
+            if (fields_.seq > 0) {
+                sendDiff(connection);
+            }
+        } else if (verb == "report") {
+            if (!latest) {
+                throw std::runtime_error("no snapshot collected yet");
+            }
+            respond(connection, true, renderReport(latest->snapshot));
+        } else if (verb == "metrics") {
+            if (!latest) {
+                throw std::runtime_error("no snapshot collected yet");
+            }
+            respond(connection, true, renderOpenMetrics(flattenSnapshot(latest->snapshot)));
+        } else if (verb == "history") {
+            if (options_.historyDirectory.empty()) {
+                throw std::runtime_error("the daemon records no history");
+            }
+            HistoryJob job;
+            job.fd = connection.fd;
+            job.serial = connection.serial;
+            job.words = words;
+            {
+                std::lock_guard<std::mutex> lock(historyMutex_);
+                historyJobs_.push_back(std::move(job));
+            }
+            historyReady_.notify_one();
+            connection.waiting = true;
+        } else {
+            throw std::runtime_error("unknown request '" + verb + "' (snapshot, report, metrics, history, subscribe, watch)");
+        }
+    } catch (const std::exception& e) {
+        respond(connection, false, e.what());
+    }
+}
+
+void ApiServer::respond(Connection& connection, bool ok, std::string body) {
+    auto header = std::make_shared<const std::string>(responseHeader(ok, body.size()));
+    auto owned = std::make_shared<const std::string>(std::move(body));
+    connection.output.push_back({header, header->data(), header->size()});
+    if (!owned->empty()) {
+        connection.output.push_back({owned, owned->data(), owned->size()});
+    }
+    connection.pending += header->size() + owned->size();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.responses;
+}
+
+void ApiServer::sendSnapshot(Connection& connection, const std::shared_ptr<const Encoded>& encoded) {
+    const std::string& json = encoded->json;
+    std::size_t bodyBytes = json.size();
+    if (connection.collectors != kAllCollectors) {
+        bodyBytes = encoded->headerBytes + 1;
+        for (std::size_t i = 0; i < kCollectorCount; ++i) {
+            if (connection.collectors & (1U << i)) {
+                bodyBytes += encoded->sections[i].second;
+            }
+        }
+    }
+
+    auto header = std::make_shared<const std::string>(responseHeader(true, bodyBytes));
+    connection.output.push_back({header, header->data(), header->size()});
+    if (connection.collectors == kAllCollectors) {
+        connection.output.push_back({encoded, json.data(), json.size()});
+    } else {
+        connection.output.push_back({encoded, json.data(), encoded->headerBytes});
+        for (std::size_t i = 0; i < kCollectorCount; ++i) {
+            if (connection.collectors & (1U << i)) {
+                connection.output.push_back({encoded, json.data() + encoded->sections[i].first, encoded->sections[i].second});
+            }
+        }
+        connection.output.push_back({encoded, json.data() + json.size() - 1, 1});
+    }
+    connection.pending += header->size() + bodyBytes;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.responses;
+}
+
+void ApiServer::deliverUpdates() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (latest_ == delivered_) {
+            return;
+        }
+        delivered_ = latest_;
+    }
+    applyFields(*delivered_);
+    diffs_.clear();
+
+    std::vector<int> failed;
+    for (auto& entry : connections_) {
+        Connection& connection = *entry.second;
+        if (!connection.subscribed && !connection.selection) {
+            continue;
+        }
+        if (connection.pending > 0) {
+            connection.stale = true;
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.coalesced;
+            continue;
+        }
+        if (connection.selection) {
+            if (!watchDue(connection)) {
+                continue;
+            }
+            sendDiff(connection);
+        } else {
+            sendSnapshot(connection, delivered_);
+        }
+        if (!flush(connection)) {
+            failed.push_back(entry.first);
+        }
+    }
+    for (const int fd : failed) {
+        close(fd);
+    }
+}
+
+void ApiServer::applyFields(const Encoded& encoded) {
+    FieldTable& table = fields_;
+    const std::uint64_t seq = ++table.seq;
+    table.timestampMs = encoded.timestampMs;
+    const double missing = std::numeric_limits<double>::quiet_NaN();
+    std::uint64_t missingBits = 0;
+    std::memcpy(&missingBits, &missing, sizeof(missingBits));
+
+    for (std::size_t i = 0; i < encoded.fieldNames.size(); ++i) {
+        const auto& [label, name] = encoded.fieldNames[i];
+        std::uint64_t bits = 0;
+        std::memcpy(&bits, &encoded.fieldValues[i], sizeof(bits));
+        auto [it, added] = table.ids.emplace(label, static_cast<std::uint32_t>(table.labels.size()));
+        const std::uint32_t id = it->second;
+        if (added) {
+            table.labels.push_back(label);
+            table.names.push_back(name);
+            table.keys.push_back('"' + jsonEscape(label) + "\":");
+            table.bits.push_back(bits);
+            table.changedSeq.push_back(seq);
+            table.seenSeq.push_back(seq);
+            continue;
+        }
+        if (table.bits[id] != bits) {
+            table.bits[id] = bits;
+            table.changedSeq[id] = seq;
+        }
+        table.seenSeq[id] = seq;
+    }
+    // A series that vanished (an unplugged interface) turns null once.
+    for (std::size_t id = 0; id < table.labels.size(); ++id) {
+        if (table.seenSeq[id] != seq && table.bits[id] != missingBits) {
+            table.bits[id] = missingBits;
+            table.changedSeq[id] = seq;
+        }
+    }
+}
+
+std::shared_ptr<ApiServer::Selection> ApiServer::selection(std::vector<std::string> selectors) {
+    std::sort(selectors.begin(), selectors.end());
+    selectors.erase(std::unique(selectors.begin(), selectors.end()), selectors.end());
+    std::string key;
+    for (const auto& selector : selectors) {
+        key += selector;
+        key += '\n';
+    }
+    auto it = selections_.find(key);
+    if (it != selections_.end()) {
+        if (auto shared = it->second.lock()) {
+            return shared;
+        }
+    }
+    for (auto prune = selections_.begin(); prune != selections_.end();) {
+        prune = prune->second.expired() ? selections_.erase(prune) : std::next(prune);
+    }
+    auto created = std::make_shared<Selection>();
+    created->id = nextSelection_++;
+    created->selectors = std::move(selectors);
+    selections_[key] = created;
+    return created;
+}
+
+bool ApiServer::watchDue(const Connection& connection) const {
+    if (connection.deliveredSeq >= fields_.seq) {
+        return false;
+    }
+    // A tenth of slack keeps "--every 2s" on a 1 s daemon at 2 s despite jitter.
+    return connection.everyMs <= 0 ||
+           fields_.timestampMs - connection.lastSentMs >= connection.everyMs - connection.everyMs / 10;
+}
+
+void ApiServer::sendDiff(Connection& connection) {
+    Selection& selection = *connection.selection;
+    const FieldTable& table = fields_;
+    for (; selection.scanned < table.labels.size(); ++selection.scanned) {
+        const std::string& label = table.labels[selection.scanned];
+        const std::string& name = table.names[selection.scanned];
+        if (fieldSelected(selection.selectors, name, label)) {
+            selection.ids.push_back(static_cast<std::uint32_t>(selection.scanned));
+        }
+    }
+
+    const std::uint64_t from = connection.deliveredSeq;
+    auto [it, added] = diffs_.emplace(std::make_pair(selection.id, from), nullptr);
+    if (added) {
+        std::string out(kApiResponseHeaderBytes, '\0');
+        out += "{\"timestamp_ms\":";
+        out += std::to_string(table.timestampMs);
+        out += ",\"seq\":";
+        out += std::to_string(table.seq);
+        out += from == 0 ? ",\"full\":true,\"fields\":{" : ",\"full\":false,\"fields\":{";
+        bool any = false;
+        for (const std::uint32_t id : selection.ids) {
+            if (table.changedSeq[id] <= from) {
+                continue;
+            }
+            double value = 0.0;
+            std::memcpy(&value, &table.bits[id], sizeof(value));
+            out += any ? "," : "";
+            out += table.keys[id];
+            if (std::isfinite(value)) {
+                appendExactNumber(out, value);
+            } else {
+                out += "null";
+            }
+            any = true;
+        }
+        out += "}}";
+        // Nothing this subscriber watches changed: send nothing at all.
+        if (any || from == 0) {
+            const std::string header = responseHeader(true, out.size() - kApiResponseHeaderBytes);
+            out.replace(0, header.size(), header);
+            it->second = std::make_shared<const std::string>(std::move(out));
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.diffsEncoded;
+        }
+    }
+
+    connection.deliveredSeq = table.seq;
+    const std::shared_ptr<const std::string>& diff = it->second;
+    if (!diff) {
+        return;
+    }
+    connection.lastSentMs = table.timestampMs;
+    connection.output.push_back({diff, diff->data(), diff->size()});
+    connection.pending += diff->size();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.diffsSent;
+    ++stats_.responses;
+}
+
+bool ApiServer::flush(Connection& connection) {
+    std::uint64_t sent = 0;
+    bool alive = true;
+    for (;;) {
+        process(connection);
+        if (connection.output.empty()) {
+            if (connection.stale && delivered_) {
+                connection.stale = false;
+                if (!connection.selection) {
+                    sendSnapshot(connection, delivered_);
+                } else if (watchDue(connection)) {
+                    sendDiff(connection);
+                }
+                continue;
+            }
+            break;
+        }
+
+        iovec iov[kMaxIov];
+        int count = 0;
+        for (auto it = connection.output.begin(); it != connection.output.end() && count < kMaxIov; ++it, ++count) {
+            iov[count].iov_base = const_cast<char*>(it->data);
+            iov[count].iov_len = it->size;
+        }
+        msghdr message {};
+        message.msg_iov = iov;
+        message.msg_iovlen = static_cast<std::size_t>(count);
+        const ssize_t n = ::sendmsg(connection.fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n < 0) {
+            alive = false;
+            break;
+        }
+
+        std::size_t remaining = static_cast<std::size_t>(n);
+        sent += remaining;
+        connection.pending -= remaining;
+        while (remaining > 0) {
+            Chunk& front = connection.output.front();
+            if (remaining < front.size) {
+                front.data += remaining;
+                front.size -= remaining;
+                break;
+            }
+            remaining -= front.size;
+            connection.output.pop_front();
+        }
+    }
+
+    if (sent > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytesSent += sent;
+    }
+    if (!alive || (connection.closing && connection.output.empty() && !connection.waiting)) {
+        return false;
+    }
+    // A closing connection only waits for its output to drain; a busy one
+    // is not read until it can take requests again.
+    const bool reading = !connection.closing && !connection.waiting && connection.pending < kMaxQueuedBytes;
+    const std::uint32_t events = (reading ? static_cast<std::uint32_t>(EPOLLIN) : 0U) |
+                                 (connection.output.empty() ? 0U : static_cast<std::uint32_t>(EPOLLOUT));
+    if (events != connection.events) {
+        epoll_event event {};
+        event.events = events;
+        event.data.fd = connection.fd;
+        ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.events = events;
+    }
+    return true;
+}
+
+void ApiServer::close(int fd) {
+    ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections_.erase(fd);
+}
+
+// The history worker: one query at a time, so a burst of requests does not
+// multiply the segment reads.
+void ApiServer::runHistory() {
+    std::unique_lock<std::mutex> lock(historyMutex_);
+    for (;;) {
+        historyReady_.wait(lock, [this] { return stopping_ || !historyJobs_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        HistoryJob job = std::move(historyJobs_.front());
+        historyJobs_.pop_front();
+        lock.unlock();
+        try {
+            job.body = answerHistory(options_.historyDirectory, job.words);
+            job.ok = true;
+        } catch (const std::exception& e) {
+            job.body = e.what();
+        }
+        job.words.clear();
+        lock.lock();
+        historyDone_.push_back(std::move(job));
+        const std::uint64_t one = 1;
+        (void)!::write(historyFd_, &one, sizeof(one));
+    }
+}
+
+void ApiServer::deliverHistory() {
+    std::vector<HistoryJob> done;
+    {
+        std::lock_guard<std::mutex> lock(historyMutex_);
+        done.swap(historyDone_);
+    }
+    for (auto& job : done) {
+        auto it = connections_.find(job.fd);
+        if (it == connections_.end() || it->second->serial != job.serial) {
+            continue; // the client left
+        }
+        Connection& connection = *it->second;
+        connection.waiting = false;
+        respond(connection, job.ok, std::move(job.body));
+        if (!flush(connection)) {
+            close(job.fd);
+        }
+    }
+}
+
+int connectApi(const std::string& path) {
+    int fd = -1;
+    try {
+        fd = connectStream("unix:" + path);
+    } catch (const std::exception&) {
+        return -1;
+    }
+    // Anyone may bind a socket under /tmp; trust only our own daemon or root's.
+    ucred peer{};
+    socklen_t size = sizeof(peer);
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &size) != 0 || (peer.uid != ::getuid() && peer.uid != 0)) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool apiSnapshotFresh(const std::string& body, std::int64_t nowMs) {
+    const auto field = [&body](std::string_view key) -> std::int64_t {
+        const std::size_t at = body.find(key);
+        std::int64_t value = -1;
+        if (at != std::string::npos) {
+            std::from_chars(body.data() + at + key.size(), body.data() + body.size(), value);
+        }
+        return value;
+    };
+    const std::int64_t timestampMs = field("\"timestamp_ms\":");
+    const std::int64_t intervalMs = field("\"interval_ms\":");
+    return timestampMs >= 0 && intervalMs > 0 && nowMs - timestampMs <= kApiStaleIntervals * intervalMs;
+}
+
+std::string apiRequest(int fd, const std::string& request) {
+    if (!sendAll(fd, request + "\n")) {
+        throw std::runtime_error(std::string("cannot send request to daemon: ") + std::strerror(errno));
+    }
+    std::string body;
+    if (!readApiResponse(fd, body)) {
+        throw std::runtime_error("daemon closed the connection");
+    }
+    return body;
+}
+
+bool readApiResponse(int fd, std::string& body) {
+    char header[kApiResponseHeaderBytes];
+    if (!readExact(fd, header, sizeof(header))) {
+        return false;
+    }
+    std::uint32_t length = 0;
+    std::memcpy(&length, header, sizeof(length));
+    if (length > kMaxResponseBytes) {
+        throw std::runtime_error("daemon response too large");
+    }
+    body.resize(length);
+    if (length > 0 && !readExact(fd, &body[0], length)) {
+        throw std::runtime_error("daemon closed the connection mid-response");
+    }
+    if (header[4] != 0) {
+        throw std::runtime_error("daemon: " + body);
+    }
+    return true;
+}
+
+} // namespace statio
@@ -0,0 +1,55 @@
+#include "statio/commands.hpp"
+
+#include "statio/api.hpp"
+#include "statio/cli_options.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace statio {
+
+int runApiCommand(const std::vector<std::string>& args) {
+    // Options come first; everything from the first other word on is the
+    // request, passed through verbatim (history takes options of its own).
+    std::size_t split = 0;
+    while (split < args.size() && (args[split] == "--socket" || args[split] == "--count")) {
+        split += 2;
+    }
+    split = std::min(split, args.size());
+    const CommandLine cli(std::vector<std::string>(args.begin(), args.begin() + static_cast<std::ptrdiff_t>(split)),
+                          {"socket", "count"});
+    const std::string path = cli.value("socket", defaultApiSocket());
+    if (split == args.size()) {
+        throw std::runtime_error("api requires a request, e.g. statio api snapshot cpu,memory");
+    }
+    std::string request;
+    for (std::size_t i = split; i < args.size(); ++i) {
+        request += request.empty() ? args[i] : " " + args[i];
+    }
+
+    const int fd = connectApi(path);
+    if (fd < 0) {
+        throw std::runtime_error("no daemon answers on " + path);
+    }
+    std::string body;
+    try {
+        body = apiRequest(fd, request);
+        std::cout << body << (body.empty() || body.back() == '\n' ? "" : "\n") << std::flush;
+        // A subscription keeps streaming until --count responses were shown.
+        const std::int64_t count = cli.integer("count", 0);
+        if (args[split] == "subscribe" || args[split] == "watch") {
+            for (std::int64_t shown = 1; (count <= 0 || shown < count) && readApiResponse(fd, body); ++shown) {
+                std::cout << body << '\n' << std::flush;
+            }
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    return 0;
+}
+
+} // namespace statio
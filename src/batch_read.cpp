@@ -0,0 +1,368 @@
+#include "statio/batch_read.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+constexpr unsigned kRingEntries = 1024;
+constexpr std::size_t kMinSlots = 64;
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned submit, unsigned wait) {
+    return static_cast<int>(
+        ::syscall(__NR_io_uring_enter, fd, submit, wait, wait > 0 ? IORING_ENTER_GETEVENTS : 0U, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, const void* arg, unsigned count) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+} // namespace
+
+// The mapped submission and completion rings (no liburing: the three
+// syscalls and the mmap layout are all it takes for plain reads).
+struct BatchReader::Ring {
+    int fd = -1;
+    unsigned entries = 0;
+    void* sqMap = MAP_FAILED;
+    std::size_t sqBytes = 0;
+    void* cqMap = MAP_FAILED;
+    std::size_t cqBytes = 0;
+    io_uring_sqe* sqes = nullptr;
+    std::size_t sqesBytes = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    std::size_t fileTable = 0; // registered file table size, 0 when none
+    bool filesRefused = false;
+    bool filesDirty = true; // the table must be (re)registered before reading
+    bool buffers = false;   // buffer_ registered as buffer 0
+    bool buffersRefused = false;
+    bool buffersDirty = true;
+
+    ~Ring() {
+        if (sqes != nullptr) {
+            ::munmap(sqes, sqesBytes);
+        }
+        if (cqMap != MAP_FAILED && cqMap != sqMap) {
+            ::munmap(cqMap, cqBytes);
+        }
+        if (sqMap != MAP_FAILED) {
+            ::munmap(sqMap, sqBytes);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    bool open(unsigned wanted) {
+        io_uring_params params {};
+        fd = ioUringSetup(wanted, &params);
+        if (fd < 0) {
+            return false;
+        }
+        entries = params.sq_entries;
+        sqBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            sqBytes = cqBytes = std::max(sqBytes, cqBytes);
+        }
+        sqMap = ::mmap(nullptr, sqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED) {
+            return false;
+        }
+        cqMap = single ? sqMap
+                       : ::mmap(nullptr, cqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                IORING_OFF_CQ_RING);
+        if (cqMap == MAP_FAILED) {
+            return false;
+        }
+        sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqeMap =
+            ::mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqeMap == MAP_FAILED) {
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(sqeMap);
+
+        auto* sq = static_cast<char*>(sqMap);
+        auto* cq = static_cast<char*>(cqMap);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Points slot `index` of the file table at `descriptor` (-1 clears it).
+    void updateFile(std::size_t index, int descriptor) {
+        if (fileTable == 0 || filesDirty) {
+            return;
+        }
+        if (index >= fileTable) {
+            filesDirty = true;
+            return;
+        }
+        io_uring_files_update update {};
+        update.offset = static_cast<unsigned>(index);
+        update.fds = reinterpret_cast<std::uintptr_t>(&descriptor);
+        if (ioUringRegister(fd, IORING_REGISTER_FILES_UPDATE, &update, 1) != 1) {
+            filesDirty = true;
+        }
+    }
+};
+
+IoBackend parseIoBackend(const std::string& text) {
+    if (text == "auto") {
+        return IoBackend::Auto;
+    }
+    if (text == "pread") {
+        return IoBackend::Pread;
+    }
+    if (text == "uring" || text == "io_uring") {
+        return IoBackend::IoUring;
+    }
+    throw std::runtime_error("unknown I/O backend '" + text + "' (auto, pread, uring)");
+}
+
+const char* ioBackendName(IoBackend backend) {
+    switch (backend) {
+    case IoBackend::Auto:
+        return "auto";
+    case IoBackend::Pread:
+        return "pread";
+    case IoBackend::IoUring:
+        return "io_uring";
+    }
+    return "?";
+}
+
+BatchReader::BatchReader(IoBackend backend, std::size_t fileBytes) : fileBytes_(std::max<std::size_t>(fileBytes, 64)) {
+    if (backend != IoBackend::Pread) {
+        auto ring = std::make_unique<Ring>();
+        if (ring->open(kRingEntries)) {
+            ring_ = std::move(ring);
+        } else if (backend == IoBackend::IoUring) {
+            throw std::runtime_error(std::string("io_uring unavailable: ") + std::strerror(errno));
+        }
+    }
+}
+
+BatchReader::~BatchReader() {
+    ring_.reset(); // drops the kernel's references first
+    for (const auto& slot : slots_) {
+        if (slot.fd >= 0) {
+            ::close(slot.fd);
+        }
+    }
+}
+
+bool BatchReader::registeredFiles() const {
+    return ring_ != nullptr && ring_->fileTable > 0;
+}
+
+bool BatchReader::registeredBuffers() const {
+    return ring_ != nullptr && ring_->buffers;
+}
+
+std::size_t BatchReader::add(const char* path) {
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    return fd < 0 ? npos : adopt(fd);
+}
+
+std::size_t BatchReader::adopt(int fd) {
+    std::size_t index = slots_.size();
+    if (!free_.empty()) {
+        index = free_.back();
+        free_.pop_back();
+    } else {
+        slots_.emplace_back();
+        growBuffers(slots_.size());
+    }
+    Slot& slot = slots_[index];
+    slot.fd = fd;
+    slot.length = 0;
+    slot.error = 0;
+    slot.live = live_.size();
+    live_.push_back(index);
+    if (ring_ != nullptr) {
+        ring_->updateFile(index, fd);
+    }
+    return index;
+}
+
+void BatchReader::remove(std::size_t index) {
+    Slot& slot = slots_[index];
+    if (slot.fd < 0) {
+        return;
+    }
+    if (ring_ != nullptr) {
+        ring_->updateFile(index, -1);
+    }
+    ::close(slot.fd);
+    slot.fd = -1;
+    slot.length = 0;
+    live_[slot.live] = live_.back();
+    slots_[live_.back()].live = slot.live;
+    live_.pop_back();
+    slot.live = npos;
+    free_.push_back(index);
+}
+
+void BatchReader::growBuffers(std::size_t slots) {
+    if (slots <= capacity_) {
+        return;
+    }
+    capacity_ = std::max(kMinSlots, capacity_ * 2);
+    buffer_.resize(capacity_ * fileBytes_);
+    iovecs_.resize(capacity_);
+    for (std::size_t i = 0; i < capacity_; ++i) {
+        iovecs_[i] = {buffer_.data() + i * fileBytes_, fileBytes_};
+    }
+    if (ring_ != nullptr) {
+        ring_->buffersDirty = true;
+    }
+}
+
+std::string_view BatchReader::data(std::size_t slot) const {
+    return {buffer_.data() + slot * fileBytes_, slots_[slot].length};
+}
+
+std::size_t BatchReader::read() {
+    if (ring_ != nullptr && !readRing()) {
+        ring_.reset();
+    }
+    if (ring_ == nullptr) {
+        readPread();
+    }
+    return static_cast<std::size_t>(
+        std::count_if(live_.begin(), live_.end(), [this](std::size_t slot) { return slots_[slot].error == 0; }));
+}
+
+void BatchReader::readPread() {
+    for (const std::size_t index : live_) {
+        Slot& slot = slots_[index];
+        const ssize_t n = ::pread(slot.fd, buffer_.data() + index * fileBytes_, fileBytes_, 0);
+        slot.length = n > 0 ? static_cast<std::uint32_t>(n) : 0;
+        slot.error = n < 0 ? errno : 0;
+    }
+}
+
+bool BatchReader::readRing() {
+    Ring& ring = *ring_;
+    if (ring.filesDirty && !ring.filesRefused) {
+        // A sparse table with room to grow; -1 marks unused entries.
+        if (ring.fileTable > 0) {
+            ioUringRegister(ring.fd, IORING_UNREGISTER_FILES, nullptr, 0);
+            ring.fileTable = 0;
+        }
+        const std::size_t table = std::max(kMinSlots, capacity_);
+        std::vector<int> fds(table, -1);
+        for (const std::size_t index : live_) {
+            fds[index] = slots_[index].fd;
+        }
+        if (ioUringRegister(ring.fd, IORING_REGISTER_FILES, fds.data(), static_cast<unsigned>(table)) == 0) {
+            ring.fileTable = table;
+        } else {
+            ring.filesRefused = true;
+        }
+        ring.filesDirty = false;
+    }
+    if (ring.buffersDirty && !ring.buffersRefused && !buffer_.empty()) {
+        if (ring.buffers) {
+            ioUringRegister(ring.fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+            ring.buffers = false;
+        }
+        const iovec whole {buffer_.data(), buffer_.size()};
+        ring.buffers = ioUringRegister(ring.fd, IORING_REGISTER_BUFFERS, &whole, 1) == 0;
+        ring.buffersRefused = !ring.buffers;
+        ring.buffersDirty = false;
+    }
+
+    const std::size_t total = live_.size();
+    for (std::size_t first = 0; first < total; first += ring.entries) {
+        const auto batch = static_cast<unsigned>(std::min<std::size_t>(ring.entries, total - first));
+        unsigned tail = *ring.sqTail;
+        for (unsigned i = 0; i < batch; ++i) {
+            const std::size_t index = live_[first + i];
+            const unsigned entry = tail & ring.sqMask;
+            io_uring_sqe& sqe = ring.sqes[entry];
+            std::memset(&sqe, 0, sizeof(sqe));
+            if (ring.buffers) {
+                sqe.opcode = IORING_OP_READ_FIXED;
+                sqe.addr = reinterpret_cast<std::uintptr_t>(buffer_.data() + index * fileBytes_);
+                sqe.len = static_cast<unsigned>(fileBytes_);
+                sqe.buf_index = 0;
+            } else {
+                sqe.opcode = IORING_OP_READV;
+                sqe.addr = reinterpret_cast<std::uintptr_t>(&iovecs_[index]);
+                sqe.len = 1;
+            }
+            if (ring.fileTable > 0) {
+                sqe.fd = static_cast<int>(index);
+                sqe.flags = IOSQE_FIXED_FILE;
+            } else {
+                sqe.fd = slots_[index].fd;
+            }
+            sqe.off = 0;
+            sqe.user_data = index;
+            ring.sqArray[entry] = entry;
+            ++tail;
+        }
+        __atomic_store_n(ring.sqTail, tail, __ATOMIC_RELEASE);
+
+        unsigned submitted = 0;
+        unsigned reaped = 0;
+        bool unsupported = false;
+        while (reaped < batch) {
+            const int n = ioUringEnter(ring.fd, batch - submitted, batch - reaped);
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                    continue;
+                }
+                return false;
+            }
+            submitted += static_cast<unsigned>(n);
+            unsigned head = *ring.cqHead;
+            const unsigned cqTail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+            for (; head != cqTail; ++head, ++reaped) {
+                const io_uring_cqe& cqe = ring.cqes[head & ring.cqMask];
+                Slot& slot = slots_[static_cast<std::size_t>(cqe.user_data)];
+                slot.length = cqe.res > 0 ? static_cast<std::uint32_t>(cqe.res) : 0;
+                slot.error = cqe.res < 0 ? -cqe.res : 0;
+                unsupported = unsupported || cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP;
+            }
+            __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+        }
+        if (unsupported) {
+            return false; // e.g. a kernel without these opcodes: pread() instead
+        }
+    }
+    return true;
+}
+
+} // namespace statio
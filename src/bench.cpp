@@ -0,0 +1,273 @@
+#include "statio/bench.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+
+namespace statio {
+namespace {
+
+int readSysfsInt(const std::string& path, int fallback) {
+    std::ifstream in(path);
+    int value = fallback;
+    if (!(in >> value)) {
+        return fallback;
+    }
+    return value;
+}
+
+std::string readSysfsLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+// Lowest CPU sharing the highest-level cache of `cpu`, or -1.
+int lastLevelCacheLeader(int cpu) {
+    const std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache/index";
+    int bestLevel = -1;
+    int leader = -1;
+    for (int index = 0; index < 16; ++index) {
+        const int level = readSysfsInt(base + std::to_string(index) + "/level", -1);
+        if (level < 0) {
+            break;
+        }
+        const std::vector<int> shared = parseCpuList(readSysfsLine(base + std::to_string(index) + "/shared_cpu_list"));
+        if (level >= bestLevel && !shared.empty()) {
+            bestLevel = level;
+            leader = *std::min_element(shared.begin(), shared.end());
+        }
+    }
+    return leader;
+}
+
+} // namespace
+
+std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        std::size_t end = text.find(',', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        const std::string item = text.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.find_first_not_of(" \t\n") == std::string::npos) {
+            continue;
+        }
+        try {
+            const std::size_t dash = item.find('-');
+            const int first = std::stoi(item.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            if (first < 0 || last < first) {
+                throw std::invalid_argument(item);
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::logic_error&) {
+            throw std::runtime_error("bad cpu list item '" + item + "' (expected e.g. 0-3,8)");
+        }
+    }
+    return cpus;
+}
+
+std::vector<CpuPlacement> readCpuTopology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    const bool haveMask = ::sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    std::vector<int> online = parseCpuList(readSysfsLine("/sys/devices/system/cpu/online"));
+    if (online.empty()) {
+        online.push_back(0);
+    }
+
+    // core_id repeats across packages; number physical cores globally.
+    std::map<std::pair<int, int>, int> cores;
+    std::vector<CpuPlacement> topology;
+    for (const int cpu : online) {
+        if (haveMask && cpu < CPU_SETSIZE && !CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        const std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        CpuPlacement placement;
+        placement.cpu = cpu;
+        placement.package = std::max(0, readSysfsInt(base + "physical_package_id", 0));
+        const int coreId = readSysfsInt(base + "core_id", cpu);
+        placement.core = cores.emplace(std::make_pair(placement.package, coreId), static_cast<int>(cores.size())).first->second;
+        const int leader = lastLevelCacheLeader(cpu);
+        placement.llc = leader >= 0 ? leader : cpu;
+        topology.push_back(placement);
+    }
+    return topology;
+}
+
+bool pinCurrentThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+}
+
+CpuRelation cpuRelation(const CpuPlacement& a, const CpuPlacement& b) {
+    if (a.cpu == b.cpu) {
+        return CpuRelation::Same;
+    }
+    if (a.core == b.core) {
+        return CpuRelation::SmtSibling;
+    }
+    if (a.llc == b.llc) {
+        return CpuRelation::SharedCache;
+    }
+    return a.package == b.package ? CpuRelation::SamePackage : CpuRelation::CrossPackage;
+}
+
+const char* cpuRelationName(CpuRelation relation) {
+    switch (relation) {
+    case CpuRelation::Same:
+        return "same cpu";
+    case CpuRelation::SmtSibling:
+        return "smt sibling";
+    case CpuRelation::SharedCache:
+        return "shared llc";
+    case CpuRelation::SamePackage:
+        return "same package";
+    case CpuRelation::CrossPackage:
+        return "cross package";
+    }
+    return "?";
+}
+
+void LatencyHistogram::record(std::uint64_t ns) {
+    std::size_t index = static_cast<std::size_t>(ns);
+    if (ns >= (1ULL << kSubBits)) {
+        const int exponent = 63 - __builtin_clzll(ns);
+        const std::uint64_t sub = (ns >> (exponent - kSubBits)) & ((1ULL << kSubBits) - 1);
+        index = (static_cast<std::size_t>(exponent - kSubBits + 1) << kSubBits) + static_cast<std::size_t>(sub);
+    }
+    ++buckets_[index];
+    ++count_;
+    sum_ += ns;
+    min_ = std::min(min_, ns);
+    max_ = std::max(max_, ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+double LatencyHistogram::quantile(double q) const {
+    if (count_ == 0) {
+        return 0.0;
+    }
+    const auto rank = static_cast<std::uint64_t>(std::max(1.0, std::ceil(q * static_cast<double>(count_))));
+    std::uint64_t seen = 0;
+    for (std::size_t index = 0; index < kBuckets; ++index) {
+        seen += buckets_[index];
+        if (seen < rank) {
+            continue;
+        }
+        double middle = static_cast<double>(index);
+        if (index >= (1U << kSubBits)) {
+            const int shift = static_cast<int>(index >> kSubBits) - 1;
+            const std::uint64_t sub = index & ((1U << kSubBits) - 1);
+            const double lower = static_cast<double>(((1ULL << kSubBits) + sub) << shift);
+            middle = lower + static_cast<double>(1ULL << shift) / 2.0;
+        }
+        return std::clamp(middle, static_cast<double>(min_), static_cast<double>(max_));
+    }
+    return static_cast<double>(max_);
+}
+
+LoadKind parseLoadKind(const std::string& text) {
+    if (text.empty() || text == "none") {
+        return LoadKind::None;
+    }
+    if (text == "cpu") {
+        return LoadKind::Cpu;
+    }
+    if (text == "memory") {
+        return LoadKind::Memory;
+    }
+    throw std::runtime_error("unknown load '" + text + "' (none, cpu, memory)");
+}
+
+BackgroundLoad::BackgroundLoad(LoadKind kind, const std::vector<int>& cpus) {
+    if (kind == LoadKind::None) {
+        return;
+    }
+    for (const int cpu : cpus) {
+        threads_.emplace_back([this, kind, cpu] {
+            pinCurrentThread(cpu);
+            if (kind == LoadKind::Cpu) {
+                // Dependent chains keep the integer and FP pipes busy
+                // without touching memory.
+                std::uint64_t x = 0x9e3779b97f4a7c15ULL ^ static_cast<std::uint64_t>(cpu);
+                double y = 1.0;
+                while (!stopping_.load(std::memory_order_relaxed)) {
+                    for (int i = 0; i < 4096; ++i) {
+                        x ^= x << 13;
+                        x ^= x >> 7;
+                        x ^= x << 17;
+                        y = y * 1.0000001 + static_cast<double>(x & 0xff) * 1e-9;
+                    }
+                }
+                volatile double sink = y + static_cast<double>(x);
+                (void)sink;
+                return;
+            }
+            constexpr std::size_t kWords = (64U << 20) / sizeof(std::uint64_t);
+            std::unique_ptr<std::uint64_t[]> buffer(new std::uint64_t[kWords]());
+            while (!stopping_.load(std::memory_order_relaxed)) {
+                for (std::size_t i = 0; i < kWords && !stopping_.load(std::memory_order_relaxed); i += 8) {
+                    buffer[i] += i;
+                }
+            }
+        });
+    }
+}
+
+BackgroundLoad::~BackgroundLoad() {
+    stopping_ = true;
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+ScratchDirectory::ScratchDirectory(const std::string& parent, const char* prefix) {
+    namespace fs = std::filesystem;
+    std::string pattern =
+        ((parent.empty() ? fs::temp_directory_path() : fs::path(parent)) / (std::string(prefix) + "-XXXXXX")).string();
+    if (::mkdtemp(pattern.data()) == nullptr) {
+        throw std::runtime_error("cannot create a scratch directory " + pattern + ": " + std::strerror(errno));
+    }
+    path_ = pattern;
+}
+
+ScratchDirectory::~ScratchDirectory() {
+    std::error_code ignored;
+    std::filesystem::remove_all(path_, ignored);
+}
+
+} // namespace statio
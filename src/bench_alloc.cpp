@@ -0,0 +1,370 @@
+#include "statio/bench.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__GLIBC__)
+#include <gnu/libc-version.h>
+#endif
+
+namespace statio {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+constexpr std::uint64_t kBatch = 64; // operations between checks of the stop flag
+
+struct SizeClass {
+    const char* pattern;
+    std::size_t minBytes;
+    std::size_t maxBytes;
+    std::size_t live; // blocks each thread keeps allocated
+};
+
+// Small sits in the thread caches, medium in the arenas' bins; large
+// crosses glibc's default 128 KiB mmap threshold.
+constexpr SizeClass kSizeClasses[] = {
+    {"small", 16, 256, 4096},
+    {"medium", 1024, 32768, 512},
+    {"large", 65536, 1U << 20, 16},
+};
+
+const std::vector<std::string>& allocPatterns() {
+    static const std::vector<std::string> names = {"small", "medium", "large", "cross-free", "handoff"};
+    return names;
+}
+
+std::uint64_t nextRandom(std::uint64_t& x) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+}
+
+// Touches the first and last byte so that the allocator cannot hand out
+// memory nobody writes, and the compiler cannot drop the pair.
+char* allocate(std::size_t bytes) {
+    auto* block = static_cast<char*>(std::malloc(bytes));
+    if (block != nullptr) {
+        block[0] = 1;
+        block[bytes - 1] = 1;
+    }
+    return block;
+}
+
+// Single-producer single-consumer queue of blocks in flight between threads.
+struct Ring {
+    static constexpr std::size_t kCapacity = 1024;
+
+    alignas(64) std::atomic<std::size_t> head{0}; // consumer position
+    alignas(64) std::atomic<std::size_t> tail{0}; // producer position
+    alignas(64) std::array<char*, kCapacity> slots {};
+
+    bool push(char* block) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == kCapacity) {
+            return false;
+        }
+        slots[t % kCapacity] = block;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    char* pop() {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        char* block = slots[h % kCapacity];
+        head.store(h + 1, std::memory_order_release);
+        return block;
+    }
+};
+
+struct Shared {
+    alignas(64) std::atomic<bool> stopping{false};
+    std::atomic<bool> go{false};
+    std::atomic<bool> failed{false};
+    std::atomic<std::size_t> ready{0};
+};
+
+std::uint64_t churn(const SizeClass& size, std::uint64_t seed, Shared& shared) {
+    std::vector<char*> slots(size.live, nullptr);
+    std::uint64_t x = seed;
+    std::uint64_t ops = 0;
+    while (!shared.stopping.load(std::memory_order_relaxed)) {
+        for (std::uint64_t i = 0; i < kBatch; ++i) {
+            char*& slot = slots[nextRandom(x) % slots.size()];
+            std::free(slot);
+            slot = allocate(size.minBytes + nextRandom(x) % (size.maxBytes - size.minBytes + 1));
+            if (slot == nullptr) {
+                shared.failed = true;
+                shared.stopping = true;
+                break;
+            }
+        }
+        ops += kBatch;
+    }
+    for (char* block : slots) {
+        std::free(block);
+    }
+    return ops;
+}
+
+// Allocates into `out`, consumed by the next thread, and frees what the
+// previous thread left in `in`; a full ring is relieved by draining `in`,
+// so the cycle cannot deadlock.
+std::uint64_t crossFree(Ring& out, Ring& in, std::uint64_t seed, Shared& shared) {
+    std::uint64_t x = seed;
+    std::uint64_t ops = 0;
+    while (!shared.stopping.load(std::memory_order_relaxed)) {
+        for (std::uint64_t i = 0; i < kBatch; ++i) {
+            char* block = allocate(16 + nextRandom(x) % 1009);
+            if (block == nullptr) {
+                shared.failed = true;
+                shared.stopping = true;
+                break;
+            }
+            while (!out.push(block)) {
+                std::free(in.pop());
+            }
+            std::free(in.pop());
+        }
+        ops += kBatch;
+    }
+    return ops;
+}
+
+std::uint64_t produce(Ring& ring, std::uint64_t seed, Shared& shared) {
+    std::uint64_t x = seed;
+    std::uint64_t ops = 0;
+    char* pending = nullptr;
+    while (!shared.stopping.load(std::memory_order_relaxed)) {
+        for (std::uint64_t i = 0; i < kBatch; ++i) {
+            if (pending == nullptr) {
+                pending = allocate(64 + nextRandom(x) % 4033);
+                if (pending == nullptr) {
+                    shared.failed = true;
+                    shared.stopping = true;
+                    break;
+                }
+                ++ops;
+            }
+            if (ring.push(pending)) {
+                pending = nullptr;
+            }
+        }
+    }
+    std::free(pending);
+    return ops;
+}
+
+void consume(Ring& ring, Shared& shared) {
+    while (!shared.stopping.load(std::memory_order_relaxed)) {
+        for (std::uint64_t i = 0; i < kBatch; ++i) {
+            std::free(ring.pop()); // free(nullptr) when the ring is empty
+        }
+    }
+}
+
+struct Residency {
+    double rssMB = kNaN;
+    double peakMB = kNaN;
+};
+
+Residency readResidency() {
+    Residency residency;
+    std::ifstream status("/proc/self/status");
+    std::string key;
+    double kb = 0.0;
+    std::string unit;
+    while (status >> key) {
+        if (key == "VmRSS:" && status >> kb >> unit) {
+            residency.rssMB = kb / 1024.0;
+        } else if (key == "VmHWM:" && status >> kb >> unit) {
+            residency.peakMB = kb / 1024.0;
+        } else {
+            status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+    }
+    return residency;
+}
+
+// Resets VmHWM to the current RSS (Linux 4.0+); false when not allowed.
+bool resetPeakRss() {
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+    clear.flush();
+    return static_cast<bool>(clear);
+}
+
+// The malloc in use: a known allocator mapped into the process, else libc.
+std::string detectAllocator() {
+    static const char* const known[] = {"jemalloc", "tcmalloc", "mimalloc", "snmalloc", "hoard"};
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+        for (const char* name : known) {
+            if (line.find(std::string("lib") + name) == std::string::npos) {
+                continue;
+            }
+            const char* preload = std::getenv("LD_PRELOAD");
+            const bool preloaded = preload != nullptr && std::string(preload).find(name) != std::string::npos;
+            return std::string(name) + (preloaded ? " (LD_PRELOAD)" : "");
+        }
+    }
+#if defined(__GLIBC__)
+    return std::string("glibc ") + gnu_get_libc_version();
+#else
+    return "libc malloc";
+#endif
+}
+
+std::vector<std::size_t> defaultThreadCounts(std::size_t available) {
+    std::vector<std::size_t> counts;
+    for (std::size_t n = 1; n <= available; n = n < 4 ? n + 1 : n * 2) {
+        counts.push_back(n);
+    }
+    if (counts.empty() || counts.back() != available) {
+        counts.push_back(available);
+    }
+    return counts;
+}
+
+AllocCase measureCase(const std::string& pattern, const std::vector<int>& cpus, std::int64_t durationMs) {
+    AllocCase result;
+    result.pattern = pattern;
+    result.threads = cpus.size();
+    if (pattern == "handoff" && cpus.size() < 2) {
+        result.opsPerSec = result.peakGrowthMB = result.retainedMB = kNaN;
+        result.note = "needs two threads";
+        return result;
+    }
+    const std::size_t n = pattern == "handoff" ? cpus.size() / 2 * 2 : cpus.size();
+    const SizeClass* size = nullptr;
+    for (const auto& candidate : kSizeClasses) {
+        if (pattern == candidate.pattern) {
+            size = &candidate;
+        }
+    }
+
+    const bool peakReset = resetPeakRss();
+    const Residency before = readResidency();
+    Shared shared;
+    std::unique_ptr<Ring[]> rings(new Ring[n]);
+    std::vector<std::uint64_t> ops(n, 0);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < n; ++i) {
+        threads.emplace_back([&, i] {
+            pinCurrentThread(cpus[i]);
+            shared.ready.fetch_add(1);
+            while (!shared.go.load()) {
+                std::this_thread::yield();
+            }
+            const std::uint64_t seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+            if (size != nullptr) {
+                ops[i] = churn(*size, seed, shared);
+            } else if (pattern == "cross-free") {
+                ops[i] = crossFree(rings[i], rings[(i + n - 1) % n], seed, shared);
+            } else if (i % 2 == 0) {
+                ops[i] = produce(rings[i / 2], seed, shared);
+            } else {
+                consume(rings[i / 2], shared);
+            }
+        });
+    }
+    while (shared.ready.load() < n) {
+        std::this_thread::yield();
+    }
+    const auto started = Clock::now();
+    shared.go = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+    shared.stopping = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    for (std::size_t i = 0; i < n; ++i) {
+        while (char* block = rings[i].pop()) {
+            std::free(block);
+        }
+    }
+    if (shared.failed.load()) {
+        throw std::runtime_error("malloc failed during the " + pattern + " case");
+    }
+
+    const Residency after = readResidency();
+    std::uint64_t total = 0;
+    for (const std::uint64_t count : ops) {
+        total += count;
+    }
+    result.threads = n;
+    result.opsPerSec = static_cast<double>(total) / seconds;
+    result.peakGrowthMB = peakReset ? std::max(0.0, after.peakMB - before.rssMB) : kNaN;
+    result.retainedMB = after.rssMB - before.rssMB;
+    if (n != cpus.size()) {
+        result.note = "rounded down to producer/consumer pairs";
+    } else if (pattern == "cross-free" && n == 1) {
+        result.note = "one thread frees its own blocks";
+    } else if (!peakReset) {
+        result.note = "peak unknown: /proc/self/clear_refs not writable";
+    }
+    return result;
+}
+
+} // namespace
+
+AllocResult runAllocBench(const AllocOptions& options,
+                          const std::function<void(std::size_t done, std::size_t total)>& progress) {
+    if (options.durationMs <= 0) {
+        throw std::runtime_error("--duration must be positive");
+    }
+    const std::vector<std::string> patterns = options.patterns.empty() ? allocPatterns() : options.patterns;
+    for (const auto& pattern : patterns) {
+        if (std::find(allocPatterns().begin(), allocPatterns().end(), pattern) == allocPatterns().end()) {
+            throw std::runtime_error("unknown pattern '" + pattern + "' (small, medium, large, cross-free, handoff)");
+        }
+    }
+    const std::vector<CpuPlacement> topology = readCpuTopology();
+    if (topology.empty()) {
+        throw std::runtime_error("no usable CPU in this process's affinity");
+    }
+    const std::vector<std::size_t> counts =
+        options.threads.empty() ? defaultThreadCounts(topology.size()) : options.threads;
+    for (const std::size_t n : counts) {
+        if (n == 0) {
+            throw std::runtime_error("--threads counts must be positive");
+        }
+    }
+
+    AllocResult result;
+    result.allocator = detectAllocator();
+    const std::size_t total = patterns.size() * counts.size();
+    for (const auto& pattern : patterns) {
+        for (const std::size_t n : counts) {
+            // More threads than CPUs oversubscribe round-robin, which is
+            // how a busy service sees its allocator too.
+            std::vector<int> cpus;
+            for (std::size_t i = 0; i < n; ++i) {
+                cpus.push_back(topology[i % topology.size()].cpu);
+            }
+            result.cases.push_back(measureCase(pattern, cpus, options.durationMs));
+            if (progress) {
+                progress(result.cases.size(), total);
+            }
+        }
+    }
+    return result;
+}
+
+} // namespace statio
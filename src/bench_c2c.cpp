@@ -0,0 +1,198 @@
+#include "statio/bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace statio {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The line the pair bounces; padded so that nothing else shares it.
+struct alignas(64) PingLine {
+    std::atomic<std::uint64_t> value{0};
+};
+
+struct PairRun {
+    std::size_t row = 0;
+    std::size_t col = 0;
+    PingLine line;
+    std::atomic<int> arrived{0};
+    std::atomic<bool> failed{false};
+    int failedCpu = -1;
+    double oneWayNs = std::numeric_limits<double>::quiet_NaN();
+};
+
+// Spins on the line. Only when the two threads share a CPU (a repeated
+// --cpus entry) does spinning starve the peer, hence the occasional yield.
+void waitFor(const std::atomic<std::uint64_t>& value, std::uint64_t want) {
+    unsigned spins = 0;
+    while (value.load(std::memory_order_acquire) != want) {
+        if (++spins == (1U << 16)) {
+            std::this_thread::yield();
+            spins = 0;
+        }
+    }
+}
+
+// Both threads pin before either starts; false when one could not.
+bool meet(PairRun& run, int cpu) {
+    if (!pinCurrentThread(cpu)) {
+        run.failedCpu = cpu;
+        run.failed = true;
+    }
+    run.arrived.fetch_add(1);
+    while (run.arrived.load() < 2) {
+        std::this_thread::yield();
+    }
+    return !run.failed;
+}
+
+void measure(PairRun& run, int initiator, int responder, std::size_t roundTrips, std::size_t samples) {
+    std::thread peer([&run, responder, total = roundTrips * samples] {
+        if (!meet(run, responder)) {
+            return;
+        }
+        for (std::uint64_t k = 0; k < total; ++k) {
+            waitFor(run.line.value, 2 * k + 1);
+            run.line.value.store(2 * k + 2, std::memory_order_release);
+        }
+    });
+
+    std::vector<double> perSample;
+    if (meet(run, initiator)) {
+        std::uint64_t k = 0;
+        for (std::size_t s = 0; s < samples; ++s) {
+            const auto started = Clock::now();
+            for (std::size_t i = 0; i < roundTrips; ++i, ++k) {
+                run.line.value.store(2 * k + 1, std::memory_order_release);
+                waitFor(run.line.value, 2 * k + 2);
+            }
+            const double ns = std::chrono::duration<double, std::nano>(Clock::now() - started).count();
+            perSample.push_back(ns / static_cast<double>(2 * roundTrips));
+        }
+    }
+    peer.join();
+    if (!perSample.empty()) {
+        std::nth_element(perSample.begin(), perSample.begin() + perSample.size() / 2, perSample.end());
+        run.oneWayNs = perSample[perSample.size() / 2];
+    }
+}
+
+// Round-robin tournament (circle method): n-1 rounds in which every index
+// meets another exactly once, each round a set of disjoint pairs.
+std::vector<std::vector<std::pair<std::size_t, std::size_t>>> tournament(std::size_t n) {
+    const std::size_t slots = n + (n % 2);
+    std::vector<std::size_t> ring(slots);
+    for (std::size_t i = 0; i < slots; ++i) {
+        ring[i] = i;
+    }
+    std::vector<std::vector<std::pair<std::size_t, std::size_t>>> rounds;
+    for (std::size_t r = 0; r + 1 < slots; ++r) {
+        std::vector<std::pair<std::size_t, std::size_t>> round;
+        for (std::size_t i = 0; i < slots / 2; ++i) {
+            const std::size_t a = ring[i];
+            const std::size_t b = ring[slots - 1 - i];
+            if (a < n && b < n) {
+                round.emplace_back(std::min(a, b), std::max(a, b));
+            }
+        }
+        rounds.push_back(std::move(round));
+        std::rotate(ring.begin() + 1, ring.end() - 1, ring.end());
+    }
+    return rounds;
+}
+
+} // namespace
+
+C2cResult runCoreToCore(const C2cOptions& options,
+                        const std::function<void(std::size_t done, std::size_t total)>& progress) {
+    const std::vector<CpuPlacement> topology = readCpuTopology();
+    C2cResult result;
+    if (options.cpus.empty()) {
+        result.cpus = topology;
+    } else {
+        for (const int cpu : options.cpus) {
+            auto it = std::find_if(topology.begin(), topology.end(), [cpu](const CpuPlacement& p) { return p.cpu == cpu; });
+            if (it == topology.end()) {
+                throw std::runtime_error("cpu " + std::to_string(cpu) + " is offline or outside this process's affinity");
+            }
+            result.cpus.push_back(*it);
+        }
+    }
+    const std::size_t n = result.cpus.size();
+    if (n < 2) {
+        throw std::runtime_error("core-to-core latency needs at least two CPUs");
+    }
+    if (options.roundTrips == 0 || options.samples == 0) {
+        throw std::runtime_error("--round-trips and --samples must be positive");
+    }
+    result.oneWayNs.assign(n * n, std::numeric_limits<double>::quiet_NaN());
+
+    // Split every tournament round into waves in which no physical core
+    // runs two pairs: SMT siblings of a busy pair would skew its timing.
+    std::vector<std::vector<std::pair<std::size_t, std::size_t>>> waves;
+    for (auto& round : tournament(n)) {
+        while (!round.empty()) {
+            std::vector<std::pair<std::size_t, std::size_t>> wave;
+            std::vector<std::pair<std::size_t, std::size_t>> later;
+            std::set<int> busy;
+            for (const auto& pair : round) {
+                const int a = result.cpus[pair.first].core;
+                const int b = result.cpus[pair.second].core;
+                if (options.serial ? !wave.empty() : (busy.count(a) || busy.count(b))) {
+                    later.push_back(pair);
+                    continue;
+                }
+                busy.insert(a);
+                busy.insert(b);
+                wave.push_back(pair);
+            }
+            waves.push_back(std::move(wave));
+            round = std::move(later);
+        }
+    }
+
+    const std::size_t totalPairs = n * (n - 1) / 2;
+    std::size_t done = 0;
+    const auto started = Clock::now();
+    for (const auto& wave : waves) {
+        std::vector<std::unique_ptr<PairRun>> runs;
+        std::vector<std::thread> threads;
+        for (const auto& pair : wave) {
+            runs.push_back(std::make_unique<PairRun>());
+            PairRun& run = *runs.back();
+            run.row = pair.first;
+            run.col = pair.second;
+            threads.emplace_back([&run, &options, a = result.cpus[pair.first].cpu, b = result.cpus[pair.second].cpu] {
+                measure(run, a, b, options.roundTrips, options.samples);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto& run : runs) {
+            if (run->failed) {
+                throw std::runtime_error("cannot pin a thread to cpu " + std::to_string(run->failedCpu));
+            }
+            result.oneWayNs[run->row * n + run->col] = run->oneWayNs;
+            result.oneWayNs[run->col * n + run->row] = run->oneWayNs;
+        }
+        done += wave.size();
+        if (progress) {
+            progress(done, totalPairs);
+        }
+    }
+    result.elapsedSeconds = std::chrono::duration<double>(Clock::now() - started).count();
+    return result;
+}
+
+} // namespace statio
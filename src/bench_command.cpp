@@ -0,0 +1,890 @@
+#include "statio/commands.hpp"
+
+#include "statio/bench.hpp"
+#include "statio/bench_results.hpp"
+#include "statio/cli_options.hpp"
+#include "statio/query.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+using BenchHandler = int (*)(const std::vector<std::string>&);
+
+constexpr const char* kDefaultResultsFile = "statio-bench.stb";
+
+void printBenchUsage() {
+    std::cerr << "usage: statio bench <benchmark> [options]\n"
+                 "\n"
+                 "  alloc      malloc/free throughput and RSS growth across threads\n"
+                 "  c2c        core-to-core cache-line latency matrix\n"
+                 "  compare    diff two recorded runs: deltas, 95% intervals, category scores\n"
+                 "  contention atomic, CAS, mutex, spinlock and sharded counter scaling\n"
+                 "  crypto     AES, SHA-256, CRC32C and LZ throughput, hardware vs portable\n"
+                 "  files      re-reading thousands of small procfs/sysfs files: ifstream, pread, io_uring\n"
+                 "  procscan   parallel /proc scan on 1-8 workers, synthetic 200k tasks or this host\n"
+                 "  fs         per-mount metadata rates and fsync/fdatasync latency\n"
+                 "  net        loopback TCP, UDP and Unix socket throughput and latency\n"
+                 "  os         syscall, context switch, thread and page fault costs\n"
+                 "  record     run a short suite several times and append it to a results file\n"
+                 "  tlb        random access on 4K, THP, 2M and 1G pages, with huge page inventory\n"
+                 "  wakeup     timer wake-up latency per CPU (cyclictest style)\n";
+}
+
+std::string formatNs(double ns) {
+    if (std::isnan(ns)) {
+        return "-";
+    }
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), ns < 100.0 ? "%.1f" : "%.0f", ns);
+    return buffer;
+}
+
+void printC2cTable(const C2cResult& result) {
+    const std::size_t n = result.cpus.size();
+    std::size_t width = 4;
+    for (const double ns : result.oneWayNs) {
+        width = std::max(width, formatNs(ns).size() + 1);
+    }
+    std::printf("%5s", "cpu");
+    for (const auto& placement : result.cpus) {
+        std::printf("%*d", static_cast<int>(width), placement.cpu);
+    }
+    std::printf("\n");
+    for (std::size_t row = 0; row < n; ++row) {
+        std::printf("%5d", result.cpus[row].cpu);
+        for (std::size_t col = 0; col < n; ++col) {
+            std::printf("%*s", static_cast<int>(width), formatNs(result.at(row, col)).c_str());
+        }
+        std::printf("\n");
+    }
+}
+
+void printC2cCsv(const C2cResult& result) {
+    std::cout << "cpu_a,cpu_b,relation,one_way_ns\n";
+    const std::size_t n = result.cpus.size();
+    for (std::size_t row = 0; row < n; ++row) {
+        for (std::size_t col = row + 1; col < n; ++col) {
+            std::cout << result.cpus[row].cpu << ',' << result.cpus[col].cpu << ','
+                      << cpuRelationName(cpuRelation(result.cpus[row], result.cpus[col])) << ','
+                      << formatNs(result.at(row, col)) << '\n';
+        }
+    }
+}
+
+// Min/avg/max per relation: the numbers thread placement decisions use.
+void printC2cSummary(const C2cResult& result) {
+    struct Stats {
+        std::size_t pairs = 0;
+        double min = INFINITY;
+        double max = 0.0;
+        double sum = 0.0;
+    };
+    Stats stats[kCpuRelationCount];
+    const std::size_t n = result.cpus.size();
+    for (std::size_t row = 0; row < n; ++row) {
+        for (std::size_t col = row + 1; col < n; ++col) {
+            const double ns = result.at(row, col);
+            if (std::isnan(ns)) {
+                continue;
+            }
+            Stats& s = stats[static_cast<std::size_t>(cpuRelation(result.cpus[row], result.cpus[col]))];
+            ++s.pairs;
+            s.min = std::min(s.min, ns);
+            s.max = std::max(s.max, ns);
+            s.sum += ns;
+        }
+    }
+    std::printf("\n%-14s %7s %9s %9s %9s\n", "relation", "pairs", "min ns", "avg ns", "max ns");
+    for (std::size_t i = 0; i < kCpuRelationCount; ++i) {
+        if (stats[i].pairs == 0) {
+            continue;
+        }
+        std::printf("%-14s %7zu %9s %9s %9s\n", cpuRelationName(static_cast<CpuRelation>(i)), stats[i].pairs,
+                    formatNs(stats[i].min).c_str(), formatNs(stats[i].sum / static_cast<double>(stats[i].pairs)).c_str(),
+                    formatNs(stats[i].max).c_str());
+    }
+    std::printf("measured in %.1f s\n", result.elapsedSeconds);
+}
+
+int runC2cBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"cpus", "round-trips", "samples", "format"}, {"serial", "quiet"});
+    C2cOptions options;
+    options.cpus = parseCpuList(cli.value("cpus"));
+    options.roundTrips = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("round-trips", 1000)));
+    options.samples = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("samples", 5)));
+    options.serial = cli.has("serial");
+    const std::string format = cli.value("format", "table");
+    if (format != "table" && format != "csv") {
+        throw std::runtime_error("unknown format '" + format + "' (table, csv)");
+    }
+
+    const bool showProgress = !cli.has("quiet") && ::isatty(2);
+    const C2cResult result = runCoreToCore(options, [showProgress](std::size_t done, std::size_t total) {
+        if (showProgress) {
+            std::fprintf(stderr, "\r%zu/%zu pairs", done, total);
+        }
+    });
+    if (showProgress) {
+        std::fprintf(stderr, "\n");
+    }
+
+    if (format == "csv") {
+        printC2cCsv(result);
+    } else {
+        std::printf("one-way cache-line transfer latency (ns), median of %zu x %zu round trips\n\n", options.samples,
+                    options.roundTrips);
+        printC2cTable(result);
+        printC2cSummary(result);
+    }
+    return 0;
+}
+
+int runWakeupBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"cpus", "interval-us", "duration", "priority", "load"});
+    WakeupOptions options;
+    options.cpus = parseCpuList(cli.value("cpus"));
+    options.intervalUs = cli.integer("interval-us", 1000);
+    options.durationMs = parseDurationMs(cli.value("duration", "10s"));
+    options.priority = static_cast<int>(cli.integer("priority", 0));
+    options.load = parseLoadKind(cli.value("load", "none"));
+
+    const WakeupResult result = runWakeupLatency(options);
+    std::printf("wake-up latency (us), %lld us interval for %lld ms, %s, load %s\n", static_cast<long long>(options.intervalUs),
+                static_cast<long long>(options.durationMs),
+                result.realtime ? ("SCHED_FIFO " + std::to_string(options.priority)).c_str() : "SCHED_OTHER",
+                cli.value("load", "none").c_str());
+    if (options.priority > 0 && !result.realtime) {
+        std::printf("note: SCHED_FIFO refused (needs CAP_SYS_NICE or an rtprio limit); measured as SCHED_OTHER\n");
+    }
+    std::printf("\n%5s %9s %9s %9s %9s %9s %9s %9s\n", "cpu", "samples", "min", "avg", "p50", "p99", "p99.99", "max");
+    const auto printRow = [](const WakeupStats& stats) {
+        const std::string cpu = stats.cpu < 0 ? "all" : std::to_string(stats.cpu);
+        std::printf("%5s %9llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", cpu.c_str(),
+                    static_cast<unsigned long long>(stats.samples), stats.minUs, stats.avgUs, stats.p50Us, stats.p99Us,
+                    stats.p9999Us, stats.maxUs);
+    };
+    for (const auto& stats : result.perCpu) {
+        printRow(stats);
+    }
+    if (result.perCpu.size() > 1) {
+        printRow(result.all);
+    }
+    return 0;
+}
+
+std::vector<std::size_t> parseCounts(const std::string& text, const char* what) {
+    std::vector<std::size_t> counts;
+    for (const auto& item : splitList(text)) {
+        try {
+            counts.push_back(static_cast<std::size_t>(std::stoul(item)));
+        } catch (const std::logic_error&) {
+            throw std::runtime_error(std::string("bad ") + what + " '" + item + "'");
+        }
+    }
+    return counts;
+}
+
+int runContentionBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"placement", "cpus", "threads", "duration", "format"}, {"quiet"});
+    ContentionOptions options;
+    options.placements = splitList(cli.value("placement"));
+    options.cpus = parseCpuList(cli.value("cpus"));
+    options.threads = parseCounts(cli.value("threads"), "thread count");
+    options.durationMs = parseDurationMs(cli.value("duration", "200ms"));
+    const std::string format = cli.value("format", "table");
+    if (format != "table" && format != "csv") {
+        throw std::runtime_error("unknown format '" + format + "' (table, csv)");
+    }
+
+    const bool showProgress = !cli.has("quiet") && ::isatty(2);
+    const ContentionResult result = runContention(options, [showProgress](std::size_t done, std::size_t total) {
+        if (showProgress) {
+            std::fprintf(stderr, "\r%zu/%zu points", done, total);
+        }
+    });
+    if (showProgress) {
+        std::fprintf(stderr, "\n");
+    }
+    for (const auto& skipped : result.skipped) {
+        std::fprintf(stderr, "skipped placement %s\n", skipped.c_str());
+    }
+
+    if (format == "csv") {
+        std::cout << "placement,threads,widest,primitive,mops_per_sec,fairness\n";
+        for (const auto& point : result.points) {
+            for (std::size_t p = 0; p < kSyncPrimitiveCount; ++p) {
+                std::printf("%s,%zu,%s,%s,%.2f,%.2f\n", point.placement.c_str(), point.threads,
+                            cpuRelationName(point.widest), syncPrimitiveName(static_cast<SyncPrimitive>(p)),
+                            point.mopsPerSec[p], point.fairness[p]);
+            }
+        }
+        return 0;
+    }
+
+    std::printf("contended operations, Mops/s over %lld ms per point\n", static_cast<long long>(options.durationMs));
+    std::string placement;
+    for (const auto& point : result.points) {
+        if (point.placement != placement) {
+            placement = point.placement;
+            std::printf("\n%-8s %-14s", ("[" + placement + "]").c_str(), "widest pair");
+            for (std::size_t p = 0; p < kSyncPrimitiveCount; ++p) {
+                std::printf(" %10s", syncPrimitiveName(static_cast<SyncPrimitive>(p)));
+            }
+            std::printf("\n");
+        }
+        std::printf("%8zu %-14s", point.threads, point.threads == 1 ? "-" : cpuRelationName(point.widest));
+        for (std::size_t p = 0; p < kSyncPrimitiveCount; ++p) {
+            std::printf(" %10.1f", point.mopsPerSec[p]);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
+
+std::string formatRate(double perSecond) {
+    if (std::isnan(perSecond)) {
+        return "-";
+    }
+    char buffer[32];
+    if (perSecond >= 1e6) {
+        std::snprintf(buffer, sizeof(buffer), "%.2fM", perSecond / 1e6);
+    } else if (perSecond >= 1e3) {
+        std::snprintf(buffer, sizeof(buffer), "%.1fk", perSecond / 1e3);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%.0f", perSecond);
+    }
+    return buffer;
+}
+
+std::string formatFixed(double value, const char* format) {
+    if (std::isnan(value)) {
+        return "-";
+    }
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), format, value);
+    return buffer;
+}
+
+int runNetBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"transports", "sizes", "connections", "threads", "batch", "duration", "format"},
+                          {"quiet"});
+    NetOptions options;
+    options.transports = splitList(cli.value("transports"));
+    options.sizes = parseCounts(cli.value("sizes"), "size");
+    options.connections = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("connections", 4)));
+    options.threads = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("threads", 0)));
+    options.batch = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("batch", 32)));
+    options.durationMs = parseDurationMs(cli.value("duration", "1s"));
+    const std::string format = cli.value("format", "table");
+    if (format != "table" && format != "csv") {
+        throw std::runtime_error("unknown format '" + format + "' (table, csv)");
+    }
+
+    const bool showProgress = !cli.has("quiet") && ::isatty(2);
+    const std::vector<NetCase> cases = statio::runNetBench(options, [showProgress](std::size_t done, std::size_t total) {
+        if (showProgress) {
+            std::fprintf(stderr, "\r%zu/%zu cases", done, total);
+        }
+    });
+    if (showProgress) {
+        std::fprintf(stderr, "\n");
+    }
+
+    if (format == "csv") {
+        std::cout << "transport,test,size,gbit_per_sec,messages_per_sec,p50_us,p99_us\n";
+        for (const auto& c : cases) {
+            std::cout << c.transport << ',' << c.test << ',' << c.size << ',' << formatFixed(c.gbitPerSec, "%.3f") << ','
+                      << formatFixed(c.messagesPerSec, "%.0f") << ',' << formatFixed(c.p50Us, "%.1f") << ','
+                      << formatFixed(c.p99Us, "%.1f") << '\n';
+        }
+        return 0;
+    }
+
+    std::printf("loopback network stack, %zu connections, %lld ms per case\n\n", options.connections,
+                static_cast<long long>(options.durationMs));
+    std::printf("%-5s %-16s %7s %8s %9s %9s %9s  %s\n", "proto", "test", "size", "Gbit/s", "msg/s", "p50 us",
+                "p99 us", "note");
+    for (const auto& c : cases) {
+        std::printf("%-5s %-16s %7zu %8s %9s %9s %9s%s%s\n", c.transport.c_str(), c.test.c_str(), c.size,
+                    formatFixed(c.gbitPerSec, "%.2f").c_str(), formatRate(c.messagesPerSec).c_str(),
+                    formatFixed(c.p50Us, "%.1f").c_str(), formatFixed(c.p99Us, "%.1f").c_str(),
+                    c.note.empty() ? "" : "  ", c.note.c_str());
+    }
+    return 0;
+}
+
+int runAllocBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"patterns", "threads", "duration", "format"}, {"quiet"});
+    AllocOptions options;
+    options.patterns = splitList(cli.value("patterns"));
+    options.threads = parseCounts(cli.value("threads"), "thread count");
+    options.durationMs = parseDurationMs(cli.value("duration", "500ms"));
+    const std::string format = cli.value("format", "table");
+    if (format != "table" && format != "csv") {
+        throw std::runtime_error("unknown format '" + format + "' (table, csv)");
+    }
+
+    const bool showProgress = !cli.has("quiet") && ::isatty(2);
+    const AllocResult result = statio::runAllocBench(options, [showProgress](std::size_t done, std::size_t total) {
+        if (showProgress) {
+            std::fprintf(stderr, "\r%zu/%zu cases", done, total);
+        }
+    });
+    if (showProgress) {
+        std::fprintf(stderr, "\n");
+    }
+
+    if (format == "csv") {
+        std::cout << "allocator,pattern,threads,ops_per_sec,peak_growth_mb,retained_mb\n";
+        for (const auto& c : result.cases) {
+            std::cout << result.allocator << ',' << c.pattern << ',' << c.threads << ','
+                      << formatFixed(c.opsPerSec, "%.0f") << ',' << formatFixed(c.peakGrowthMB, "%.1f") << ','
+                      << formatFixed(c.retainedMB, "%.1f") << '\n';
+        }
+        return 0;
+    }
+
+    std::printf("allocator %s, %lld ms per case\n\n", result.allocator.c_str(),
+                static_cast<long long>(options.durationMs));
+    std::printf("%-10s %7s %9s %9s %9s  %s\n", "pattern", "threads", "ops/s", "peak MB", "kept MB", "note");
+    for (const auto& c : result.cases) {
+        std::printf("%-10s %7zu %9s %9s %9s%s%s\n", c.pattern.c_str(), c.threads, formatRate(c.opsPerSec).c_str(),
+                    formatFixed(c.peakGrowthMB, "%.1f").c_str(), formatFixed(c.retainedMB, "%.1f").c_str(),
+                    c.note.empty() ? "" : "  ", c.note.c_str());
+    }
+    return 0;
+}
+
+int runTlbBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"pages", "size-mb", "accesses", "format"}, {"quiet"});
+    TlbOptions options;
+    options.pages = splitList(cli.value("pages"));
+    options.sizeMB = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("size-mb", 1024)));
+    options.accesses = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("accesses", 1LL << 24)));
+    const std::string format = cli.value("format", "table");
+    if (format != "table" && format != "csv") {
+        throw std::runtime_error("unknown format '" + format + "' (table, csv)");
+    }
+
+    const bool showProgress = !cli.has("quiet") && ::isatty(2);
+    const TlbResult result = statio::runTlbBench(options, [showProgress](std::size_t done, std::size_t total) {
+        if (showProgress) {
+            std::fprintf(stderr, "\r%zu/%zu page sizes", done, total);
+        }
+    });
+    if (showProgress) {
+        std::fprintf(stderr, "\n");
+    }
+
+    // Speedups are against the 4 KiB row when it ran.
+    double baseChase = NAN;
+    for (const auto& c : result.cases) {
+        if (c.page == "4k") {
+            baseChase = c.chaseNs;
+        }
+    }
+    if (format == "csv") {
+        std::cout << "page,bytes,chase_ns,gather_ns,huge_fraction,chase_speedup\n";
+        for (const auto& c : result.cases) {
+            std::cout << c.page << ',' << c.bytes << ',' << formatFixed(c.chaseNs, "%.2f") << ','
+                      << formatFixed(c.gatherNs, "%.2f") << ',' << formatFixed(c.hugeFraction, "%.3f") << ','
+                      << formatFixed(baseChase / c.chaseNs, "%.3f") << '\n';
+        }
+        return 0;
+    }
+
+    const HugePageInfo& huge = result.hugepages;
+    std::printf("THP %s, defrag %s; free memory %llu MB, %llu MB of it in 2 MB+ blocks\n",
+                huge.thpEnabled.empty() ? "unknown" : huge.thpEnabled.c_str(),
+                huge.thpDefrag.empty() ? "unknown" : huge.thpDefrag.c_str(),
+                static_cast<unsigned long long>(huge.freeMB), static_cast<unsigned long long>(huge.free2MBlockMB));
+    for (const auto& pool : huge.pools) {
+        std::printf("hugetlb %7llu kB pages: %llu total, %llu free, %llu reserved\n",
+                    static_cast<unsigned long long>(pool.pageKB), static_cast<unsigned long long>(pool.total),
+                    static_cast<unsigned long long>(pool.free), static_cast<unsigned long long>(pool.reserved));
+    }
+    std::printf("\n%-5s %8s %9s %9s %6s %7s  %s\n", "page", "MB", "chase ns", "gather ns", "huge", "speedup",
+                "note");
+    for (const auto& c : result.cases) {
+        std::printf("%-5s %8zu %9s %9s %6s %7s%s%s\n", c.page.c_str(), c.bytes >> 20,
+                    formatFixed(c.chaseNs, "%.1f").c_str(), formatFixed(c.gatherNs, "%.2f").c_str(),
+                    formatFixed(c.hugeFraction * 100.0, "%.0f%%").c_str(),
+                    formatFixed(baseChase / c.chaseNs, "%.2fx").c_str(), c.note.empty() ? "" : "  ", c.note.c_str());
+    }
+    return 0;
+}
+
+int runFilesBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"trees", "cpus", "interfaces", "samples", "dir", "format"}, {"quiet"});
+    FilesOptions options;
+    options.trees = splitList(cli.value("trees"));
+    options.cpus = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("cpus", 512)));
+    options.interfaces = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("interfaces", 5000)));
+    options.samples = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("samples", 20)));
+    options.directory = cli.value("dir");
+    const std::string format = cli.value("format", "table");
+    if (format != "table" && format != "csv") {
+        throw std::runtime_error("unknown format '" + format + "' (table, csv)");
+    }
+
+    const bool showProgress = !cli.has("quiet") && ::isatty(2);
+    const FilesResult result = statio::runFilesBench(options, [showProgress](std::size_t done, std::size_t total) {
+        if (showProgress) {
+            std::fprintf(stderr, "\r%zu/%zu trees", done, total);
+        }
+    });
+    if (showProgress) {
+        std::fprintf(stderr, "\n");
+    }
+
+    if (format == "csv") {
+        std::cout << "tree,files,ifstream_us,pread_us,uring_us\n";
+        for (const auto& c : result.cases) {
+            std::cout << c.tree << ',' << c.files << ',' << formatFixed(c.ifstreamUs, "%.1f") << ','
+                      << formatFixed(c.preadUs, "%.1f") << ',' << formatFixed(c.uringUs, "%.1f") << '\n';
+        }
+        return 0;
+    }
+
+    std::printf("one sample re-reads every file of the tree; median of %zu samples, speedups over ifstream\n",
+                options.samples);
+    std::printf("io_uring: %s\n\n", result.uring.c_str());
+    std::printf("%-8s %6s %11s %11s %11s %7s %7s  %s\n", "tree", "files", "ifstream us", "pread us", "uring us",
+                "pread", "uring", "note");
+    for (const auto& c : result.cases) {
+        std::printf("%-8s %6zu %11s %11s %11s %7s %7s%s%s\n", c.tree.c_str(), c.files,
+                    formatFixed(c.ifstreamUs, "%.0f").c_str(), formatFixed(c.preadUs, "%.0f").c_str(),
+                    formatFixed(c.uringUs, "%.0f").c_str(), formatFixed(c.ifstreamUs / c.preadUs, "%.1fx").c_str(),
+                    formatFixed(c.ifstreamUs / c.uringUs, "%.1fx").c_str(), c.note.empty() ? "" : "  ",
+                    c.note.c_str());
+    }
+    return 0;
+}
+
+int runProcScanBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"workers", "tasks", "samples", "dir", "format"}, {"host", "quiet"});
+    ProcScanOptions options;
+    if (cli.has("workers")) {
+        options.workers = parseCounts(cli.value("workers"), "worker count");
+    }
+    options.tasks = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("tasks", 200000)));
+    options.host = cli.has("host");
+    options.samples = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("samples", 5)));
+    options.directory = cli.value("dir");
+    const std::string format = cli.value("format", "table");
+    if (format != "table" && format != "csv") {
+        throw std::runtime_error("unknown format '" + format + "' (table, csv)");
+    }
+
+    const bool showProgress = !cli.has("quiet") && ::isatty(2);
+    if (showProgress && !options.host) {
+        std::fprintf(stderr, "writing %zu synthetic tasks\n", options.tasks);
+    }
+    const ProcScanResult result =
+        statio::runProcScanBench(options, [showProgress](std::size_t done, std::size_t total) {
+            if (showProgress) {
+                std::fprintf(stderr, "\r%zu/%zu worker counts", done, total);
+            }
+        });
+    if (showProgress) {
+        std::fprintf(stderr, "\n");
+    }
+
+    // Speedups are over the one-worker row, when there is one.
+    double serialMs = std::numeric_limits<double>::quiet_NaN();
+    for (const auto& c : result.cases) {
+        if (c.used == 1) {
+            serialMs = c.scanMs;
+            break;
+        }
+    }
+    if (format == "csv") {
+        std::cout << "workers,used,tasks,scan_ms,tasks_per_s\n";
+        for (const auto& c : result.cases) {
+            std::cout << (c.workers == 0 ? std::string("auto") : std::to_string(c.workers)) << ',' << c.used << ','
+                      << c.rows << ',' << formatFixed(c.scanMs, "%.3f") << ','
+                      << formatFixed(c.rows / (c.scanMs / 1000.0), "%.0f") << '\n';
+        }
+        return 0;
+    }
+
+    std::printf("root %s, %zu usable CPUs; median of %zu scans\n\n", result.root.c_str(), result.cpus,
+                options.samples);
+    std::printf("%-8s %5s %8s %10s %10s %8s %10s\n", "workers", "used", "tasks", "scan ms", "tasks/s", "speedup",
+                "efficiency");
+    for (const auto& c : result.cases) {
+        const double speedup = serialMs / c.scanMs;
+        std::printf("%-8s %5zu %8zu %10s %10s %8s %10s\n",
+                    c.workers == 0 ? "auto" : std::to_string(c.workers).c_str(), c.used, c.rows,
+                    formatFixed(c.scanMs, "%.2f").c_str(), formatRate(c.rows / (c.scanMs / 1000.0)).c_str(),
+                    formatFixed(speedup, "%.2fx").c_str(),
+                    formatFixed(speedup / static_cast<double>(c.used) * 100.0, "%.0f%%").c_str());
+    }
+    if (result.cpus < 8) {
+        std::printf("\n%zu usable CPU%s: more workers than that share them and cannot scale\n", result.cpus,
+                    result.cpus == 1 ? "" : "s");
+    }
+    return 0;
+}
+
+int runCryptoBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"algorithms", "threads", "duration", "format"}, {"quiet"});
+    CryptoOptions options;
+    options.algorithms = splitList(cli.value("algorithms"));
+    options.threads = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("threads", 0)));
+    options.durationMs = parseDurationMs(cli.value("duration", "500ms"));
+    const std::string format = cli.value("format", "table");
+    if (format != "table" && format != "csv") {
+        throw std::runtime_error("unknown format '" + format + "' (table, csv)");
+    }
+
+    const bool showProgress = !cli.has("quiet") && ::isatty(2);
+    const std::vector<CryptoResult> results =
+        statio::runCryptoBench(options, [showProgress](std::size_t done, std::size_t total) {
+            if (showProgress) {
+                std::fprintf(stderr, "\r%zu/%zu implementations", done, total);
+            }
+        });
+    if (showProgress) {
+        std::fprintf(stderr, "\n");
+    }
+
+    if (format == "csv") {
+        std::cout << "algorithm,implementation,flag,supported,single_gb_per_sec,multi_gb_per_sec,threads\n";
+        for (const auto& r : results) {
+            std::cout << r.algorithm << ',' << r.implementation << ',' << r.flag << ',' << (r.supported ? 1 : 0) << ','
+                      << formatFixed(r.supported ? r.singleGBps : NAN, "%.3f") << ','
+                      << formatFixed(r.supported ? r.multiGBps : NAN, "%.3f") << ',' << r.threads << '\n';
+        }
+        return 0;
+    }
+
+    const CpuInfo cpu = collectCpuInfo(SourceCpuInfo);
+    std::string flags;
+    for (const char* flag : {"aes", "sha_ni", "sse4_2", "avx2", "vaes", "pclmulqdq", "sha2", "crc32", "pmull"}) {
+        if (cpuHasFlag(cpu, flag)) {
+            flags += flags.empty() ? flag : std::string(" ") + flag;
+        }
+    }
+    std::printf("%s\ncpu flags: %s\n\n", cpu.model.c_str(), flags.empty() ? "none relevant" : flags.c_str());
+    std::printf("%-14s %-10s %9s %9s  %s\n", "algorithm", "impl", "1T GB/s",
+                ("x" + std::to_string(results.empty() ? 0 : results.front().threads) + " GB/s").c_str(), "note");
+    for (const auto& r : results) {
+        std::printf("%-14s %-10s %9s %9s%s%s\n", r.algorithm.c_str(), r.implementation.c_str(),
+                    formatFixed(r.supported ? r.singleGBps : NAN, "%.2f").c_str(),
+                    formatFixed(r.supported ? r.multiGBps : NAN, "%.2f").c_str(), r.note.empty() ? "" : "  ",
+                    r.note.c_str());
+    }
+    return 0;
+}
+
+// Four significant digits, with k/M suffixes past 10000 instead of exponents.
+std::string formatValue(double value) {
+    return std::fabs(value) >= 1e4 ? formatRate(value) : formatFixed(value, "%.4g");
+}
+
+int runRecordBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"file", "runs", "categories", "dir", "label"}, {"quiet"});
+    const std::string file = cli.value("file", kDefaultResultsFile);
+    RecordOptions options;
+    options.runs = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("runs", 5)));
+    options.categories = splitList(cli.value("categories"));
+    const std::string parent = std::filesystem::path(file).parent_path().string();
+    options.directory = cli.value("dir", parent.empty() ? "." : parent);
+    options.label = cli.value("label");
+
+    const bool showProgress = !cli.has("quiet") && ::isatty(2);
+    const BenchRun run = recordBenchSuite(options, [showProgress](std::size_t done, std::size_t total) {
+        if (showProgress) {
+            std::fprintf(stderr, "\r%zu/%zu benchmarks", done, total);
+        }
+    });
+    if (showProgress) {
+        std::fprintf(stderr, "\n");
+    }
+    appendBenchRun(file, run);
+
+    std::printf("%s (%s), kernel %s\n\n", run.host.hostname.c_str(), run.host.cpuModel.c_str(),
+                run.host.kernel.c_str());
+    std::printf("%-32s %-7s %10s %10s %10s\n", "metric", "unit", "mean", "min", "max");
+    for (const auto& metric : run.metrics) {
+        double sum = 0.0;
+        for (const double sample : metric.samples) {
+            sum += sample;
+        }
+        const auto [low, high] = std::minmax_element(metric.samples.begin(), metric.samples.end());
+        std::printf("%-32s %-7s %10s %10s %10s\n", metric.name.c_str(), metric.unit.c_str(),
+                    formatValue(sum / static_cast<double>(metric.samples.size())).c_str(),
+                    formatValue(*low).c_str(), formatValue(*high).c_str());
+    }
+    std::printf("\nappended %zu repetitions of %zu metrics to %s\n", options.runs, run.metrics.size(), file.c_str());
+    return 0;
+}
+
+// The newest run with `label` (any label when empty), skipping `skip`
+// matches first.
+const BenchRun& selectRun(const std::vector<BenchRun>& runs, const std::string& label, std::size_t skip,
+                          const std::string& file) {
+    std::size_t matches = 0;
+    for (auto it = runs.rbegin(); it != runs.rend(); ++it) {
+        if ((label.empty() || it->label == label) && matches++ == skip) {
+            return *it;
+        }
+    }
+    const std::string which = skip > 0 ? "second " : "";
+    throw std::runtime_error(file + " has no " + which + (label.empty() ? "run" : "run labelled '" + label + "'"));
+}
+
+std::string describeRun(const BenchRun& run) {
+    return formatTimestamp(run.timestampMs) + (run.label.empty() ? "" : " [" + run.label + "]") + " on " +
+           run.host.hostname;
+}
+
+std::string formatPct(double pct) {
+    return formatFixed(pct, "%+.1f%%");
+}
+
+int runCompareBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"file", "label", "baseline-label", "format"}, {"fail-worse"});
+    const std::string file = cli.value("file", kDefaultResultsFile);
+    const auto& files = cli.positional();
+    if (files.size() > 2) {
+        throw std::runtime_error("usage: statio bench compare [BASELINE-FILE [CANDIDATE-FILE]]");
+    }
+    const std::string baselineFile = files.empty() ? file : files[0];
+    const std::string candidateFile = files.size() < 2 ? file : files[1];
+    const std::string format = cli.value("format", "table");
+    if (format != "table" && format != "csv") {
+        throw std::runtime_error("unknown format '" + format + "' (table, csv)");
+    }
+
+    // Within one file the baseline is the run before the candidate unless
+    // labels pick them apart.
+    const std::string label = cli.value("label");
+    const std::string baselineLabel = cli.value("baseline-label");
+    const std::vector<BenchRun> baselineRuns = readBenchRuns(baselineFile);
+    const std::vector<BenchRun> candidateRuns =
+        candidateFile == baselineFile ? baselineRuns : readBenchRuns(candidateFile);
+    const BenchRun& candidate = selectRun(candidateRuns, label, 0, candidateFile);
+    const bool sameSelection = candidateFile == baselineFile && baselineLabel == label;
+    const BenchRun& baseline = selectRun(baselineRuns, baselineLabel, sameSelection ? 1 : 0, baselineFile);
+    const BenchComparison comparison = compareBenchRuns(baseline, candidate);
+    const bool worse = std::any_of(comparison.metrics.begin(), comparison.metrics.end(),
+                                   [](const MetricComparison& m) { return m.change == BenchChange::Worse; });
+    const int status = cli.has("fail-worse") && worse ? 1 : 0;
+
+    if (format == "csv") {
+        std::cout << "metric,category,unit,higher_is_better,baseline,candidate,delta_pct,ci_low_pct,ci_high_pct,change\n";
+        for (const auto& m : comparison.metrics) {
+            std::cout << m.name << ',' << m.category << ',' << m.unit << ',' << (m.higherIsBetter ? 1 : 0) << ','
+                      << formatFixed(m.baselineMean, "%.6g") << ',' << formatFixed(m.candidateMean, "%.6g") << ','
+                      << formatFixed(m.deltaPct, "%.2f") << ',' << formatFixed(m.ciLowPct, "%.2f") << ','
+                      << formatFixed(m.ciHighPct, "%.2f") << ','
+                      << (m.change == BenchChange::Better ? "better" : m.change == BenchChange::Worse ? "worse" : "")
+                      << '\n';
+        }
+        return status;
+    }
+
+    std::printf("baseline   %s\ncandidate  %s\n", describeRun(baseline).c_str(), describeRun(candidate).c_str());
+    if (!comparison.hostDifferences.empty()) {
+        std::printf("\nhosts differ:\n");
+        for (const auto& difference : comparison.hostDifferences) {
+            std::printf("  %s\n", difference.c_str());
+        }
+    }
+    std::printf("\n%-32s %-7s %10s %10s %8s  %-6s  %s\n", "metric", "unit", "baseline", "candidate", "delta",
+                "change", "95% CI");
+    for (const auto& m : comparison.metrics) {
+        const std::string interval =
+            std::isnan(m.ciLowPct) ? "-" : "[" + formatPct(m.ciLowPct) + ", " + formatPct(m.ciHighPct) + "]";
+        std::printf("%-32s %-7s %10s %10s %8s  %-6s  %s\n", m.name.c_str(), m.unit.c_str(),
+                    formatValue(m.baselineMean).c_str(), formatValue(m.candidateMean).c_str(),
+                    formatPct(m.deltaPct).c_str(),
+                    m.change == BenchChange::Better ? "better" : m.change == BenchChange::Worse ? "worse" : "",
+                    interval.c_str());
+    }
+    if (!comparison.missing.empty()) {
+        std::printf("\nnot compared:\n");
+        for (const auto& name : comparison.missing) {
+            std::printf("  %s\n", name.c_str());
+        }
+    }
+    std::printf("\nscores (baseline = 100)\n");
+    for (const auto& score : comparison.scores) {
+        std::printf("  %-10s %6.1f  (%zu metrics)\n", score.category.c_str(), score.score, score.metrics);
+    }
+    return status;
+}
+
+std::string formatUs(double us) {
+    if (std::isnan(us)) {
+        return "-";
+    }
+    if (us < 10.0) {
+        return formatFixed(us, "%.1f us");
+    }
+    return us < 1000.0 ? formatFixed(us, "%.0f us") : formatFixed(us / 1000.0, "%.1f ms");
+}
+
+int runFsBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"mounts", "dir", "threads", "files", "syncs", "append", "format"}, {"quiet"});
+    FsBenchOptions options;
+    options.mounts = splitList(cli.value("mounts"));
+    options.directory = cli.value("dir");
+    options.threads = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("threads", 4)));
+    options.files = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("files", 1000)));
+    options.syncs = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("syncs", 200)));
+    options.appendBytes = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("append", 4096)));
+    const std::string format = cli.value("format", "table");
+    if (format != "table" && format != "csv") {
+        throw std::runtime_error("unknown format '" + format + "' (table, csv)");
+    }
+
+    const bool showProgress = !cli.has("quiet") && ::isatty(2);
+    const std::vector<FsResult> results = statio::runFsBench(options, [showProgress](std::size_t done, std::size_t total) {
+        if (showProgress) {
+            std::fprintf(stderr, "\r%zu/%zu paths", done, total);
+        }
+    });
+    if (showProgress) {
+        std::fprintf(stderr, "\n");
+    }
+
+    int status = 0;
+    if (format == "csv") {
+        std::cout << "path,filesystem,device,write_cache,create_per_sec,stat_per_sec,rename_per_sec,unlink_per_sec,"
+                     "fsync_p50_us,fsync_p99_us,fsync_max_us,fdatasync_p50_us,fdatasync_p99_us,fdatasync_max_us\n";
+    }
+    for (const auto& r : results) {
+        status = r.error.empty() ? status : 1;
+        if (format == "csv") {
+            std::cout << r.path << ',' << r.filesystem << ',' << r.device << ',' << r.writeCache << ','
+                      << formatFixed(r.createPerSec, "%.0f") << ',' << formatFixed(r.statPerSec, "%.0f") << ','
+                      << formatFixed(r.renamePerSec, "%.0f") << ',' << formatFixed(r.unlinkPerSec, "%.0f");
+            for (const SyncLatency* sync : {&r.fsync, &r.fdatasync}) {
+                const bool have = sync->samples > 0;
+                std::cout << ',' << formatFixed(have ? sync->p50Us : NAN, "%.1f") << ','
+                          << formatFixed(have ? sync->p99Us : NAN, "%.1f") << ','
+                          << formatFixed(have ? sync->maxUs : NAN, "%.1f");
+            }
+            std::cout << '\n';
+            continue;
+        }
+
+        std::printf("%s (%s%s%s%s%s)\n", r.path.c_str(), r.filesystem.empty() ? "unknown fs" : r.filesystem.c_str(),
+                    r.device.empty() ? "" : ", ", r.device.c_str(), r.writeCache.empty() ? "" : ", cache ",
+                    r.writeCache.c_str());
+        std::printf("  ops/s     create %8s  stat %8s  rename %8s  unlink %8s  (%zu threads x %zu files)\n",
+                    formatRate(r.createPerSec).c_str(), formatRate(r.statPerSec).c_str(),
+                    formatRate(r.renamePerSec).c_str(), formatRate(r.unlinkPerSec).c_str(), options.threads,
+                    options.files);
+        const auto printSync = [&options](const char* name, const SyncLatency& sync) {
+            if (sync.samples == 0) {
+                return;
+            }
+            std::printf("  %-9s p50 %8s  p99 %8s  max %8s  (%llu x %zu B appends)\n", name, formatUs(sync.p50Us).c_str(),
+                        formatUs(sync.p99Us).c_str(), formatUs(sync.maxUs).c_str(),
+                        static_cast<unsigned long long>(sync.samples), options.appendBytes);
+        };
+        printSync("fsync", r.fsync);
+        printSync("fdatasync", r.fdatasync);
+        for (const auto& warning : r.warnings) {
+            std::printf("  warning: %s\n", warning.c_str());
+        }
+        if (!r.error.empty()) {
+            std::printf("  error: %s\n", r.error.c_str());
+        }
+    }
+    return status;
+}
+
+int runOsBench(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"tests", "repeats", "cpus", "dir", "format"}, {"quiet"});
+    OsBenchOptions options;
+    options.tests = splitList(cli.value("tests"));
+    options.repeats = static_cast<std::size_t>(std::max<std::int64_t>(0, cli.integer("repeats", 5)));
+    options.cpus = parseCpuList(cli.value("cpus"));
+    options.directory = cli.value("dir");
+    const std::string format = cli.value("format", "table");
+    if (format != "table" && format != "csv") {
+        throw std::runtime_error("unknown format '" + format + "' (table, csv)");
+    }
+
+    const bool showProgress = !cli.has("quiet") && ::isatty(2);
+    const OsBenchResult result = runOsCosts(options, [showProgress](std::size_t done, std::size_t total) {
+        if (showProgress) {
+            std::fprintf(stderr, "\r%zu/%zu tests", done, total);
+        }
+    });
+    if (showProgress) {
+        std::fprintf(stderr, "\n");
+    }
+
+    const std::string hypervisor = result.hypervisor.empty() ? "none" : result.hypervisor;
+    if (format == "csv") {
+        std::cout << "kernel,hypervisor,test,median_ns,min_ns,operations\n";
+        for (const auto& cost : result.costs) {
+            std::cout << result.os.kernel << ',' << hypervisor << ',' << cost.test << ',' << formatNs(cost.medianNs) << ','
+                      << formatNs(cost.minNs) << ',' << cost.operations << '\n';
+        }
+        return 0;
+    }
+
+    std::printf("kernel %s (%s), hypervisor %s\n", result.os.kernel.c_str(), result.os.architecture.c_str(),
+                hypervisor.c_str());
+    for (const auto& mitigation : result.mitigations) {
+        if (mitigation.second != "Not affected") {
+            std::printf("  %-26s %s\n", mitigation.first.c_str(), mitigation.second.c_str());
+        }
+    }
+    std::printf("\n%-15s %10s %10s  %s\n", "test", "median ns", "best ns", "per operation");
+    for (const auto& cost : result.costs) {
+        std::printf("%-15s %10s %10s  %s\n", cost.test.c_str(), formatNs(cost.medianNs).c_str(),
+                    formatNs(cost.minNs).c_str(), cost.note.c_str());
+    }
+    return 0;
+}
+
+} // namespace
+
+int runBenchCommand(const std::vector<std::string>& args) {
+    static const std::map<std::string, BenchHandler> benches = {
+        {"alloc", runAllocBench},
+        {"c2c", runC2cBench},
+        {"compare", runCompareBench},
+        {"contention", runContentionBench},
+        {"crypto", runCryptoBench},
+        {"files", runFilesBench},
+        {"procscan", runProcScanBench},
+        {"fs", runFsBench},
+        {"net", runNetBench},
+        {"os", runOsBench},
+        {"record", runRecordBench},
+        {"tlb", runTlbBench},
+        {"wakeup", runWakeupBench},
+    };
+    if (args.empty()) {
+        printBenchUsage();
+        return 2;
+    }
+    auto it = benches.find(args.front());
+    if (it == benches.end()) {
+        printBenchUsage();
+        return args.front() == "help" || args.front() == "--help" ? 0 : 2;
+    }
+    return it->second(std::vector<std::string>(args.begin() + 1, args.end()));
+}
+
+} // namespace statio
@@ -0,0 +1,317 @@
+#include "statio/bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace statio {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::uint64_t kBatch = 64; // operations between checks of the stop flag
+
+// Every contended word on its own line, so that the primitives do not
+// false-share with each other or with the control flags.
+struct alignas(64) Line {
+    std::atomic<std::uint64_t> value{0};
+};
+
+struct Shared {
+    Line counter;
+    Line lock;
+    alignas(64) std::mutex mutex;
+    std::uint64_t guarded = 0;
+    alignas(64) std::atomic<bool> stopping{false};
+    std::atomic<bool> go{false};
+    std::atomic<std::size_t> ready{0};
+    std::atomic<int> failedCpu{-1};
+};
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Test-and-test-and-set. Yields now and then only so that threads sharing
+// a CPU (a repeated --cpus entry) cannot starve the holder.
+void spinLock(std::atomic<std::uint64_t>& lock) {
+    unsigned spins = 0;
+    for (;;) {
+        if (lock.exchange(1, std::memory_order_acquire) == 0) {
+            return;
+        }
+        while (lock.load(std::memory_order_relaxed) != 0) {
+            cpuRelax();
+            if (++spins == (1U << 16)) {
+                std::this_thread::yield();
+                spins = 0;
+            }
+        }
+    }
+}
+
+template <typename Op>
+std::uint64_t hammer(const Shared& shared, Op&& op) {
+    std::uint64_t ops = 0;
+    while (!shared.stopping.load(std::memory_order_relaxed)) {
+        for (std::uint64_t i = 0; i < kBatch; ++i) {
+            op();
+        }
+        ops += kBatch;
+    }
+    return ops;
+}
+
+std::uint64_t runPrimitive(SyncPrimitive primitive, Shared& shared, Line& shard) {
+    switch (primitive) {
+    case SyncPrimitive::FetchAdd:
+        return hammer(shared, [&shared] { shared.counter.value.fetch_add(1, std::memory_order_relaxed); });
+    case SyncPrimitive::Cas:
+        return hammer(shared, [&shared] {
+            std::uint64_t seen = shared.counter.value.load(std::memory_order_relaxed);
+            while (!shared.counter.value.compare_exchange_weak(seen, seen + 1, std::memory_order_relaxed)) {
+            }
+        });
+    case SyncPrimitive::Mutex:
+        return hammer(shared, [&shared] {
+            std::lock_guard<std::mutex> hold(shared.mutex);
+            ++shared.guarded;
+        });
+    case SyncPrimitive::Spinlock:
+        return hammer(shared, [&shared] {
+            spinLock(shared.lock.value);
+            ++shared.guarded;
+            shared.lock.value.store(0, std::memory_order_release);
+        });
+    case SyncPrimitive::Sharded:
+        return hammer(shared, [&shard] { shard.value.fetch_add(1, std::memory_order_relaxed); });
+    }
+    return 0;
+}
+
+// Runs one primitive on `cpus` for `durationMs`; returns Mops/s and fairness.
+std::pair<double, double> measurePoint(SyncPrimitive primitive, const std::vector<int>& cpus, std::int64_t durationMs) {
+    Shared shared;
+    std::unique_ptr<Line[]> shards(new Line[cpus.size()]);
+    std::vector<std::uint64_t> ops(cpus.size(), 0);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < cpus.size(); ++i) {
+        threads.emplace_back([&, i] {
+            if (!pinCurrentThread(cpus[i])) {
+                shared.failedCpu = cpus[i];
+            }
+            shared.ready.fetch_add(1);
+            while (!shared.go.load()) {
+                std::this_thread::yield();
+            }
+            if (shared.failedCpu.load() < 0) {
+                ops[i] = runPrimitive(primitive, shared, shards[i]);
+            }
+        });
+    }
+    while (shared.ready.load() < cpus.size()) {
+        std::this_thread::yield();
+    }
+    const auto started = Clock::now();
+    shared.go = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+    shared.stopping = true;
+    const double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (shared.failedCpu.load() >= 0) {
+        throw std::runtime_error("cannot pin a thread to cpu " + std::to_string(shared.failedCpu.load()));
+    }
+
+    std::uint64_t total = 0;
+    for (const std::uint64_t count : ops) {
+        total += count;
+    }
+    const auto [slowest, fastest] = std::minmax_element(ops.begin(), ops.end());
+    const double fairness = *fastest == 0 ? 0.0 : static_cast<double>(*slowest) / static_cast<double>(*fastest);
+    return {static_cast<double>(total) / seconds / 1e6, fairness};
+}
+
+// Position of each CPU among the SMT siblings of its core: 0 for the first.
+std::map<int, std::size_t> siblingRanks(const std::vector<CpuPlacement>& topology) {
+    std::map<int, std::size_t> perCore;
+    std::map<int, std::size_t> ranks;
+    for (const auto& placement : topology) {
+        ranks[placement.cpu] = perCore[placement.core]++;
+    }
+    return ranks;
+}
+
+// CPU order for a placement, or an empty list plus the reason it does not
+// apply to this host.
+std::vector<CpuPlacement> placementOrder(const std::string& name, const std::vector<CpuPlacement>& topology,
+                                         std::string& reason) {
+    const std::map<int, std::size_t> ranks = siblingRanks(topology);
+    const bool smt = std::any_of(ranks.begin(), ranks.end(), [](const auto& rank) { return rank.second > 0; });
+    std::vector<CpuPlacement> order;
+    if (name == "smt" || name == "socket") {
+        if (name == "smt" && !smt) {
+            reason = "no SMT siblings";
+            return {};
+        }
+        const int package = topology.front().package;
+        std::copy_if(topology.begin(), topology.end(), std::back_inserter(order),
+                     [package](const CpuPlacement& p) { return p.package == package; });
+        std::stable_sort(order.begin(), order.end(), [&](const CpuPlacement& a, const CpuPlacement& b) {
+            if (name == "smt") {
+                return a.core < b.core;
+            }
+            return ranks.at(a.cpu) < ranks.at(b.cpu);
+        });
+        return order;
+    }
+    if (name == "cross") {
+        std::map<int, std::vector<CpuPlacement>> packages;
+        for (const auto& placement : topology) {
+            if (ranks.at(placement.cpu) == 0) {
+                packages[placement.package].push_back(placement);
+            }
+        }
+        if (packages.size() < 2) {
+            reason = "single package";
+            return {};
+        }
+        for (std::size_t i = 0;; ++i) {
+            const std::size_t before = order.size();
+            for (const auto& package : packages) {
+                if (i < package.second.size()) {
+                    order.push_back(package.second[i]);
+                }
+            }
+            if (order.size() == before) {
+                break;
+            }
+        }
+        return order;
+    }
+    throw std::runtime_error("unknown placement '" + name + "' (smt, socket, cross)");
+}
+
+std::vector<std::size_t> defaultThreadCounts(std::size_t available) {
+    std::vector<std::size_t> counts;
+    for (std::size_t n = 1; n <= available; n = n < 4 ? n + 1 : n * 2) {
+        counts.push_back(n);
+    }
+    if (counts.empty() || counts.back() != available) {
+        counts.push_back(available);
+    }
+    return counts;
+}
+
+CpuRelation widestRelation(const std::vector<CpuPlacement>& cpus) {
+    CpuRelation widest = CpuRelation::Same;
+    for (std::size_t a = 0; a < cpus.size(); ++a) {
+        for (std::size_t b = a + 1; b < cpus.size(); ++b) {
+            widest = std::max(widest, cpuRelation(cpus[a], cpus[b]));
+        }
+    }
+    return widest;
+}
+
+} // namespace
+
+const char* syncPrimitiveName(SyncPrimitive primitive) {
+    switch (primitive) {
+    case SyncPrimitive::FetchAdd:
+        return "fetch-add";
+    case SyncPrimitive::Cas:
+        return "cas";
+    case SyncPrimitive::Mutex:
+        return "mutex";
+    case SyncPrimitive::Spinlock:
+        return "spinlock";
+    case SyncPrimitive::Sharded:
+        return "sharded";
+    }
+    return "?";
+}
+
+ContentionResult runContention(const ContentionOptions& options,
+                               const std::function<void(std::size_t done, std::size_t total)>& progress) {
+    if (options.durationMs <= 0) {
+        throw std::runtime_error("--duration must be positive");
+    }
+    const std::vector<CpuPlacement> topology = readCpuTopology();
+    if (topology.empty()) {
+        throw std::runtime_error("no usable CPU in this process's affinity");
+    }
+
+    ContentionResult result;
+    std::vector<std::pair<std::string, std::vector<CpuPlacement>>> curves;
+    if (!options.cpus.empty()) {
+        std::vector<CpuPlacement> order;
+        for (const int cpu : options.cpus) {
+            auto it = std::find_if(topology.begin(), topology.end(), [cpu](const CpuPlacement& p) { return p.cpu == cpu; });
+            if (it == topology.end()) {
+                throw std::runtime_error("cpu " + std::to_string(cpu) + " is offline or outside this process's affinity");
+            }
+            order.push_back(*it);
+        }
+        curves.emplace_back("custom", std::move(order));
+    } else {
+        const std::vector<std::string> names =
+            options.placements.empty() ? std::vector<std::string>{"smt", "socket", "cross"} : options.placements;
+        for (const auto& name : names) {
+            std::string reason;
+            std::vector<CpuPlacement> order = placementOrder(name, topology, reason);
+            if (order.empty()) {
+                result.skipped.push_back(name + ": " + reason);
+                continue;
+            }
+            curves.emplace_back(name, std::move(order));
+        }
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> plan; // (curve, threads)
+    for (std::size_t c = 0; c < curves.size(); ++c) {
+        const std::size_t available = curves[c].second.size();
+        for (const std::size_t n : options.threads.empty() ? defaultThreadCounts(available) : options.threads) {
+            if (n == 0) {
+                throw std::runtime_error("--threads counts must be positive");
+            }
+            if (n <= available) {
+                plan.emplace_back(c, n);
+            }
+        }
+    }
+
+    for (const auto& [curve, n] : plan) {
+        const std::vector<CpuPlacement> placed(curves[curve].second.begin(), curves[curve].second.begin() + n);
+        std::vector<int> cpus;
+        for (const auto& placement : placed) {
+            cpus.push_back(placement.cpu);
+        }
+        ContentionPoint point;
+        point.placement = curves[curve].first;
+        point.threads = n;
+        point.widest = widestRelation(placed);
+        for (std::size_t p = 0; p < kSyncPrimitiveCount; ++p) {
+            const auto measured = measurePoint(static_cast<SyncPrimitive>(p), cpus, options.durationMs);
+            point.mopsPerSec[p] = measured.first;
+            point.fairness[p] = measured.second;
+        }
+        result.points.push_back(point);
+        if (progress) {
+            progress(result.points.size(), plan.size());
+        }
+    }
+    return result;
+}
+
+} // namespace statio
@@ -0,0 +1,684 @@
+#include "statio/bench.hpp"
+
+#include "statio/lz.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <arm_neon.h>
+#endif
+
+namespace statio {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t kBufferBytes = 1U << 20;
+
+// ---- AES-128 -------------------------------------------------------------
+
+constexpr std::uint8_t kSbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+// The eleven round keys in FIPS-197 byte order, which is also what
+// AESENC and AESE expect.
+struct AesKey {
+    std::array<std::uint8_t, 176> roundKeys {};
+};
+
+std::uint8_t xtime(std::uint8_t x) {
+    return static_cast<std::uint8_t>((x << 1) ^ ((x >> 7) * 0x1b));
+}
+
+AesKey expandAesKey(const std::uint8_t key[16]) {
+    AesKey expanded;
+    std::uint8_t* rk = expanded.roundKeys.data();
+    std::memcpy(rk, key, 16);
+    std::uint8_t rcon = 1;
+    for (std::size_t i = 16; i < 176; i += 4) {
+        std::uint8_t t[4] = {rk[i - 4], rk[i - 3], rk[i - 2], rk[i - 1]};
+        if (i % 16 == 0) {
+            const std::uint8_t first = t[0];
+            t[0] = static_cast<std::uint8_t>(kSbox[t[1]] ^ rcon);
+            t[1] = kSbox[t[2]];
+            t[2] = kSbox[t[3]];
+            t[3] = kSbox[first];
+            rcon = xtime(rcon);
+        }
+        for (std::size_t j = 0; j < 4; ++j) {
+            rk[i + j] = static_cast<std::uint8_t>(rk[i - 16 + j] ^ t[j]);
+        }
+    }
+    return expanded;
+}
+
+// Byte-wise reference: no tables beyond the S-box, constant work per block.
+void aesEncryptBlock(const AesKey& key, const std::uint8_t in[16], std::uint8_t out[16]) {
+    const std::uint8_t* rk = key.roundKeys.data();
+    std::uint8_t s[16];
+    for (std::size_t i = 0; i < 16; ++i) {
+        s[i] = static_cast<std::uint8_t>(in[i] ^ rk[i]);
+    }
+    for (std::size_t round = 1; round <= 10; ++round) {
+        std::uint8_t t[16];
+        for (std::size_t c = 0; c < 4; ++c) {
+            for (std::size_t r = 0; r < 4; ++r) {
+                t[r + 4 * c] = kSbox[s[r + 4 * ((c + r) % 4)]]; // SubBytes + ShiftRows
+            }
+        }
+        if (round != 10) {
+            for (std::size_t c = 0; c < 4; ++c) {
+                std::uint8_t* col = t + 4 * c;
+                const std::uint8_t all = static_cast<std::uint8_t>(col[0] ^ col[1] ^ col[2] ^ col[3]);
+                const std::uint8_t first = col[0];
+                col[0] = static_cast<std::uint8_t>(col[0] ^ all ^ xtime(static_cast<std::uint8_t>(col[0] ^ col[1])));
+                col[1] = static_cast<std::uint8_t>(col[1] ^ all ^ xtime(static_cast<std::uint8_t>(col[1] ^ col[2])));
+                col[2] = static_cast<std::uint8_t>(col[2] ^ all ^ xtime(static_cast<std::uint8_t>(col[2] ^ col[3])));
+                col[3] = static_cast<std::uint8_t>(col[3] ^ all ^ xtime(static_cast<std::uint8_t>(col[3] ^ first)));
+            }
+        }
+        for (std::size_t i = 0; i < 16; ++i) {
+            s[i] = static_cast<std::uint8_t>(t[i] ^ rk[16 * round + i]);
+        }
+    }
+    std::memcpy(out, s, 16);
+}
+
+std::uint64_t loadBigEndian64(const std::uint8_t* p) {
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < 8; ++i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+void storeBigEndian64(std::uint8_t* p, std::uint64_t value) {
+    for (std::size_t i = 0; i < 8; ++i) {
+        p[7 - i] = static_cast<std::uint8_t>(value >> (8 * i));
+    }
+}
+
+// CTR mode: the IV is an 8-byte nonce and a 64-bit big-endian counter.
+using AesCtr = void (*)(const AesKey&, const std::uint8_t iv[16], const std::uint8_t* in, std::uint8_t* out,
+                        std::size_t n);
+
+void aesCtrPortable(const AesKey& key, const std::uint8_t iv[16], const std::uint8_t* in, std::uint8_t* out,
+                    std::size_t n) {
+    std::uint8_t block[16];
+    std::memcpy(block, iv, 16);
+    std::uint64_t counter = loadBigEndian64(iv + 8);
+    for (std::size_t offset = 0; offset < n; offset += 16) {
+        std::uint8_t stream[16];
+        aesEncryptBlock(key, block, stream);
+        const std::size_t length = std::min<std::size_t>(16, n - offset);
+        for (std::size_t i = 0; i < length; ++i) {
+            out[offset + i] = static_cast<std::uint8_t>(in[offset + i] ^ stream[i]);
+        }
+        storeBigEndian64(block + 8, ++counter);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Eight independent blocks in flight hide the AESENC latency.
+__attribute__((target("aes"))) void aesCtrNi(const AesKey& key, const std::uint8_t iv[16], const std::uint8_t* in,
+                                             std::uint8_t* out, std::size_t n) {
+    __m128i rk[11];
+    for (std::size_t i = 0; i < 11; ++i) {
+        rk[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key.roundKeys.data() + 16 * i));
+    }
+    long long nonce = 0;
+    std::memcpy(&nonce, iv, 8);
+    std::uint64_t counter = loadBigEndian64(iv + 8);
+    std::size_t offset = 0;
+    for (; offset + 128 <= n; offset += 128, counter += 8) {
+        __m128i b[8];
+        for (std::size_t i = 0; i < 8; ++i) {
+            b[i] = _mm_xor_si128(_mm_set_epi64x(static_cast<long long>(__builtin_bswap64(counter + i)), nonce), rk[0]);
+        }
+        for (std::size_t r = 1; r < 10; ++r) {
+            for (std::size_t i = 0; i < 8; ++i) {
+                b[i] = _mm_aesenc_si128(b[i], rk[r]);
+            }
+        }
+        for (std::size_t i = 0; i < 8; ++i) {
+            b[i] = _mm_aesenclast_si128(b[i], rk[10]);
+            const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + offset + 16 * i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + offset + 16 * i), _mm_xor_si128(b[i], data));
+        }
+    }
+    for (; offset < n; offset += 16, ++counter) {
+        __m128i b = _mm_xor_si128(_mm_set_epi64x(static_cast<long long>(__builtin_bswap64(counter)), nonce), rk[0]);
+        for (std::size_t r = 1; r < 10; ++r) {
+            b = _mm_aesenc_si128(b, rk[r]);
+        }
+        std::uint8_t stream[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(stream), _mm_aesenclast_si128(b, rk[10]));
+        const std::size_t length = std::min<std::size_t>(16, n - offset);
+        for (std::size_t i = 0; i < length; ++i) {
+            out[offset + i] = static_cast<std::uint8_t>(in[offset + i] ^ stream[i]);
+        }
+    }
+}
+#elif defined(__aarch64__)
+__attribute__((target("+crypto"))) void aesCtrArm(const AesKey& key, const std::uint8_t iv[16],
+                                                   const std::uint8_t* in, std::uint8_t* out, std::size_t n) {
+    uint8x16_t rk[11];
+    for (std::size_t i = 0; i < 11; ++i) {
+        rk[i] = vld1q_u8(key.roundKeys.data() + 16 * i);
+    }
+    std::uint8_t block[16];
+    std::memcpy(block, iv, 16);
+    std::uint64_t counter = loadBigEndian64(iv + 8);
+    for (std::size_t offset = 0; offset < n; offset += 16) {
+        uint8x16_t s = vld1q_u8(block);
+        for (std::size_t r = 0; r < 9; ++r) {
+            s = vaesmcq_u8(vaeseq_u8(s, rk[r]));
+        }
+        s = veorq_u8(vaeseq_u8(s, rk[9]), rk[10]);
+        if (n - offset >= 16) {
+            vst1q_u8(out + offset, veorq_u8(s, vld1q_u8(in + offset)));
+        } else {
+            std::uint8_t stream[16];
+            vst1q_u8(stream, s);
+            for (std::size_t i = 0; i < n - offset; ++i) {
+                out[offset + i] = static_cast<std::uint8_t>(in[offset + i] ^ stream[i]);
+            }
+        }
+        storeBigEndian64(block + 8, ++counter);
+    }
+}
+#endif
+
+// ---- SHA-256 -------------------------------------------------------------
+
+constexpr std::uint32_t kSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+constexpr std::uint32_t kSha256Initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+// Compresses `blocks` whole 64-byte blocks into `state`.
+using Sha256Blocks = void (*)(std::uint32_t state[8], const std::uint8_t* data, std::size_t blocks);
+
+std::uint32_t rotr(std::uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+void sha256Portable(std::uint32_t state[8], const std::uint8_t* data, std::size_t blocks) {
+    for (std::size_t block = 0; block < blocks; ++block, data += 64) {
+        std::uint32_t w[64];
+        for (std::size_t i = 0; i < 16; ++i) {
+            w[i] = (static_cast<std::uint32_t>(data[4 * i]) << 24) | (static_cast<std::uint32_t>(data[4 * i + 1]) << 16) |
+                   (static_cast<std::uint32_t>(data[4 * i + 2]) << 8) | data[4 * i + 3];
+        }
+        for (std::size_t i = 16; i < 64; ++i) {
+            const std::uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const std::uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        std::uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (std::size_t i = 0; i < 64; ++i) {
+            const std::uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + kSha256K[i] + w[i];
+            const std::uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// SHA-NI keeps the state as ABEF/CDGH halves and runs four rounds per
+// group, two per SHA256RNDS2. The message schedule for group g+1 is
+// finished (MSG2) while group g runs and started (MSG1) one group earlier.
+__attribute__((target("sha,sse4.1,ssse3"))) void sha256Ni(std::uint32_t state[8], const std::uint8_t* data,
+                                                          std::size_t blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1); // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);       // CDGH
+
+    for (std::size_t block = 0; block < blocks; ++block, data += 64) {
+        const __m128i abefSave = state0;
+        const __m128i cdghSave = state1;
+        __m128i w[4];
+        for (std::size_t g = 0; g < 16; ++g) {
+            if (g < 4) {
+                w[g] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * g)), mask);
+            }
+            __m128i msg = _mm_add_epi32(w[g % 4], _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[4 * g])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (g >= 3 && g <= 14) {
+                __m128i& next = w[(g + 1) % 4];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(w[g % 4], w[(g + 3) % 4], 4));
+                next = _mm_sha256msg2_epu32(next, w[g % 4]);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            if (g >= 1 && g <= 12) {
+                w[(g + 3) % 4] = _mm_sha256msg1_epu32(w[(g + 3) % 4], w[g % 4]);
+            }
+        }
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);      // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);   // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0); // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);    // ABEF
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+#endif
+
+std::array<std::uint8_t, 32> sha256Digest(Sha256Blocks compress, const std::uint8_t* data, std::size_t n) {
+    std::uint32_t state[8];
+    std::memcpy(state, kSha256Initial, sizeof(state));
+    compress(state, data, n / 64);
+    std::uint8_t tail[128] = {};
+    const std::size_t rest = n % 64;
+    std::memcpy(tail, data + n - rest, rest);
+    tail[rest] = 0x80;
+    const std::size_t tailBytes = rest < 56 ? 64 : 128;
+    storeBigEndian64(tail + tailBytes - 8, static_cast<std::uint64_t>(n) * 8);
+    compress(state, tail, tailBytes / 64);
+    std::array<std::uint8_t, 32> digest {};
+    for (std::size_t i = 0; i < 8; ++i) {
+        for (std::size_t j = 0; j < 4; ++j) {
+            digest[4 * i + j] = static_cast<std::uint8_t>(state[i] >> (24 - 8 * j));
+        }
+    }
+    return digest;
+}
+
+// ---- CRC32C --------------------------------------------------------------
+
+using Crc32c = std::uint32_t (*)(const std::uint8_t* data, std::size_t n);
+
+std::uint32_t crc32cPortable(const std::uint8_t* data, std::size_t n) {
+    static const std::array<std::uint32_t, 256> table = [] {
+        std::array<std::uint32_t, 256> t {};
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c >> 1) ^ ((c & 1) ? 0x82f63b78U : 0U);
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    std::uint32_t crc = 0xffffffffU;
+    for (std::size_t i = 0; i < n; ++i) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) std::uint32_t crc32cSse42(const std::uint8_t* data, std::size_t n) {
+    std::uint64_t crc = 0xffffffffU;
+    for (; n >= 8; n -= 8, data += 8) {
+        std::uint64_t word = 0;
+        std::memcpy(&word, data, 8);
+        crc = _mm_crc32_u64(crc, word);
+    }
+    auto crc32 = static_cast<std::uint32_t>(crc);
+    for (; n > 0; --n, ++data) {
+        crc32 = _mm_crc32_u8(crc32, *data);
+    }
+    return ~crc32;
+}
+#elif defined(__aarch64__)
+__attribute__((target("+crc"))) std::uint32_t crc32cArm(const std::uint8_t* data, std::size_t n) {
+    std::uint32_t crc = 0xffffffffU;
+    for (; n >= 8; n -= 8, data += 8) {
+        std::uint64_t word = 0;
+        std::memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+    }
+    for (; n > 0; --n, ++data) {
+        crc = __crc32cb(crc, *data);
+    }
+    return ~crc;
+}
+#endif
+
+// ---- Dispatch table ------------------------------------------------------
+
+// One thread's buffers. `input` is what every run consumes; throughput is
+// counted in its bytes for every algorithm, decompression included.
+struct Work {
+    std::vector<std::uint8_t> input;
+    std::vector<std::uint8_t> output;
+    std::string compressed;
+    std::string scratch;
+};
+
+struct Implementation {
+    const char* algorithm;
+    const char* name;
+    const char* flag; // nullptr for portable code
+    AesCtr aes = nullptr;
+    Sha256Blocks sha = nullptr;
+    Crc32c crc = nullptr;
+    bool lzCompress = false;
+    bool lzDecompress = false;
+};
+
+const std::vector<Implementation>& implementations() {
+    static const std::vector<Implementation> table = {
+#if defined(__x86_64__) || defined(__i386__)
+        {"aes-128-ctr", "aes-ni", "aes", aesCtrNi},
+#elif defined(__aarch64__)
+        {"aes-128-ctr", "armv8-aes", "aes", aesCtrArm},
+#endif
+        {"aes-128-ctr", "portable", nullptr, aesCtrPortable},
+#if defined(__x86_64__) || defined(__i386__)
+        {"sha-256", "sha-ni", "sha_ni", nullptr, sha256Ni},
+#endif
+        {"sha-256", "portable", nullptr, nullptr, sha256Portable},
+#if defined(__x86_64__)
+        {"crc32c", "sse4.2", "sse4_2", nullptr, nullptr, crc32cSse42},
+#elif defined(__aarch64__)
+        {"crc32c", "armv8-crc", "crc32", nullptr, nullptr, crc32cArm},
+#endif
+        {"crc32c", "portable", nullptr, nullptr, nullptr, crc32cPortable},
+        {"lz-compress", "portable", nullptr, nullptr, nullptr, nullptr, true, false},
+        {"lz-decompress", "portable", nullptr, nullptr, nullptr, nullptr, false, true},
+    };
+    return table;
+}
+
+// Which --algorithms name selects an implementation.
+std::string familyOf(const Implementation& impl) {
+    const std::string algorithm = impl.algorithm;
+    if (algorithm.rfind("aes", 0) == 0) {
+        return "aes";
+    }
+    if (algorithm.rfind("sha", 0) == 0) {
+        return "sha256";
+    }
+    return algorithm.rfind("lz", 0) == 0 ? "lz" : algorithm;
+}
+
+std::vector<std::uint8_t> randomBytes(std::size_t n, std::uint64_t seed) {
+    std::vector<std::uint8_t> bytes(n);
+    std::uint64_t x = seed | 1;
+    for (auto& byte : bytes) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        byte = static_cast<std::uint8_t>(x >> 24);
+    }
+    return bytes;
+}
+
+// Metric-style text, the kind of data the history store compresses.
+std::vector<std::uint8_t> metricText(std::size_t n) {
+    static const char* const names[] = {"cpu.user", "cpu.system", "disk.read_bytes", "net.rx_bytes", "mem.available_mb"};
+    std::string text;
+    std::uint64_t x = 0x2545f4914f6cdd1dULL;
+    while (text.size() < n) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        text += names[x % 5];
+        text += "{entity=\"dev" + std::to_string((x >> 8) % 8) + "\"} " + std::to_string((x >> 16) % 100000) + "\n";
+    }
+    text.resize(n);
+    return std::vector<std::uint8_t>(text.begin(), text.end());
+}
+
+const AesKey& benchKey() {
+    static const AesKey key = [] {
+        std::uint8_t raw[16];
+        for (std::uint8_t i = 0; i < 16; ++i) {
+            raw[i] = i;
+        }
+        return expandAesKey(raw);
+    }();
+    return key;
+}
+
+std::unique_ptr<Work> makeWork(const Implementation& impl) {
+    auto work = std::make_unique<Work>();
+    if (impl.lzCompress || impl.lzDecompress) {
+        work->input = metricText(kBufferBytes);
+        lzCompress(std::string_view(reinterpret_cast<const char*>(work->input.data()), work->input.size()),
+                   work->compressed);
+    } else {
+        work->input = randomBytes(kBufferBytes, 0x9e3779b97f4a7c15ULL);
+    }
+    work->output.resize(work->input.size());
+    return work;
+}
+
+std::uint64_t runOnce(const Implementation& impl, Work& work) {
+    static const std::uint8_t iv[16] = {};
+    if (impl.aes != nullptr) {
+        impl.aes(benchKey(), iv, work.input.data(), work.output.data(), work.input.size());
+        return work.output[work.output.size() - 1];
+    }
+    if (impl.sha != nullptr) {
+        std::uint32_t state[8];
+        std::memcpy(state, kSha256Initial, sizeof(state));
+        impl.sha(state, work.input.data(), work.input.size() / 64);
+        return state[0];
+    }
+    if (impl.crc != nullptr) {
+        return impl.crc(work.input.data(), work.input.size());
+    }
+    work.scratch.clear();
+    if (impl.lzCompress) {
+        lzCompress(std::string_view(reinterpret_cast<const char*>(work.input.data()), work.input.size()), work.scratch);
+    } else {
+        lzDecompress(work.compressed, work.input.size(), work.scratch);
+    }
+    return work.scratch.size();
+}
+
+// Known answers (FIPS-197 C.1, FIPS-180 "abc", the CRC32C check value)
+// plus agreement with the portable code on an odd-sized random buffer.
+bool selfTest(const Implementation& impl) {
+    const std::vector<std::uint8_t> random = randomBytes(1000, 42);
+    if (impl.aes != nullptr) {
+        std::uint8_t key[16];
+        for (std::uint8_t i = 0; i < 16; ++i) {
+            key[i] = i;
+        }
+        const std::uint8_t iv[16] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                                     0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+        const std::uint8_t expected[16] = {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+                                           0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a};
+        const std::uint8_t zeros[16] = {};
+        std::uint8_t out[16];
+        impl.aes(expandAesKey(key), iv, zeros, out, 16);
+        std::vector<std::uint8_t> mine(random.size());
+        std::vector<std::uint8_t> reference(random.size());
+        impl.aes(benchKey(), iv, random.data(), mine.data(), random.size());
+        aesCtrPortable(benchKey(), iv, random.data(), reference.data(), random.size());
+        return std::memcmp(out, expected, 16) == 0 && mine == reference;
+    }
+    if (impl.sha != nullptr) {
+        const std::array<std::uint8_t, 32> expected = {
+            0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+            0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+        };
+        const std::uint8_t abc[3] = {'a', 'b', 'c'};
+        return sha256Digest(impl.sha, abc, 3) == expected &&
+               sha256Digest(impl.sha, random.data(), random.size()) ==
+                   sha256Digest(sha256Portable, random.data(), random.size());
+    }
+    if (impl.crc != nullptr) {
+        const std::uint8_t check[9] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+        return impl.crc(check, 9) == 0xe3069283U &&
+               impl.crc(random.data(), random.size()) == crc32cPortable(random.data(), random.size());
+    }
+    const std::vector<std::uint8_t> text = metricText(4096);
+    std::string packed;
+    std::string unpacked;
+    lzCompress(std::string_view(reinterpret_cast<const char*>(text.data()), text.size()), packed);
+    lzDecompress(packed, text.size(), unpacked);
+    return unpacked == std::string(text.begin(), text.end());
+}
+
+// Runs `impl` on `cpus.size()` pinned threads for `durationMs`; GB/s.
+double throughput(const Implementation& impl, const std::vector<int>& cpus, std::int64_t durationMs) {
+    std::vector<std::unique_ptr<Work>> works;
+    for (std::size_t i = 0; i < cpus.size(); ++i) {
+        works.push_back(makeWork(impl));
+    }
+    std::atomic<std::size_t> ready{0};
+    std::atomic<bool> go{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::uint64_t> sink{0};
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < cpus.size(); ++i) {
+        threads.emplace_back([&, i] {
+            pinCurrentThread(cpus[i]);
+            ready.fetch_add(1);
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            Work& work = *works[i];
+            std::uint64_t done = 0;
+            std::uint64_t folded = 0;
+            while (!stopping.load(std::memory_order_relaxed)) {
+                folded ^= runOnce(impl, work);
+                done += work.input.size();
+            }
+            bytes.fetch_add(done);
+            sink.fetch_xor(folded);
+        });
+    }
+    while (ready.load() < cpus.size()) {
+        std::this_thread::yield();
+    }
+    const auto started = Clock::now();
+    go = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+    stopping = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // Threads finish the buffer they are on, so time the whole run.
+    const double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    return static_cast<double>(bytes.load()) / seconds / 1e9;
+}
+
+} // namespace
+
+std::vector<CryptoResult> runCryptoBench(const CryptoOptions& options,
+                                         const std::function<void(std::size_t done, std::size_t total)>& progress) {
+    if (options.durationMs <= 0) {
+        throw std::runtime_error("--duration must be positive");
+    }
+    for (const auto& name : options.algorithms) {
+        if (name != "aes" && name != "sha256" && name != "crc32c" && name != "lz") {
+            throw std::runtime_error("unknown algorithm '" + name + "' (aes, sha256, crc32c, lz)");
+        }
+    }
+    const std::vector<CpuPlacement> topology = readCpuTopology();
+    if (topology.empty()) {
+        throw std::runtime_error("no usable CPU in this process's affinity");
+    }
+    const std::size_t threads = options.threads == 0 ? topology.size() : options.threads;
+    std::vector<int> cpus;
+    for (std::size_t i = 0; i < threads; ++i) {
+        cpus.push_back(topology[i % topology.size()].cpu);
+    }
+
+    const CpuInfo cpu = collectCpuInfo(SourceCpuInfo);
+    std::vector<const Implementation*> selected;
+    for (const auto& impl : implementations()) {
+        if (options.algorithms.empty() ||
+            std::find(options.algorithms.begin(), options.algorithms.end(), familyOf(impl)) != options.algorithms.end()) {
+            selected.push_back(&impl);
+        }
+    }
+
+    std::vector<CryptoResult> results;
+    for (const Implementation* impl : selected) {
+        CryptoResult result;
+        result.algorithm = impl->algorithm;
+        result.implementation = impl->name;
+        result.flag = impl->flag == nullptr ? "" : impl->flag;
+        result.threads = threads;
+        result.supported = impl->flag == nullptr || cpuHasFlag(cpu, impl->flag);
+        if (!result.supported) {
+            result.note = std::string("cpu lacks the ") + impl->flag + " flag";
+        } else {
+            if (!selfTest(*impl)) {
+                throw std::runtime_error(std::string(impl->algorithm) + " (" + impl->name + ") failed its self-test");
+            }
+            result.singleGBps = throughput(*impl, {cpus.front()}, options.durationMs);
+            result.multiGBps = threads > 1 ? throughput(*impl, cpus, options.durationMs) : result.singleGBps;
+            if (impl->lzCompress || impl->lzDecompress) {
+                const auto work = makeWork(*impl);
+                char buffer[48];
+                std::snprintf(buffer, sizeof(buffer), "metric text, ratio %.1f:1",
+                              static_cast<double>(work->input.size()) / static_cast<double>(work->compressed.size()));
+                result.note = buffer;
+            }
+        }
+        results.push_back(result);
+        if (progress) {
+            progress(results.size(), selected.size());
+        }
+    }
+    return results;
+}
+
+} // namespace statio
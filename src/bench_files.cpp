@@ -0,0 +1,247 @@
+#include "statio/bench.hpp"
+
+#include "statio/batch_read.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+constexpr const char* kTrees[] = {"cpufreq", "netdev", "proc", "sysfs"};
+// What readLinkState() reads for a physical interface.
+constexpr const char* kLinkFiles[] = {"operstate", "speed", "carrier_changes", "statistics/rx_errors",
+                                      "statistics/tx_errors"};
+constexpr std::size_t kSpareDescriptors = 128;
+
+volatile std::size_t gSink = 0; // keeps the reads observable
+
+void writeFile(const fs::path& path, const std::string& text) {
+    std::ofstream out(path);
+    out << text;
+    if (!out) {
+        throw std::runtime_error("cannot write " + path.string());
+    }
+}
+
+std::vector<std::string> syntheticTree(const std::string& tree, const fs::path& root, const FilesOptions& options) {
+    std::vector<std::string> paths;
+    if (tree == "cpufreq") {
+        for (std::size_t cpu = 0; cpu < options.cpus; ++cpu) {
+            const fs::path dir = root / "cpu" / ("cpu" + std::to_string(cpu)) / "cpufreq";
+            fs::create_directories(dir);
+            paths.push_back(dir / "scaling_cur_freq");
+            writeFile(paths.back(), std::to_string(800000 + cpu % 32 * 100000) + "\n");
+        }
+        return paths;
+    }
+    for (std::size_t i = 0; i < options.interfaces; ++i) {
+        const fs::path dir = root / "net" / ("veth" + std::to_string(i));
+        fs::create_directories(dir / "statistics");
+        for (const char* file : kLinkFiles) {
+            paths.push_back(dir / file);
+            const std::string name = file;
+            writeFile(paths.back(), name == "operstate" ? "up\n" : name == "speed" ? "10000\n" : std::to_string(i) + "\n");
+        }
+    }
+    return paths;
+}
+
+std::vector<std::string> hostTree(const std::string& tree) {
+    std::vector<std::string> paths;
+    if (tree == "proc") {
+        if (DIR* dir = ::opendir("/proc")) {
+            while (const dirent* entry = ::readdir(dir)) {
+                if (entry->d_name[0] >= '1' && entry->d_name[0] <= '9') {
+                    paths.push_back(std::string("/proc/") + entry->d_name + "/stat");
+                }
+            }
+            ::closedir(dir);
+        }
+        return paths;
+    }
+    std::error_code error;
+    for (const auto& link : fs::directory_iterator("/sys/class/net", error)) {
+        for (const auto& file : fs::directory_iterator(link.path() / "statistics", error)) {
+            paths.push_back(file.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// Raises the soft descriptor limit as far as allowed and returns how many
+// files the held-descriptor methods may keep open.
+std::size_t descriptorBudget() {
+    rlimit limit {};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return 1024 - kSpareDescriptors;
+    }
+    if (limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+        ::getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (limit.rlim_cur == RLIM_INFINITY) {
+        return std::numeric_limits<std::size_t>::max();
+    }
+    return limit.rlim_cur > 2 * kSpareDescriptors ? static_cast<std::size_t>(limit.rlim_cur) - kSpareDescriptors
+                                                  : kSpareDescriptors;
+}
+
+// Median wall time of one call of `sample`, in microseconds, after one
+// call that warms the caches.
+template <typename Sample>
+double medianUs(std::size_t samples, Sample&& sample) {
+    sample();
+    std::vector<double> times;
+    times.reserve(samples);
+    for (std::size_t i = 0; i < samples; ++i) {
+        const auto started = Clock::now();
+        sample();
+        times.push_back(std::chrono::duration<double, std::micro>(Clock::now() - started).count());
+    }
+    std::nth_element(times.begin(), times.begin() + static_cast<std::ptrdiff_t>(times.size() / 2), times.end());
+    return times[times.size() / 2];
+}
+
+FilesCase measureTree(const std::string& tree, std::vector<std::string> paths, const FilesOptions& options,
+                      std::size_t budget, bool uring) {
+    FilesCase result;
+    result.tree = tree;
+    result.uringUs = kNaN;
+    if (paths.size() > budget) {
+        result.note = "descriptor limit: " + std::to_string(budget) + " of " + std::to_string(paths.size()) + " files";
+        paths.resize(budget);
+    }
+    result.files = paths.size();
+    if (paths.empty()) {
+        result.ifstreamUs = result.preadUs = kNaN;
+        result.note = "no such files on this host";
+        return result;
+    }
+
+    result.ifstreamUs = medianUs(options.samples, [&paths] {
+        std::size_t bytes = 0;
+        std::string line;
+        for (const auto& path : paths) {
+            std::ifstream file(path);
+            if (std::getline(file, line)) {
+                bytes += line.size();
+            }
+        }
+        gSink = bytes;
+    });
+
+    std::vector<int> fds;
+    fds.reserve(paths.size());
+    for (const auto& path : paths) {
+        fds.push_back(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    }
+    const std::size_t fileBytes = tree == "proc" ? 1024 : 256;
+    std::vector<char> buffer(fileBytes);
+    result.preadUs = medianUs(options.samples, [&fds, &buffer] {
+        std::size_t bytes = 0;
+        for (const int fd : fds) {
+            const ssize_t n = ::pread(fd, buffer.data(), buffer.size(), 0);
+            bytes += n > 0 ? static_cast<std::size_t>(n) : 0;
+        }
+        gSink = bytes;
+    });
+    for (const int fd : fds) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    if (uring) {
+        BatchReader reader(IoBackend::IoUring, fileBytes);
+        std::vector<std::size_t> slots;
+        for (const auto& path : paths) {
+            const std::size_t slot = reader.add(path.c_str());
+            if (slot != BatchReader::npos) {
+                slots.push_back(slot);
+            }
+        }
+        result.uringUs = medianUs(options.samples, [&reader, &slots] {
+            reader.read();
+            std::size_t bytes = 0;
+            for (const std::size_t slot : slots) {
+                bytes += reader.data(slot).size();
+            }
+            gSink = bytes;
+        });
+        if (reader.backend() != IoBackend::IoUring) {
+            result.uringUs = kNaN;
+            result.note += (result.note.empty() ? "" : "; ") + std::string("io_uring reads refused");
+        } else if (!reader.registeredFiles() || !reader.registeredBuffers()) {
+            result.note += (result.note.empty() ? "" : "; ") +
+                           std::string(reader.registeredFiles() ? "buffers" : "files") + " not registered";
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+FilesResult runFilesBench(const FilesOptions& options,
+                          const std::function<void(std::size_t done, std::size_t total)>& progress) {
+    if (options.samples == 0) {
+        throw std::runtime_error("--samples must be positive");
+    }
+    for (const auto& tree : options.trees) {
+        if (std::find_if(std::begin(kTrees), std::end(kTrees), [&tree](const char* known) { return tree == known; }) ==
+            std::end(kTrees)) {
+            throw std::runtime_error("unknown tree '" + tree + "' (cpufreq, netdev, proc, sysfs)");
+        }
+    }
+    std::vector<std::string> trees = options.trees;
+    if (trees.empty()) {
+        trees.assign(std::begin(kTrees), std::end(kTrees));
+    }
+
+    FilesResult result;
+    bool uring = true;
+    try {
+        BatchReader probe(IoBackend::IoUring);
+        result.uring = "io_uring";
+    } catch (const std::exception& e) {
+        result.uring = e.what();
+        uring = false;
+    }
+
+    const std::size_t budget = descriptorBudget();
+    std::unique_ptr<ScratchDirectory> scratch;
+    for (const auto& tree : trees) {
+        std::vector<std::string> paths;
+        if (tree == "cpufreq" || tree == "netdev") {
+            if (!scratch) {
+                scratch = std::make_unique<ScratchDirectory>(options.directory, "statio-files");
+            }
+            paths = syntheticTree(tree, scratch->path(), options);
+        } else {
+            paths = hostTree(tree);
+        }
+        result.cases.push_back(measureTree(tree, std::move(paths), options, budget, uring));
+        if (progress) {
+            progress(result.cases.size(), trees.size());
+        }
+    }
+    return result;
+}
+
+} // namespace statio
@@ -0,0 +1,306 @@
+#include "statio/bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+// A flush that reaches stable media takes longer than this on any device
+// without power-loss protection; faster means a cache acknowledged it.
+constexpr double kFastSyncUs = 50.0;
+constexpr double kSlowSyncUs = 50000.0;
+
+std::string readFirstLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+// "write back" or "write through" for the block device behind `device`,
+// looking at the parent disk for a partition.
+std::string writeCacheMode(const std::string& device) {
+    char resolved[PATH_MAX];
+    if (device.rfind("/dev/", 0) != 0 || ::realpath(device.c_str(), resolved) == nullptr) {
+        return {};
+    }
+    std::error_code ec;
+    const std::filesystem::path name = std::filesystem::path(resolved).filename();
+    const std::filesystem::path sys = std::filesystem::canonical("/sys/class/block" / name, ec);
+    if (ec) {
+        return {};
+    }
+    for (const auto& dir : {sys, sys.parent_path()}) {
+        const std::string mode = readFirstLine((dir / "queue" / "write_cache").string());
+        if (!mode.empty()) {
+            return mode;
+        }
+    }
+    return {};
+}
+
+// Runs `work(thread)` on `threads` threads at once and returns the wall
+// time in seconds, or NaN with `error` set when any of them failed.
+template <typename Work>
+double timedPhase(std::size_t threads, Work&& work, std::string& error) {
+    std::mutex errorMutex;
+    std::atomic<std::size_t> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            ready.fetch_add(1);
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            const std::string failure = work(t);
+            if (!failure.empty()) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                error = failure;
+            }
+        });
+    }
+    while (ready.load() < threads) {
+        std::this_thread::yield();
+    }
+    const auto started = Clock::now();
+    go = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    return error.empty() ? seconds : kNaN;
+}
+
+std::string failure(const char* what, const std::string& path) {
+    return std::string(what) + " " + path + ": " + std::strerror(errno);
+}
+
+void measureMetadata(const FsBenchOptions& options, const std::string& scratch, FsResult& result) {
+    std::vector<std::vector<std::string>> names(options.threads);
+    std::vector<std::vector<std::string>> renamed(options.threads);
+    for (std::size_t t = 0; t < options.threads; ++t) {
+        const std::string dir = scratch + "/t" + std::to_string(t);
+        if (::mkdir(dir.c_str(), 0755) != 0) {
+            result.error = failure("cannot create", dir);
+            return;
+        }
+        for (std::size_t i = 0; i < options.files; ++i) {
+            names[t].push_back(dir + "/f" + std::to_string(i));
+            renamed[t].push_back(names[t].back() + ".r");
+        }
+    }
+    // Each phase needs the files the previous one left; stop at the first failure.
+    const double operations = static_cast<double>(options.threads * options.files);
+    const auto phase = [&](auto&& work) {
+        if (!result.error.empty()) {
+            return kNaN;
+        }
+        const double seconds = timedPhase(options.threads, work, result.error);
+        return std::isnan(seconds) ? kNaN : operations / seconds;
+    };
+
+    result.createPerSec = phase(
+        [&](std::size_t t) -> std::string {
+            for (const auto& name : names[t]) {
+                const int fd = ::open(name.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0644);
+                if (fd < 0) {
+                    return failure("cannot create", name);
+                }
+                ::close(fd);
+            }
+            return {};
+        });
+    result.statPerSec = phase(
+        [&](std::size_t t) -> std::string {
+            struct stat st {};
+            for (const auto& name : names[t]) {
+                if (::stat(name.c_str(), &st) != 0) {
+                    return failure("cannot stat", name);
+                }
+            }
+            return {};
+        });
+    result.renamePerSec = phase(
+        [&](std::size_t t) -> std::string {
+            for (std::size_t i = 0; i < names[t].size(); ++i) {
+                if (::rename(names[t][i].c_str(), renamed[t][i].c_str()) != 0) {
+                    return failure("cannot rename", names[t][i]);
+                }
+            }
+            return {};
+        });
+    result.unlinkPerSec = phase(
+        [&](std::size_t t) -> std::string {
+            for (const auto& name : renamed[t]) {
+                if (::unlink(name.c_str()) != 0) {
+                    return failure("cannot unlink", name);
+                }
+            }
+            return {};
+        });
+}
+
+// Appends like a write-ahead log: every sync also has to persist the new
+// file size, so fdatasync() cannot skip the metadata here either.
+SyncLatency measureSync(const FsBenchOptions& options, const std::string& path, bool dataOnly, std::string& error) {
+    SyncLatency latency;
+    latency.p50Us = latency.p99Us = latency.maxUs = kNaN;
+    const int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = failure("cannot create", path);
+        return latency;
+    }
+    const std::vector<char> block(options.appendBytes, 'x');
+    auto histogram = std::make_unique<LatencyHistogram>();
+    for (std::size_t i = 0; i < options.syncs; ++i) {
+        if (::write(fd, block.data(), block.size()) != static_cast<ssize_t>(block.size())) {
+            error = failure("cannot append to", path);
+            break;
+        }
+        const auto started = Clock::now();
+        if ((dataOnly ? ::fdatasync(fd) : ::fsync(fd)) != 0) {
+            error = failure(dataOnly ? "fdatasync failed on" : "fsync failed on", path);
+            break;
+        }
+        histogram->record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count()));
+    }
+    ::close(fd);
+    ::unlink(path.c_str());
+    if (histogram->count() > 0) {
+        latency.samples = histogram->count();
+        latency.p50Us = histogram->quantile(0.5) / 1000.0;
+        latency.p99Us = histogram->quantile(0.99) / 1000.0;
+        latency.maxUs = static_cast<double>(histogram->max()) / 1000.0;
+    }
+    return latency;
+}
+
+void addSyncWarnings(const char* call, const SyncLatency& latency, FsResult& result) {
+    char buffer[160];
+    if (latency.samples == 0 || result.filesystem == "tmpfs") {
+        return;
+    }
+    if (latency.p50Us < kFastSyncUs) {
+        std::snprintf(buffer, sizeof(buffer),
+                      "%s p50 %.0f us is faster than a media flush: a volatile write cache may acknowledge it%s", call,
+                      latency.p50Us, result.writeCache == "write through" ? " (device claims write through)" : "");
+        result.warnings.push_back(buffer);
+    }
+    if (latency.p99Us > kSlowSyncUs) {
+        std::snprintf(buffer, sizeof(buffer), "%s p99 %.1f ms: slow journal or saturated device", call,
+                      latency.p99Us / 1000.0);
+        result.warnings.push_back(buffer);
+    }
+}
+
+// Filesystem and source of the mount holding `directory`: the longest
+// mount point in /proc/mounts that prefixes it. Unlike collectDiskInfo()
+// this includes tmpfs and network filesystems.
+void describeMount(const std::string& directory, FsResult& result) {
+    std::error_code ec;
+    const std::string absolute = std::filesystem::weakly_canonical(directory, ec).string() + "/";
+    std::ifstream mounts("/proc/mounts");
+    std::string source;
+    std::string mountPoint;
+    std::string fsType;
+    std::string rest;
+    std::size_t longest = 0;
+    while (mounts >> source >> mountPoint >> fsType && std::getline(mounts, rest)) {
+        const std::string prefix = mountPoint == "/" ? "/" : mountPoint + "/";
+        if (absolute.rfind(prefix, 0) == 0 && prefix.size() >= longest) {
+            longest = prefix.size();
+            result.filesystem = fsType;
+            result.device = source;
+        }
+    }
+}
+
+void benchmarkPath(const FsBenchOptions& options, FsResult& result) {
+    result.createPerSec = result.statPerSec = result.renamePerSec = result.unlinkPerSec = kNaN;
+    std::string scratch = (result.path == "/" ? std::string() : result.path) + "/.statio-bench-XXXXXX";
+    if (::mkdtemp(scratch.data()) == nullptr) {
+        result.error = failure("cannot create a scratch directory in", result.path);
+        return;
+    }
+    measureMetadata(options, scratch, result);
+    if (result.error.empty()) {
+        result.fsync = measureSync(options, scratch + "/log", false, result.error);
+    }
+    if (result.error.empty()) {
+        result.fdatasync = measureSync(options, scratch + "/log", true, result.error);
+    }
+    std::error_code ec;
+    std::filesystem::remove_all(scratch, ec);
+    addSyncWarnings("fsync", result.fsync, result);
+    addSyncWarnings("fdatasync", result.fdatasync, result);
+}
+
+} // namespace
+
+std::vector<FsResult> runFsBench(const FsBenchOptions& options,
+                                 const std::function<void(std::size_t done, std::size_t total)>& progress) {
+    if (options.threads == 0 || options.files == 0 || options.syncs == 0 || options.appendBytes == 0) {
+        throw std::runtime_error("--threads, --files, --syncs and --append must be positive");
+    }
+    std::vector<FsResult> results;
+    if (!options.directory.empty()) {
+        FsResult result;
+        result.path = options.directory;
+        describeMount(options.directory, result);
+        results.push_back(result);
+    } else {
+        for (const auto& disk : collectDiskInfo()) {
+            if (!options.mounts.empty() &&
+                std::find(options.mounts.begin(), options.mounts.end(), disk.mountPoint) == options.mounts.end()) {
+                continue;
+            }
+            FsResult result;
+            result.path = disk.mountPoint;
+            result.filesystem = disk.filesystem;
+            result.device = disk.device;
+            results.push_back(result);
+        }
+        for (const auto& mount : options.mounts) {
+            if (std::none_of(results.begin(), results.end(), [&mount](const FsResult& r) { return r.path == mount; })) {
+                throw std::runtime_error("'" + mount + "' is not a mount statio reports (use --dir for any directory)");
+            }
+        }
+        if (results.empty()) {
+            throw std::runtime_error("no block-device mounts found (use --dir)");
+        }
+    }
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        results[i].writeCache = writeCacheMode(results[i].device);
+        benchmarkPath(options, results[i]);
+        if (progress) {
+            progress(i + 1, results.size());
+        }
+    }
+    return results;
+}
+
+} // namespace statio
@@ -0,0 +1,614 @@
+#include "statio/bench.hpp"
+
+#include "statio/wire.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <limits>
+#include <linux/errqueue.h>
+#include <memory>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+constexpr int kMaxEvents = 64;
+constexpr int kOpsPerEvent = 64; // bounded work per event keeps the stop flag checked
+constexpr int kPollMs = 10;
+constexpr std::size_t kMaxDatagram = 65507;
+constexpr std::size_t kStreamBuffer = 256U << 10;
+constexpr auto kUdpRetry = std::chrono::milliseconds(200);
+
+enum class Transport : std::uint8_t { Tcp, Udp, Unix };
+enum class NetTest : std::uint8_t { Stream, StreamMmsg, StreamZerocopy, RequestResponse };
+
+const char* transportName(Transport transport) {
+    switch (transport) {
+    case Transport::Tcp:
+        return "tcp";
+    case Transport::Udp:
+        return "udp";
+    case Transport::Unix:
+        return "unix";
+    }
+    return "?";
+}
+
+const char* netTestName(NetTest test) {
+    switch (test) {
+    case NetTest::Stream:
+        return "stream";
+    case NetTest::StreamMmsg:
+        return "stream-mmsg";
+    case NetTest::StreamZerocopy:
+        return "stream-zerocopy";
+    case NetTest::RequestResponse:
+        return "rr";
+    }
+    return "?";
+}
+
+struct Flow {
+    int client = -1;
+    int server = -1;
+};
+
+void closeFlows(std::vector<Flow>& flows) {
+    for (const Flow& flow : flows) {
+        if (flow.client >= 0) {
+            ::close(flow.client);
+        }
+        if (flow.server >= 0) {
+            ::close(flow.server);
+        }
+    }
+    flows.clear();
+}
+
+void setNonBlocking(int fd) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+int boundUdpSocket(sockaddr_in& address) {
+    const int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        const int error = errno;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error(std::string("cannot bind a loopback udp socket: ") + std::strerror(error));
+    }
+    return fd;
+}
+
+// Connected client/server descriptor pairs, non-blocking. TCP goes through
+// a listener on an ephemeral loopback port, UDP through two sockets
+// connected to each other, Unix through socketpair().
+std::vector<Flow> openFlows(Transport transport, std::size_t count) {
+    std::vector<Flow> flows;
+    try {
+        if (transport == Transport::Tcp) {
+            const int listener = listenStream("127.0.0.1:0", static_cast<int>(count));
+            sockaddr_in bound {};
+            socklen_t length = sizeof(bound);
+            ::getsockname(listener, reinterpret_cast<sockaddr*>(&bound), &length);
+            const std::string address = "127.0.0.1:" + std::to_string(ntohs(bound.sin_port));
+            for (std::size_t i = 0; i < count; ++i) {
+                Flow flow;
+                flow.client = connectStream(address);
+                flow.server = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+                flows.push_back(flow);
+                if (flow.server < 0) {
+                    ::close(listener);
+                    throw std::runtime_error(std::string("accept failed: ") + std::strerror(errno));
+                }
+            }
+            ::close(listener);
+        } else if (transport == Transport::Udp) {
+            for (std::size_t i = 0; i < count; ++i) {
+                sockaddr_in clientAddress {};
+                sockaddr_in serverAddress {};
+                Flow flow;
+                flow.client = boundUdpSocket(clientAddress);
+                flows.push_back(flow);
+                flows.back().server = boundUdpSocket(serverAddress);
+                if (::connect(flows.back().client, reinterpret_cast<const sockaddr*>(&serverAddress),
+                              sizeof(serverAddress)) != 0 ||
+                    ::connect(flows.back().server, reinterpret_cast<const sockaddr*>(&clientAddress),
+                              sizeof(clientAddress)) != 0) {
+                    throw std::runtime_error(std::string("cannot connect udp sockets: ") + std::strerror(errno));
+                }
+            }
+        } else {
+            for (std::size_t i = 0; i < count; ++i) {
+                int pair[2];
+                if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) {
+                    throw std::runtime_error(std::string("socketpair failed: ") + std::strerror(errno));
+                }
+                flows.push_back(Flow{pair[0], pair[1]});
+            }
+        }
+    } catch (...) {
+        closeFlows(flows);
+        throw;
+    }
+    for (const Flow& flow : flows) {
+        setNonBlocking(flow.client);
+        setNonBlocking(flow.server);
+    }
+    return flows;
+}
+
+struct Run {
+    Transport transport = Transport::Tcp;
+    NetTest test = NetTest::Stream;
+    std::size_t size = 0;
+    std::size_t batch = 32;
+    std::atomic<bool> go{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<std::size_t> ready{0};
+};
+
+// Per-thread results, merged once every thread has joined.
+struct Side {
+    std::uint64_t bytes = 0;
+    std::uint64_t messages = 0;
+    std::uint64_t retries = 0;
+    bool copied = false; // a zerocopy send was completed by copying
+    LatencyHistogram histogram;
+};
+
+// One epoll instance per thread, level-triggered. A descriptor that
+// cannot take `events` right now simply is not reported.
+class Poller {
+public:
+    Poller() : fd_(::epoll_create1(EPOLL_CLOEXEC)) {
+        if (fd_ < 0) {
+            throw std::runtime_error(std::string("epoll_create1 failed: ") + std::strerror(errno));
+        }
+    }
+    ~Poller() { ::close(fd_); }
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+
+    void add(int fd, std::uint32_t events, std::size_t index) { control(EPOLL_CTL_ADD, fd, events, index); }
+    void modify(int fd, std::uint32_t events, std::size_t index) { control(EPOLL_CTL_MOD, fd, events, index); }
+    int wait(epoll_event* events) { return ::epoll_wait(fd_, events, kMaxEvents, kPollMs); }
+
+private:
+    void control(int op, int fd, std::uint32_t events, std::size_t index) {
+        epoll_event event {};
+        event.events = events;
+        event.data.u64 = index;
+        ::epoll_ctl(fd_, op, fd, &event);
+    }
+
+    int fd_;
+};
+
+void waitForGo(Run& run) {
+    run.ready.fetch_add(1);
+    while (!run.go.load()) {
+        std::this_thread::yield();
+    }
+}
+
+// Reaps MSG_ZEROCOPY completions so that the socket's notification budget
+// (optmem) does not run out.
+void drainZerocopy(int fd, Side& side) {
+    for (;;) {
+        char control[128];
+        msghdr message {};
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if (::recvmsg(fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return;
+        }
+        for (cmsghdr* cm = CMSG_FIRSTHDR(&message); cm != nullptr; cm = CMSG_NXTHDR(&message, cm)) {
+            const auto* error = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+            if (error->ee_origin == SO_EE_ORIGIN_ZEROCOPY && (error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0) {
+                side.copied = true;
+            }
+        }
+    }
+}
+
+void streamClient(Run& run, const std::vector<int>& fds, Side& side) {
+    Poller poller;
+    for (std::size_t i = 0; i < fds.size(); ++i) {
+        poller.add(fds[i], EPOLLOUT, i);
+    }
+    const std::vector<char> payload(std::max<std::size_t>(run.size, 1), 'x');
+    std::vector<iovec> iov(run.batch, iovec{const_cast<char*>(payload.data()), run.size});
+    std::vector<mmsghdr> messages(run.batch);
+    for (std::size_t i = 0; i < run.batch; ++i) {
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    int sendFlags = MSG_DONTWAIT | MSG_NOSIGNAL;
+    if (run.test == NetTest::StreamZerocopy) {
+        sendFlags |= MSG_ZEROCOPY;
+    }
+
+    waitForGo(run);
+    epoll_event events[kMaxEvents];
+    while (!run.stopping.load(std::memory_order_relaxed)) {
+        const int ready = poller.wait(events);
+        for (int e = 0; e < ready; ++e) {
+            const int fd = fds[events[e].data.u64];
+            if ((events[e].events & EPOLLERR) != 0 && run.test == NetTest::StreamZerocopy) {
+                drainZerocopy(fd, side);
+            }
+            for (int op = 0; op < kOpsPerEvent; ++op) {
+                if (run.test == NetTest::StreamMmsg) {
+                    if (::sendmmsg(fd, messages.data(), static_cast<unsigned>(run.batch), MSG_DONTWAIT) <= 0) {
+                        break;
+                    }
+                } else if (::send(fd, payload.data(), run.size, sendFlags) < 0) {
+                    if (errno == ENOBUFS && run.test == NetTest::StreamZerocopy) {
+                        drainZerocopy(fd, side);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void streamServer(Run& run, const std::vector<int>& fds, Side& side) {
+    Poller poller;
+    for (std::size_t i = 0; i < fds.size(); ++i) {
+        poller.add(fds[i], EPOLLIN, i);
+    }
+    const bool datagrams = run.transport == Transport::Udp;
+    const std::size_t slot = datagrams ? run.size : kStreamBuffer;
+    std::vector<char> buffer(std::max<std::size_t>(slot, 1) * run.batch);
+    std::vector<iovec> iov(run.batch);
+    std::vector<mmsghdr> messages(run.batch);
+    for (std::size_t i = 0; i < run.batch; ++i) {
+        iov[i] = iovec{buffer.data() + i * slot, slot};
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    waitForGo(run);
+    epoll_event events[kMaxEvents];
+    while (!run.stopping.load(std::memory_order_relaxed)) {
+        const int ready = poller.wait(events);
+        for (int e = 0; e < ready; ++e) {
+            const int fd = fds[events[e].data.u64];
+            for (int op = 0; op < kOpsPerEvent; ++op) {
+                if (run.test == NetTest::StreamMmsg) {
+                    const int received =
+                        ::recvmmsg(fd, messages.data(), static_cast<unsigned>(run.batch), MSG_DONTWAIT, nullptr);
+                    if (received <= 0) {
+                        break;
+                    }
+                    side.messages += static_cast<std::uint64_t>(received);
+                    for (int m = 0; m < received; ++m) {
+                        side.bytes += messages[m].msg_len;
+                    }
+                    continue;
+                }
+                const ssize_t received = ::recv(fd, buffer.data(), slot, MSG_DONTWAIT);
+                if (received <= 0) {
+                    break;
+                }
+                side.bytes += static_cast<std::uint64_t>(received);
+                side.messages += datagrams ? 1 : 0;
+            }
+        }
+    }
+}
+
+// Request/response state of one descriptor: bytes still to send of the
+// current message and bytes received towards the next complete one.
+struct Exchange {
+    int fd = -1;
+    std::size_t unsent = 0;
+    std::size_t received = 0;
+    bool wantOut = false;
+    Clock::time_point sentAt;
+};
+
+// Sends what is pending; asks for EPOLLOUT only while the socket is full.
+void flush(Run& run, Poller& poller, Exchange& ex, std::size_t index, const std::vector<char>& payload) {
+    while (ex.unsent > 0) {
+        const std::size_t chunk = run.transport == Transport::Udp ? run.size : std::min(ex.unsent, payload.size());
+        const ssize_t sent = ::send(ex.fd, payload.data(), chunk, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0) {
+            break;
+        }
+        ex.unsent -= run.transport == Transport::Udp ? chunk : static_cast<std::size_t>(sent);
+    }
+    const bool wantOut = ex.unsent > 0;
+    if (wantOut != ex.wantOut) {
+        ex.wantOut = wantOut;
+        poller.modify(ex.fd, wantOut ? EPOLLIN | EPOLLOUT : EPOLLIN, index);
+    }
+}
+
+// Reads what is available; returns the number of complete messages.
+std::size_t absorb(Run& run, Exchange& ex, std::vector<char>& buffer) {
+    std::size_t complete = 0;
+    for (int op = 0; op < kOpsPerEvent; ++op) {
+        const ssize_t received = ::recv(ex.fd, buffer.data(), buffer.size(), MSG_DONTWAIT);
+        if (received <= 0) {
+            break;
+        }
+        if (run.transport == Transport::Udp) {
+            ++complete;
+            continue;
+        }
+        ex.received += static_cast<std::size_t>(received);
+        complete += ex.received / run.size;
+        ex.received %= run.size;
+    }
+    return complete;
+}
+
+void rrClient(Run& run, const std::vector<int>& fds, Side& side) {
+    Poller poller;
+    std::vector<Exchange> exchanges(fds.size());
+    for (std::size_t i = 0; i < fds.size(); ++i) {
+        exchanges[i].fd = fds[i];
+        poller.add(fds[i], EPOLLIN, i);
+    }
+    const std::vector<char> payload(run.size, 'x');
+    std::vector<char> buffer(std::max(run.size, kStreamBuffer));
+    const auto request = [&](std::size_t i) {
+        exchanges[i].unsent = run.size;
+        exchanges[i].received = 0;
+        exchanges[i].sentAt = Clock::now();
+        flush(run, poller, exchanges[i], i, payload);
+    };
+
+    waitForGo(run);
+    for (std::size_t i = 0; i < exchanges.size(); ++i) {
+        request(i);
+    }
+    epoll_event events[kMaxEvents];
+    while (!run.stopping.load(std::memory_order_relaxed)) {
+        const int ready = poller.wait(events);
+        for (int e = 0; e < ready; ++e) {
+            const std::size_t i = events[e].data.u64;
+            if ((events[e].events & EPOLLOUT) != 0) {
+                flush(run, poller, exchanges[i], i, payload);
+            }
+            if ((events[e].events & EPOLLIN) != 0 && absorb(run, exchanges[i], buffer) > 0) {
+                const auto now = Clock::now();
+                side.histogram.record(static_cast<std::uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(now - exchanges[i].sentAt).count()));
+                request(i);
+            }
+        }
+        if (run.transport == Transport::Udp) {
+            // A datagram lost to a full receive buffer is simply asked again.
+            const auto now = Clock::now();
+            for (std::size_t i = 0; i < exchanges.size(); ++i) {
+                if (now - exchanges[i].sentAt > kUdpRetry) {
+                    ++side.retries;
+                    request(i);
+                }
+            }
+        }
+    }
+}
+
+void rrServer(Run& run, const std::vector<int>& fds, Side&) {
+    Poller poller;
+    std::vector<Exchange> exchanges(fds.size());
+    for (std::size_t i = 0; i < fds.size(); ++i) {
+        exchanges[i].fd = fds[i];
+        poller.add(fds[i], EPOLLIN, i);
+    }
+    const std::vector<char> payload(run.size, 'x');
+    std::vector<char> buffer(std::max(run.size, kStreamBuffer));
+
+    waitForGo(run);
+    epoll_event events[kMaxEvents];
+    while (!run.stopping.load(std::memory_order_relaxed)) {
+        const int ready = poller.wait(events);
+        for (int e = 0; e < ready; ++e) {
+            const std::size_t i = events[e].data.u64;
+            if ((events[e].events & EPOLLIN) != 0) {
+                exchanges[i].unsent += absorb(run, exchanges[i], buffer) * run.size;
+            }
+            flush(run, poller, exchanges[i], i, payload);
+        }
+    }
+}
+
+NetCase skippedCase(Transport transport, NetTest test, std::size_t size, std::string note) {
+    NetCase result;
+    result.transport = transportName(transport);
+    result.test = netTestName(test);
+    result.size = size;
+    result.gbitPerSec = kNaN;
+    result.messagesPerSec = kNaN;
+    result.p50Us = kNaN;
+    result.p99Us = kNaN;
+    result.note = std::move(note);
+    return result;
+}
+
+NetCase runCase(const NetOptions& options, std::size_t threads, Transport transport, NetTest test, std::size_t size) {
+    if (transport == Transport::Udp && size > kMaxDatagram) {
+        return skippedCase(transport, test, size, "larger than a UDP datagram");
+    }
+    std::vector<Flow> flows = openFlows(transport, options.connections);
+    if (test == NetTest::StreamZerocopy) {
+        for (const Flow& flow : flows) {
+            const int one = 1;
+            if (::setsockopt(flow.client, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+                closeFlows(flows);
+                return skippedCase(transport, test, size, "SO_ZEROCOPY not supported by this kernel");
+            }
+        }
+    }
+
+    Run run;
+    run.transport = transport;
+    run.test = test;
+    run.size = size;
+    run.batch = test == NetTest::StreamMmsg ? options.batch : 1;
+    std::vector<std::vector<int>> clientFds(threads);
+    std::vector<std::vector<int>> serverFds(threads);
+    for (std::size_t i = 0; i < flows.size(); ++i) {
+        clientFds[i % threads].push_back(flows[i].client);
+        serverFds[i % threads].push_back(flows[i].server);
+    }
+
+    const bool rr = test == NetTest::RequestResponse;
+    std::vector<std::unique_ptr<Side>> clients;
+    std::vector<std::unique_ptr<Side>> servers;
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < threads; ++t) {
+        clients.push_back(std::make_unique<Side>());
+        servers.push_back(std::make_unique<Side>());
+        workers.emplace_back(rr ? rrServer : streamServer, std::ref(run), std::cref(serverFds[t]), std::ref(*servers.back()));
+        workers.emplace_back(rr ? rrClient : streamClient, std::ref(run), std::cref(clientFds[t]), std::ref(*clients.back()));
+    }
+    while (run.ready.load() < workers.size()) {
+        std::this_thread::yield();
+    }
+    const auto started = Clock::now();
+    run.go = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.durationMs));
+    run.stopping = true;
+    const double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    closeFlows(flows);
+
+    Side total;
+    for (const auto& side : clients) {
+        total.histogram.merge(side->histogram);
+        total.retries += side->retries;
+        total.copied = total.copied || side->copied;
+    }
+    for (const auto& side : servers) {
+        total.bytes += side->bytes;
+        total.messages += side->messages;
+    }
+
+    NetCase result = skippedCase(transport, test, size, {});
+    if (rr) {
+        result.messagesPerSec = static_cast<double>(total.histogram.count()) / seconds;
+        result.p50Us = total.histogram.quantile(0.5) / 1000.0;
+        result.p99Us = total.histogram.quantile(0.99) / 1000.0;
+        if (total.retries > 0) {
+            result.note = std::to_string(total.retries) + " datagrams lost and resent";
+        }
+        return result;
+    }
+    const std::uint64_t messages = transport == Transport::Udp ? total.messages : total.bytes / size;
+    result.gbitPerSec = static_cast<double>(total.bytes) * 8.0 / seconds / 1e9;
+    result.messagesPerSec = static_cast<double>(messages) / seconds;
+    if (test == NetTest::StreamMmsg) {
+        result.note = std::to_string(options.batch) + " datagrams per call";
+    } else if (test == NetTest::StreamZerocopy && total.copied) {
+        result.note = "kernel copied (loopback never skips the copy)";
+    }
+    return result;
+}
+
+Transport parseTransport(const std::string& name) {
+    if (name == "tcp") {
+        return Transport::Tcp;
+    }
+    if (name == "udp") {
+        return Transport::Udp;
+    }
+    if (name == "unix") {
+        return Transport::Unix;
+    }
+    throw std::runtime_error("unknown transport '" + name + "' (tcp, udp, unix)");
+}
+
+std::vector<NetTest> testsFor(Transport transport) {
+    switch (transport) {
+    case Transport::Tcp:
+        return {NetTest::Stream, NetTest::StreamZerocopy, NetTest::RequestResponse};
+    case Transport::Udp:
+        return {NetTest::Stream, NetTest::StreamMmsg, NetTest::RequestResponse};
+    case Transport::Unix:
+        return {NetTest::Stream, NetTest::RequestResponse};
+    }
+    return {};
+}
+
+} // namespace
+
+std::vector<NetCase> runNetBench(const NetOptions& options,
+                                 const std::function<void(std::size_t done, std::size_t total)>& progress) {
+    if (options.connections == 0 || options.batch == 0 || options.durationMs <= 0) {
+        throw std::runtime_error("--connections, --batch and --duration must be positive");
+    }
+    std::vector<Transport> transports;
+    for (const auto& name : options.transports.empty() ? std::vector<std::string>{"tcp", "udp", "unix"}
+                                                       : options.transports) {
+        transports.push_back(parseTransport(name));
+    }
+    const std::vector<std::size_t> sizes =
+        options.sizes.empty() ? std::vector<std::size_t>{64, 1024, 16384} : options.sizes;
+    if (std::find(sizes.begin(), sizes.end(), 0U) != sizes.end()) {
+        throw std::runtime_error("--sizes must be positive");
+    }
+    const std::size_t threads =
+        std::min(options.connections, options.threads == 0 ? std::size_t{4} : options.threads);
+
+    std::vector<std::pair<Transport, NetTest>> plan;
+    for (const Transport transport : transports) {
+        for (const NetTest test : testsFor(transport)) {
+            plan.emplace_back(transport, test);
+        }
+    }
+    const std::size_t total = plan.size() * sizes.size();
+    std::vector<NetCase> cases;
+    for (const auto& [transport, test] : plan) {
+        for (const std::size_t size : sizes) {
+            cases.push_back(runCase(options, threads, transport, test, size));
+            // Batched and zerocopy sends are judged against plain sends.
+            if (test == NetTest::StreamMmsg || test == NetTest::StreamZerocopy) {
+                NetCase& batched = cases.back();
+                auto plain = std::find_if(cases.begin(), cases.end(), [&](const NetCase& c) {
+                    return c.transport == batched.transport && c.test == "stream" && c.size == size;
+                });
+                if (plain != cases.end() && plain->messagesPerSec > 0.0 && !std::isnan(batched.messagesPerSec)) {
+                    char buffer[48];
+                    std::snprintf(buffer, sizeof(buffer), "%.2fx plain send", batched.messagesPerSec / plain->messagesPerSec);
+                    batched.note = batched.note.empty() ? buffer : std::string(buffer) + ", " + batched.note;
+                }
+            }
+            if (progress) {
+                progress(cases.size(), total);
+            }
+        }
+    }
+    return cases;
+}
+
+} // namespace statio
@@ -0,0 +1,573 @@
+#include "statio/bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <linux/futex.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+constexpr std::size_t kFaultBytes = 64U << 20;
+constexpr std::size_t kMajorFaultBytes = 16U << 20;
+constexpr std::size_t kHugePageBytes = 2U << 20;
+constexpr std::size_t kMaxSpinners = 15;
+
+struct Env {
+    std::size_t repeats = 5;
+    int cpu = 0;             // single-threaded tests and the context-switch initiator
+    int peerCpu = 0;         // context-switch responder
+    std::vector<int> others; // every other usable CPU, for shootdown spinners
+    std::string directory;
+};
+
+using OsTest = OsCost (*)(const Env&);
+
+double elapsedNs(Clock::time_point started) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - started).count();
+}
+
+std::size_t pageBytes() {
+    const long size = ::sysconf(_SC_PAGESIZE);
+    return size > 0 ? static_cast<std::size_t>(size) : 4096;
+}
+
+std::string readFirstLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+OsCost summarize(const std::string& test, std::vector<double> samples, std::uint64_t operations, std::string note) {
+    OsCost cost;
+    cost.test = test;
+    cost.operations = operations;
+    cost.note = std::move(note);
+    samples.erase(std::remove_if(samples.begin(), samples.end(), [](double ns) { return std::isnan(ns); }),
+                  samples.end());
+    if (samples.empty()) {
+        cost.medianNs = kNaN;
+        cost.minNs = kNaN;
+        return cost;
+    }
+    std::sort(samples.begin(), samples.end());
+    cost.medianNs = samples[samples.size() / 2];
+    cost.minNs = samples.front();
+    return cost;
+}
+
+// Runs `fn` on a fresh thread pinned to `cpu`, leaving the caller's own
+// affinity alone. `fn` must not throw.
+template <typename Fn>
+void runPinned(int cpu, Fn&& fn) {
+    bool pinned = false;
+    std::thread worker([&] {
+        pinned = pinCurrentThread(cpu);
+        if (pinned) {
+            fn();
+        }
+    });
+    worker.join();
+    if (!pinned) {
+        throw std::runtime_error("cannot pin a thread to cpu " + std::to_string(cpu));
+    }
+}
+
+// Starts `initiator` and `responder` together on two pinned threads.
+template <typename Initiator, typename Responder>
+void runPair(int initiatorCpu, int responderCpu, Initiator&& initiator, Responder&& responder) {
+    std::atomic<int> arrived{0};
+    std::atomic<int> failedCpu{-1};
+    const auto meet = [&](int cpu) {
+        if (!pinCurrentThread(cpu)) {
+            failedCpu = cpu;
+        }
+        arrived.fetch_add(1);
+        while (arrived.load() < 2) {
+            std::this_thread::yield();
+        }
+        return failedCpu.load() < 0;
+    };
+    std::thread peer([&] {
+        if (meet(responderCpu)) {
+            responder();
+        }
+    });
+    std::thread self([&] {
+        if (meet(initiatorCpu)) {
+            initiator();
+        }
+    });
+    self.join();
+    peer.join();
+    if (failedCpu.load() >= 0) {
+        throw std::runtime_error("cannot pin a thread to cpu " + std::to_string(failedCpu.load()));
+    }
+}
+
+struct FaultCounts {
+    long minor = 0;
+    long major = 0;
+};
+
+FaultCounts threadFaults() {
+    rusage usage {};
+    ::getrusage(RUSAGE_THREAD, &usage);
+    return FaultCounts{usage.ru_minflt, usage.ru_majflt};
+}
+
+std::string switchNote(const Env& env) {
+    if (env.cpu == env.peerCpu) {
+        return "per switch, both threads on cpu " + std::to_string(env.cpu);
+    }
+    return "per one-way wake-up, cpu " + std::to_string(env.cpu) + " <-> " + std::to_string(env.peerCpu);
+}
+
+OsCost measureSyscall(const Env& env) {
+    constexpr std::uint64_t kCalls = 200000;
+    std::vector<double> samples;
+    runPinned(env.cpu, [&] {
+        for (std::size_t r = 0; r < env.repeats; ++r) {
+            const auto started = Clock::now();
+            for (std::uint64_t i = 0; i < kCalls; ++i) {
+                ::syscall(SYS_getpid);
+            }
+            samples.push_back(elapsedNs(started) / static_cast<double>(kCalls));
+        }
+    });
+    return summarize("syscall", samples, kCalls, "getpid through syscall(2), no vDSO or libc cache");
+}
+
+OsCost measurePipeSwitch(const Env& env) {
+    constexpr std::uint64_t kRoundTrips = 20000;
+    int there[2];
+    int back[2];
+    if (::pipe(there) != 0) {
+        return summarize("ctx-pipe", {}, 0, "pipe() failed");
+    }
+    if (::pipe(back) != 0) {
+        ::close(there[0]);
+        ::close(there[1]);
+        return summarize("ctx-pipe", {}, 0, "pipe() failed");
+    }
+
+    std::vector<double> samples;
+    runPair(
+        env.cpu, env.peerCpu,
+        [&] {
+            char byte = 0;
+            for (std::size_t r = 0; r < env.repeats; ++r) {
+                const auto started = Clock::now();
+                for (std::uint64_t i = 0; i < kRoundTrips; ++i) {
+                    if (::write(there[1], &byte, 1) != 1 || ::read(back[0], &byte, 1) != 1) {
+                        return;
+                    }
+                }
+                samples.push_back(elapsedNs(started) / static_cast<double>(2 * kRoundTrips));
+            }
+        },
+        [&] {
+            char byte = 0;
+            for (std::uint64_t i = 0; i < kRoundTrips * env.repeats; ++i) {
+                if (::read(there[0], &byte, 1) != 1 || ::write(back[1], &byte, 1) != 1) {
+                    return;
+                }
+            }
+        });
+    for (const int fd : {there[0], there[1], back[0], back[1]}) {
+        ::close(fd);
+    }
+    return summarize("ctx-pipe", samples, 2 * kRoundTrips, switchNote(env));
+}
+
+void futexWait(std::atomic<std::uint32_t>& word, std::uint32_t expected) {
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+void futexWake(std::atomic<std::uint32_t>& word) {
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+// The word counts handoffs: odd values belong to the responder, even ones
+// to the initiator. Each side sleeps in FUTEX_WAIT until its turn.
+OsCost measureFutexSwitch(const Env& env) {
+    constexpr std::uint32_t kRoundTrips = 20000;
+    std::atomic<std::uint32_t> word{0};
+    std::vector<double> samples;
+    runPair(
+        env.cpu, env.peerCpu,
+        [&] {
+            std::uint32_t k = 0;
+            for (std::size_t r = 0; r < env.repeats; ++r) {
+                const auto started = Clock::now();
+                for (std::uint32_t i = 0; i < kRoundTrips; ++i, ++k) {
+                    word.store(2 * k + 1);
+                    futexWake(word);
+                    while (word.load() != 2 * k + 2) {
+                        futexWait(word, 2 * k + 1);
+                    }
+                }
+                samples.push_back(elapsedNs(started) / static_cast<double>(2 * kRoundTrips));
+            }
+        },
+        [&] {
+            const auto total = static_cast<std::uint32_t>(kRoundTrips * env.repeats);
+            for (std::uint32_t k = 0; k < total; ++k) {
+                while (word.load() != 2 * k + 1) {
+                    futexWait(word, 2 * k);
+                }
+                word.store(2 * k + 2);
+                futexWake(word);
+            }
+        });
+    return summarize("ctx-futex", samples, 2 * kRoundTrips, switchNote(env));
+}
+
+OsCost measureThreadCreate(const Env& env) {
+    constexpr std::uint64_t kThreads = 2000;
+    std::vector<double> samples;
+    runPinned(env.cpu, [&] {
+        for (std::size_t r = 0; r < env.repeats; ++r) {
+            const auto started = Clock::now();
+            for (std::uint64_t i = 0; i < kThreads; ++i) {
+                std::thread([] {}).join();
+            }
+            samples.push_back(elapsedNs(started) / static_cast<double>(kThreads));
+        }
+    });
+    return summarize("thread-create", samples, kThreads, "create and join an empty thread");
+}
+
+// Touches `bytes` of a fresh mapping every `stride` bytes and returns the
+// time per fault the kernel actually took, or NaN.
+double touchFaults(char* region, std::size_t bytes, std::size_t stride, long* faultsOut) {
+    const FaultCounts before = threadFaults();
+    const auto started = Clock::now();
+    for (std::size_t offset = 0; offset < bytes; offset += stride) {
+        static_cast<volatile char*>(region)[offset] = 1;
+    }
+    const double ns = elapsedNs(started);
+    const long faults = threadFaults().minor - before.minor;
+    *faultsOut = faults;
+    return faults > 0 ? ns / static_cast<double>(faults) : kNaN;
+}
+
+OsCost measureMinorFault(const Env& env) {
+    const std::size_t page = pageBytes();
+    std::vector<double> samples;
+    runPinned(env.cpu, [&] {
+        for (std::size_t r = 0; r < env.repeats; ++r) {
+            void* region = ::mmap(nullptr, kFaultBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (region == MAP_FAILED) {
+                return;
+            }
+            ::madvise(region, kFaultBytes, MADV_NOHUGEPAGE);
+            long faults = 0;
+            samples.push_back(touchFaults(static_cast<char*>(region), kFaultBytes, page, &faults));
+            ::munmap(region, kFaultBytes);
+        }
+    });
+    return summarize("fault-minor", samples, kFaultBytes / page,
+                     "anonymous zero-fill, " + std::to_string(page / 1024) + " KiB pages, THP off");
+}
+
+std::string transparentHugePageMode() {
+    const std::string line = readFirstLine("/sys/kernel/mm/transparent_hugepage/enabled");
+    const std::size_t open = line.find('[');
+    const std::size_t close = line.find(']', open);
+    if (open == std::string::npos || close == std::string::npos) {
+        return "unavailable";
+    }
+    return line.substr(open + 1, close - open - 1);
+}
+
+OsCost measureHugePageFault(const Env& env) {
+    constexpr std::size_t kChunks = kFaultBytes / kHugePageBytes;
+    std::vector<double> samples;
+    bool granted = true;
+    runPinned(env.cpu, [&] {
+        for (std::size_t r = 0; r < env.repeats && granted; ++r) {
+            const std::size_t mapped = kFaultBytes + kHugePageBytes;
+            void* region = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (region == MAP_FAILED) {
+                return;
+            }
+            const auto base = reinterpret_cast<std::uintptr_t>(region);
+            char* aligned = reinterpret_cast<char*>((base + kHugePageBytes - 1) & ~(kHugePageBytes - 1));
+            ::madvise(aligned, kFaultBytes, MADV_HUGEPAGE);
+            long faults = 0;
+            const double ns = touchFaults(aligned, kFaultBytes, kHugePageBytes, &faults);
+            // A 4K fallback faults once per touch just the same; only a
+            // huge page has the middle of each chunk already mapped.
+            long tailFaults = 0;
+            touchFaults(aligned + kHugePageBytes / 2, kFaultBytes - kHugePageBytes / 2, kHugePageBytes, &tailFaults);
+            granted = tailFaults == 0 && faults <= static_cast<long>(2 * kChunks);
+            samples.push_back(granted ? ns : kNaN);
+            ::munmap(region, mapped);
+        }
+    });
+    const std::string mode = transparentHugePageMode();
+    if (!granted) {
+        return summarize("fault-thp", {}, kChunks, "no transparent huge pages granted (enabled=" + mode + ")");
+    }
+    OsCost cost = summarize("fault-thp", samples, kChunks, "2 MiB anonymous zero-fill");
+    if (!std::isnan(cost.medianNs)) {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), ", %.0f ns per 4 KiB", cost.medianNs / 512.0);
+        cost.note += buffer;
+    }
+    return cost;
+}
+
+std::string scratchDirectory(const Env& env) {
+    if (!env.directory.empty()) {
+        return env.directory;
+    }
+    const char* tmp = std::getenv("TMPDIR");
+    return tmp && *tmp ? tmp : "/var/tmp";
+}
+
+// Major faults read a file whose pages were just dropped from the page
+// cache; MADV_RANDOM keeps readahead from turning most of them minor.
+OsCost measureMajorFault(const Env& env) {
+    const std::size_t page = pageBytes();
+    const std::string directory = scratchDirectory(env);
+    std::string path = directory + "/statio-bench-XXXXXX";
+    const int fd = ::mkstemp(path.data());
+    if (fd < 0) {
+        return summarize("fault-major", {}, 0, "cannot create a scratch file in " + directory);
+    }
+    ::unlink(path.c_str());
+
+    std::vector<char> chunk(1U << 20, 'x');
+    bool written = true;
+    for (std::size_t offset = 0; offset < kMajorFaultBytes && written; offset += chunk.size()) {
+        written = ::write(fd, chunk.data(), chunk.size()) == static_cast<ssize_t>(chunk.size());
+    }
+    if (!written || ::fsync(fd) != 0) {
+        ::close(fd);
+        return summarize("fault-major", {}, 0, "cannot write a scratch file in " + directory);
+    }
+
+    std::vector<double> samples;
+    bool cached = false;
+    runPinned(env.cpu, [&] {
+        for (std::size_t r = 0; r < env.repeats && !cached; ++r) {
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            void* region = ::mmap(nullptr, kMajorFaultBytes, PROT_READ, MAP_SHARED, fd, 0);
+            if (region == MAP_FAILED) {
+                return;
+            }
+            ::madvise(region, kMajorFaultBytes, MADV_RANDOM);
+            const FaultCounts before = threadFaults();
+            const auto started = Clock::now();
+            char sink = 0;
+            for (std::size_t offset = 0; offset < kMajorFaultBytes; offset += page) {
+                sink ^= static_cast<volatile const char*>(region)[offset];
+            }
+            const double ns = elapsedNs(started);
+            const long major = threadFaults().major - before.major;
+            ::munmap(region, kMajorFaultBytes);
+            (void)sink;
+            cached = major < static_cast<long>(kMajorFaultBytes / page / 2);
+            samples.push_back(cached ? kNaN : ns / static_cast<double>(major));
+        }
+    });
+    ::close(fd);
+    if (cached) {
+        return summarize("fault-major", {}, kMajorFaultBytes / page,
+                         "pages stayed cached in " + directory + " (tmpfs?); pass --dir on a disk");
+    }
+    return summarize("fault-major", samples, kMajorFaultBytes / page, "file pages read back from " + directory);
+}
+
+// munmap() must flush the TLB of every CPU currently running this mm. With
+// sibling threads spinning elsewhere, that is one IPI round per call.
+double mmapCycle(std::uint64_t cycles, std::size_t page) {
+    const auto started = Clock::now();
+    for (std::uint64_t i = 0; i < cycles; ++i) {
+        void* region = ::mmap(nullptr, page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            return kNaN;
+        }
+        static_cast<volatile char*>(region)[0] = 1;
+        ::munmap(region, page);
+    }
+    return elapsedNs(started) / static_cast<double>(cycles);
+}
+
+constexpr std::uint64_t kMmapCycles = 20000;
+
+OsCost measureMmap(const Env& env) {
+    std::vector<double> samples;
+    runPinned(env.cpu, [&] {
+        for (std::size_t r = 0; r < env.repeats; ++r) {
+            samples.push_back(mmapCycle(kMmapCycles, pageBytes()));
+        }
+    });
+    return summarize("mmap-munmap", samples, kMmapCycles, "map, touch and unmap one page, single thread");
+}
+
+OsCost measureMmapShootdown(const Env& env) {
+    if (env.others.empty()) {
+        return summarize("mmap-shootdown", {}, kMmapCycles, "needs a second CPU");
+    }
+    std::atomic<bool> stopping{false};
+    std::atomic<std::size_t> running{0};
+    std::vector<std::thread> spinners;
+    for (const int cpu : env.others) {
+        spinners.emplace_back([&stopping, &running, cpu] {
+            pinCurrentThread(cpu);
+            running.fetch_add(1);
+            while (!stopping.load(std::memory_order_relaxed)) {
+            }
+        });
+    }
+    while (running.load() < spinners.size()) {
+        std::this_thread::yield();
+    }
+
+    std::vector<double> samples;
+    try {
+        runPinned(env.cpu, [&] {
+            for (std::size_t r = 0; r < env.repeats; ++r) {
+                samples.push_back(mmapCycle(kMmapCycles, pageBytes()));
+            }
+        });
+    } catch (...) {
+        stopping = true;
+        for (auto& spinner : spinners) {
+            spinner.join();
+        }
+        throw;
+    }
+    stopping = true;
+    for (auto& spinner : spinners) {
+        spinner.join();
+    }
+    return summarize("mmap-shootdown", samples, kMmapCycles,
+                     "as mmap-munmap, " + std::to_string(env.others.size()) + " threads spinning on other CPUs");
+}
+
+const std::vector<std::pair<std::string, OsTest>>& osTestTable() {
+    static const std::vector<std::pair<std::string, OsTest>> table = {
+        {"syscall", measureSyscall},
+        {"ctx-pipe", measurePipeSwitch},
+        {"ctx-futex", measureFutexSwitch},
+        {"thread-create", measureThreadCreate},
+        {"fault-minor", measureMinorFault},
+        {"fault-major", measureMajorFault},
+        {"fault-thp", measureHugePageFault},
+        {"mmap-munmap", measureMmap},
+        {"mmap-shootdown", measureMmapShootdown},
+    };
+    return table;
+}
+
+std::vector<std::pair<std::string, std::string>> readMitigations() {
+    std::vector<std::pair<std::string, std::string>> mitigations;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/cpu/vulnerabilities", ec)) {
+        mitigations.emplace_back(entry.path().filename().string(), readFirstLine(entry.path().string()));
+    }
+    std::sort(mitigations.begin(), mitigations.end());
+    return mitigations;
+}
+
+} // namespace
+
+std::string detectHypervisor() {
+    const std::string xen = readFirstLine("/sys/hypervisor/type");
+    if (!xen.empty()) {
+        return xen;
+    }
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("flags", 0) != 0) {
+            continue;
+        }
+        if ((line + ' ').find(" hypervisor ") == std::string::npos) {
+            return {};
+        }
+        const std::string vendor = readFirstLine("/sys/class/dmi/id/sys_vendor");
+        return vendor.empty() ? "unknown" : vendor;
+    }
+    return {};
+}
+
+const std::vector<std::string>& osBenchTests() {
+    static const std::vector<std::string> names = [] {
+        std::vector<std::string> out;
+        for (const auto& test : osTestTable()) {
+            out.push_back(test.first);
+        }
+        return out;
+    }();
+    return names;
+}
+
+OsBenchResult runOsCosts(const OsBenchOptions& options,
+                         const std::function<void(std::size_t done, std::size_t total)>& progress) {
+    std::vector<std::pair<std::string, OsTest>> selected;
+    for (const auto& name : options.tests.empty() ? osBenchTests() : options.tests) {
+        const auto& table = osTestTable();
+        auto it = std::find_if(table.begin(), table.end(), [&name](const auto& test) { return test.first == name; });
+        if (it == table.end()) {
+            throw std::runtime_error("unknown os test '" + name + "'");
+        }
+        selected.push_back(*it);
+    }
+    if (options.repeats == 0) {
+        throw std::runtime_error("--repeats must be positive");
+    }
+    if (options.cpus.size() > 2) {
+        throw std::runtime_error("--cpus takes one or two CPUs");
+    }
+
+    const std::vector<CpuPlacement> topology = readCpuTopology();
+    if (topology.empty()) {
+        throw std::runtime_error("no usable CPU in this process's affinity");
+    }
+    Env env;
+    env.repeats = options.repeats;
+    env.cpu = options.cpus.empty() ? topology.front().cpu : options.cpus.front();
+    env.peerCpu = options.cpus.size() > 1 ? options.cpus[1] : env.cpu;
+    env.directory = options.directory;
+    for (const auto& placement : topology) {
+        if (placement.cpu != env.cpu && env.others.size() < kMaxSpinners) {
+            env.others.push_back(placement.cpu);
+        }
+    }
+
+    OsBenchResult result;
+    result.os = collectOsInfo();
+    result.hypervisor = detectHypervisor();
+    result.mitigations = readMitigations();
+    for (const auto& test : selected) {
+        result.costs.push_back(test.second(env));
+        if (progress) {
+            progress(result.costs.size(), selected.size());
+        }
+    }
+    return result;
+}
+
+} // namespace statio
@@ -0,0 +1,128 @@
+#include "statio/bench.hpp"
+
+#include "statio/proc_scan.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+bool writeStat(int rootFd, const char* pid, const char* line, std::size_t length) {
+    if (::mkdirat(rootFd, pid, 0755) != 0) {
+        return false;
+    }
+    const int dirFd = ::openat(rootFd, pid, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        return false;
+    }
+    const int fd = ::openat(dirFd, "stat", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ::close(dirFd);
+    if (fd < 0) {
+        return false;
+    }
+    const bool written = ::write(fd, line, length) == static_cast<ssize_t>(length);
+    ::close(fd);
+    return written;
+}
+
+// Writes <pid>/stat for pids 1..tasks under `root`, each a line of the
+// length and shape the kernel writes, so that parsing costs the same.
+void writeSyntheticProc(const std::string& root, std::size_t tasks) {
+    const int rootFd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        throw std::runtime_error("cannot open " + root + ": " + std::strerror(errno));
+    }
+    char name[16];
+    char line[512];
+    for (std::size_t pid = 1; pid <= tasks; ++pid) {
+        std::snprintf(name, sizeof(name), "%zu", pid);
+        const int length = std::snprintf(
+            line, sizeof(line),
+            "%zu (worker-%zu) S 1 %zu %zu 0 -1 4194560 %zu 0 0 0 %zu %zu 0 0 20 0 %zu 0 %zu 28737536 %zu "
+            "18446744073709551615 1 1 0 0 0 0 0 4096 1088 0 0 0 17 %zu 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+            pid, pid % 1000, pid, pid, pid * 7, pid % 5000, pid % 700, 1 + pid % 16, pid * 3, 1000 + pid % 9000,
+            pid % 64);
+        const bool written = length > 0 && writeStat(rootFd, name, line, static_cast<std::size_t>(length));
+        if (!written) {
+            const int error = errno;
+            ::close(rootFd);
+            throw std::runtime_error("cannot write " + root + "/" + name + "/stat: " + std::strerror(error));
+        }
+    }
+    ::close(rootFd);
+}
+
+// Median wall time of one scan, in milliseconds, after one scan that warms
+// the dentry and inode caches and starts the workers.
+ProcScanCase measureScan(const std::string& root, std::size_t workers, std::size_t samples) {
+    ProcScanner scanner(workers, root);
+    ProcessColumns columns;
+    scanner.scan(columns);
+    std::vector<double> times;
+    times.reserve(samples);
+    for (std::size_t i = 0; i < samples; ++i) {
+        const auto started = Clock::now();
+        scanner.scan(columns);
+        times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - started).count());
+    }
+    std::nth_element(times.begin(), times.begin() + static_cast<std::ptrdiff_t>(times.size() / 2), times.end());
+
+    ProcScanCase result;
+    result.workers = workers;
+    result.used = scanner.lastWorkers();
+    result.rows = columns.size();
+    result.scanMs = times[times.size() / 2];
+    return result;
+}
+
+} // namespace
+
+ProcScanResult runProcScanBench(const ProcScanOptions& options,
+                                const std::function<void(std::size_t done, std::size_t total)>& progress) {
+    if (options.samples == 0) {
+        throw std::runtime_error("--samples must be positive");
+    }
+    if (std::find(options.workers.begin(), options.workers.end(), 0) != options.workers.end()) {
+        throw std::runtime_error("--workers must be positive");
+    }
+
+    ProcScanResult result;
+    result.cpus = readCpuTopology().size();
+    std::unique_ptr<ScratchDirectory> scratch;
+    if (options.host) {
+        result.root = "/proc";
+    } else {
+        if (options.tasks == 0) {
+            throw std::runtime_error("--tasks must be positive");
+        }
+        scratch = std::make_unique<ScratchDirectory>(options.directory, "statio-proc");
+        writeSyntheticProc(scratch->path(), options.tasks);
+        result.root = scratch->path();
+    }
+
+    const std::size_t total = options.workers.size() + 1;
+    for (const std::size_t workers : options.workers) {
+        result.cases.push_back(measureScan(result.root, workers, options.samples));
+        if (progress) {
+            progress(result.cases.size(), total);
+        }
+    }
+    result.cases.push_back(measureScan(result.root, 0, options.samples));
+    if (progress) {
+        progress(result.cases.size(), total);
+    }
+    return result;
+}
+
+} // namespace statio
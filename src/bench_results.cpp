@@ -0,0 +1,581 @@
+#include "statio/bench_results.hpp"
+
+#include "statio/bench.hpp"
+#include "statio/history.hpp"
+#include "statio/lz.hpp"
+#include "statio/system_info.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+namespace statio {
+namespace {
+
+constexpr char kResultsMagic[8] = {'S', 'T', 'A', 'T', 'I', 'O', 'B', '1'};
+constexpr std::uint32_t kRunMagic = 0x314e5552; // "RUN1"
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+std::string readFirstLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+// ---- Encoding ------------------------------------------------------------
+
+void putVarint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void putString(std::string& out, const std::string& text) {
+    putVarint(out, text.size());
+    out += text;
+}
+
+void putDouble(std::string& out, double value) {
+    char bytes[sizeof(value)];
+    std::memcpy(bytes, &value, sizeof(value));
+    out.append(bytes, sizeof(bytes));
+}
+
+class Decoder {
+public:
+    explicit Decoder(std::string_view data) : data_(data) {}
+
+    std::uint64_t varint() {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const auto byte = static_cast<std::uint8_t>(take(1)[0]);
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("corrupt results file: varint too long");
+    }
+
+    std::string string() {
+        const std::uint64_t length = varint();
+        return std::string(take(length));
+    }
+
+    double f64() {
+        double value = 0.0;
+        std::memcpy(&value, take(sizeof(value)).data(), sizeof(value));
+        return value;
+    }
+
+private:
+    std::string_view take(std::uint64_t bytes) {
+        if (bytes > data_.size() - pos_) {
+            throw std::runtime_error("corrupt results file: record truncated");
+        }
+        const std::string_view out = data_.substr(pos_, bytes);
+        pos_ += bytes;
+        return out;
+    }
+
+    std::string_view data_;
+    std::size_t pos_ = 0;
+};
+
+std::string encodeRun(const BenchRun& run) {
+    std::string out;
+    putVarint(out, static_cast<std::uint64_t>(run.timestampMs));
+    putString(out, run.label);
+    const HostInventory& host = run.host;
+    putString(out, host.hostname);
+    putString(out, host.cpuModel);
+    putVarint(out, host.logicalThreads);
+    putVarint(out, host.physicalCores);
+    putString(out, host.architecture);
+    putString(out, host.kernel);
+    putString(out, host.distro);
+    putString(out, host.hypervisor);
+    putVarint(out, host.memoryMB);
+    putVarint(out, host.swapMB);
+    putVarint(out, host.numaNodes);
+    putString(out, host.transparentHugepages);
+    putVarint(out, run.metrics.size());
+    for (const auto& metric : run.metrics) {
+        putString(out, metric.name);
+        putString(out, metric.category);
+        putString(out, metric.unit);
+        putVarint(out, metric.higherIsBetter ? 1 : 0);
+        putVarint(out, metric.samples.size());
+        for (const double sample : metric.samples) {
+            putDouble(out, sample);
+        }
+    }
+    return out;
+}
+
+BenchRun decodeRun(std::string_view payload) {
+    Decoder in(payload);
+    BenchRun run;
+    run.timestampMs = static_cast<std::int64_t>(in.varint());
+    run.label = in.string();
+    HostInventory& host = run.host;
+    host.hostname = in.string();
+    host.cpuModel = in.string();
+    host.logicalThreads = static_cast<unsigned int>(in.varint());
+    host.physicalCores = static_cast<unsigned int>(in.varint());
+    host.architecture = in.string();
+    host.kernel = in.string();
+    host.distro = in.string();
+    host.hypervisor = in.string();
+    host.memoryMB = in.varint();
+    host.swapMB = in.varint();
+    host.numaNodes = static_cast<unsigned int>(in.varint());
+    host.transparentHugepages = in.string();
+    const std::uint64_t metrics = in.varint();
+    for (std::uint64_t m = 0; m < metrics; ++m) {
+        BenchMetric metric;
+        metric.name = in.string();
+        metric.category = in.string();
+        metric.unit = in.string();
+        metric.higherIsBetter = in.varint() != 0;
+        const std::uint64_t samples = in.varint();
+        for (std::uint64_t s = 0; s < samples; ++s) {
+            metric.samples.push_back(in.f64());
+        }
+        run.metrics.push_back(std::move(metric));
+    }
+    return run;
+}
+
+// ---- Record suite --------------------------------------------------------
+
+// Collects one sample per metric per repetition; NaN results (a test that
+// could not run here) are dropped rather than recorded.
+class MetricSink {
+public:
+    explicit MetricSink(BenchRun& run) : run_(run) {}
+
+    void add(const std::string& name, const char* category, const char* unit, bool higherIsBetter, double value) {
+        if (std::isnan(value)) {
+            return;
+        }
+        auto it = index_.find(name);
+        if (it == index_.end()) {
+            BenchMetric metric;
+            metric.name = name;
+            metric.category = category;
+            metric.unit = unit;
+            metric.higherIsBetter = higherIsBetter;
+            it = index_.emplace(name, run_.metrics.size()).first;
+            run_.metrics.push_back(std::move(metric));
+        }
+        run_.metrics[it->second].samples.push_back(value);
+    }
+
+private:
+    BenchRun& run_;
+    std::map<std::string, std::size_t> index_;
+};
+
+struct SuiteStep {
+    const char* category;
+    std::function<void(const RecordOptions&, MetricSink&)> run;
+};
+
+void recordCrypto(const RecordOptions&, MetricSink& sink) {
+    CryptoOptions options;
+    options.threads = 1;
+    options.durationMs = 150;
+    for (const auto& r : runCryptoBench(options)) {
+        if (r.supported) {
+            sink.add("crypto." + r.algorithm + "." + r.implementation, "cpu", "GB/s", true, r.singleGBps);
+        }
+    }
+}
+
+// One thread and every usable CPU, named "1t" and "all" so that hosts
+// with different CPU counts still line up.
+void recordContention(const RecordOptions&, MetricSink& sink) {
+    ContentionOptions options;
+    for (const auto& placement : readCpuTopology()) {
+        options.cpus.push_back(placement.cpu);
+    }
+    options.threads = {1};
+    if (options.cpus.size() > 1) {
+        options.threads.push_back(options.cpus.size());
+    }
+    options.durationMs = 100;
+    for (const auto& point : runContention(options).points) {
+        for (std::size_t p = 0; p < kSyncPrimitiveCount; ++p) {
+            sink.add(std::string("contention.") + syncPrimitiveName(static_cast<SyncPrimitive>(p)) +
+                         (point.threads == 1 ? ".1t" : ".all"),
+                     "coherence", "Mops/s", true, point.mopsPerSec[p]);
+        }
+    }
+}
+
+void recordCoreToCore(const RecordOptions&, MetricSink& sink) {
+    if (readCpuTopology().size() < 2) {
+        return;
+    }
+    C2cOptions options;
+    options.roundTrips = 500;
+    options.samples = 3;
+    const C2cResult result = runCoreToCore(options);
+    double sum = 0.0;
+    double best = kNaN;
+    std::size_t pairs = 0;
+    for (const double ns : result.oneWayNs) {
+        if (!std::isnan(ns)) {
+            sum += ns;
+            best = std::isnan(best) ? ns : std::min(best, ns);
+            ++pairs;
+        }
+    }
+    sink.add("c2c.avg", "coherence", "ns", false, pairs == 0 ? kNaN : sum / static_cast<double>(pairs));
+    sink.add("c2c.min", "coherence", "ns", false, best);
+}
+
+void recordOsCosts(const RecordOptions&, MetricSink& sink) {
+    OsBenchOptions options;
+    options.tests = {"syscall", "ctx-pipe", "ctx-futex", "thread-create", "fault-minor", "mmap-munmap"};
+    options.repeats = 3;
+    for (const auto& cost : runOsCosts(options).costs) {
+        sink.add("os." + cost.test, "os", "ns", false, cost.medianNs);
+    }
+}
+
+void recordWakeup(const RecordOptions&, MetricSink& sink) {
+    WakeupOptions options;
+    options.durationMs = 1000;
+    const WakeupResult result = runWakeupLatency(options);
+    sink.add("wakeup.p50", "os", "us", false, result.all.p50Us);
+    sink.add("wakeup.p99", "os", "us", false, result.all.p99Us);
+}
+
+void recordNet(const RecordOptions&, MetricSink& sink) {
+    NetOptions options;
+    options.sizes = {64};
+    options.connections = 2;
+    options.durationMs = 200;
+    for (const auto& c : runNetBench(options)) {
+        if (c.test == "stream") {
+            sink.add("net." + c.transport + ".stream64", "network", "msg/s", true, c.messagesPerSec);
+        } else if (c.test == "rr") {
+            sink.add("net." + c.transport + ".rr.p50", "network", "us", false, c.p50Us);
+        }
+    }
+}
+
+void recordFs(const RecordOptions& record, MetricSink& sink) {
+    FsBenchOptions options;
+    options.directory = record.directory;
+    options.threads = 2;
+    options.files = 200;
+    options.syncs = 50;
+    for (const auto& r : runFsBench(options)) {
+        if (!r.error.empty()) {
+            throw std::runtime_error(r.error);
+        }
+        sink.add("fs.create", "storage", "ops/s", true, r.createPerSec);
+        sink.add("fs.stat", "storage", "ops/s", true, r.statPerSec);
+        sink.add("fs.rename", "storage", "ops/s", true, r.renamePerSec);
+        sink.add("fs.unlink", "storage", "ops/s", true, r.unlinkPerSec);
+        sink.add("fs.fsync.p50", "storage", "us", false, r.fsync.samples == 0 ? kNaN : r.fsync.p50Us);
+        sink.add("fs.fdatasync.p50", "storage", "us", false, r.fdatasync.samples == 0 ? kNaN : r.fdatasync.p50Us);
+    }
+}
+
+const std::vector<SuiteStep>& suite() {
+    static const std::vector<SuiteStep> steps = {
+        {"cpu", recordCrypto},         {"coherence", recordContention}, {"coherence", recordCoreToCore},
+        {"os", recordOsCosts},         {"os", recordWakeup},            {"network", recordNet},
+        {"storage", recordFs},
+    };
+    return steps;
+}
+
+// ---- Statistics ----------------------------------------------------------
+
+struct Summary {
+    std::size_t n = 0;
+    double mean = kNaN;
+    double variance = kNaN; // sample variance, NaN below two samples
+};
+
+Summary summarize(const std::vector<double>& samples) {
+    Summary s;
+    s.n = samples.size();
+    if (s.n == 0) {
+        return s;
+    }
+    double sum = 0.0;
+    for (const double x : samples) {
+        sum += x;
+    }
+    s.mean = sum / static_cast<double>(s.n);
+    if (s.n > 1) {
+        double squares = 0.0;
+        for (const double x : samples) {
+            squares += (x - s.mean) * (x - s.mean);
+        }
+        s.variance = squares / static_cast<double>(s.n - 1);
+    }
+    return s;
+}
+
+// Two-sided 95% Student t quantile. Fractional degrees of freedom (Welch)
+// round down, which widens the interval slightly; past 30 the
+// Cornish-Fisher expansion around the normal quantile is within 0.001.
+double tCritical95(double df) {
+    static const double table[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                     2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                     2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (!(df >= 1.0)) {
+        return kNaN;
+    }
+    if (df < 31.0) {
+        return table[static_cast<std::size_t>(df) - 1];
+    }
+    const double z = 1.959964;
+    const double z3 = z * z * z;
+    const double z5 = z3 * z * z;
+    return z + (z3 + z) / (4.0 * df) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * df * df);
+}
+
+void addDifference(std::vector<std::string>& out, const char* field, const std::string& a, const std::string& b) {
+    if (a != b) {
+        out.push_back(std::string(field) + ": " + (a.empty() ? "-" : a) + " -> " + (b.empty() ? "-" : b));
+    }
+}
+
+std::vector<std::string> hostDifferences(const HostInventory& a, const HostInventory& b) {
+    std::vector<std::string> out;
+    addDifference(out, "hostname", a.hostname, b.hostname);
+    addDifference(out, "cpu", a.cpuModel, b.cpuModel);
+    addDifference(out, "threads", std::to_string(a.logicalThreads), std::to_string(b.logicalThreads));
+    addDifference(out, "cores", std::to_string(a.physicalCores), std::to_string(b.physicalCores));
+    addDifference(out, "architecture", a.architecture, b.architecture);
+    addDifference(out, "kernel", a.kernel, b.kernel);
+    addDifference(out, "distro", a.distro, b.distro);
+    addDifference(out, "hypervisor", a.hypervisor, b.hypervisor);
+    addDifference(out, "memory MB", std::to_string(a.memoryMB), std::to_string(b.memoryMB));
+    addDifference(out, "swap MB", std::to_string(a.swapMB), std::to_string(b.swapMB));
+    addDifference(out, "numa nodes", std::to_string(a.numaNodes), std::to_string(b.numaNodes));
+    addDifference(out, "thp", a.transparentHugepages, b.transparentHugepages);
+    return out;
+}
+
+} // namespace
+
+HostInventory collectHostInventory() {
+    HostInventory host;
+    const CpuInfo cpu = collectCpuInfo(SourceCpuInfo);
+    const OsInfo os = collectOsInfo();
+    const MemoryInfo memory = collectMemoryInfo();
+    host.hostname = os.hostname;
+    host.cpuModel = cpu.model;
+    host.logicalThreads = cpu.logicalThreads;
+    host.physicalCores = cpu.physicalCores;
+    host.architecture = os.architecture;
+    host.kernel = os.kernel;
+    host.distro = os.version.empty() ? os.distro : os.distro + " " + os.version;
+    host.hypervisor = detectHypervisor();
+    host.memoryMB = memory.totalMB;
+    host.swapMB = memory.swapTotalMB;
+    host.numaNodes = static_cast<unsigned int>(parseCpuList(readFirstLine("/sys/devices/system/node/online")).size());
+    // "always [madvise] never": the bracketed word is the active mode.
+    const std::string thp = readFirstLine("/sys/kernel/mm/transparent_hugepage/enabled");
+    const std::size_t open = thp.find('[');
+    const std::size_t close = thp.find(']', open);
+    if (open != std::string::npos && close != std::string::npos) {
+        host.transparentHugepages = thp.substr(open + 1, close - open - 1);
+    }
+    return host;
+}
+
+void appendBenchRun(const std::string& path, const BenchRun& run) {
+    std::error_code ec;
+    const bool fresh = !std::filesystem::exists(path, ec) || std::filesystem::file_size(path, ec) == 0;
+    if (!fresh) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[sizeof(kResultsMagic)] = {};
+        in.read(magic, sizeof(magic));
+        if (!in || std::memcmp(magic, kResultsMagic, sizeof(magic)) != 0) {
+            throw std::runtime_error(path + " is not a statio results file");
+        }
+    }
+    const std::string raw = encodeRun(run);
+    std::string packed;
+    lzCompress(raw, packed);
+    const std::uint32_t header[3] = {kRunMagic, static_cast<std::uint32_t>(raw.size()),
+                                     static_cast<std::uint32_t>(packed.size())};
+
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    if (!out) {
+        throw std::runtime_error("cannot open " + path + " for appending");
+    }
+    if (fresh) {
+        out.write(kResultsMagic, sizeof(kResultsMagic));
+    }
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(packed.data(), static_cast<std::streamsize>(packed.size()));
+    if (!out.flush()) {
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+std::vector<BenchRun> readBenchRuns(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(kResultsMagic) || std::memcmp(data.data(), kResultsMagic, sizeof(kResultsMagic)) != 0) {
+        throw std::runtime_error(path + " is not a statio results file");
+    }
+    std::vector<BenchRun> runs;
+    std::size_t pos = sizeof(kResultsMagic);
+    std::string raw;
+    while (pos < data.size()) {
+        std::uint32_t header[3];
+        if (data.size() - pos < sizeof(header)) {
+            throw std::runtime_error("corrupt results file " + path + ": truncated record header");
+        }
+        std::memcpy(header, data.data() + pos, sizeof(header));
+        pos += sizeof(header);
+        if (header[0] != kRunMagic || header[2] > data.size() - pos) {
+            throw std::runtime_error("corrupt results file " + path + ": bad record");
+        }
+        raw.clear();
+        lzDecompress(std::string_view(data).substr(pos, header[2]), header[1], raw);
+        pos += header[2];
+        runs.push_back(decodeRun(raw));
+    }
+    return runs;
+}
+
+const std::vector<std::string>& benchCategories() {
+    static const std::vector<std::string> names = {"cpu", "coherence", "os", "network", "storage"};
+    return names;
+}
+
+BenchRun recordBenchSuite(const RecordOptions& options,
+                          const std::function<void(std::size_t done, std::size_t total)>& progress) {
+    if (options.runs == 0) {
+        throw std::runtime_error("--runs must be positive");
+    }
+    for (const auto& category : options.categories) {
+        if (std::find(benchCategories().begin(), benchCategories().end(), category) == benchCategories().end()) {
+            throw std::runtime_error("unknown category '" + category + "' (cpu, coherence, os, network, storage)");
+        }
+    }
+    std::vector<const SuiteStep*> steps;
+    for (const auto& step : suite()) {
+        if (options.categories.empty() ||
+            std::find(options.categories.begin(), options.categories.end(), step.category) != options.categories.end()) {
+            steps.push_back(&step);
+        }
+    }
+
+    BenchRun run;
+    run.timestampMs = currentTimeMs();
+    run.label = options.label;
+    run.host = collectHostInventory();
+    MetricSink sink(run);
+    const std::size_t total = options.runs * steps.size();
+    std::size_t done = 0;
+    for (std::size_t repetition = 0; repetition < options.runs; ++repetition) {
+        for (const SuiteStep* step : steps) {
+            step->run(options, sink);
+            if (progress) {
+                progress(++done, total);
+            }
+        }
+    }
+    return run;
+}
+
+BenchComparison compareBenchRuns(const BenchRun& baseline, const BenchRun& candidate) {
+    BenchComparison comparison;
+    comparison.hostDifferences = hostDifferences(baseline.host, candidate.host);
+
+    std::map<std::string, const BenchMetric*> candidates;
+    for (const auto& metric : candidate.metrics) {
+        candidates[metric.name] = &metric;
+    }
+    std::map<std::string, std::pair<double, std::size_t>> logRatios; // category -> (sum, count)
+    for (const auto& base : baseline.metrics) {
+        auto it = candidates.find(base.name);
+        if (it == candidates.end()) {
+            comparison.missing.push_back(base.name + " (baseline only)");
+            continue;
+        }
+        const BenchMetric& next = *it->second;
+        candidates.erase(it);
+        const Summary b = summarize(base.samples);
+        const Summary c = summarize(next.samples);
+        if (b.n == 0 || c.n == 0) {
+            continue;
+        }
+
+        MetricComparison m;
+        m.name = base.name;
+        m.category = base.category;
+        m.unit = base.unit;
+        m.higherIsBetter = base.higherIsBetter;
+        m.baselineMean = b.mean;
+        m.candidateMean = c.mean;
+        const double scale = b.mean == 0.0 ? kNaN : 100.0 / b.mean;
+        const double difference = c.mean - b.mean;
+        m.deltaPct = difference * scale;
+        m.ciLowPct = m.ciHighPct = kNaN;
+        if (b.n > 1 && c.n > 1) {
+            const double vb = b.variance / static_cast<double>(b.n);
+            const double vc = c.variance / static_cast<double>(c.n);
+            const double se = std::sqrt(vb + vc);
+            double halfWidth = 0.0;
+            if (se > 0.0) {
+                const double df = (vb + vc) * (vb + vc) /
+                                  (vb * vb / static_cast<double>(b.n - 1) + vc * vc / static_cast<double>(c.n - 1));
+                halfWidth = tCritical95(df) * se;
+            }
+            m.ciLowPct = (difference - halfWidth) * scale;
+            m.ciHighPct = (difference + halfWidth) * scale;
+            if (m.ciLowPct > 0.0) {
+                m.change = m.higherIsBetter ? BenchChange::Better : BenchChange::Worse;
+            } else if (m.ciHighPct < 0.0) {
+                m.change = m.higherIsBetter ? BenchChange::Worse : BenchChange::Better;
+            }
+        }
+        if (b.mean > 0.0 && c.mean > 0.0) {
+            auto& [sum, count] = logRatios[m.category];
+            sum += std::log(m.higherIsBetter ? c.mean / b.mean : b.mean / c.mean);
+            ++count;
+        }
+        comparison.metrics.push_back(std::move(m));
+    }
+    for (const auto& rest : candidates) {
+        comparison.missing.push_back(rest.first + " (candidate only)");
+    }
+
+    for (const auto& category : benchCategories()) {
+        auto it = logRatios.find(category);
+        if (it != logRatios.end()) {
+            const auto [sum, count] = it->second;
+            comparison.scores.push_back({category, 100.0 * std::exp(sum / static_cast<double>(count)), count});
+        }
+    }
+    return comparison;
+}
+
+} // namespace statio
@@ -0,0 +1,239 @@
+#include "statio/bench.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+namespace statio {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+constexpr std::size_t kLineBytes = 64;
+constexpr std::size_t kLineWords = kLineBytes / sizeof(std::uint64_t);
+
+volatile std::uint64_t gSink = 0; // keeps the measured loads observable
+
+struct PageKind {
+    const char* name;
+    std::size_t pageBytes;
+    bool hugetlb;
+};
+
+constexpr PageKind kPageKinds[] = {
+    {"4k", 4096, false},
+    {"thp", 2U << 20, false},
+    {"2m", 2U << 20, true},
+    {"1g", 1U << 30, true},
+};
+
+std::uint64_t nextRandom(std::uint64_t& x) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+}
+
+// An anonymous mapping of `bytes`, aligned to the page size; empty when
+// the kernel refused it.
+class Mapping {
+public:
+    Mapping(const PageKind& kind, std::size_t bytes) {
+        if (kind.hugetlb) {
+            const int shift = __builtin_ctzll(kind.pageBytes);
+            base_ = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+            data_ = base_ == MAP_FAILED ? nullptr : base_;
+            length_ = bytes;
+            return;
+        }
+        // Over-allocate by one huge page so the THP buffer starts on a 2 MiB
+        // boundary; otherwise the first and last partial extents stay small.
+        length_ = bytes + kind.pageBytes;
+        base_ = ::mmap(nullptr, length_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base_ == MAP_FAILED) {
+            return;
+        }
+        const auto address = reinterpret_cast<std::uintptr_t>(base_);
+        data_ = reinterpret_cast<void*>((address + kind.pageBytes - 1) & ~(kind.pageBytes - 1));
+        ::madvise(data_, bytes, kind.pageBytes == 4096 ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+    }
+
+    ~Mapping() {
+        if (base_ != MAP_FAILED) {
+            ::munmap(base_, length_);
+        }
+    }
+
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    std::uint64_t* words() const { return static_cast<std::uint64_t*>(data_); }
+
+private:
+    void* base_ = MAP_FAILED;
+    void* data_ = nullptr;
+    std::size_t length_ = 0;
+};
+
+// AnonHugePages of the VMA containing `address`, from /proc/self/smaps.
+std::uint64_t anonHugeBytes(const void* address) {
+    const auto target = reinterpret_cast<std::uintptr_t>(address);
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool inside = false;
+    while (std::getline(smaps, line)) {
+        unsigned long long start = 0;
+        unsigned long long end = 0;
+        if (std::sscanf(line.c_str(), "%llx-%llx ", &start, &end) == 2 && line.find(':') > line.find(' ')) {
+            inside = target >= start && target < end;
+            continue;
+        }
+        if (inside && line.rfind("AnonHugePages:", 0) == 0) {
+            std::istringstream fields(line.substr(std::strlen("AnonHugePages:")));
+            std::uint64_t kb = 0;
+            fields >> kb;
+            return kb * 1024;
+        }
+    }
+    return 0;
+}
+
+// A single random cycle through `lines` (Sattolo's shuffle), so the chase
+// visits every line once before repeating.
+std::vector<std::uint32_t> randomCycle(std::size_t lines) {
+    std::vector<std::uint32_t> order(lines);
+    for (std::size_t i = 0; i < lines; ++i) {
+        order[i] = static_cast<std::uint32_t>(i);
+    }
+    std::uint64_t x = 0x2545f4914f6cdd1dULL;
+    for (std::size_t i = lines - 1; i > 0; --i) {
+        std::swap(order[i], order[nextRandom(x) % i]);
+    }
+    return order;
+}
+
+double chase(const std::uint64_t* words, std::uint64_t start, std::size_t accesses, std::uint64_t& sink) {
+    std::uint64_t line = start;
+    for (std::size_t i = 0; i < accesses / 8; ++i) { // warm the caches and TLBs as far as they go
+        line = words[line * kLineWords];
+    }
+    const auto started = Clock::now();
+    for (std::size_t i = 0; i < accesses; ++i) {
+        line = words[line * kLineWords];
+    }
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - started).count();
+    sink += line;
+    return ns / static_cast<double>(accesses);
+}
+
+double gather(const std::uint64_t* words, std::size_t lines, std::size_t accesses, std::uint64_t& sink) {
+    std::uint64_t x = 0x9e3779b97f4a7c15ULL;
+    std::uint64_t sum = 0;
+    const auto started = Clock::now();
+    for (std::size_t i = 0; i < accesses; ++i) {
+        sum += words[(nextRandom(x) % lines) * kLineWords];
+    }
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - started).count();
+    sink += sum;
+    return ns / static_cast<double>(accesses);
+}
+
+TlbCase measureCase(const PageKind& kind, const TlbOptions& options, const std::vector<std::uint32_t>& order,
+                    const HugePageInfo& hugepages, std::uint64_t& sink) {
+    TlbCase result;
+    result.page = kind.name;
+    const std::size_t working = options.sizeMB << 20;
+    result.bytes = (working + kind.pageBytes - 1) / kind.pageBytes * kind.pageBytes;
+    result.chaseNs = result.gatherNs = result.hugeFraction = kNaN;
+
+    Mapping mapping(kind, result.bytes);
+    if (mapping.words() == nullptr) {
+        const std::uint64_t pageKB = kind.pageBytes / 1024;
+        auto pool = std::find_if(hugepages.pools.begin(), hugepages.pools.end(),
+                                 [pageKB](const HugePagePool& p) { return p.pageKB == pageKB; });
+        if (kind.hugetlb && pool == hugepages.pools.end()) {
+            result.note = "no " + std::to_string(pageKB) + " kB hugetlb pool on this host";
+        } else if (kind.hugetlb) {
+            result.note = std::to_string(pool->free) + " free " + std::to_string(pageKB) + " kB pages, need " +
+                          std::to_string(result.bytes / kind.pageBytes) + " (raise nr_hugepages)";
+        } else {
+            result.note = std::string("mmap failed: ") + std::strerror(errno);
+        }
+        return result;
+    }
+
+    // Writing the cycle faults in every page of the working set.
+    std::uint64_t* words = mapping.words();
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        words[static_cast<std::size_t>(order[i]) * kLineWords] = order[(i + 1) % order.size()];
+    }
+    result.hugeFraction = kind.hugetlb ? 1.0
+                                       : static_cast<double>(anonHugeBytes(words)) / static_cast<double>(result.bytes);
+    result.chaseNs = chase(words, order.front(), options.accesses, sink);
+    result.gatherNs = gather(words, order.size(), options.accesses, sink);
+    if (std::string(kind.name) == "thp" && result.hugeFraction < 0.9) {
+        result.note = hugepages.thpEnabled == "never" ? "THP disabled (transparent_hugepage/enabled = never)"
+                                                      : "THP only partly backed: fragmented memory or khugepaged behind";
+    }
+    return result;
+}
+
+} // namespace
+
+TlbResult runTlbBench(const TlbOptions& options,
+                      const std::function<void(std::size_t done, std::size_t total)>& progress) {
+    if (options.sizeMB == 0 || options.accesses == 0) {
+        throw std::runtime_error("--size-mb and --accesses must be positive");
+    }
+    std::vector<const PageKind*> kinds;
+    for (const auto& kind : kPageKinds) {
+        if (options.pages.empty() ||
+            std::find(options.pages.begin(), options.pages.end(), kind.name) != options.pages.end()) {
+            kinds.push_back(&kind);
+        }
+    }
+    for (const auto& page : options.pages) {
+        if (std::none_of(std::begin(kPageKinds), std::end(kPageKinds),
+                         [&page](const PageKind& kind) { return page == kind.name; })) {
+            throw std::runtime_error("unknown page size '" + page + "' (4k, thp, 2m, 1g)");
+        }
+    }
+    const MemoryInfo memory = collectMemoryInfo();
+    if (memory.availableMB != 0 && options.sizeMB > memory.availableMB / 2) {
+        throw std::runtime_error("--size-mb " + std::to_string(options.sizeMB) + " exceeds half of the " +
+                                 std::to_string(memory.availableMB) + " MB available");
+    }
+    const std::size_t lines = (options.sizeMB << 20) / kLineBytes;
+    if (lines > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::runtime_error("--size-mb too large");
+    }
+
+    TlbResult result;
+    result.hugepages = collectHugePageInfo();
+    const std::vector<std::uint32_t> order = randomCycle(lines);
+    std::uint64_t sink = 0;
+    for (const PageKind* kind : kinds) {
+        result.cases.push_back(measureCase(*kind, options, order, result.hugepages, sink));
+        if (progress) {
+            progress(result.cases.size(), kinds.size());
+        }
+    }
+    gSink = sink;
+    return result;
+}
+
+} // namespace statio
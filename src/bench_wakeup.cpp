@@ -0,0 +1,142 @@
+#include "statio/bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <thread>
+#include <time.h>
+
+namespace statio {
+namespace {
+
+constexpr std::int64_t kNsPerSec = 1000000000LL;
+
+std::int64_t toNs(const timespec& ts) {
+    return static_cast<std::int64_t>(ts.tv_sec) * kNsPerSec + ts.tv_nsec;
+}
+
+timespec fromNs(std::int64_t ns) {
+    timespec ts {};
+    ts.tv_sec = static_cast<time_t>(ns / kNsPerSec);
+    ts.tv_nsec = static_cast<long>(ns % kNsPerSec);
+    return ts;
+}
+
+struct TimerThread {
+    int cpu = 0;
+    LatencyHistogram histogram; // written only by this CPU's thread
+    bool pinned = true;
+    bool realtime = true;
+};
+
+WakeupStats summarize(int cpu, const LatencyHistogram& histogram) {
+    WakeupStats stats;
+    stats.cpu = cpu;
+    stats.samples = histogram.count();
+    stats.minUs = static_cast<double>(histogram.min()) / 1000.0;
+    stats.avgUs = histogram.mean() / 1000.0;
+    stats.p50Us = histogram.quantile(0.5) / 1000.0;
+    stats.p99Us = histogram.quantile(0.99) / 1000.0;
+    stats.p9999Us = histogram.quantile(0.9999) / 1000.0;
+    stats.maxUs = static_cast<double>(histogram.max()) / 1000.0;
+    return stats;
+}
+
+} // namespace
+
+WakeupResult runWakeupLatency(const WakeupOptions& options) {
+    if (options.intervalUs <= 0 || options.durationMs <= 0) {
+        throw std::runtime_error("--interval-us and --duration must be positive");
+    }
+    const int maxPriority = ::sched_get_priority_max(SCHED_FIFO);
+    if (options.priority < 0 || options.priority > maxPriority) {
+        throw std::runtime_error("--priority must be 0 (SCHED_OTHER) or 1.." + std::to_string(maxPriority));
+    }
+
+    std::vector<int> cpus = options.cpus;
+    if (cpus.empty()) {
+        for (const auto& placement : readCpuTopology()) {
+            cpus.push_back(placement.cpu);
+        }
+    }
+
+    // The histograms are zeroed, hence faulted in, before the clock starts,
+    // and locked so that they stay resident. MCL_FUTURE is left out: it
+    // would count the memory load's buffers against RLIMIT_MEMLOCK.
+    std::vector<std::unique_ptr<TimerThread>> timers;
+    for (const int cpu : cpus) {
+        timers.push_back(std::make_unique<TimerThread>());
+        timers.back()->cpu = cpu;
+    }
+    const bool locked = ::mlockall(MCL_CURRENT) == 0;
+
+    {
+        BackgroundLoad load(options.load, cpus);
+        std::atomic<bool> go{false};
+        std::vector<std::thread> threads;
+        for (auto& timer : timers) {
+            threads.emplace_back([&options, &go, &timer = *timer] {
+                timer.pinned = pinCurrentThread(timer.cpu);
+                if (options.priority > 0) {
+                    sched_param param {};
+                    param.sched_priority = options.priority;
+                    timer.realtime = ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param) == 0;
+                }
+                while (!go.load()) {
+                    std::this_thread::yield();
+                }
+                if (!timer.pinned) {
+                    return;
+                }
+
+                const std::int64_t intervalNs = options.intervalUs * 1000;
+                timespec now {};
+                ::clock_gettime(CLOCK_MONOTONIC, &now);
+                const std::int64_t end = toNs(now) + options.durationMs * 1000000LL;
+                std::int64_t next = toNs(now) + intervalNs;
+                while (next < end) {
+                    const timespec deadline = fromNs(next);
+                    while (::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+                    }
+                    ::clock_gettime(CLOCK_MONOTONIC, &now);
+                    const std::int64_t woke = toNs(now);
+                    timer.histogram.record(static_cast<std::uint64_t>(std::max<std::int64_t>(0, woke - next)));
+                    // Deadlines overrun by a long stall are skipped, not
+                    // replayed back to back.
+                    next += intervalNs;
+                    if (next <= woke) {
+                        next += ((woke - next) / intervalNs + 1) * intervalNs;
+                    }
+                }
+            });
+        }
+        go = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    if (locked) {
+        ::munlockall();
+    }
+
+    WakeupResult result;
+    result.realtime = options.priority > 0;
+    LatencyHistogram all;
+    for (const auto& timer : timers) {
+        if (!timer->pinned) {
+            throw std::runtime_error("cannot pin a thread to cpu " + std::to_string(timer->cpu));
+        }
+        result.realtime = result.realtime && timer->realtime;
+        result.perCpu.push_back(summarize(timer->cpu, timer->histogram));
+        all.merge(timer->histogram);
+    }
+    result.all = summarize(-1, all);
+    return result;
+}
+
+} // namespace statio
@@ -0,0 +1,594 @@
+#include "statio/burst.hpp"
+
+#include "statio/cli_options.hpp"
+#include "statio/latency.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+constexpr std::size_t kSkipped = static_cast<std::size_t>(-1);
+
+const char* const kCpuFields[] = {"cpu.user", "cpu.nice", "cpu.system", "cpu.idle",
+                                  "cpu.iowait", "cpu.irq", "cpu.softirq", "cpu.steal"};
+const char* const kNetFields[] = {"network.rx_bytes", "network.tx_bytes"};
+const char* const kDiskFields[] = {"disk.reads", "disk.writes", "disk.read_bytes", "disk.write_bytes", "disk.busy_ms"};
+
+// SIGUSR1 lands here; the handler only touches async-signal-safe state.
+std::atomic<int> signalWakeFd{-1};
+volatile std::sig_atomic_t signalRequested = 0;
+
+void onBurstSignal(int) {
+    signalRequested = 1;
+    const int fd = signalWakeFd.load();
+    if (fd >= 0) {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] const ssize_t n = ::write(fd, &one, sizeof(one));
+    }
+}
+
+std::int64_t steadyMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    return p;
+}
+
+// Parses the next unsigned field; a missing field reads as 0.
+const char* nextNumber(const char* p, const char* end, double& out) {
+    p = skipSpaces(p, end);
+    std::uint64_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + static_cast<std::uint64_t>(*p - '0');
+        ++p;
+    }
+    out = static_cast<double>(value);
+    return p;
+}
+
+const char* lineEnd(const char* p, const char* end) {
+    const void* nl = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+    return nl ? static_cast<const char*>(nl) : end;
+}
+
+sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("socket path too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+} // namespace
+
+unsigned parseBurstCollectors(const std::string& list) {
+    unsigned mask = 0;
+    for (const auto& item : splitList(list)) {
+        if (item == "cpu") {
+            mask |= BurstCpu;
+        } else if (item == "net" || item == "network") {
+            mask |= BurstNetwork;
+        } else if (item == "disk") {
+            mask |= BurstDisk;
+        } else if (item == "all") {
+            mask |= BurstAll;
+        } else {
+            throw std::runtime_error("unknown burst collector: " + item + " (expected cpu, net, disk or all)");
+        }
+    }
+    if (mask == 0) {
+        throw std::runtime_error("no burst collectors selected");
+    }
+    return mask;
+}
+
+BurstSampler::BurstSampler(unsigned collectors, IoBackend io) : reader_(io, kBatchFileBytes) {
+    const std::pair<unsigned, const char*> paths[] = {
+        {BurstCpu, "/proc/stat"}, {BurstNetwork, "/proc/net/dev"}, {BurstDisk, "/proc/diskstats"}};
+    for (const auto& [collector, path] : paths) {
+        if ((collectors & collector) == 0) {
+            continue;
+        }
+        Source source;
+        source.collector = collector;
+        source.slot = reader_.add(path);
+        if (source.slot == BatchReader::npos) {
+            std::cerr << "statio: burst collector unavailable: " << path << ": " << std::strerror(errno) << '\n';
+            continue;
+        }
+        sources_.push_back(std::move(source));
+    }
+}
+
+BurstSampler::~BurstSampler() = default;
+
+MetricSample BurstSampler::describe(std::size_t index) const {
+    std::lock_guard<std::mutex> lock(seriesMutex_);
+    return series_[index];
+}
+
+bool BurstSampler::read(Source& source) {
+    if (reader_.error(source.slot) != 0) {
+        return false;
+    }
+    text_ = reader_.data(source.slot);
+    if (text_.size() < kBatchFileBytes) {
+        return true;
+    }
+    // The batch cut the file. procfs regenerates the whole file on every
+    // read from offset 0; grow the buffer until one read returns it all.
+    if (buffer_.size() <= kBatchFileBytes) {
+        buffer_.assign(2 * kBatchFileBytes, '\0');
+    }
+    for (;;) {
+        const ssize_t n = ::pread(reader_.fd(source.slot), buffer_.data(), buffer_.size(), 0);
+        if (n < 0) {
+            return false;
+        }
+        if (static_cast<std::size_t>(n) < buffer_.size()) {
+            text_ = std::string_view(buffer_.data(), static_cast<std::size_t>(n));
+            return true;
+        }
+        buffer_.resize(buffer_.size() * 2);
+    }
+}
+
+std::size_t BurstSampler::slotsFor(Source& source, std::size_t line, std::string_view entity) {
+    if (line < source.lineNames.size() && source.lineNames[line] == entity) {
+        return source.lineSlots[line];
+    }
+    if (line >= source.lineNames.size()) {
+        source.lineNames.resize(line + 1);
+        source.lineSlots.resize(line + 1, kSkipped);
+    }
+    source.lineNames[line].assign(entity);
+
+    std::string key = std::to_string(source.collector);
+    key += ':';
+    key += entity;
+    auto it = slotIndex_.find(key);
+    if (it == slotIndex_.end()) {
+        const char* const* fields = nullptr;
+        std::size_t count = 0;
+        MetricKind kind = MetricKind::Counter;
+        if (source.collector == BurstCpu) {
+            fields = kCpuFields;
+            count = std::size(kCpuFields);
+        } else if (source.collector == BurstNetwork) {
+            fields = kNetFields;
+            count = std::size(kNetFields);
+        } else if (isWholeBlockDevice(std::string(entity))) {
+            fields = kDiskFields;
+            count = std::size(kDiskFields);
+        }
+
+        std::size_t first = kSkipped;
+        if (count > 0) {
+            std::lock_guard<std::mutex> lock(seriesMutex_);
+            first = series_.size();
+            for (std::size_t i = 0; i < count; ++i) {
+                MetricSample sample;
+                sample.name = fields[i];
+                sample.entity = std::string(entity);
+                sample.kind = kind;
+                sample.value = kNaN;
+                series_.push_back(std::move(sample));
+            }
+        }
+        it = slotIndex_.emplace(std::move(key), first).first;
+    }
+    source.lineSlots[line] = it->second;
+    return it->second;
+}
+
+bool BurstSampler::sample(std::vector<double>& values) {
+    values.assign(series_.size(), kNaN);
+    if (sources_.empty()) {
+        return false;
+    }
+    reader_.read();
+    bool any = false;
+    for (auto& source : sources_) {
+        if (!read(source)) {
+            continue;
+        }
+        any = true;
+        switch (source.collector) {
+        case BurstCpu:
+            parseStat(source, values);
+            break;
+        case BurstNetwork:
+            parseNetDev(source, values);
+            break;
+        case BurstDisk:
+            parseDiskstats(source, values);
+            break;
+        }
+    }
+    return any;
+}
+
+void BurstSampler::parseStat(Source& source, std::vector<double>& values) {
+    const char* p = text_.data();
+    const char* end = p + text_.size();
+    for (std::size_t line = 0; p < end; ++line) {
+        const char* eol = lineEnd(p, end);
+        if (eol - p < 3 || std::memcmp(p, "cpu", 3) != 0) {
+            break; // the cpu lines come first
+        }
+        const char* name = p;
+        while (p < eol && *p != ' ') {
+            ++p;
+        }
+        const std::size_t slot = slotsFor(source, line, std::string_view(name, static_cast<std::size_t>(p - name)));
+        if (slot != kSkipped) {
+            values.resize(series_.size(), kNaN);
+            for (std::size_t i = 0; i < std::size(kCpuFields); ++i) {
+                p = nextNumber(p, eol, values[slot + i]);
+            }
+        }
+        p = eol + 1;
+    }
+}
+
+void BurstSampler::parseNetDev(Source& source, std::vector<double>& values) {
+    const char* p = text_.data();
+    const char* end = p + text_.size();
+    // Two header lines, then "  name: rx_bytes packets errs drop fifo frame
+    // compressed multicast tx_bytes ...".
+    for (std::size_t line = 0; p < end; ++line) {
+        const char* eol = lineEnd(p, end);
+        const char* colon = static_cast<const char*>(std::memchr(p, ':', static_cast<std::size_t>(eol - p)));
+        if (line >= 2 && colon) {
+            const char* name = skipSpaces(p, colon);
+            const std::size_t slot =
+                slotsFor(source, line, std::string_view(name, static_cast<std::size_t>(colon - name)));
+            if (slot != kSkipped) {
+                values.resize(series_.size(), kNaN);
+                double field[9] = {};
+                const char* q = colon + 1;
+                for (auto& f : field) {
+                    q = nextNumber(q, eol, f);
+                }
+                values[slot] = field[0];
+                values[slot + 1] = field[8];
+            }
+        }
+        p = eol + 1;
+    }
+}
+
+void BurstSampler::parseDiskstats(Source& source, std::vector<double>& values) {
+    const char* p = text_.data();
+    const char* end = p + text_.size();
+    // major minor name reads merged sectors read_ms writes merged sectors
+    // write_ms in_flight io_ms ...
+    for (std::size_t line = 0; p < end; ++line) {
+        const char* eol = lineEnd(p, end);
+        double ignored = 0.0;
+        const char* q = nextNumber(p, eol, ignored);
+        q = nextNumber(q, eol, ignored);
+        q = skipSpaces(q, eol);
+        const char* name = q;
+        while (q < eol && *q != ' ') {
+            ++q;
+        }
+        if (q > name) {
+            const std::size_t slot = slotsFor(source, line, std::string_view(name, static_cast<std::size_t>(q - name)));
+            if (slot != kSkipped) {
+                values.resize(series_.size(), kNaN);
+                double field[10] = {};
+                for (auto& f : field) {
+                    q = nextNumber(q, eol, f);
+                }
+                values[slot] = field[0];
+                values[slot + 1] = field[4];
+                values[slot + 2] = field[2] * 512.0;
+                values[slot + 3] = field[6] * 512.0;
+                values[slot + 4] = field[9];
+            }
+        }
+        p = eol + 1;
+    }
+}
+
+PsiTriggerSpec parsePsiTrigger(const std::string& text) {
+    // resource:some|full:stall/window, e.g. cpu:some:150ms/1s
+    const auto first = text.find(':');
+    const auto second = first == std::string::npos ? std::string::npos : text.find(':', first + 1);
+    const auto slash = second == std::string::npos ? std::string::npos : text.find('/', second + 1);
+    if (slash == std::string::npos) {
+        throw std::runtime_error("invalid PSI trigger (expected resource:some|full:stall/window): " + text);
+    }
+    PsiTriggerSpec spec;
+    spec.resource = text.substr(0, first);
+    const std::string type = text.substr(first + 1, second - first - 1);
+    if (spec.resource != "cpu" && spec.resource != "memory" && spec.resource != "io" && spec.resource != "irq") {
+        throw std::runtime_error("unknown PSI resource: " + spec.resource);
+    }
+    if (type != "some" && type != "full") {
+        throw std::runtime_error("PSI trigger type must be some or full: " + text);
+    }
+    const std::int64_t stallMs = parseDurationMs(text.substr(second + 1, slash - second - 1));
+    const std::int64_t windowMs = parseDurationMs(text.substr(slash + 1));
+    if (stallMs <= 0 || windowMs <= 0 || stallMs > windowMs) {
+        throw std::runtime_error("PSI trigger needs 0 < stall <= window: " + text);
+    }
+    spec.line = type + ' ' + std::to_string(stallMs * 1000) + ' ' + std::to_string(windowMs * 1000);
+    return spec;
+}
+
+BurstController::BurstController(BurstOptions options)
+    : options_(std::move(options)), sampler_(options_.collectors, options_.io), ring_(options_.ringFrames) {
+    if (options_.intervalMs <= 0) {
+        throw std::runtime_error("burst interval must be positive");
+    }
+    wakeFd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd_ < 0) {
+        throw std::runtime_error(std::string("eventfd failed: ") + std::strerror(errno));
+    }
+
+    try {
+        for (const auto& psi : options_.psi) {
+            const std::string path = "/proc/pressure/" + psi.resource;
+            const int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+            if (fd < 0) {
+                throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+            }
+            psiFds_.push_back(fd);
+            // The kernel expects the terminating NUL as part of the write.
+            if (::write(fd, psi.line.c_str(), psi.line.size() + 1) < 0) {
+                throw std::runtime_error("cannot arm PSI trigger '" + psi.line + "' on " + path + ": " +
+                                         std::strerror(errno));
+            }
+        }
+
+        if (!options_.controlSocket.empty()) {
+            const sockaddr_un address = socketAddress(options_.controlSocket);
+            controlFd_ = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+            if (controlFd_ < 0) {
+                throw std::runtime_error(std::string("socket failed: ") + std::strerror(errno));
+            }
+            ::unlink(options_.controlSocket.c_str());
+            if (::bind(controlFd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+                throw std::runtime_error("cannot bind " + options_.controlSocket + ": " + std::strerror(errno));
+            }
+        }
+    } catch (...) {
+        for (int fd : psiFds_) {
+            ::close(fd);
+        }
+        if (controlFd_ >= 0) {
+            ::close(controlFd_);
+        }
+        ::close(wakeFd_);
+        throw;
+    }
+
+    signalWakeFd.store(wakeFd_);
+    thread_ = std::thread([this] { run(); });
+}
+
+BurstController::~BurstController() {
+    stopping_ = true;
+    wake();
+    thread_.join();
+
+    int expected = wakeFd_;
+    signalWakeFd.compare_exchange_strong(expected, -1);
+    for (int fd : psiFds_) {
+        ::close(fd);
+    }
+    if (controlFd_ >= 0) {
+        ::close(controlFd_);
+        ::unlink(options_.controlSocket.c_str());
+    }
+    ::close(wakeFd_);
+}
+
+void BurstController::installSignalHandler() {
+    struct sigaction action {};
+    action.sa_handler = onBurstSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    ::sigaction(SIGUSR1, &action, nullptr);
+}
+
+void BurstController::log(const std::string& message) const {
+    if (!options_.quiet) {
+        std::cerr << "statio daemon: " << message << '\n';
+    }
+}
+
+void BurstController::wake() {
+    const std::uint64_t one = 1;
+    [[maybe_unused]] const ssize_t n = ::write(wakeFd_, &one, sizeof(one));
+}
+
+void BurstController::trigger(std::int64_t durationMs, const std::string& reason) {
+    const std::int64_t now = steadyMs();
+    const std::int64_t window = std::min(durationMs > 0 ? durationMs : options_.windowMs, options_.maxWindowMs);
+    const std::int64_t target = now + window;
+    std::int64_t current = deadlineMs_.load();
+    while (current < target && !deadlineMs_.compare_exchange_weak(current, target)) {
+    }
+    if (current <= now) {
+        ++bursts_;
+        log("burst sampling for " + std::to_string(window) + " ms (" + reason + ")");
+    }
+    wake();
+}
+
+bool BurstController::active() const {
+    return steadyMs() < deadlineMs_.load();
+}
+
+void BurstController::handleControlMessage() {
+    char message[256];
+    for (;;) {
+        const ssize_t n = ::recv(controlFd_, message, sizeof(message) - 1, 0);
+        if (n < 0) {
+            return;
+        }
+        message[n] = '\0';
+        const std::string text(message);
+        if (text.rfind("burst", 0) != 0) {
+            log("ignoring control message: " + text);
+            continue;
+        }
+        try {
+            const std::string duration = text.size() > 6 ? text.substr(6) : std::string();
+            trigger(duration.empty() ? 0 : parseDurationMs(duration), "control socket");
+        } catch (const std::exception& e) {
+            log(std::string("bad control message: ") + e.what());
+        }
+    }
+}
+
+void BurstController::run() {
+    std::vector<pollfd> fds;
+    fds.push_back(pollfd{wakeFd_, POLLIN, 0});
+    if (controlFd_ >= 0) {
+        fds.push_back(pollfd{controlFd_, POLLIN, 0});
+    }
+    const std::size_t firstPsi = fds.size();
+    for (int fd : psiFds_) {
+        fds.push_back(pollfd{fd, POLLPRI, 0});
+    }
+
+    std::int64_t nextSample = 0;
+    std::uint64_t framesAtStart = 0;
+    while (!stopping_) {
+        std::int64_t now = steadyMs();
+        int timeout = -1;
+        if (now < deadlineMs_.load()) {
+            if (nextSample == 0) {
+                nextSample = now;
+                framesAtStart = frames_.load();
+            }
+            timeout = static_cast<int>(std::max<std::int64_t>(0, nextSample - now));
+        } else if (nextSample != 0) {
+            nextSample = 0;
+            log("burst finished, " + std::to_string(frames_.load() - framesAtStart) + " frames");
+        }
+
+        if (::poll(fds.data(), fds.size(), timeout) > 0) {
+            if (fds[0].revents & POLLIN) {
+                std::uint64_t count = 0;
+                [[maybe_unused]] const ssize_t n = ::read(wakeFd_, &count, sizeof(count));
+            }
+            if (controlFd_ >= 0 && (fds[1].revents & POLLIN)) {
+                handleControlMessage();
+            }
+            for (std::size_t i = firstPsi; i < fds.size(); ++i) {
+                if (fds[i].revents & POLLPRI) {
+                    trigger(0, "psi " + options_.psi[i - firstPsi].resource);
+                } else if (fds[i].revents & (POLLERR | POLLNVAL)) {
+                    log("PSI trigger on " + options_.psi[i - firstPsi].resource + " failed, disabling it");
+                    fds[i].fd = -1;
+                }
+            }
+        }
+        if (signalRequested) {
+            signalRequested = 0;
+            trigger(0, "SIGUSR1");
+        }
+
+        now = steadyMs();
+        if (nextSample == 0 || now < nextSample || now >= deadlineMs_.load()) {
+            continue;
+        }
+        if (Frame* frame = ring_.claim()) {
+            frame->timestampMs = currentTimeMs();
+            if (sampler_.sample(frame->values)) {
+                ring_.publish();
+                ++frames_;
+            }
+        } else {
+            ++dropped_;
+        }
+        // Skip missed ticks rather than sampling back-to-back to catch up.
+        nextSample += options_.intervalMs;
+        if (nextSample <= now) {
+            nextSample = now + options_.intervalMs;
+        }
+    }
+}
+
+void BurstController::drain(std::int64_t beforeMs,
+                            const std::function<void(std::int64_t, const std::vector<MetricSample>&)>& append) {
+    while (Frame* frame = ring_.front()) {
+        if (frame->timestampMs >= beforeMs) {
+            break;
+        }
+        if (frame->timestampMs < drainedBeforeMs_) {
+            // Stamped before the previous drain but published after it; rows
+            // must stay in timestamp order.
+            ++late_;
+            ring_.pop();
+            continue;
+        }
+        for (std::size_t i = samples_.size(); i < frame->values.size(); ++i) {
+            samples_.push_back(sampler_.describe(i));
+        }
+        for (std::size_t i = 0; i < samples_.size(); ++i) {
+            samples_[i].value = i < frame->values.size() ? frame->values[i] : kNaN;
+        }
+        append(frame->timestampMs, samples_);
+        ring_.pop();
+    }
+    drainedBeforeMs_ = std::max(drainedBeforeMs_, beforeMs);
+}
+
+BurstStats BurstController::stats() const {
+    BurstStats stats;
+    stats.bursts = bursts_.load();
+    stats.frames = frames_.load();
+    stats.dropped = dropped_.load();
+    stats.late = late_;
+    return stats;
+}
+
+void sendBurstRequest(const std::string& socketPath, std::int64_t durationMs) {
+    const sockaddr_un address = socketAddress(socketPath);
+    const int fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("socket failed: ") + std::strerror(errno));
+    }
+    std::string message = "burst";
+    if (durationMs > 0) {
+        message += ' ' + std::to_string(durationMs) + "ms";
+    }
+    const ssize_t sent = ::sendto(fd, message.data(), message.size(), 0, reinterpret_cast<const sockaddr*>(&address),
+                                  sizeof(address));
+    const int error = errno;
+    ::close(fd);
+    if (sent < 0) {
+        throw std::runtime_error("cannot reach " + socketPath + ": " + std::strerror(error));
+    }
+}
+
+} // namespace statio
@@ -0,0 +1,139 @@
+#include "statio/cli_options.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace statio {
+
+CommandLine::CommandLine(const std::vector<std::string>& args,
+                         const std::set<std::string>& valueOptions,
+                         const std::set<std::string>& flagOptions) {
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (arg.rfind("--", 0) != 0 || arg.size() == 2) {
+            positional_.push_back(arg);
+            continue;
+        }
+
+        std::string name = arg.substr(2);
+        std::string inlineValue;
+        bool hasInlineValue = false;
+        const auto eq = name.find('=');
+        if (eq != std::string::npos) {
+            inlineValue = name.substr(eq + 1);
+            name = name.substr(0, eq);
+            hasInlineValue = true;
+        }
+
+        if (flagOptions.count(name) != 0 && !hasInlineValue) {
+            flags_.insert(name);
+        } else if (valueOptions.count(name) != 0) {
+            if (hasInlineValue) {
+                values_[name] = inlineValue;
+            } else if (i + 1 < args.size()) {
+                values_[name] = args[++i];
+            } else {
+                throw std::runtime_error("option --" + name + " requires a value");
+            }
+        } else {
+            throw std::runtime_error("unknown option --" + name);
+        }
+    }
+}
+
+bool CommandLine::has(const std::string& name) const {
+    return flags_.count(name) != 0 || values_.count(name) != 0;
+}
+
+std::string CommandLine::value(const std::string& name, const std::string& fallback) const {
+    auto it = values_.find(name);
+    return it == values_.end() ? fallback : it->second;
+}
+
+double CommandLine::number(const std::string& name, double fallback) const {
+    auto it = values_.find(name);
+    if (it == values_.end()) {
+        return fallback;
+    }
+    try {
+        std::size_t used = 0;
+        const double parsed = std::stod(it->second, &used);
+        if (used == it->second.size()) {
+            return parsed;
+        }
+    } catch (...) {
+    }
+    throw std::runtime_error("option --" + name + " expects a number, got '" + it->second + "'");
+}
+
+std::int64_t CommandLine::integer(const std::string& name, std::int64_t fallback) const {
+    auto it = values_.find(name);
+    if (it == values_.end()) {
+        return fallback;
+    }
+    try {
+        std::size_t used = 0;
+        const long long parsed = std::stoll(it->second, &used);
+        if (used == it->second.size()) {
+            return parsed;
+        }
+    } catch (...) {
+    }
+    throw std::runtime_error("option --" + name + " expects an integer, got '" + it->second + "'");
+}
+
+std::int64_t parseDurationMs(const std::string& text) {
+    std::size_t used = 0;
+    double amount = 0.0;
+    // stod() would skip leading spaces and take a '+' sign.
+    if (text.empty() || std::isspace(static_cast<unsigned char>(text[0])) || text[0] == '+') {
+        throw std::runtime_error("invalid duration '" + text + "'");
+    }
+    try {
+        amount = std::stod(text, &used);
+    } catch (...) {
+        throw std::runtime_error("invalid duration '" + text + "'");
+    }
+
+    const std::string unit = text.substr(used);
+    double scale = 0.0;
+    if (unit.empty() || unit == "s") {
+        scale = 1000.0;
+    } else if (unit == "ms") {
+        scale = 1.0;
+    } else if (unit == "m") {
+        scale = 60.0 * 1000.0;
+    } else if (unit == "h") {
+        scale = 3600.0 * 1000.0;
+    } else if (unit == "d") {
+        scale = 86400.0 * 1000.0;
+    } else {
+        throw std::runtime_error("invalid duration unit in '" + text + "'");
+    }
+
+    // stod() also takes "nan", "inf" and exponents; llround() of anything
+    // outside int64 is undefined.
+    const double limit = static_cast<double>(std::numeric_limits<std::int64_t>::max()) / scale;
+    if (!std::isfinite(amount) || amount < 0.0 || amount >= limit) {
+        throw std::runtime_error("duration out of range '" + text + "'");
+    }
+    return static_cast<std::int64_t>(std::llround(amount * scale));
+}
+
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> out;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            out.push_back(item);
+        }
+    }
+    return out;
+}
+
+} // namespace statio
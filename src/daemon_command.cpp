@@ -0,0 +1,376 @@
+#include "statio/commands.hpp"
+
+#include "statio/anomaly.hpp"
+#include "statio/api.hpp"
+#include "statio/burst.hpp"
+#include "statio/cli_options.hpp"
+#include "statio/history.hpp"
+#include "statio/latency.hpp"
+#include "statio/push.hpp"
+#include "statio/rollup.hpp"
+#include "statio/rules.hpp"
+#include "statio/system_info.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <signal.h>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+RetentionPolicy retentionFromCommandLine(const CommandLine& cli) {
+    RetentionPolicy policy = defaultRetentionPolicy();
+    if (cli.has("tiers")) {
+        policy.tiers = parseTiers(cli.value("tiers"));
+    }
+    parseRetention(cli.value("retain"), policy);
+    return policy;
+}
+
+// Runs compaction and retention on its own thread so rollups never delay
+// sampling.
+class BackgroundCompactor {
+public:
+    BackgroundCompactor(const std::string& directory, RetentionPolicy policy, std::int64_t everyMs)
+        : compactor_(directory, std::move(policy)), everyMs_(everyMs), thread_([this] { run(); }) {}
+
+    ~BackgroundCompactor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        thread_.join();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!wake_.wait_for(lock, std::chrono::milliseconds(everyMs_), [this] { return stopping_; })) {
+            lock.unlock();
+            try {
+                compactor_.runOnce(currentTimeMs());
+            } catch (const std::exception& e) {
+                std::cerr << "statio daemon: compaction failed: " << e.what() << '\n';
+            }
+            lock.lock();
+        }
+    }
+
+    Compactor compactor_;
+    std::int64_t everyMs_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+// Builds the burst controller when any burst trigger is configured.
+std::unique_ptr<BurstController> burstFromCommandLine(const CommandLine& cli) {
+    const bool wanted = cli.has("burst") || cli.has("burst-psi") || cli.has("burst-control") ||
+                        cli.has("burst-on-rule") || cli.has("anomaly-burst");
+    if (!wanted) {
+        return nullptr;
+    }
+    BurstOptions options;
+    options.collectors = parseBurstCollectors(cli.value("burst", "all"));
+    options.intervalMs = parseDurationMs(cli.value("burst-interval", "100ms"));
+    options.windowMs = parseDurationMs(cli.value("burst-for", "30s"));
+    options.maxWindowMs = parseDurationMs(cli.value("burst-max", "5m"));
+    options.ringFrames = static_cast<std::size_t>(cli.integer("burst-ring", 4096));
+    for (const auto& trigger : splitList(cli.value("burst-psi"))) {
+        options.psi.push_back(parsePsiTrigger(trigger));
+    }
+    options.controlSocket = cli.value("burst-control");
+    options.io = parseIoBackend(cli.value("burst-io", "pread"));
+    options.quiet = cli.has("quiet");
+    if (options.intervalMs <= 0 || options.windowMs <= 0 || options.maxWindowMs <= 0 || options.ringFrames == 0) {
+        throw std::runtime_error("--burst-interval, --burst-for, --burst-max and --burst-ring must be positive");
+    }
+    return std::make_unique<BurstController>(std::move(options));
+}
+
+std::unique_ptr<PushTransport> pushFromCommandLine(const CommandLine& cli) {
+    if (!cli.has("push")) {
+        return nullptr;
+    }
+    PushOptions options;
+    options.address = cli.value("push");
+    char host[256] = {};
+    ::gethostname(host, sizeof(host) - 1);
+    options.host = cli.value("push-host", host[0] ? host : "localhost");
+    options.batchSnapshots = static_cast<std::size_t>(cli.integer("push-batch", 10));
+    options.batchMaxMs = parseDurationMs(cli.value("push-max-delay", "30s"));
+    options.queueBytes = static_cast<std::size_t>(cli.integer("push-queue-mb", 8)) << 20;
+    options.spillDirectory = cli.value("push-spill");
+    options.spillBytes = static_cast<std::uint64_t>(cli.integer("push-spill-mb", 256)) << 20;
+    options.quiet = cli.has("quiet");
+    return std::make_unique<PushTransport>(std::move(options));
+}
+
+// Sends SIGUSR1 to a running daemon. The pid must name a statio daemon
+// that catches SIGUSR1: kill(0) or kill(-1) would reach a whole process
+// group or every process of the user, and a daemon started without burst
+// options would die of the signal's default action.
+void signalBurst(std::int64_t pid) {
+    if (pid <= 0 || pid > std::numeric_limits<pid_t>::max()) {
+        throw std::runtime_error("--pid expects a positive process id");
+    }
+    const std::string proc = "/proc/" + std::to_string(pid);
+    std::ifstream cmdline(proc + "/cmdline");
+    std::vector<std::string> argv;
+    for (std::string arg; std::getline(cmdline, arg, '\0');) {
+        argv.push_back(arg);
+    }
+    const std::string program = argv.empty() ? "" : argv[0].substr(argv[0].rfind('/') + 1);
+    if (program.rfind("statio", 0) != 0 || std::find(argv.begin(), argv.end(), "daemon") == argv.end()) {
+        throw std::runtime_error("pid " + std::to_string(pid) + " is not a statio daemon");
+    }
+
+    std::ifstream status(proc + "/status");
+    unsigned long long caught = 0;
+    for (std::string line; std::getline(status, line);) {
+        if (line.rfind("SigCgt:", 0) == 0) {
+            caught = std::strtoull(line.c_str() + 7, nullptr, 16);
+        }
+    }
+    if ((caught & (1ULL << (SIGUSR1 - 1))) == 0) {
+        throw std::runtime_error("statio daemon " + std::to_string(pid) +
+                                 " does not take SIGUSR1; start it with --burst to enable burst mode");
+    }
+    if (::kill(static_cast<pid_t>(pid), SIGUSR1) != 0) {
+        throw std::runtime_error("cannot signal pid " + std::to_string(pid) + ": " + std::strerror(errno));
+    }
+}
+
+} // namespace
+
+int runDaemonCommand(const std::vector<std::string>& args) {
+    const CommandLine cli(args,
+                          {"history-dir", "interval", "samples", "block-rows", "segment", "tiers", "retain", "compact-every",
+                           "latency-poll", "rules", "alert-log", "alert-hook", "anomaly-burst", "burst", "burst-interval",
+                           "burst-for", "burst-max", "burst-ring", "burst-psi", "burst-control", "burst-io", "burst-on-rule",
+                           "push", "push-host", "push-batch", "push-max-delay", "push-queue-mb", "push-spill", "push-spill-mb",
+                           "api", "fields"},
+                          {"quiet", "anomalies"});
+
+    HistoryOptions options;
+    options.directory = cli.value("history-dir");
+    if (options.directory.empty()) {
+        throw std::runtime_error("daemon requires --history-dir DIR");
+    }
+    options.blockRows = static_cast<std::size_t>(cli.integer("block-rows", 300));
+    options.segmentMs = parseDurationMs(cli.value("segment", "1h"));
+
+    const std::int64_t intervalMs = parseDurationMs(cli.value("interval", "1s"));
+    const std::int64_t maxSamples = cli.integer("samples", 0);
+    const std::int64_t compactEveryMs = parseDurationMs(cli.value("compact-every", "1m"));
+    if (intervalMs <= 0 || compactEveryMs <= 0) {
+        throw std::runtime_error("--interval and --compact-every must be positive");
+    }
+    // 0 turns the disk/scheduler latency polling off.
+    const std::int64_t pollMs = parseDurationMs(cli.value("latency-poll", "100ms"));
+    RetentionPolicy policy = retentionFromCommandLine(cli);
+    // Only the selected series are recorded, and sources none of them reads
+    // are not collected at all.
+    const std::vector<std::string> fields = splitList(cli.value("fields"));
+    const unsigned sources = fieldSources(fields);
+
+    std::unique_ptr<RuleEngine> rules;
+    AlertDispatcher alerts;
+    if (cli.has("rules")) {
+        rules = std::make_unique<RuleEngine>(loadRules(cli.value("rules")), intervalMs);
+        alerts.setHook(cli.value("alert-hook"));
+    }
+    if (cli.has("alert-log")) {
+        alerts.setLogFile(cli.value("alert-log"));
+    }
+
+    // Burst mode samples the cheap collectors at --burst-interval while a
+    // trigger (SIGUSR1, PSI, control socket, rule, anomaly) is active.
+    std::unique_ptr<AnomalyDetector> anomalies;
+    const std::int64_t anomalyBurstMs = parseDurationMs(cli.value("anomaly-burst", "0"));
+    if (cli.has("anomalies") || anomalyBurstMs > 0) {
+        anomalies = std::make_unique<AnomalyDetector>();
+    }
+    const std::vector<std::string> burstRules = splitList(cli.value("burst-on-rule"));
+    const bool burstOnAnyRule = std::find(burstRules.begin(), burstRules.end(), "*") != burstRules.end();
+    std::unique_ptr<BurstController> burst = burstFromCommandLine(cli);
+
+    std::unique_ptr<PushTransport> push = pushFromCommandLine(cli);
+
+    // The query API is on by default so that `statio` and statio_py.py find
+    // the daemon; a second daemon on the same socket runs without one.
+    std::unique_ptr<ApiServer> api;
+    const std::string apiSocket = cli.value("api", defaultApiSocket());
+    if (apiSocket != "off") {
+        ApiOptions apiOptions;
+        apiOptions.socketPath = apiSocket;
+        apiOptions.historyDirectory = options.directory;
+        apiOptions.intervalMs = intervalMs;
+        try {
+            api = std::make_unique<ApiServer>(std::move(apiOptions));
+        } catch (const std::exception& e) {
+            std::cerr << "statio daemon: api disabled: " << e.what() << '\n';
+        }
+    }
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+    if (burst) {
+        BurstController::installSignalHandler();
+    }
+
+    HistoryWriter writer(options);
+    BackgroundCompactor compactor(options.directory, std::move(policy), compactEveryMs);
+    if (!cli.has("quiet")) {
+        std::cerr << "statio daemon: recording every " << intervalMs << " ms into " << options.directory << '\n';
+        if (api) {
+            std::cerr << "statio daemon: answering queries on " << apiSocket << '\n';
+        }
+    }
+
+    LatencySampler latency;
+    if (pollMs > 0) {
+        latency.poll(); // baseline for the first interval's deltas
+    }
+
+    // Burst rows carry only the burst series and are written in timestamp
+    // order between the regular rows.
+    const auto appendBurst = [&writer](std::int64_t timestampMs, const std::vector<MetricSample>& burstSamples) {
+        writer.append(timestampMs, burstSamples);
+    };
+
+    auto next = std::chrono::steady_clock::now();
+    for (std::int64_t taken = 0; !stopRequested && (maxSamples <= 0 || taken < maxSamples); ++taken) {
+        const auto started = std::chrono::steady_clock::now();
+        SystemSnapshot snapshot = collectSystemSnapshot(sources);
+        const auto collectUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+        latency.record("collector.latency_us", "snapshot", static_cast<double>(collectUs.count()));
+        snapshot.distributions = latency.drain();
+        const std::int64_t now = currentTimeMs();
+        std::vector<MetricSample> samples = flattenSnapshot(snapshot);
+        retainFields(samples, fields);
+        if (burst) {
+            burst->drain(now, appendBurst);
+        }
+        writer.append(now, samples);
+        if (api) {
+            api->publish(now, snapshot, samples);
+        }
+        if (push) {
+            push->push(now, samples);
+        }
+        if (rules) {
+            rules->observe(now, samples, [&](const AlertEvent& event) {
+                alerts.publish(event);
+                if (burst && event.firing &&
+                    (burstOnAnyRule || std::find(burstRules.begin(), burstRules.end(), event.rule) != burstRules.end())) {
+                    burst->trigger(0, "rule " + std::string(event.rule));
+                }
+            });
+        }
+        if (anomalies) {
+            anomalies->observe(now, samples, [&](const AnomalyEvent& event) {
+                alerts.publishLine(formatAnomaly(event));
+                if (burst && anomalyBurstMs > 0) {
+                    burst->trigger(anomalyBurstMs, "anomaly " + seriesLabel(event.name, event.entity));
+                }
+            });
+        }
+
+        next += std::chrono::milliseconds(intervalMs);
+        auto nextPoll = std::chrono::steady_clock::now() + std::chrono::milliseconds(pollMs);
+        while (!stopRequested && std::chrono::steady_clock::now() < next) {
+            auto wake = std::min(next, std::chrono::steady_clock::now() + std::chrono::milliseconds(200));
+            if (pollMs > 0) {
+                wake = std::min(wake, nextPoll);
+            }
+            std::this_thread::sleep_until(wake);
+            if (pollMs > 0 && std::chrono::steady_clock::now() >= nextPoll) {
+                latency.poll();
+                nextPoll += std::chrono::milliseconds(pollMs);
+            }
+            if (burst) {
+                burst->drain(currentTimeMs(), appendBurst);
+            }
+        }
+    }
+
+    if (burst) {
+        burst->drain(currentTimeMs(), appendBurst);
+        const BurstStats stats = burst->stats();
+        if (!cli.has("quiet") && stats.bursts > 0) {
+            std::cerr << "statio daemon: " << stats.bursts << " bursts, " << stats.frames << " burst frames, "
+                      << stats.dropped << " dropped, " << stats.late << " late\n";
+        }
+    }
+    writer.flush();
+    if (api && !cli.has("quiet")) {
+        const ApiStats stats = api->stats();
+        std::cerr << "statio daemon: api served " << stats.requests << " requests on " << stats.connections
+                  << " connections, " << stats.bytesSent << " bytes, " << stats.diffsSent << " diffs from " << stats.diffsEncoded
+                  << " encoded, " << stats.coalesced << " coalesced updates\n";
+    }
+    if (push) {
+        push->close(); // delivers or spills the tail
+        const PushStats stats = push->stats();
+        if (!cli.has("quiet")) {
+            std::cerr << "statio daemon: pushed " << stats.snapshots << " snapshots in " << stats.batches << " batches, "
+                      << stats.rawBytes << " -> " << stats.wireBytes << " bytes, " << stats.acked << " acked, "
+                      << stats.spilled << " spilled, " << stats.dropped << " dropped\n";
+        }
+    }
+    return 0;
+}
+
+int runBurstCommand(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"control", "pid", "for"});
+    if (cli.has("control")) {
+        sendBurstRequest(cli.value("control"), parseDurationMs(cli.value("for", "0")));
+    } else if (cli.has("pid")) {
+        if (cli.has("for")) {
+            throw std::runtime_error("--for needs --control; a signal uses the daemon's --burst-for");
+        }
+        signalBurst(cli.integer("pid", 0));
+    } else {
+        throw std::runtime_error("burst requires --control SOCKET or --pid PID");
+    }
+    return 0;
+}
+
+int runCompactCommand(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"history-dir", "tiers", "retain"});
+    const std::string directory = cli.value("history-dir");
+    if (directory.empty()) {
+        throw std::runtime_error("compact requires --history-dir DIR");
+    }
+
+    Compactor compactor(directory, retentionFromCommandLine(cli));
+    const CompactionStats stats = compactor.runOnce(currentTimeMs());
+    std::cout << "rollup buckets written: " << stats.bucketsWritten << '\n'
+              << "segments removed: " << stats.segmentsRemoved << '\n';
+    return 0;
+}
+
+} // namespace statio
@@ -0,0 +1,96 @@
+#include "statio/commands.hpp"
+
+#include "statio/cli_options.hpp"
+#include "statio/history.hpp"
+#include "statio/schema.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace statio {
+namespace {
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+// `label value` lines, or one JSON object per poll in the shape of an API
+// watch diff: {"timestamp_ms":T,"fields":{"memory.free_mb":V,...}}.
+void printFields(std::string& out, const std::vector<MetricSample>& samples, bool json) {
+    out.clear();
+    if (json) {
+        out += "{\"timestamp_ms\":";
+        out += std::to_string(currentTimeMs());
+        out += ",\"fields\":{";
+    }
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        const std::string label = seriesLabel(samples[i].name, samples[i].entity);
+        if (json) {
+            out += i == 0 ? "" : ",";
+            appendJsonValue(out, label); // mount points keep /proc/mounts' \040 escapes
+            out += ':';
+        } else {
+            out += label;
+            out += ' ';
+        }
+        appendJsonValue(out, samples[i].value);
+        if (!json) {
+            out += '\n';
+        }
+    }
+    out += json ? "}}\n" : "";
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int runFieldsCommand(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"fields", "format", "every", "count"});
+    const std::vector<std::string> selectors = splitList(cli.value("fields"));
+    if (selectors.empty()) {
+        throw std::runtime_error("--fields requires a comma-separated list of fields");
+    }
+    const std::string format = cli.value("format", "text");
+    if (format != "text" && format != "json" && format != "openmetrics") {
+        throw std::runtime_error("--format must be text, json or openmetrics");
+    }
+    const std::int64_t everyMs = parseDurationMs(cli.value("every", "0"));
+    const std::int64_t count = cli.integer("count", everyMs > 0 ? 0 : 1);
+    if (everyMs < 0 || count < 0) {
+        throw std::runtime_error("--every and --count must not be negative");
+    }
+
+    // Resolved once, so an unknown field fails before the first poll.
+    fieldSources(selectors);
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    std::string out;
+    auto next = std::chrono::steady_clock::now();
+    for (std::int64_t taken = 0; stopRequested == 0 && (count == 0 || taken < count); ++taken) {
+        if (taken > 0) {
+            next += std::chrono::milliseconds(everyMs);
+            std::this_thread::sleep_until(next);
+            if (format == "text") {
+                std::fputc('\n', stdout);
+            }
+        }
+        if (format == "openmetrics") {
+            out = renderOpenMetrics(collectFields(selectors));
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            std::fflush(stdout);
+            continue;
+        }
+        printFields(out, collectFields(selectors), format == "json");
+    }
+    return 0;
+}
+
+} // namespace statio
@@ -0,0 +1,872 @@
+#include "statio/history.hpp"
+
+#include "statio/query.hpp"
+#include "statio/schema.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace statio {
+namespace {
+
+constexpr char kSegmentMagic[8] = {'S', 'T', 'A', 'T', 'I', 'O', 'H', '1'};
+constexpr char kRollupSegmentMagic[8] = {'S', 'T', 'A', 'T', 'I', 'O', 'R', '1'};
+constexpr std::uint32_t kBlockMagic = 0x324b4c42;    // "BLK2"
+constexpr std::uint32_t kRollupMagic = 0x32504c52;   // "RLP2"
+constexpr std::uint32_t kBlockMagicV1 = 0x314b4c42;  // "BLK1", no metric kinds
+constexpr std::uint32_t kRollupMagicV1 = 0x31504c52; // "RLP1", no metric kinds
+constexpr std::size_t kRollupStats = 5;            // min, max, sum, count, last
+constexpr const char* kSegmentPrefix = "segment-";
+constexpr const char* kSegmentSuffix = ".sts";
+
+// On-disk layout (host byte order, every section 8-byte aligned).
+// Raw segments start with kSegmentMagic, rollup segments with
+// kRollupSegmentMagic followed by the i64 tier resolution. Raw blocks are
+//   BlockHeader | directory (u16 nameLen, u16 entityLen, u8 kind, bytes...)
+//   padded | i64 timestamps[rows] | f64 column[series][rows] |
+//   u32 sketchOffsets[distributions * rows + 1] padded | sketch bytes padded
+// where the sketch sections are present only when the block holds
+// distribution series, and rollup blocks replace the columns with
+//   f64 stats[series][min, max, sum, count, last][rows] |
+//   u32 sketchOffsets[series * rows + 1] padded | sketch bytes padded
+// Version 1 blocks (BLK1/RLP1) lack the kind byte and raw sketch sections.
+struct BlockHeader {
+    std::uint32_t magic = 0;
+    std::uint32_t rows = 0;
+    std::uint32_t series = 0;
+    std::uint32_t directoryBytes = 0;
+    std::int64_t minMs = 0;
+    std::int64_t maxMs = 0;
+    std::uint64_t payloadBytes = 0;
+};
+static_assert(sizeof(BlockHeader) == 40, "block header layout changed");
+
+std::size_t padTo8(std::size_t value) {
+    return (value + 7U) & ~static_cast<std::size_t>(7U);
+}
+
+// Adds count * width to `total`; false instead of wrapping around.
+bool addBytes(std::size_t& total, std::size_t count, std::size_t width) {
+    if (width != 0 && count > (std::numeric_limits<std::size_t>::max() - total) / width) {
+        return false;
+    }
+    total += count * width;
+    return true;
+}
+
+// Adds a sketch offset table of `count` entries, padded to an even count.
+bool addOffsetTable(std::size_t& total, std::size_t count) {
+    return count < std::numeric_limits<std::size_t>::max() - 1 &&
+           addBytes(total, count + count % 2, sizeof(std::uint32_t));
+}
+
+// Payload bytes a block needs before its sketch bytes, from the counts in
+// its header (for raw blocks, before the sketch offset table, whose length
+// depends on the directory). False when the counts overflow.
+bool fixedPayloadBytes(const BlockHeader& header, bool rollup, std::size_t& total) {
+    const std::size_t rows = header.rows;
+    if (header.directoryBytes % 8 != 0 || (rows != 0 && header.series > std::numeric_limits<std::size_t>::max() / rows)) {
+        return false;
+    }
+    const std::size_t cells = static_cast<std::size_t>(header.series) * rows;
+    total = header.directoryBytes;
+    if (!addBytes(total, rows, sizeof(std::int64_t))) {
+        return false;
+    }
+    if (!rollup) {
+        return addBytes(total, cells, sizeof(double));
+    }
+    return addBytes(total, cells, kRollupStats * sizeof(double)) && addOffsetTable(total, cells + 1);
+}
+
+std::string encodeDirectory(const std::vector<SeriesKey>& series, const std::vector<MetricKind>& kinds) {
+    std::string directory;
+    for (std::size_t i = 0; i < series.size(); ++i) {
+        const auto& [name, entity] = series[i];
+        const auto nameLen = static_cast<std::uint16_t>(std::min<std::size_t>(name.size(), 0xffff));
+        const auto entityLen = static_cast<std::uint16_t>(std::min<std::size_t>(entity.size(), 0xffff));
+        directory.append(reinterpret_cast<const char*>(&nameLen), sizeof(nameLen));
+        directory.append(reinterpret_cast<const char*>(&entityLen), sizeof(entityLen));
+        directory += static_cast<char>(kinds[i]);
+        directory.append(name, 0, nameLen);
+        directory.append(entity, 0, entityLen);
+    }
+    directory.resize(padTo8(directory.size()), '\0');
+    return directory;
+}
+
+// Concatenates encoded sketches behind an offset table (padded to an even
+// count so the bytes that follow stay 8-byte aligned).
+void packSketches(const std::vector<std::string>& sketches, std::vector<std::uint32_t>& offsets, std::string& bytes) {
+    offsets.assign(sketches.size() + 1, 0);
+    bytes.clear();
+    for (std::size_t i = 0; i < sketches.size(); ++i) {
+        bytes += sketches[i];
+        offsets[i + 1] = static_cast<std::uint32_t>(bytes.size());
+    }
+    if (offsets.size() % 2 != 0) {
+        offsets.push_back(0);
+    }
+    bytes.resize(padTo8(bytes.size()), '\0');
+}
+
+template <typename T>
+void writeArray(std::ofstream& out, const T* data, std::size_t count) {
+    out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+struct SegmentFile {
+    std::string path;
+    std::int64_t startMs = 0;
+};
+
+std::vector<SegmentFile> listSegments(const std::string& directory) {
+    std::vector<SegmentFile> segments;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind(kSegmentPrefix, 0) != 0 || name.size() <= std::strlen(kSegmentPrefix) + std::strlen(kSegmentSuffix)) {
+            continue;
+        }
+        if (name.compare(name.size() - std::strlen(kSegmentSuffix), std::string::npos, kSegmentSuffix) != 0) {
+            continue;
+        }
+
+        const std::string stamp = name.substr(std::strlen(kSegmentPrefix),
+                                              name.size() - std::strlen(kSegmentPrefix) - std::strlen(kSegmentSuffix));
+        try {
+            segments.push_back(SegmentFile{entry.path().string(), std::stoll(stamp)});
+        } catch (...) {
+        }
+    }
+
+    std::sort(segments.begin(), segments.end(), [](const SegmentFile& a, const SegmentFile& b) {
+        return a.startMs < b.startMs;
+    });
+    return segments;
+}
+
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st {};
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* addr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                data_ = static_cast<const unsigned char*>(addr);
+                size_ = static_cast<std::size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            munmap(const_cast<unsigned char*>(data_), size_);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Validates the segment file header, returning the offset of the first block
+// and the tier resolution (0 for raw segments).
+bool openSegment(const MappedFile& file, std::size_t& offset, std::int64_t& resolutionMs) {
+    if (file.data() == nullptr || file.size() < sizeof(kSegmentMagic)) {
+        return false;
+    }
+    if (std::memcmp(file.data(), kSegmentMagic, sizeof(kSegmentMagic)) == 0) {
+        offset = sizeof(kSegmentMagic);
+        resolutionMs = 0;
+        return true;
+    }
+    if (file.size() >= sizeof(kRollupSegmentMagic) + sizeof(std::int64_t) &&
+        std::memcmp(file.data(), kRollupSegmentMagic, sizeof(kRollupSegmentMagic)) == 0) {
+        std::memcpy(&resolutionMs, file.data() + sizeof(kRollupSegmentMagic), sizeof(resolutionMs));
+        offset = sizeof(kRollupSegmentMagic) + sizeof(std::int64_t);
+        return resolutionMs > 0;
+    }
+    return false;
+}
+
+// Calls `visit` with each complete block header of a segment file and
+// returns the offset just past the last complete block (0 if unreadable).
+template <typename Visitor>
+std::size_t forEachBlockHeader(const std::string& path, Visitor visit) {
+    MappedFile file(path);
+    std::size_t offset = 0;
+    std::int64_t resolutionMs = 0;
+    if (!openSegment(file, offset, resolutionMs)) {
+        return 0;
+    }
+    while (offset + sizeof(BlockHeader) <= file.size()) {
+        BlockHeader header;
+        std::memcpy(&header, file.data() + offset, sizeof(header));
+        if ((header.magic != kBlockMagic && header.magic != kRollupMagic &&
+             header.magic != kBlockMagicV1 && header.magic != kRollupMagicV1) ||
+            header.payloadBytes > file.size() - offset - sizeof(header)) {
+            break;
+        }
+        offset += sizeof(header) + header.payloadBytes;
+        visit(header);
+    }
+    return offset;
+}
+
+} // namespace
+
+std::vector<MetricSample> flattenSnapshot(const SystemSnapshot& snapshot) {
+    std::vector<MetricSample> out;
+    out.reserve(16 + snapshot.cpu.times.size() * 8 + snapshot.disks.size() * 2 + snapshot.network.size() * 6 +
+                snapshot.distributions.size());
+    forEachSection([&](const auto& section) { flattenSection(out, snapshot.*section.member); });
+
+    // An interval without observations records nothing rather than an empty
+    // sketch, so gaps read as missing samples.
+    for (const auto& d : snapshot.distributions) {
+        if (d.sketch.empty()) {
+            continue;
+        }
+        MetricSample sample;
+        sample.name = d.name;
+        sample.entity = d.entity;
+        sample.value = d.sketch.sum() / static_cast<double>(d.sketch.count());
+        sample.kind = MetricKind::Distribution;
+        sample.sketch = d.sketch;
+        out.push_back(std::move(sample));
+    }
+
+    return out;
+}
+
+bool fieldSelected(const std::vector<std::string>& selectors, std::string_view name, std::string_view label) {
+    if (selectors.empty()) {
+        return true;
+    }
+    for (const auto& selector : selectors) {
+        if (globMatch(selector, label) || globMatch(selector, name) ||
+            (name.size() > selector.size() && name.compare(0, selector.size(), selector) == 0 &&
+             name[selector.size()] == '.')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned fieldSources(const std::vector<std::string>& selectors) {
+    if (selectors.empty()) {
+        return SourceAll;
+    }
+    unsigned sources = 0;
+    for (const auto& selector : selectors) {
+        // Only the name part of a label glob says which sources it needs.
+        const std::string_view pattern = std::string_view(selector).substr(0, selector.find('{'));
+        bool matched = false;
+        for (const auto& metric : metricCatalog()) {
+            if (fieldSelected({std::string(pattern)}, metric.name, metric.name)) {
+                sources |= metric.sources;
+                matched = true;
+            }
+        }
+        if (!matched) {
+            throw std::runtime_error("no field matches '" + selector + "'");
+        }
+    }
+    return sources;
+}
+
+void retainFields(std::vector<MetricSample>& samples, const std::vector<std::string>& selectors) {
+    if (selectors.empty()) {
+        return;
+    }
+    samples.erase(std::remove_if(samples.begin(), samples.end(),
+                                 [&selectors](const MetricSample& sample) {
+                                     return !fieldSelected(selectors, sample.name,
+                                                           seriesLabel(sample.name, sample.entity));
+                                 }),
+                  samples.end());
+}
+
+std::vector<MetricSample> collectFields(const std::vector<std::string>& selectors) {
+    std::vector<MetricSample> samples = flattenSnapshot(collectSystemSnapshot(fieldSources(selectors)));
+    retainFields(samples, selectors);
+    return samples;
+}
+
+std::string seriesLabel(std::string_view name, std::string_view entity) {
+    std::string label(name);
+    if (!entity.empty()) {
+        label += '{';
+        label += entity;
+        label += '}';
+    }
+    return label;
+}
+
+std::int64_t currentTimeMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+SegmentAppender::SegmentAppender(std::string directory, std::int64_t segmentMs, std::string fileHeader)
+    : directory_(std::move(directory)), segmentMs_(segmentMs), fileHeader_(std::move(fileHeader)) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) {
+        throw std::runtime_error("cannot create history directory " + directory_ + ": " + ec.message());
+    }
+}
+
+bool SegmentAppender::needsRotation(std::int64_t timestampMs) const {
+    return !segment_.is_open() || timestampMs >= segmentStartMs_ + segmentMs_;
+}
+
+void SegmentAppender::open(std::int64_t timestampMs) {
+    const bool firstOpen = !segment_.is_open();
+    if (segment_.is_open()) {
+        segment_.close();
+    }
+
+    std::int64_t startMs = timestampMs;
+    std::error_code ec;
+    if (firstOpen) {
+        // Continue the newest segment when it still covers this timestamp,
+        // dropping any torn block left behind by an interrupted writer.
+        const auto segments = listSegments(directory_);
+        if (!segments.empty() && timestampMs >= segments.back().startMs &&
+            timestampMs < segments.back().startMs + segmentMs_) {
+            const std::size_t validEnd = forEachBlockHeader(segments.back().path, [](const BlockHeader&) {});
+            if (validEnd > 0) {
+                if (validEnd < std::filesystem::file_size(segments.back().path, ec)) {
+                    std::filesystem::resize_file(segments.back().path, validEnd, ec);
+                }
+                startMs = segments.back().startMs;
+            }
+        }
+    }
+
+    const std::string path = directory_ + "/" + kSegmentPrefix + std::to_string(startMs) + kSegmentSuffix;
+    const bool fresh = !std::filesystem::exists(path, ec);
+    segment_.open(path, std::ios::binary | std::ios::app);
+    if (!segment_) {
+        throw std::runtime_error("cannot open history segment " + path);
+    }
+    if (fresh) {
+        segment_.write(fileHeader_.data(), static_cast<std::streamsize>(fileHeader_.size()));
+    }
+    segmentStartMs_ = startMs;
+}
+
+HistoryWriter::HistoryWriter(HistoryOptions options)
+    : options_(std::move(options)),
+      appender_(options_.directory, options_.segmentMs, std::string(kSegmentMagic, sizeof(kSegmentMagic))) {
+    if (options_.blockRows == 0) {
+        options_.blockRows = 1;
+    }
+}
+
+HistoryWriter::~HistoryWriter() {
+    try {
+        flush();
+    } catch (...) {
+    }
+}
+
+void HistoryWriter::append(std::int64_t timestampMs, const std::vector<MetricSample>& samples) {
+    if (appender_.needsRotation(timestampMs)) {
+        flush();
+        appender_.open(timestampMs);
+    }
+
+    const std::size_t row = timestamps_.size();
+    timestamps_.push_back(timestampMs);
+    for (auto& column : columns_) {
+        column.push_back(std::numeric_limits<double>::quiet_NaN());
+    }
+    for (std::size_t s = 0; s < kinds_.size(); ++s) {
+        if (kinds_[s] == MetricKind::Distribution) {
+            sketches_[s].emplace_back();
+        }
+    }
+
+    std::string key;
+    for (const auto& sample : samples) {
+        key.assign(sample.name);
+        key += '\0';
+        key += sample.entity;
+
+        auto it = seriesIndex_.find(key);
+        if (it == seriesIndex_.end()) {
+            it = seriesIndex_.emplace(key, series_.size()).first;
+            series_.emplace_back(sample.name, sample.entity);
+            kinds_.push_back(sample.kind);
+            columns_.emplace_back(row + 1, std::numeric_limits<double>::quiet_NaN());
+            sketches_.emplace_back(sample.kind == MetricKind::Distribution ? row + 1 : 0);
+        }
+        const std::size_t s = it->second;
+        columns_[s][row] = sample.value;
+        if (kinds_[s] == MetricKind::Distribution) {
+            sample.sketch.encode(sketches_[s][row]);
+        }
+    }
+
+    if (timestamps_.size() >= options_.blockRows) {
+        flush();
+    }
+}
+
+void HistoryWriter::flush() {
+    if (timestamps_.empty() || !appender_.isOpen()) {
+        return;
+    }
+
+    const std::string directory = encodeDirectory(series_, kinds_);
+
+    std::vector<std::string> sketches;
+    for (std::size_t s = 0; s < series_.size(); ++s) {
+        for (auto& sketch : sketches_[s]) {
+            sketches.push_back(std::move(sketch));
+        }
+    }
+    std::vector<std::uint32_t> offsets;
+    std::string sketchBytes;
+    if (!sketches.empty()) {
+        packSketches(sketches, offsets, sketchBytes);
+    }
+
+    BlockHeader header;
+    header.magic = kBlockMagic;
+    header.rows = static_cast<std::uint32_t>(timestamps_.size());
+    header.series = static_cast<std::uint32_t>(series_.size());
+    header.directoryBytes = static_cast<std::uint32_t>(directory.size());
+    header.minMs = *std::min_element(timestamps_.begin(), timestamps_.end());
+    header.maxMs = *std::max_element(timestamps_.begin(), timestamps_.end());
+    header.payloadBytes = directory.size() + (1U + series_.size()) * timestamps_.size() * sizeof(double) +
+                          offsets.size() * sizeof(std::uint32_t) + sketchBytes.size();
+
+    std::ofstream& out = appender_.stream();
+    writeArray(out, &header, 1);
+    writeArray(out, directory.data(), directory.size());
+    writeArray(out, timestamps_.data(), timestamps_.size());
+    for (const auto& column : columns_) {
+        writeArray(out, column.data(), column.size());
+    }
+    writeArray(out, offsets.data(), offsets.size());
+    writeArray(out, sketchBytes.data(), sketchBytes.size());
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("failed to write history block");
+    }
+
+    timestamps_.clear();
+    series_.clear();
+    kinds_.clear();
+    seriesIndex_.clear();
+    columns_.clear();
+    sketches_.clear();
+}
+
+void RollupCell::add(std::int64_t timestampMs, double value) {
+    if (std::isnan(value)) {
+        return;
+    }
+    if (count == 0) {
+        min = value;
+        max = value;
+    } else {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    sum += value;
+    ++count;
+    if (timestampMs >= lastMs) {
+        last = value;
+        lastMs = timestampMs;
+    }
+    if (kind != MetricKind::Counter) {
+        sketch.add(value);
+    }
+}
+
+void RollupCell::addDistribution(std::int64_t timestampMs, double mean, const QuantileSketch& observations) {
+    if (observations.empty()) {
+        return;
+    }
+    if (count == 0) {
+        min = observations.min();
+        max = observations.max();
+    } else {
+        min = std::min(min, observations.min());
+        max = std::max(max, observations.max());
+    }
+    sum += observations.sum();
+    count += observations.count();
+    if (timestampMs >= lastMs) {
+        last = mean;
+        lastMs = timestampMs;
+    }
+    sketch.merge(observations);
+}
+
+void RollupCell::merge(const RollupCell& other) {
+    if (other.count == 0) {
+        return;
+    }
+    if (count == 0) {
+        kind = other.kind;
+        min = other.min;
+        max = other.max;
+    } else {
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+    sum += other.sum;
+    count += other.count;
+    if (other.lastMs >= lastMs) {
+        last = other.last;
+        lastMs = other.lastMs;
+    }
+    if (kind != MetricKind::Counter) {
+        sketch.merge(other.sketch);
+    }
+}
+
+RollupWriter::RollupWriter(HistoryOptions options, std::int64_t resolutionMs)
+    : options_(std::move(options)),
+      resolutionMs_(resolutionMs),
+      appender_(options_.directory, options_.segmentMs, [resolutionMs] {
+          std::string header(kRollupSegmentMagic, sizeof(kRollupSegmentMagic));
+          header.append(reinterpret_cast<const char*>(&resolutionMs), sizeof(resolutionMs));
+          return header;
+      }()) {
+    if (options_.blockRows == 0) {
+        options_.blockRows = 1;
+    }
+}
+
+RollupWriter::~RollupWriter() {
+    try {
+        flush();
+    } catch (...) {
+    }
+}
+
+void RollupWriter::append(std::int64_t bucketMs, const std::map<SeriesKey, RollupCell>& cells) {
+    if (appender_.needsRotation(bucketMs)) {
+        flush();
+        appender_.open(bucketMs);
+    }
+
+    timestamps_.push_back(bucketMs);
+    rows_.push_back(cells);
+    if (timestamps_.size() >= options_.blockRows) {
+        flush();
+    }
+}
+
+void RollupWriter::flush() {
+    if (timestamps_.empty() || !appender_.isOpen()) {
+        return;
+    }
+
+    std::map<SeriesKey, std::size_t> index;
+    for (const auto& row : rows_) {
+        for (const auto& cell : row) {
+            index.emplace(cell.first, 0);
+        }
+    }
+    std::vector<SeriesKey> series;
+    for (auto& [key, position] : index) {
+        position = series.size();
+        series.push_back(key);
+    }
+    std::vector<MetricKind> kinds(series.size(), MetricKind::Gauge);
+
+    const std::size_t rows = timestamps_.size();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> stats(series.size() * kRollupStats * rows, nan);
+    for (std::size_t s = 0; s < series.size(); ++s) {
+        std::fill_n(stats.begin() + static_cast<std::ptrdiff_t>((s * kRollupStats + 3) * rows), rows, 0.0);
+    }
+    std::vector<std::string> sketches(series.size() * rows);
+    for (std::size_t r = 0; r < rows; ++r) {
+        for (const auto& [key, cell] : rows_[r]) {
+            const std::size_t s = index[key];
+            double* base = stats.data() + s * kRollupStats * rows;
+            base[0 * rows + r] = cell.min;
+            base[1 * rows + r] = cell.max;
+            base[2 * rows + r] = cell.sum;
+            base[3 * rows + r] = static_cast<double>(cell.count);
+            base[4 * rows + r] = cell.last;
+            kinds[s] = cell.kind;
+            // A bucket holding a single distinct value is fully described by
+            // min and count, so its sketch is left out; so are counters'.
+            if (cell.kind != MetricKind::Counter && !cell.sketch.empty() && cell.min != cell.max) {
+                cell.sketch.encode(sketches[s * rows + r]);
+            }
+        }
+    }
+
+    std::vector<std::uint32_t> offsets;
+    std::string sketchBytes;
+    packSketches(sketches, offsets, sketchBytes);
+
+    const std::string directory = encodeDirectory(series, kinds);
+    BlockHeader header;
+    header.magic = kRollupMagic;
+    header.rows = static_cast<std::uint32_t>(rows);
+    header.series = static_cast<std::uint32_t>(series.size());
+    header.directoryBytes = static_cast<std::uint32_t>(directory.size());
+    header.minMs = timestamps_.front();
+    header.maxMs = timestamps_.back();
+    header.payloadBytes = directory.size() + rows * sizeof(std::int64_t) + stats.size() * sizeof(double) +
+                          offsets.size() * sizeof(std::uint32_t) + sketchBytes.size();
+
+    std::ofstream& out = appender_.stream();
+    writeArray(out, &header, 1);
+    writeArray(out, directory.data(), directory.size());
+    writeArray(out, timestamps_.data(), rows);
+    writeArray(out, stats.data(), stats.size());
+    writeArray(out, offsets.data(), offsets.size());
+    writeArray(out, sketchBytes.data(), sketchBytes.size());
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("failed to write rollup block");
+    }
+
+    timestamps_.clear();
+    rows_.clear();
+}
+
+QuantileSketch columnSketch(const HistoryBlock::Column& column, std::size_t row) {
+    QuantileSketch sketch;
+    if (column.sketchOffsets == nullptr) {
+        return sketch;
+    }
+    const std::uint32_t begin = column.sketchOffsets[row];
+    const std::uint32_t end = column.sketchOffsets[row + 1];
+    if (end > begin && end <= column.sketchByteCount) {
+        sketch.decode(column.sketchBytes + begin, end - begin);
+    } else if (column.count != nullptr && column.count[row] > 0.0) {
+        sketch.add(column.min[row], static_cast<std::uint64_t>(column.count[row]));
+    }
+    return sketch;
+}
+
+HistoryReader::HistoryReader(std::string directory)
+    : directory_(std::move(directory)) {}
+
+HistoryScanStats HistoryReader::scan(std::int64_t fromMs,
+                                     std::int64_t toMs,
+                                     const SeriesPredicate& select,
+                                     const std::function<void(const HistoryBlock&)>& visit) const {
+    HistoryScanStats stats;
+    const auto segments = listSegments(directory_);
+
+    HistoryBlock block;
+    for (std::size_t s = 0; s < segments.size(); ++s) {
+        // A segment ends where the next one starts, so whole files outside the
+        // range are pruned by name without being opened.
+        if (segments[s].startMs > toMs) {
+            break;
+        }
+        if (s + 1 < segments.size() && segments[s + 1].startMs <= fromMs) {
+            continue;
+        }
+
+        MappedFile file(segments[s].path);
+        std::size_t offset = 0;
+        if (!openSegment(file, offset, block.resolutionMs)) {
+            continue;
+        }
+        ++stats.segmentsOpened;
+
+        while (offset + sizeof(BlockHeader) <= file.size()) {
+            BlockHeader header;
+            std::memcpy(&header, file.data() + offset, sizeof(header));
+            const std::uint32_t expected = block.resolutionMs == 0 ? kBlockMagic : kRollupMagic;
+            const std::uint32_t legacy = block.resolutionMs == 0 ? kBlockMagicV1 : kRollupMagicV1;
+            if ((header.magic != expected && header.magic != legacy) ||
+                header.payloadBytes > file.size() - offset - sizeof(header)) {
+                break; // torn tail from an interrupted writer
+            }
+
+            const unsigned char* payload = file.data() + offset + sizeof(header);
+            offset += sizeof(header) + header.payloadBytes;
+
+            if (header.maxMs < fromMs || header.minMs > toMs) {
+                ++stats.blocksSkipped;
+                continue;
+            }
+
+            block.minMs = header.minMs;
+            block.maxMs = header.maxMs;
+            block.rows = header.rows;
+            block.columns.clear();
+
+            // Everything before the sketch bytes must fit in the payload; a
+            // corrupt header would otherwise send the column pointers past
+            // the end of the mapping.
+            const std::size_t rows = header.rows;
+            std::size_t fixedBytes = 0;
+            if (!fixedPayloadBytes(header, block.resolutionMs != 0, fixedBytes) || fixedBytes > header.payloadBytes) {
+                ++stats.blocksSkipped;
+                continue;
+            }
+            const unsigned char* payloadEnd = payload + header.payloadBytes;
+            const unsigned char* cursor = payload;
+            const unsigned char* directoryEnd = payload + header.directoryBytes;
+            const auto* timestamps = reinterpret_cast<const std::int64_t*>(directoryEnd);
+            const auto* values = reinterpret_cast<const double*>(timestamps + rows);
+            const bool hasKinds = header.magic == expected;
+            const std::size_t entryBytes = hasKinds ? 5 : 4;
+            const std::uint32_t* sketchOffsets = nullptr;
+            const unsigned char* sketchBytes = nullptr;
+            if (block.resolutionMs == 0) {
+                sketchOffsets = reinterpret_cast<const std::uint32_t*>(values + header.series * rows);
+            } else {
+                const std::size_t offsetCount = header.series * rows + 1;
+                sketchOffsets = reinterpret_cast<const std::uint32_t*>(values + header.series * kRollupStats * rows);
+                sketchBytes = reinterpret_cast<const unsigned char*>(sketchOffsets + offsetCount + offsetCount % 2);
+            }
+            block.timestamps = timestamps;
+            const std::size_t sketchByteCount =
+                sketchBytes != nullptr ? static_cast<std::size_t>(payloadEnd - sketchBytes) : 0;
+
+            std::size_t distributions = 0;
+            for (std::uint32_t i = 0; i < header.series && cursor + entryBytes <= directoryEnd; ++i) {
+                std::uint16_t nameLen = 0;
+                std::uint16_t entityLen = 0;
+                std::memcpy(&nameLen, cursor, sizeof(nameLen));
+                std::memcpy(&entityLen, cursor + 2, sizeof(entityLen));
+                const auto kind = hasKinds ? static_cast<MetricKind>(cursor[4]) : MetricKind::Gauge;
+                cursor += entryBytes;
+                if (cursor + nameLen + entityLen > directoryEnd) {
+                    break;
+                }
+
+                const std::string_view name(reinterpret_cast<const char*>(cursor), nameLen);
+                const std::string_view entity(reinterpret_cast<const char*>(cursor + nameLen), entityLen);
+                cursor += nameLen + entityLen;
+
+                // Raw sketch rows are numbered across distribution series only.
+                const bool rawDistribution = block.resolutionMs == 0 && kind == MetricKind::Distribution;
+                const std::size_t distribution = rawDistribution ? distributions++ : 0;
+                if (select && !select(name, entity)) {
+                    continue;
+                }
+
+                HistoryBlock::Column column;
+                column.name = name;
+                column.entity = entity;
+                column.kind = kind;
+                if (block.resolutionMs == 0) {
+                    column.values = values + static_cast<std::size_t>(i) * rows;
+                    if (rawDistribution) {
+                        column.sketchOffsets = sketchOffsets + distribution * rows;
+                    }
+                } else {
+                    const double* base = values + static_cast<std::size_t>(i) * kRollupStats * rows;
+                    column.min = base;
+                    column.max = base + rows;
+                    column.sum = base + 2 * rows;
+                    column.count = base + 3 * rows;
+                    column.last = base + 4 * rows;
+                    column.sketchOffsets = sketchOffsets + static_cast<std::size_t>(i) * rows;
+                    column.sketchBytes = sketchBytes;
+                    column.sketchByteCount = sketchByteCount;
+                }
+                block.columns.push_back(column);
+            }
+
+            if (block.resolutionMs == 0 && distributions > 0) {
+                // The sketch bytes follow the offset table, whose length is
+                // only known once the directory has been walked.
+                const std::size_t offsetCount = distributions * rows + 1;
+                std::size_t tableEnd = fixedBytes;
+                if (!addOffsetTable(tableEnd, offsetCount) || tableEnd > header.payloadBytes) {
+                    ++stats.blocksSkipped;
+                    continue;
+                }
+                sketchBytes = reinterpret_cast<const unsigned char*>(sketchOffsets + offsetCount + offsetCount % 2);
+                for (auto& column : block.columns) {
+                    if (column.sketchOffsets != nullptr) {
+                        column.sketchBytes = sketchBytes;
+                        column.sketchByteCount = static_cast<std::size_t>(payloadEnd - sketchBytes);
+                    }
+                }
+            }
+
+            ++stats.blocksRead;
+            if (!block.columns.empty()) {
+                visit(block);
+            }
+        }
+    }
+
+    return stats;
+}
+
+HistoryRange HistoryReader::range() const {
+    HistoryRange range;
+    const auto segments = listSegments(directory_);
+    for (const auto& segment : segments) {
+        forEachBlockHeader(segment.path, [&range](const BlockHeader& header) {
+            if (range.empty) {
+                range.firstMs = header.minMs;
+                range.empty = false;
+            }
+        });
+        if (!range.empty) {
+            break;
+        }
+    }
+
+    bool haveLast = false;
+    for (std::size_t s = segments.size(); s > 0 && !haveLast; --s) {
+        forEachBlockHeader(segments[s - 1].path, [&](const BlockHeader& header) {
+            range.lastMs = haveLast ? std::max(range.lastMs, header.maxMs) : header.maxMs;
+            haveLast = true;
+        });
+    }
+    return range;
+}
+
+std::size_t removeSegmentsBefore(const std::string& directory, std::int64_t cutoffMs) {
+    const auto segments = listSegments(directory);
+    std::size_t removed = 0;
+    for (std::size_t s = 0; s + 1 < segments.size(); ++s) {
+        if (segments[s + 1].startMs > cutoffMs) {
+            break;
+        }
+        std::error_code ec;
+        if (std::filesystem::remove(segments[s].path, ec)) {
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+} // namespace statio
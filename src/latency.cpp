@@ -0,0 +1,114 @@
+#include "statio/latency.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+namespace statio {
+
+// Partitions would count every I/O twice, and loop/ram devices only add noise.
+bool isWholeBlockDevice(const std::string& name) {
+    if (name.rfind("loop", 0) == 0 || name.rfind("ram", 0) == 0) {
+        return false;
+    }
+    struct stat st {};
+    return ::stat(("/sys/block/" + name).c_str(), &st) == 0;
+}
+
+void LatencySampler::poll() {
+    pollDisks();
+    pollScheduler();
+}
+
+void LatencySampler::record(const std::string& name, const std::string& entity, double value) {
+    sketches_[SeriesKey{name, entity}].add(value);
+}
+
+std::vector<DistributionInfo> LatencySampler::drain() {
+    std::vector<DistributionInfo> out;
+    for (auto& [key, sketch] : sketches_) {
+        if (sketch.empty()) {
+            continue;
+        }
+        out.push_back(DistributionInfo{key.first, key.second, sketch});
+        sketch.clear();
+    }
+    return out;
+}
+
+void LatencySampler::pollDisks() {
+    std::ifstream input("/proc/diskstats");
+    std::string line;
+    while (std::getline(input, line)) {
+        std::istringstream fields(line);
+        unsigned int major = 0;
+        unsigned int minor = 0;
+        std::string name;
+        std::uint64_t reads = 0;
+        std::uint64_t readsMerged = 0;
+        std::uint64_t sectorsRead = 0;
+        std::uint64_t readMs = 0;
+        std::uint64_t writes = 0;
+        std::uint64_t writesMerged = 0;
+        std::uint64_t sectorsWritten = 0;
+        std::uint64_t writeMs = 0;
+        if (!(fields >> major >> minor >> name >> reads >> readsMerged >> sectorsRead >> readMs >> writes >>
+              writesMerged >> sectorsWritten >> writeMs)) {
+            continue;
+        }
+
+        auto it = disks_.find(name);
+        if (it == disks_.end()) {
+            if (!isWholeBlockDevice(name)) {
+                continue;
+            }
+            it = disks_.emplace(name, IoCounters{reads + writes, readMs + writeMs}).first;
+            continue;
+        }
+
+        const IoCounters now{reads + writes, readMs + writeMs};
+        if (now.completed > it->second.completed && now.busyMs >= it->second.busyMs) {
+            const double await = static_cast<double>(now.busyMs - it->second.busyMs) /
+                                 static_cast<double>(now.completed - it->second.completed);
+            record("disk.await_ms", name, await);
+        }
+        it->second = now;
+    }
+}
+
+void LatencySampler::pollScheduler() {
+    std::ifstream input("/proc/schedstat");
+    std::string line;
+    while (std::getline(input, line)) {
+        if (line.rfind("cpu", 0) != 0) {
+            continue;
+        }
+        // cpuN yld_count 0 sched_count sched_goidle ttwu_count ttwu_local
+        //      run_ns wait_ns timeslices
+        std::istringstream fields(line);
+        std::string name;
+        std::uint64_t value[9] = {};
+        fields >> name;
+        for (auto& v : value) {
+            fields >> v;
+        }
+        if (!fields) {
+            continue;
+        }
+
+        const SchedCounters now{value[7], value[8]};
+        auto it = cpus_.find(name);
+        if (it == cpus_.end()) {
+            cpus_.emplace(name, now);
+            continue;
+        }
+        if (now.timeslices > it->second.timeslices && now.waitNs >= it->second.waitNs) {
+            const double delayUs = static_cast<double>(now.waitNs - it->second.waitNs) / 1000.0 /
+                                   static_cast<double>(now.timeslices - it->second.timeslices);
+            record("sched.delay_us", name, delayUs);
+        }
+        it->second = now;
+    }
+}
+
+} // namespace statio
@@ -0,0 +1,146 @@
+#include "statio/lz.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace statio {
+namespace {
+
+constexpr std::size_t kMinMatch = 4;
+constexpr std::size_t kMaxOffset = 65535;
+constexpr int kHashBits = 12;
+// The last bytes are always literals so the decoder's final sequence needs
+// no match.
+constexpr std::size_t kTailLiterals = 5;
+
+std::uint32_t read32(const char* p) {
+    std::uint32_t value = 0;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+std::uint32_t hash4(std::uint32_t value) {
+    return (value * 2654435761U) >> (32 - kHashBits);
+}
+
+void putLength(std::string& out, std::size_t length) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+void putSequence(std::string& out, const char* literals, std::size_t literalLength, std::size_t offset, std::size_t matchLength) {
+    const std::size_t matchCode = matchLength >= kMinMatch ? matchLength - kMinMatch : 0;
+    const std::size_t literalNibble = literalLength < 15 ? literalLength : 15;
+    const std::size_t matchNibble = matchCode < 15 ? matchCode : 15;
+    out.push_back(static_cast<char>((literalNibble << 4) | matchNibble));
+    if (literalNibble == 15) {
+        putLength(out, literalLength - 15);
+    }
+    out.append(literals, literalLength);
+    if (matchLength == 0) {
+        return; // final literal run
+    }
+    out.push_back(static_cast<char>(offset & 0xff));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (matchNibble == 15) {
+        putLength(out, matchCode - 15);
+    }
+}
+
+std::size_t getLength(const unsigned char*& p, const unsigned char* end, std::size_t nibble) {
+    std::size_t length = nibble;
+    if (nibble == 15) {
+        unsigned char b = 255;
+        while (b == 255) {
+            if (p >= end) {
+                throw std::runtime_error("corrupt LZ block: truncated length");
+            }
+            b = *p++;
+            length += b;
+        }
+    }
+    return length;
+}
+
+} // namespace
+
+void lzCompress(std::string_view input, std::string& out) {
+    const char* base = input.data();
+    const std::size_t size = input.size();
+    std::uint32_t table[1 << kHashBits];
+    std::memset(table, 0xff, sizeof(table));
+
+    std::size_t anchor = 0;
+    std::size_t pos = 0;
+    if (size > kMinMatch + kTailLiterals) {
+        const std::size_t limit = size - kMinMatch - kTailLiterals;
+        while (pos <= limit) {
+            const std::uint32_t sequence = read32(base + pos);
+            const std::uint32_t h = hash4(sequence);
+            const std::uint32_t candidate = table[h];
+            table[h] = static_cast<std::uint32_t>(pos);
+            if (candidate == 0xffffffffU || pos - candidate > kMaxOffset || read32(base + candidate) != sequence) {
+                ++pos;
+                continue;
+            }
+
+            std::size_t length = kMinMatch;
+            const std::size_t maxLength = size - kTailLiterals - pos;
+            while (length < maxLength && base[candidate + length] == base[pos + length]) {
+                ++length;
+            }
+            putSequence(out, base + anchor, pos - anchor, pos - candidate, length);
+            pos += length;
+            anchor = pos;
+        }
+    }
+    putSequence(out, base + anchor, size - anchor, 0, 0);
+}
+
+void lzDecompress(std::string_view input, std::size_t rawSize, std::string& out) {
+    const std::size_t start = out.size();
+    out.resize(start + rawSize);
+    char* dst = &out[start];
+    std::size_t written = 0;
+    const auto* p = reinterpret_cast<const unsigned char*>(input.data());
+    const unsigned char* end = p + input.size();
+
+    while (p < end) {
+        const unsigned char token = *p++;
+        const std::size_t literals = getLength(p, end, token >> 4);
+        if (literals > static_cast<std::size_t>(end - p) || literals > rawSize - written) {
+            throw std::runtime_error("corrupt LZ block: literal run overflows");
+        }
+        std::memcpy(dst + written, p, literals);
+        p += literals;
+        written += literals;
+        if (p == end) {
+            break;
+        }
+
+        if (end - p < 2) {
+            throw std::runtime_error("corrupt LZ block: truncated offset");
+        }
+        const std::size_t offset = static_cast<std::size_t>(p[0]) | (static_cast<std::size_t>(p[1]) << 8);
+        p += 2;
+        const std::size_t length = getLength(p, end, token & 0x0f) + kMinMatch;
+        if (offset == 0 || offset > written || length > rawSize - written) {
+            throw std::runtime_error("corrupt LZ block: bad match");
+        }
+        // Byte-wise copy: matches may overlap their own output.
+        const char* from = dst + written - offset;
+        for (std::size_t i = 0; i < length; ++i) {
+            dst[written + i] = from[i];
+        }
+        written += length;
+    }
+    if (written != rawSize) {
+        throw std::runtime_error("corrupt LZ block: size mismatch");
+    }
+}
+
+} // namespace statio
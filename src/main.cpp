@@ -1,10 +1,94 @@
+#include "statio/api.hpp"
+#include "statio/commands.hpp"
+#include "statio/history.hpp"
 #include "statio/system_info.hpp"
 
 #include <exception>
 #include <iostream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using CommandHandler = int (*)(const std::vector<std::string>&);
+
+void printUsage() {
+    std::cerr << "usage: statio [command] [options]\n"
+                 "\n"
+                 "  (none)     print the diagnostic report (from a running daemon's API\n"
+                 "             socket when one answers; --local always collects)\n"
+                 "  --fields   print only the listed fields, collecting just their sources\n"
+                 "             (--fields memory.*,network.rx_bytes [--format json] [--every 1s])\n"
+                 "  daemon     sample periodically and record history\n"
+                 "  burst      ask a running daemon for high-frequency sampling\n"
+                 "  compact    roll history into downsampled tiers and apply retention\n"
+                 "  query      aggregate recorded history\n"
+                 "  rules      check alert rules or benchmark their evaluation\n"
+                 "  anomalies  replay history through the anomaly detectors\n"
+                 "  agent      send snapshots to a statio-aggregator\n"
+                 "  fleet      query a statio-aggregator (top cpu 10, degraded, host NAME)\n"
+                 "  receive    accept pushed snapshots (local stand-in for an aggregator)\n"
+                 "  api        send a request to a running daemon (snapshot, report, history, subscribe)\n"
+                 "  bench      run a hardware/OS benchmark (statio bench help)\n"
+                 "  top        live terminal view: per-core load, memory, disk and network rates, processes\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    static const std::map<std::string, CommandHandler> commands = {
+        {"daemon", statio::runDaemonCommand},
+        {"burst", statio::runBurstCommand},
+        {"compact", statio::runCompactCommand},
+        {"query", statio::runQueryCommand},
+        {"rules", statio::runRulesCommand},
+        {"anomalies", statio::runAnomaliesCommand},
+        {"agent", statio::runAgentCommand},
+        {"fleet", statio::runFleetCommand},
+        {"receive", statio::runReceiveCommand},
+        {"api", statio::runApiCommand},
+        {"bench", statio::runBenchCommand},
+        {"top", statio::runTopCommand},
+    };
 
-int main() {
     try {
+        const bool local = argc == 2 && std::string(argv[1]) == "--local";
+        if (argc > 1 && std::string(argv[1]).rfind("--fields", 0) == 0) {
+            return statio::runFieldsCommand(std::vector<std::string>(argv + 1, argv + argc));
+        }
+        if (argc > 1 && !local) {
+            const std::string command = argv[1];
+            auto it = commands.find(command);
+            if (it == commands.end()) {
+                printUsage();
+                return command == "help" || command == "--help" ? 0 : 2;
+            }
+            return it->second(std::vector<std::string>(argv + 2, argv + argc));
+        }
+
+        // A daemon already holds a fresh snapshot; asking it is far cheaper
+        // than collecting one. A stalled daemon's snapshot is not fresh.
+        if (!local) {
+            const int fd = statio::connectApi(statio::defaultApiSocket());
+            if (fd >= 0) {
+                std::string report;
+                try {
+                    if (statio::apiSnapshotFresh(statio::apiRequest(fd, "snapshot os"), statio::currentTimeMs())) {
+                        report = statio::apiRequest(fd, "report");
+                    }
+                } catch (const std::exception&) {
+                    report.clear(); // e.g. no sample yet: collect locally
+                }
+                ::close(fd);
+                if (!report.empty()) {
+                    std::cout << report;
+                    return 0;
+                }
+            }
+        }
+
         statio::SystemSnapshot snapshot = statio::collectSystemSnapshot();
         std::cout << statio::renderReport(snapshot);
     } catch (const std::exception& e) {
@@ -1,9 +1,14 @@
 #include "statio/main_window.hpp"
 
+#include "statio/anomaly.hpp"
+#include "statio/bench.hpp"
+#include "statio/history.hpp"
+#include "statio/schema.hpp"
 #include "statio/system_info.hpp"
 
 #include <QAction>
 #include <QActionGroup>
+#include <QColor>
 #include <QDateTime>
 #include <QDialog>
 #include <QDialogButtonBox>
@@ -21,34 +26,17 @@
 #include <QTimer>
 #include <QVBoxLayout>
 #include <QWidget>
-#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
 namespace {
 
-QString formatBytes(std::uint64_t bytes) {
-    constexpr double kb = 1024.0;
-    constexpr double mb = kb * 1024.0;
-    constexpr double gb = mb * 1024.0;
-    constexpr double tb = gb * 1024.0;
-
-    const double value = static_cast<double>(bytes);
-    if (value >= tb) {
-        return QString::number(value / tb, 'f', 2) + " TB";
-    }
-    if (value >= gb) {
-        return QString::number(value / gb, 'f', 2) + " GB";
-    }
-    if (value >= mb) {
-        return QString::number(value / mb, 'f', 2) + " MB";
-    }
-    if (value >= kb) {
-        return QString::number(value / kb, 'f', 2) + " KB";
-    }
-    return QString::number(bytes) + " B";
-}
-
 QTableWidget* makeInfoTable(int columns, const QStringList& headers, QWidget* parent) {
     auto* table = new QTableWidget(parent);
     table->setColumnCount(columns);
@@ -80,6 +68,58 @@ void setKeyValueRows(QTableWidget* table, const std::vector<std::pair<QString, Q
     table->horizontalHeader()->setStretchLastSection(true);
 }
 
+QStringList toStringList(const std::vector<std::string>& texts) {
+    QStringList list;
+    for (const auto& text : texts) {
+        list << QString::fromStdString(text);
+    }
+    return list;
+}
+
+void highlightRow(QTableWidget* table, int row) {
+    for (int col = 0; col < table->columnCount(); ++col) {
+        if (auto* item = table->item(row, col)) {
+            item->setBackground(QColor(0xc6, 0x28, 0x28));
+            item->setForeground(QColor(0xff, 0xff, 0xff));
+        }
+    }
+}
+
+// A key/value table of one snapshot record, rows from its schema.
+template <typename Record>
+void setRecordRows(QTableWidget* table, const Record& record) {
+    std::vector<std::pair<QString, QString>> rows;
+    for (const auto& [label, value] : statio::fieldRows(record)) {
+        rows.emplace_back(QString::fromStdString(label), QString::fromStdString(value));
+    }
+    setKeyValueRows(table, rows);
+}
+
+// A table with one row per record and one column per schema field.
+template <typename Record>
+QTableWidget* makeRecordTable(QWidget* parent) {
+    const QStringList headers = toStringList(statio::fieldCaptions<Record>());
+    return makeInfoTable(static_cast<int>(headers.size()), headers, parent);
+}
+
+// Fills a makeRecordTable() table; rows whose entity `anomalous` flags are highlighted.
+template <typename Record, typename Predicate>
+void setRecordTable(QTableWidget* table, const std::vector<Record>& records, Predicate anomalous) {
+    table->setRowCount(static_cast<int>(records.size()));
+    for (int i = 0; i < static_cast<int>(records.size()); ++i) {
+        const Record& record = records[static_cast<std::size_t>(i)];
+        const std::vector<std::string> cells = statio::fieldCells(record);
+        for (int col = 0; col < static_cast<int>(cells.size()); ++col) {
+            setCell(table, i, col, QString::fromStdString(cells[static_cast<std::size_t>(col)]));
+        }
+        if (anomalous(statio::Schema<Record>::entity(record))) {
+            highlightRow(table, i);
+        }
+    }
+    table->resizeColumnsToContents();
+    table->horizontalHeader()->setStretchLastSection(true);
+}
+
 QWidget* makeMetricCard(const QString& title, QLabel*& valueLabel, QWidget* parent) {
     auto* box = new QGroupBox(title, parent);
     auto* layout = new QVBoxLayout(box);
@@ -93,7 +133,7 @@ QWidget* makeMetricCard(const QString& title, QLabel*& valueLabel, QWidget* pare
 } // namespace
 
 MainWindow::MainWindow(QWidget* parent)
-    : QMainWindow(parent) {
+    : QMainWindow(parent), anomalies_(std::make_unique<statio::AnomalyDetector>()) {
     setWindowTitle("Statio");
     resize(1100, 760);
 
@@ -157,6 +197,8 @@ MainWindow::MainWindow(QWidget* parent)
     refreshTimer_->start();
 }
 
+MainWindow::~MainWindow() = default;
+
 void MainWindow::setupTabs() {
     tabs_->addTab(buildOverviewTab(), "Overview");
     tabs_->addTab(buildCpuTab(), "CPU");
@@ -164,6 +206,8 @@ void MainWindow::setupTabs() {
     tabs_->addTab(buildDisksTab(), "Disks");
     tabs_->addTab(buildNetworkTab(), "Network");
     tabs_->addTab(buildGpuTab(), "GPU");
+    tabs_->addTab(buildAnomaliesTab(), "Anomalies");
+    tabs_->addTab(buildCoreToCoreTab(), "Core-to-Core");
 }
 
 QWidget* MainWindow::buildOverviewTab() {
@@ -213,7 +257,7 @@ QWidget* MainWindow::buildMemoryTab() {
 QWidget* MainWindow::buildDisksTab() {
     auto* page = new QWidget(tabs_);
     auto* layout = new QVBoxLayout(page);
-    diskTable_ = makeInfoTable(5, {"Mount", "FS", "Total", "Used", "Free"}, page);
+    diskTable_ = makeRecordTable<statio::DiskInfo>(page);
     diskTable_->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
     diskTable_->horizontalHeader()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
     layout->addWidget(diskTable_);
@@ -223,7 +267,7 @@ QWidget* MainWindow::buildDisksTab() {
 QWidget* MainWindow::buildNetworkTab() {
     auto* page = new QWidget(tabs_);
     auto* layout = new QVBoxLayout(page);
-    networkTable_ = makeInfoTable(5, {"Interface", "IPv4", "MAC", "RX", "TX"}, page);
+    networkTable_ = makeRecordTable<statio::NetworkInfo>(page);
     networkTable_->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
     layout->addWidget(networkTable_);
     return page;
@@ -232,11 +276,116 @@ QWidget* MainWindow::buildNetworkTab() {
 QWidget* MainWindow::buildGpuTab() {
     auto* page = new QWidget(tabs_);
     auto* layout = new QVBoxLayout(page);
-    gpuTable_ = makeInfoTable(2, {"Adapter", "Status"}, page);
+    gpuTable_ = makeRecordTable<statio::GpuInfo>(page);
     layout->addWidget(gpuTable_);
     return page;
 }
 
+QWidget* MainWindow::buildAnomaliesTab() {
+    auto* page = new QWidget(tabs_);
+    auto* layout = new QVBoxLayout(page);
+    anomalyTable_ = makeInfoTable(5, {"Series", "Detector", "Value", "Baseline", "Score"}, page);
+    anomalyTable_->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+    layout->addWidget(anomalyTable_);
+    return page;
+}
+
+QWidget* MainWindow::buildCoreToCoreTab() {
+    auto* page = new QWidget(tabs_);
+    auto* layout = new QVBoxLayout(page);
+    auto* bar = new QHBoxLayout();
+    c2cStatus_ = new QLabel("One-way cache-line transfer latency between every pair of CPUs, in ns.", page);
+    c2cStatus_->setWordWrap(true);
+    c2cRunButton_ = new QPushButton("Run Benchmark", page);
+    bar->addWidget(c2cStatus_, 1);
+    bar->addWidget(c2cRunButton_);
+    layout->addLayout(bar);
+
+    c2cTable_ = new QTableWidget(page);
+    c2cTable_->setSelectionMode(QAbstractItemView::NoSelection);
+    c2cTable_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    c2cTable_->setFocusPolicy(Qt::NoFocus);
+    c2cTable_->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    c2cTable_->verticalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    layout->addWidget(c2cTable_, 1);
+
+    c2cPoll_ = new QTimer(this);
+    c2cPoll_->setInterval(200);
+    connect(c2cRunButton_, &QPushButton::clicked, this, &MainWindow::runCoreToCore);
+    connect(c2cPoll_, &QTimer::timeout, this, &MainWindow::checkCoreToCore);
+    return page;
+}
+
+void MainWindow::runCoreToCore() {
+    if (c2cRun_.valid()) {
+        return;
+    }
+    c2cRunButton_->setEnabled(false);
+    c2cStatus_->setText("Measuring every CPU pair...");
+    c2cRun_ = std::async(std::launch::async, [] { return statio::runCoreToCore(statio::C2cOptions {}); });
+    c2cPoll_->start();
+}
+
+void MainWindow::checkCoreToCore() {
+    if (!c2cRun_.valid() || c2cRun_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    c2cPoll_->stop();
+    c2cRunButton_->setEnabled(true);
+    try {
+        showCoreToCore(c2cRun_.get());
+    } catch (const std::exception& e) {
+        c2cStatus_->setText(QString("Benchmark failed: ") + e.what());
+    }
+}
+
+void MainWindow::showCoreToCore(const statio::C2cResult& result) {
+    const int n = static_cast<int>(result.cpus.size());
+    double low = INFINITY;
+    double high = 0.0;
+    for (const double ns : result.oneWayNs) {
+        if (!std::isnan(ns)) {
+            low = std::min(low, ns);
+            high = std::max(high, ns);
+        }
+    }
+
+    QStringList labels;
+    for (const auto& placement : result.cpus) {
+        labels << QString::number(placement.cpu);
+    }
+    c2cTable_->clear();
+    c2cTable_->setRowCount(n);
+    c2cTable_->setColumnCount(n);
+    c2cTable_->setHorizontalHeaderLabels(labels);
+    c2cTable_->setVerticalHeaderLabels(labels);
+    for (int row = 0; row < n; ++row) {
+        for (int col = 0; col < n; ++col) {
+            const double ns = result.at(static_cast<std::size_t>(row), static_cast<std::size_t>(col));
+            auto* item = new QTableWidgetItem(std::isnan(ns) ? QString() : QString::number(ns, 'f', 0));
+            item->setTextAlignment(Qt::AlignCenter);
+            if (!std::isnan(ns)) {
+                // Green for the fastest pairs through red for the slowest.
+                const double t = high > low ? (ns - low) / (high - low) : 0.0;
+                item->setBackground(QColor::fromHsv(static_cast<int>((1.0 - t) * 120.0), 190, 235));
+                item->setForeground(QColor(0x10, 0x10, 0x10));
+                item->setToolTip(QString("cpu %1 <-> cpu %2: %3 ns (%4)")
+                                     .arg(result.cpus[static_cast<std::size_t>(row)].cpu)
+                                     .arg(result.cpus[static_cast<std::size_t>(col)].cpu)
+                                     .arg(ns, 0, 'f', 1)
+                                     .arg(statio::cpuRelationName(statio::cpuRelation(
+                                         result.cpus[static_cast<std::size_t>(row)], result.cpus[static_cast<std::size_t>(col)]))));
+            }
+            c2cTable_->setItem(row, col, item);
+        }
+    }
+    c2cStatus_->setText(QString("%1 CPUs, %2 - %3 ns one-way, measured in %4 s")
+                            .arg(n)
+                            .arg(low, 0, 'f', 0)
+                            .arg(high, 0, 'f', 0)
+                            .arg(result.elapsedSeconds, 0, 'f', 1));
+}
+
 void MainWindow::applyTheme(bool dark) {
     darkThemeEnabled_ = dark;
 
@@ -469,6 +618,7 @@ void MainWindow::applyTheme(bool dark) {
 void MainWindow::refreshReport() {
     const auto snapshot = statio::collectSystemSnapshot();
     const QString stamp = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
+    anomalies_->observe(statio::currentTimeMs(), statio::flattenSnapshot(snapshot), nullptr);
 
     overviewHostValue_->setText(QString::fromStdString(snapshot.os.hostname.empty() ? "N/A" : snapshot.os.hostname));
     overviewOsValue_->setText(QString::fromStdString(snapshot.os.distro.empty() ? "N/A" : snapshot.os.distro));
@@ -479,55 +629,29 @@ void MainWindow::refreshReport() {
     overviewNetworkCountValue_->setText(QString::number(static_cast<int>(snapshot.network.size())));
     overviewGpuCountValue_->setText(QString::number(static_cast<int>(snapshot.gpus.size())));
 
-    setKeyValueRows(cpuTable_, {
-                                {"Model", QString::fromStdString(snapshot.cpu.model.empty() ? "N/A" : snapshot.cpu.model)},
-                                {"Physical cores", QString::number(snapshot.cpu.physicalCores)},
-                                {"Logical threads", QString::number(snapshot.cpu.logicalThreads)},
-                                {"Current MHz", QString::number(snapshot.cpu.currentMHz, 'f', 2)},
-                            });
-
-    setKeyValueRows(memoryTable_, {
-                                   {"Total RAM", QString::number(snapshot.memory.totalMB) + " MB"},
-                                   {"Free RAM", QString::number(snapshot.memory.freeMB) + " MB"},
-                                   {"Available RAM", QString::number(snapshot.memory.availableMB) + " MB"},
-                                   {"Total Swap", QString::number(snapshot.memory.swapTotalMB) + " MB"},
-                                   {"Free Swap", QString::number(snapshot.memory.swapFreeMB) + " MB"},
-                               });
-
-    diskTable_->setRowCount(static_cast<int>(snapshot.disks.size()));
-    for (int i = 0; i < static_cast<int>(snapshot.disks.size()); ++i) {
-        const auto& disk = snapshot.disks[static_cast<std::size_t>(i)];
-        const auto usedGB = disk.totalGB >= disk.freeGB ? (disk.totalGB - disk.freeGB) : 0ULL;
-
-        setCell(diskTable_, i, 0, QString::fromStdString(disk.mountPoint));
-        setCell(diskTable_, i, 1, QString::fromStdString(disk.filesystem));
-        setCell(diskTable_, i, 2, QString::number(disk.totalGB) + " GB");
-        setCell(diskTable_, i, 3, QString::number(usedGB) + " GB");
-        setCell(diskTable_, i, 4, QString::number(disk.freeGB) + " GB");
-    }
-    diskTable_->resizeColumnsToContents();
-    diskTable_->horizontalHeader()->setStretchLastSection(true);
-
-    networkTable_->setRowCount(static_cast<int>(snapshot.network.size()));
-    for (int i = 0; i < static_cast<int>(snapshot.network.size()); ++i) {
-        const auto& net = snapshot.network[static_cast<std::size_t>(i)];
-        setCell(networkTable_, i, 0, QString::fromStdString(net.name));
-        setCell(networkTable_, i, 1, net.ipv4.empty() ? "N/A" : QString::fromStdString(net.ipv4));
-        setCell(networkTable_, i, 2, net.mac.empty() ? "N/A" : QString::fromStdString(net.mac));
-        setCell(networkTable_, i, 3, formatBytes(net.rxBytes));
-        setCell(networkTable_, i, 4, formatBytes(net.txBytes));
-    }
-    networkTable_->resizeColumnsToContents();
-    networkTable_->horizontalHeader()->setStretchLastSection(true);
-
-    gpuTable_->setRowCount(static_cast<int>(snapshot.gpus.size()));
-    for (int i = 0; i < static_cast<int>(snapshot.gpus.size()); ++i) {
-        const auto& gpu = snapshot.gpus[static_cast<std::size_t>(i)];
-        setCell(gpuTable_, i, 0, QString::fromStdString(gpu.adapter));
-        setCell(gpuTable_, i, 1, gpu.detected ? "Detected" : "Fallback");
+    setRecordRows(cpuTable_, snapshot.cpu);
+    setRecordRows(memoryTable_, snapshot.memory);
+
+    const auto anomalous = [this](const std::string& entity) { return anomalies_->entityAnomalous(entity); };
+    setRecordTable(diskTable_, snapshot.disks, anomalous);
+    setRecordTable(networkTable_, snapshot.network, anomalous);
+    setRecordTable(gpuTable_, snapshot.gpus, anomalous);
+
+    const auto active = anomalies_->active();
+    anomalyTable_->setRowCount(static_cast<int>(active.size()));
+    for (int i = 0; i < static_cast<int>(active.size()); ++i) {
+        const auto& event = active[static_cast<std::size_t>(i)];
+        setCell(anomalyTable_, i, 0, QString::fromStdString(statio::seriesLabel(event.name, event.entity)));
+        setCell(anomalyTable_, i, 1, statio::anomalyKindName(event.kind));
+        setCell(anomalyTable_, i, 2, QString::number(event.value, 'f', 2));
+        setCell(anomalyTable_, i, 3, QString::number(event.baseline, 'f', 2));
+        setCell(anomalyTable_, i, 4, QString::number(event.score, 'f', 1));
+        highlightRow(anomalyTable_, i);
     }
-    gpuTable_->resizeColumnsToContents();
-    gpuTable_->horizontalHeader()->setStretchLastSection(true);
+    anomalyTable_->resizeColumnsToContents();
+    anomalyTable_->horizontalHeader()->setStretchLastSection(true);
+    tabs_->setTabText(tabs_->indexOf(anomalyTable_->parentWidget()),
+                      active.empty() ? QString("Anomalies") : QString("Anomalies (%1)").arg(static_cast<int>(active.size())));
 
     statusLabel_->setText("Last update: " + stamp + " | Auto-refresh: 5s");
 }
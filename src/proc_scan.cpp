@@ -0,0 +1,359 @@
+#include "statio/proc_scan.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+// Large enough for about 4000 /proc entries per getdents64() call.
+constexpr std::size_t kDirentBytes = 128 * 1024;
+
+struct LinuxDirent64 {
+    std::uint64_t ino;
+    std::int64_t off;
+    unsigned short reclen;
+    unsigned char type;
+    char name[1];
+};
+
+std::uint64_t packRange(std::uint32_t begin, std::uint32_t end) {
+    return static_cast<std::uint64_t>(begin) << 32 | end;
+}
+
+std::size_t usableCpus() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (::sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        return static_cast<std::size_t>(std::max(1, CPU_COUNT(&allowed)));
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Parses the decimal at `p`, after any spaces; false when there is none.
+bool parseField(const char*& p, const char* end, long long& value) {
+    while (p < end && *p == ' ') {
+        ++p;
+    }
+    const bool negative = p < end && *p == '-';
+    p += negative ? 1 : 0;
+    if (p == end || *p < '0' || *p > '9') {
+        return false;
+    }
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p++ - '0');
+    }
+    value = negative ? -value : value;
+    return true;
+}
+
+} // namespace
+
+bool parseProcStat(std::string_view text, ProcStat& out) {
+    if (text.empty()) {
+        return false;
+    }
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    // "pid (comm) state ppid ...": comm may itself hold spaces and ')'.
+    const char* open = static_cast<const char*>(std::memchr(begin, '(', text.size()));
+    const char* close = end;
+    while (close > begin && *(close - 1) != ')') {
+        --close;
+    }
+    if (open == nullptr || close <= open + 1 || end - close < 3) {
+        return false;
+    }
+    out.name = std::string_view(open + 1, static_cast<std::size_t>(close - 1 - (open + 1)));
+    out.state = close[1];
+
+    // Fields 4 (ppid) to 24 (rss); a few of them may be negative.
+    long long fields[25] = {};
+    const char* p = close + 2;
+    for (int field = 4; field <= 24; ++field) {
+        if (!parseField(p, end, fields[field])) {
+            return false;
+        }
+    }
+    out.ppid = static_cast<int>(fields[4]);
+    out.ticks = static_cast<std::uint64_t>(fields[14]) + static_cast<std::uint64_t>(fields[15]);
+    out.threads = static_cast<unsigned>(std::max(fields[20], 0LL));
+    out.rssPages = static_cast<std::uint64_t>(std::max(fields[24], 0LL));
+    return true;
+}
+
+void listPids(int dirFd, std::vector<int>& pids) {
+    if (::lseek(dirFd, 0, SEEK_SET) < 0) {
+        throw std::runtime_error(std::string("cannot rewind a /proc listing: ") + std::strerror(errno));
+    }
+    std::vector<char> buffer(kDirentBytes);
+    for (;;) {
+        const long n = ::syscall(SYS_getdents64, dirFd, buffer.data(), buffer.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("cannot list /proc: ") + std::strerror(errno));
+        }
+        if (n == 0) {
+            return;
+        }
+        for (long offset = 0; offset < n;) {
+            const auto* entry = reinterpret_cast<const LinuxDirent64*>(buffer.data() + offset);
+            offset += entry->reclen;
+            int pid = 0;
+            const char* c = entry->name;
+            for (; *c >= '0' && *c <= '9'; ++c) {
+                pid = pid * 10 + (*c - '0');
+            }
+            if (*c == '\0' && pid > 0) {
+                pids.push_back(pid);
+            }
+        }
+    }
+}
+
+std::string_view ProcessColumns::nameOf(std::size_t row) const {
+    const auto& text = name[row];
+    return std::string_view(text.data(), ::strnlen(text.data(), text.size()));
+}
+
+void ProcessColumns::resize(std::size_t rows) {
+    pid.resize(rows);
+    ppid.resize(rows);
+    state.resize(rows);
+    ticks.resize(rows);
+    rssKB.resize(rows);
+    threads.resize(rows);
+    name.resize(rows);
+}
+
+ProcScanner::ProcScanner(std::size_t workers, const std::string& root) {
+    rootFd_ = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd_ < 0) {
+        throw std::runtime_error("cannot open " + root + ": " + std::strerror(errno));
+    }
+    const long page = ::sysconf(_SC_PAGESIZE);
+    if (page > 0) {
+        pageKB_ = static_cast<std::uint64_t>(page) / 1024;
+    }
+    if (workers == 0) {
+        workers = std::min(usableCpus(), kMaxAutoWorkers);
+    }
+
+    // Worker 0 is the thread that calls scan().
+    try {
+        for (std::size_t i = 0; i < workers; ++i) {
+            workers_.push_back(std::make_unique<Worker>());
+            workers_.back()->buffer.assign(1024, '\0');
+            if (i > 0) {
+                workers_.back()->thread = std::thread([this, i] { runWorker(i); });
+            }
+        }
+    } catch (...) {
+        stopWorkers();
+        throw;
+    }
+}
+
+ProcScanner::~ProcScanner() {
+    stopWorkers();
+}
+
+void ProcScanner::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    start_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    if (rootFd_ >= 0) {
+        ::close(rootFd_);
+        rootFd_ = -1;
+    }
+}
+
+void ProcScanner::scan(ProcessColumns& out) {
+    pids_.clear();
+    listPids(rootFd_, pids_);
+    readListed(out);
+}
+
+void ProcScanner::read(const std::vector<int>& pids, ProcessColumns& out) {
+    pids_.assign(pids.begin(), pids.end());
+    readListed(out);
+}
+
+void ProcScanner::readListed(ProcessColumns& out) {
+    const std::size_t listed = pids_.size();
+    const std::size_t chunks = (listed + kChunkPids - 1) / kChunkPids;
+    out.resize(listed);
+    found_.assign(listed, 0);
+    out_ = &out;
+
+    const std::size_t use = std::clamp<std::size_t>(listed / kPidsPerWorker, 1, workers_.size());
+    lastWorkers_ = use;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = use;
+        running_ = use - 1;
+    }
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+        const auto begin = static_cast<std::uint32_t>(i < use ? chunks * i / use : chunks);
+        const auto end = static_cast<std::uint32_t>(i < use ? chunks * (i + 1) / use : chunks);
+        workers_[i]->range.store(packRange(begin, end), std::memory_order_relaxed);
+    }
+
+    if (use == 1) {
+        work(0);
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++round_;
+        }
+        start_.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return running_ == 0; });
+    }
+
+    // Merge: the rows of processes that exited before their read are gaps.
+    std::size_t kept = 0;
+    for (std::size_t row = 0; row < listed; ++row) {
+        if (!found_[row]) {
+            continue;
+        }
+        if (kept != row) {
+            out.pid[kept] = out.pid[row];
+            out.ppid[kept] = out.ppid[row];
+            out.state[kept] = out.state[row];
+            out.ticks[kept] = out.ticks[row];
+            out.rssKB[kept] = out.rssKB[row];
+            out.threads[kept] = out.threads[row];
+            out.name[kept] = out.name[row];
+        }
+        ++kept;
+    }
+    out.resize(kept);
+    out_ = nullptr;
+}
+
+void ProcScanner::runWorker(std::size_t self) {
+    std::uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        start_.wait(lock, [this, seen] { return stopping_ || round_ != seen; });
+        if (stopping_) {
+            return;
+        }
+        seen = round_;
+        if (self >= active_) {
+            continue;
+        }
+        lock.unlock();
+        work(self);
+        lock.lock();
+        if (--running_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+void ProcScanner::work(std::size_t self) {
+    Worker& worker = *workers_[self];
+    for (;;) {
+        std::uint32_t chunk = 0;
+        std::uint64_t range = worker.range.load(std::memory_order_acquire);
+        bool popped = false;
+        while (static_cast<std::uint32_t>(range >> 32) < static_cast<std::uint32_t>(range)) {
+            const auto begin = static_cast<std::uint32_t>(range >> 32);
+            if (worker.range.compare_exchange_weak(range, packRange(begin + 1, static_cast<std::uint32_t>(range)),
+                                                   std::memory_order_acq_rel)) {
+                chunk = begin;
+                popped = true;
+                break;
+            }
+        }
+        if (!popped && !steal(self, chunk)) {
+            return;
+        }
+        readChunk(worker, chunk);
+    }
+}
+
+// Takes the back half of the first other worker's range that has any work
+// left: the first chunk of it is returned, the rest becomes this worker's
+// range. False when every range is empty.
+bool ProcScanner::steal(std::size_t self, std::uint32_t& chunk) {
+    const std::size_t count = active_;
+    for (std::size_t step = 1; step < count; ++step) {
+        Worker& victim = *workers_[(self + step) % count];
+        std::uint64_t range = victim.range.load(std::memory_order_acquire);
+        for (;;) {
+            const auto begin = static_cast<std::uint32_t>(range >> 32);
+            const auto end = static_cast<std::uint32_t>(range);
+            if (begin >= end) {
+                break;
+            }
+            const std::uint32_t middle = end - (end - begin + 1) / 2;
+            if (victim.range.compare_exchange_weak(range, packRange(begin, middle), std::memory_order_acq_rel)) {
+                chunk = middle;
+                workers_[self]->range.store(packRange(middle + 1, end), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ProcScanner::readChunk(Worker& worker, std::uint32_t chunk) {
+    const std::size_t first = static_cast<std::size_t>(chunk) * kChunkPids;
+    const std::size_t last = std::min(first + kChunkPids, pids_.size());
+    ProcessColumns& out = *out_;
+    char path[32];
+    ProcStat stat;
+    for (std::size_t row = first; row < last; ++row) {
+        std::snprintf(path, sizeof(path), "%d/stat", pids_[row]);
+        const int fd = ::openat(rootFd_, path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue; // exited since the listing
+        }
+        ssize_t n = 0;
+        for (;;) {
+            n = ::pread(fd, worker.buffer.data(), worker.buffer.size(), 0);
+            if (n < 0 || static_cast<std::size_t>(n) < worker.buffer.size()) {
+                break;
+            }
+            worker.buffer.resize(worker.buffer.size() * 2);
+        }
+        ::close(fd);
+        if (n <= 0 || !parseProcStat(std::string_view(worker.buffer.data(), static_cast<std::size_t>(n)), stat)) {
+            continue;
+        }
+        out.pid[row] = pids_[row];
+        out.ppid[row] = stat.ppid;
+        out.state[row] = stat.state;
+        out.ticks[row] = stat.ticks;
+        out.rssKB[row] = stat.rssPages * pageKB_;
+        out.threads[row] = stat.threads;
+        auto& name = out.name[row];
+        const std::size_t length = std::min(stat.name.size(), name.size() - 1);
+        std::memcpy(name.data(), stat.name.data(), length);
+        name[length] = '\0';
+        found_[row] = 1;
+    }
+}
+
+} // namespace statio
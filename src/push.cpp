@@ -0,0 +1,484 @@
+#include "statio/push.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <poll.h>
+#include <random>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+constexpr const char* kSpillPrefix = "batch-";
+constexpr const char* kSpillSuffix = ".stw";
+// How long the destructor waits for outstanding batches to be acked.
+constexpr std::int64_t kShutdownGraceMs = 2000;
+// An unreachable receiver that drops SYNs is given up on after this long.
+constexpr std::int64_t kConnectTimeoutMs = 5000;
+
+std::int64_t steadyMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+std::string spillName(std::uint64_t sequence) {
+    char name[48];
+    std::snprintf(name, sizeof(name), "%s%016llx%s", kSpillPrefix, static_cast<unsigned long long>(sequence),
+                  kSpillSuffix);
+    return name;
+}
+
+void removeFiles(const std::vector<std::string>& paths) {
+    for (const auto& path : paths) {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+}
+
+} // namespace
+
+PushTransport::PushTransport(PushOptions options) : options_(std::move(options)) {
+    if (options_.address.empty()) {
+        throw std::runtime_error("push needs an address");
+    }
+    if (options_.batchSnapshots == 0 || options_.window == 0 || options_.backoffMinMs <= 0) {
+        throw std::runtime_error("push batch size, window and backoff must be positive");
+    }
+    if (!options_.spillDirectory.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(options_.spillDirectory, ec);
+        if (ec) {
+            throw std::runtime_error("cannot create spill directory " + options_.spillDirectory + ": " + ec.message());
+        }
+        loadSpilled();
+    }
+    // Sequences start from the clock so they keep increasing across
+    // restarts; receivers use them to skip batches they already stored.
+    nextSequence_ = std::max(nextSequence_, static_cast<std::uint64_t>(currentTimeMs()) << 10);
+    if (queue_.empty()) {
+        nextSend_ = nextSequence_;
+    }
+    wakeFd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd_ < 0) {
+        throw std::runtime_error(std::string("eventfd failed: ") + std::strerror(errno));
+    }
+    thread_ = std::thread([this] { run(); });
+}
+
+PushTransport::~PushTransport() {
+    close();
+}
+
+void PushTransport::close() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    flush();
+    stopDeadlineMs_ = steadyMs() + kShutdownGraceMs;
+    stopping_ = true;
+    wake();
+    thread_.join();
+    ::close(wakeFd_);
+
+    std::vector<Spill> spills;
+    std::size_t lost = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = queue_.begin(); it != queue_.end();) {
+            if (!it->spillPath.empty()) {
+                ++it;
+            } else if (!options_.spillDirectory.empty()) {
+                spills.push_back({it->sequence, it->bytes, {}});
+                ++it;
+            } else {
+                memoryBytes_ -= it->size;
+                ++lost;
+                ++stats_.dropped;
+                it = queue_.erase(it);
+            }
+        }
+    }
+    spill(spills);
+    if (lost > 0) {
+        log(std::to_string(lost) + " unsent batches discarded (no spill directory)");
+    }
+}
+
+void PushTransport::log(const std::string& message) const {
+    if (!options_.quiet) {
+        std::cerr << "statio push: " << message << '\n';
+    }
+}
+
+void PushTransport::wake() {
+    const std::uint64_t one = 1;
+    [[maybe_unused]] const ssize_t n = ::write(wakeFd_, &one, sizeof(one));
+}
+
+void PushTransport::loadSpilled() {
+    for (const auto& entry : std::filesystem::directory_iterator(options_.spillDirectory)) {
+        const std::string name = entry.path().filename().string();
+        const std::size_t suffix = std::strlen(kSpillSuffix);
+        if (name.rfind(kSpillPrefix, 0) != 0 || name.size() <= suffix + std::strlen(kSpillPrefix) ||
+            name.compare(name.size() - suffix, suffix, kSpillSuffix) != 0) {
+            continue;
+        }
+        Batch batch;
+        try {
+            batch.sequence = std::stoull(name.substr(std::strlen(kSpillPrefix)), nullptr, 16);
+        } catch (...) {
+            continue;
+        }
+        batch.spillPath = entry.path().string();
+        batch.size = static_cast<std::size_t>(entry.file_size());
+        spillBytes_ += batch.size;
+        queue_.push_back(std::move(batch));
+    }
+    std::sort(queue_.begin(), queue_.end(), [](const Batch& a, const Batch& b) { return a.sequence < b.sequence; });
+    if (!queue_.empty()) {
+        nextSequence_ = queue_.back().sequence + 1;
+        nextSend_ = queue_.front().sequence;
+        log("replaying " + std::to_string(queue_.size()) + " spilled batches");
+    }
+}
+
+void PushTransport::push(std::int64_t timestampMs, const std::vector<MetricSample>& samples) {
+    if (batchCount_ == 0) {
+        encoder_.reset(); // every batch decodes on its own
+        batchStartMs_ = steadyMs();
+    }
+    encoder_.encode(timestampMs, samples, frames_);
+    ++batchCount_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.snapshots;
+    }
+    if (batchCount_ >= options_.batchSnapshots || steadyMs() - batchStartMs_ >= options_.batchMaxMs) {
+        seal();
+    }
+}
+
+void PushTransport::flush() {
+    if (batchCount_ > 0) {
+        seal();
+    }
+}
+
+void PushTransport::seal() {
+    Batch batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batch.sequence = nextSequence_++;
+    }
+    std::string bytes;
+    appendWireBatch(bytes, batch.sequence, frames_, options_.compress ? WireCodec::Lz : WireCodec::None);
+    batch.size = bytes.size();
+    batch.bytes = std::make_shared<const std::string>(std::move(bytes));
+    const std::size_t raw = frames_.size();
+    frames_.clear();
+    batchCount_ = 0;
+
+    std::vector<Spill> spills;
+    std::vector<std::string> removals;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.batches;
+        stats_.rawBytes += raw;
+        stats_.wireBytes += batch.size;
+        memoryBytes_ += batch.size;
+        queue_.push_back(std::move(batch));
+        enforceLimits(spills, removals);
+    }
+    wake();
+    // Disk writes happen unlocked, so a slow disk holds up neither the
+    // sender thread nor longer than this push.
+    removeFiles(removals);
+    spill(spills);
+}
+
+bool PushTransport::writeSpill(Spill& spill) const {
+    const std::filesystem::path path = std::filesystem::path(options_.spillDirectory) / spillName(spill.sequence);
+    const std::filesystem::path temporary = path.string() + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(spill.bytes->data(), static_cast<std::streamsize>(spill.bytes->size()));
+        if (!out) {
+            log("cannot write " + temporary.string());
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) {
+        log("cannot write " + path.string() + ": " + ec.message());
+        return false;
+    }
+    spill.path = path.string();
+    return true;
+}
+
+// Writes the batches to the spill directory, then swaps each queued batch
+// for its file. A batch whose write failed is dropped; one acked meanwhile
+// leaves no file behind.
+void PushTransport::spill(std::vector<Spill>& spills) {
+    if (spills.empty()) {
+        return;
+    }
+    for (auto& pending : spills) {
+        writeSpill(pending);
+    }
+    std::vector<std::string> removals;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& pending : spills) {
+            const std::uint64_t sequence = pending.sequence;
+            auto it = std::find_if(queue_.begin(), queue_.end(),
+                                   [sequence](const Batch& b) { return b.sequence >= sequence; });
+            if (it == queue_.end() || it->sequence != sequence || !it->spillPath.empty()) {
+                if (!pending.path.empty()) {
+                    removals.push_back(pending.path);
+                }
+                continue;
+            }
+            memoryBytes_ -= it->size;
+            if (pending.path.empty()) {
+                ++stats_.dropped;
+                queue_.erase(it);
+                continue;
+            }
+            it->spillPath = pending.path;
+            it->bytes.reset();
+            spillBytes_ += it->size;
+            ++stats_.spilled;
+        }
+        trimSpilled(removals);
+    }
+    removeFiles(removals);
+}
+
+// Called with mutex_ held. Picks the oldest in-memory batches that bring the
+// queue back under queueBytes for spill(), or drops them without a spill
+// directory.
+void PushTransport::enforceLimits(std::vector<Spill>& spills, std::vector<std::string>& removals) {
+    std::size_t memory = memoryBytes_;
+    for (auto it = queue_.begin(); memory > options_.queueBytes && it != queue_.end();) {
+        if (!it->spillPath.empty()) {
+            ++it;
+            continue;
+        }
+        memory -= it->size;
+        if (!options_.spillDirectory.empty()) {
+            spills.push_back({it->sequence, it->bytes, {}});
+            ++it;
+        } else {
+            memoryBytes_ -= it->size;
+            ++stats_.dropped;
+            it = queue_.erase(it);
+        }
+    }
+    trimSpilled(removals);
+}
+
+// Called with mutex_ held: drops the oldest spilled batches past spillBytes;
+// their files go to `removals`.
+void PushTransport::trimSpilled(std::vector<std::string>& removals) {
+    while (spillBytes_ > options_.spillBytes) {
+        auto it = std::find_if(queue_.begin(), queue_.end(), [](const Batch& b) { return !b.spillPath.empty(); });
+        if (it == queue_.end()) {
+            break;
+        }
+        removals.push_back(it->spillPath);
+        spillBytes_ -= it->size;
+        ++stats_.dropped;
+        queue_.erase(it);
+    }
+}
+
+bool PushTransport::batchBytes(std::uint64_t sequence, std::string& out) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(queue_.begin(), queue_.end(), [sequence](const Batch& b) { return b.sequence >= sequence; });
+        if (it == queue_.end() || it->sequence != sequence) {
+            return false;
+        }
+        if (it->spillPath.empty()) {
+            out = *it->bytes;
+            return true;
+        }
+        path = it->spillPath;
+    }
+    std::ifstream in(path, std::ios::binary);
+    out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !out.empty();
+}
+
+void PushTransport::acknowledge(std::uint64_t sequence) {
+    std::vector<std::string> removals;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (!queue_.empty() && queue_.front().sequence <= sequence) {
+            Batch& batch = queue_.front();
+            if (batch.spillPath.empty()) {
+                memoryBytes_ -= batch.size;
+            } else {
+                removals.push_back(std::move(batch.spillPath));
+                spillBytes_ -= batch.size;
+            }
+            ++stats_.acked;
+            queue_.pop_front();
+        }
+    }
+    removeFiles(removals);
+}
+
+void PushTransport::run() {
+    int fd = -1;
+    std::int64_t backoffMs = options_.backoffMinMs;
+    std::int64_t retryAtMs = 0;
+    std::string hello;
+    std::string bytes;
+    std::string received;
+    std::mt19937 jitter(std::random_device{}());
+
+    const auto disconnect = [&](const std::string& why) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+            log("disconnected from " + options_.address + ": " + why);
+        }
+        received.clear();
+        // Exponential backoff with +-25% jitter so a fleet does not reconnect in lockstep.
+        const auto spread = std::uniform_int_distribution<std::int64_t>(-backoffMs / 4, backoffMs / 4)(jitter);
+        retryAtMs = steadyMs() + backoffMs + spread;
+        backoffMs = std::min(backoffMs * 2, options_.backoffMaxMs);
+    };
+
+    for (;;) {
+        std::uint64_t nextSend = 0;
+        std::uint64_t lastQueued = 0;
+        bool empty = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            empty = queue_.empty();
+            if (!empty && nextSend_ < queue_.front().sequence) {
+                nextSend_ = queue_.front().sequence;
+            }
+            nextSend = nextSend_;
+            lastQueued = empty ? 0 : queue_.back().sequence;
+        }
+        if (stopping_ && (empty || steadyMs() >= stopDeadlineMs_)) {
+            break;
+        }
+
+        if (fd < 0 && !empty && steadyMs() >= retryAtMs) {
+            try {
+                // Shutdown does not wait out a pending connect past its grace.
+                fd = connectStream(options_.address, kConnectTimeoutMs,
+                                   [this] { return stopping_ && steadyMs() >= stopDeadlineMs_; });
+                timeval timeout {};
+                timeout.tv_sec = 5;
+                ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                hello.clear();
+                encoder_.hello(options_.host, hello);
+                if (!sendAll(fd, hello)) {
+                    throw std::runtime_error(std::strerror(errno));
+                }
+                backoffMs = options_.backoffMinMs;
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++stats_.reconnects;
+                // Everything unacknowledged goes out again.
+                nextSend_ = queue_.empty() ? nextSequence_ : queue_.front().sequence;
+                nextSend = nextSend_;
+            } catch (const std::exception& e) {
+                if (fd >= 0) {
+                    ::close(fd);
+                    fd = -1;
+                }
+                if (backoffMs == options_.backoffMinMs) {
+                    log(std::string("cannot connect: ") + e.what() + ", retrying with backoff");
+                }
+                disconnect(e.what());
+            }
+        }
+
+        // Keep up to `window` batches in flight.
+        while (fd >= 0 && nextSend <= lastQueued) {
+            std::uint64_t oldest = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                oldest = queue_.empty() ? nextSend : queue_.front().sequence;
+            }
+            if (nextSend - oldest >= options_.window) {
+                break;
+            }
+            if (!batchBytes(nextSend, bytes)) {
+                ++nextSend; // dropped under memory pressure meanwhile
+                continue;
+            }
+            if (!sendAll(fd, bytes)) {
+                disconnect(std::strerror(errno));
+                break;
+            }
+            ++nextSend;
+            std::lock_guard<std::mutex> lock(mutex_);
+            nextSend_ = std::max(nextSend_, nextSend);
+        }
+
+        pollfd fds[2] = {{wakeFd_, POLLIN, 0}, {fd, POLLIN, 0}};
+        int timeout = 1000;
+        if (fd < 0 && !empty) {
+            timeout = static_cast<int>(std::clamp<std::int64_t>(retryAtMs - steadyMs(), 0, 1000));
+        }
+        if (stopping_) {
+            timeout = std::min(timeout, 100);
+        }
+        if (::poll(fds, fd >= 0 ? 2 : 1, timeout) <= 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            std::uint64_t count = 0;
+            [[maybe_unused]] const ssize_t n = ::read(wakeFd_, &count, sizeof(count));
+        }
+        if (fd >= 0 && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            char chunk[4096];
+            const ssize_t n = ::recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+            if (n <= 0) {
+                if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    disconnect(n == 0 ? "closed by receiver" : std::strerror(errno));
+                }
+                continue;
+            }
+            received.append(chunk, static_cast<std::size_t>(n));
+            try {
+                std::string_view view(received);
+                std::string_view payload;
+                while (nextWireFrame(view, payload)) {
+                    acknowledge(parseWireAck(payload));
+                }
+                received.erase(0, received.size() - view.size());
+            } catch (const std::exception& e) {
+                disconnect(e.what());
+            }
+        }
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+PushStats PushTransport::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+} // namespace statio
@@ -0,0 +1,755 @@
+#include "statio/query.hpp"
+
+#include "statio/cli_options.hpp"
+#include "statio/rollup.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace statio {
+namespace {
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+struct Accumulator {
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double sum = 0.0;
+    std::uint64_t count = 0;
+    double last = kNaN;
+    std::int64_t lastMs = std::numeric_limits<std::int64_t>::min();
+    double increase = 0.0;
+    std::int64_t spanMs = 0;
+    double rateSum = 0.0;
+    std::uint64_t rateSeries = 0;
+    std::vector<double> values;
+    QuantileSketch sketch;
+
+    void merge(Accumulator& other) {
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        sum += other.sum;
+        count += other.count;
+        if (other.lastMs > lastMs) {
+            last = other.last;
+            lastMs = other.lastMs;
+        }
+        if (other.spanMs > 0) {
+            rateSum += other.increase * 1000.0 / static_cast<double>(other.spanMs);
+            ++rateSeries;
+        }
+        values.insert(values.end(), other.values.begin(), other.values.end());
+        sketch.merge(other.sketch);
+    }
+};
+
+// Tight min/max/sum/count pass over one contiguous bucket slice of a column.
+void accumulateSlice(Accumulator& acc, const std::int64_t* ts, const double* v, std::size_t n, bool keepValues) {
+    double mn = acc.min;
+    double mx = acc.max;
+    double sum = acc.sum;
+    std::uint64_t count = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const double x = v[i];
+        if (std::isnan(x)) {
+            continue;
+        }
+        mn = x < mn ? x : mn;
+        mx = x > mx ? x : mx;
+        sum += x;
+        ++count;
+    }
+    acc.min = mn;
+    acc.max = mx;
+    acc.sum = sum;
+    acc.count += count;
+
+    if (keepValues && count != 0) {
+        for (std::size_t i = 0; i < n; ++i) {
+            if (!std::isnan(v[i])) {
+                acc.values.push_back(v[i]);
+            }
+        }
+    }
+
+    for (std::size_t i = n; i > 0; --i) {
+        if (!std::isnan(v[i - 1])) {
+            acc.last = v[i - 1];
+            acc.lastMs = ts[i - 1];
+            break;
+        }
+    }
+}
+
+// Raw distribution rows: statistics come from each row's observations rather
+// than the stored means, and the row sketches merge for percentiles.
+void accumulateDistributionSlice(Accumulator& acc,
+                                 const std::int64_t* ts,
+                                 const HistoryBlock::Column& column,
+                                 std::size_t begin,
+                                 std::size_t end,
+                                 bool keepSketch) {
+    for (std::size_t i = begin; i < end; ++i) {
+        const QuantileSketch observations = columnSketch(column, i);
+        if (observations.empty()) {
+            continue;
+        }
+        acc.min = std::min(acc.min, observations.min());
+        acc.max = std::max(acc.max, observations.max());
+        acc.sum += observations.sum();
+        acc.count += observations.count();
+        acc.last = column.values[i];
+        acc.lastMs = ts[i];
+
+        if (keepSketch) {
+            acc.sketch.merge(observations);
+        }
+    }
+}
+
+// Same as accumulateSlice for rollup rows, merging bucket sketches when
+// percentiles were requested.
+void accumulateRollupSlice(Accumulator& acc,
+                           const std::int64_t* ts,
+                           const HistoryBlock::Column& column,
+                           std::size_t begin,
+                           std::size_t end,
+                           bool keepSketch) {
+    for (std::size_t i = begin; i < end; ++i) {
+        if (column.count[i] <= 0.0) {
+            continue;
+        }
+        acc.min = std::min(acc.min, column.min[i]);
+        acc.max = std::max(acc.max, column.max[i]);
+        acc.sum += column.sum[i];
+        acc.count += static_cast<std::uint64_t>(column.count[i]);
+        acc.last = column.last[i];
+        acc.lastMs = ts[i];
+
+        if (keepSketch) {
+            acc.sketch.merge(columnSketch(column, i));
+        }
+    }
+}
+
+struct SeriesState {
+    std::string group;
+    double prevValue = kNaN;
+    std::int64_t prevMs = 0;
+    bool open = false;
+    std::int64_t bucketMs = 0;
+    Accumulator acc;
+};
+
+struct Slice {
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    std::int64_t bucketMs = 0;
+};
+
+class QueryEngine {
+public:
+    // A non-streaming engine holds every row until finish(), for inputs that
+    // do not arrive in time order.
+    QueryEngine(const QuerySpec& spec, const std::function<void(const QueryRow&)>& emit, bool streaming)
+        : spec_(spec), emit_(emit), streaming_(streaming) {
+        for (const auto& agg : spec_.aggregations) {
+            keepValues_ = keepValues_ || agg.kind == AggregationKind::Quantile;
+            counterPass_ = counterPass_ || agg.kind == AggregationKind::Rate;
+        }
+        counterPass_ = counterPass_ || spec_.perSecond;
+    }
+
+    // Consumes the rows of `block` inside [fromMs, toMs], the range of the
+    // tier scan that produced it.
+    void consume(const HistoryBlock& block, std::int64_t fromMs, std::int64_t toMs) {
+        const std::int64_t* ts = block.timestamps;
+        const std::size_t lo = static_cast<std::size_t>(std::lower_bound(ts, ts + block.rows, fromMs) - ts);
+        const std::size_t hi = static_cast<std::size_t>(std::upper_bound(ts, ts + block.rows, toMs) - ts);
+
+        // Bucket boundaries are shared by every column of the block.
+        slices_.clear();
+        for (std::size_t start = lo; start < hi;) {
+            const std::int64_t bucket = bucketOf(ts[start]);
+            std::size_t end = hi;
+            if (spec_.bucketMs > 0) {
+                end = static_cast<std::size_t>(std::lower_bound(ts + start, ts + hi, bucket + spec_.bucketMs) - ts);
+            }
+            slices_.push_back(Slice{start, end, bucket});
+            start = end;
+        }
+
+        if (!slices_.empty()) {
+            for (const auto& column : block.columns) {
+                consumeColumn(block, column);
+            }
+        }
+
+        if (streaming_ && spec_.bucketMs > 0) {
+            release(std::min(block.maxMs, toMs));
+        }
+    }
+
+    // Series of different sources never share counter state, though they
+    // still fold into the same groups.
+    void setSource(std::size_t source) {
+        source_ = std::to_string(source);
+    }
+
+    void finish() {
+        release(std::numeric_limits<std::int64_t>::max());
+    }
+
+private:
+    std::int64_t bucketOf(std::int64_t timestampMs) const {
+        if (spec_.bucketMs <= 0) {
+            return spec_.fromMs;
+        }
+        std::int64_t bucket = timestampMs - timestampMs % spec_.bucketMs;
+        if (timestampMs < 0 && timestampMs % spec_.bucketMs != 0) {
+            bucket -= spec_.bucketMs;
+        }
+        return bucket;
+    }
+
+    std::string groupOf(std::string_view name, std::string_view entity) const {
+        switch (spec_.groupBy) {
+        case GroupBy::Series:
+            return seriesLabel(name, entity);
+        case GroupBy::Metric:
+            return std::string(name);
+        case GroupBy::Entity:
+            return entity.empty() ? std::string("host") : std::string(entity);
+        case GroupBy::None:
+            break;
+        }
+        return "all";
+    }
+
+    void consumeColumn(const HistoryBlock& block, const HistoryBlock::Column& column) {
+        key_.assign(source_);
+        key_ += '\0';
+        key_ += column.name;
+        key_ += '\0';
+        key_ += column.entity;
+        auto it = series_.find(key_);
+        if (it == series_.end()) {
+            it = series_.emplace(key_, SeriesState{}).first;
+            it->second.group = groupOf(column.name, column.entity);
+        }
+        SeriesState& state = it->second;
+
+        for (const auto& slice : slices_) {
+            if (!state.open || state.bucketMs != slice.bucketMs) {
+                closeSeries(state);
+                state.open = true;
+                state.bucketMs = slice.bucketMs;
+            }
+
+            const std::int64_t* ts = block.timestamps + slice.begin;
+            const std::size_t n = slice.end - slice.begin;
+            const bool rollup = column.values == nullptr;
+            const bool distribution = !rollup && column.kind == MetricKind::Distribution;
+
+            if (rollup && !spec_.perSecond) {
+                accumulateRollupSlice(state.acc, block.timestamps, column, slice.begin, slice.end, keepValues_);
+            } else if (distribution && !spec_.perSecond) {
+                accumulateDistributionSlice(state.acc, block.timestamps, column, slice.begin, slice.end, keepValues_);
+            }
+            if (!counterPass_) {
+                if (!rollup && !distribution) {
+                    accumulateSlice(state.acc, ts, column.values + slice.begin, n, keepValues_);
+                }
+                continue;
+            }
+
+            // Counter-aware pass: tracks resets and derives per-second values
+            // across slice and block boundaries. Rollup rows take part through
+            // the last value of each bucket, observed at the bucket's end.
+            const double* values = rollup ? column.last + slice.begin : column.values + slice.begin;
+            const double* counts = rollup ? column.count + slice.begin : nullptr;
+            const std::int64_t observedAt = rollup ? block.resolutionMs : 0;
+            scratch_.assign(n, kNaN);
+            for (std::size_t i = 0; i < n; ++i) {
+                const double x = values[i];
+                if (std::isnan(x) || (counts != nullptr && counts[i] <= 0.0)) {
+                    continue;
+                }
+                const std::int64_t at = ts[i] + observedAt;
+                if (!std::isnan(state.prevValue) && at > state.prevMs) {
+                    const double delta = x >= state.prevValue ? x - state.prevValue : x;
+                    const std::int64_t dt = at - state.prevMs;
+                    state.acc.increase += delta;
+                    state.acc.spanMs += dt;
+                    scratch_[i] = delta * 1000.0 / static_cast<double>(dt);
+                }
+                state.prevValue = x;
+                state.prevMs = at;
+            }
+            if (spec_.perSecond) {
+                accumulateSlice(state.acc, ts, scratch_.data(), n, keepValues_);
+            } else if (!rollup && !distribution) {
+                accumulateSlice(state.acc, ts, values, n, keepValues_);
+            }
+        }
+    }
+
+    void closeSeries(SeriesState& state) {
+        if (!state.open) {
+            return;
+        }
+        pending_[{state.bucketMs, state.group}].merge(state.acc);
+        state.acc = Accumulator{};
+        state.open = false;
+    }
+
+    void release(std::int64_t maxMs) {
+        const bool all = maxMs == std::numeric_limits<std::int64_t>::max();
+        for (auto& [key, state] : series_) {
+            if (state.open && (all || state.bucketMs + spec_.bucketMs <= maxMs)) {
+                closeSeries(state);
+            }
+        }
+
+        while (!pending_.empty()) {
+            auto first = pending_.begin();
+            if (!all && first->first.first + spec_.bucketMs > maxMs) {
+                break;
+            }
+            emitRow(first->first.first, first->first.second, first->second);
+            pending_.erase(first);
+        }
+    }
+
+    void emitRow(std::int64_t bucketMs, const std::string& group, Accumulator& acc) {
+        if (acc.count == 0 && acc.rateSeries == 0) {
+            return;
+        }
+        if (keepValues_ && !acc.sketch.empty()) {
+            for (const double v : acc.values) {
+                acc.sketch.add(v);
+            }
+            acc.values.clear();
+        } else if (keepValues_) {
+            std::sort(acc.values.begin(), acc.values.end());
+        }
+
+        row_.bucketMs = bucketMs;
+        row_.group = group;
+        row_.values.clear();
+        const double count = static_cast<double>(acc.count);
+        for (const auto& agg : spec_.aggregations) {
+            double value = kNaN;
+            switch (agg.kind) {
+            case AggregationKind::Min:
+                value = acc.count ? acc.min : kNaN;
+                break;
+            case AggregationKind::Max:
+                value = acc.count ? acc.max : kNaN;
+                break;
+            case AggregationKind::Avg:
+                value = acc.count ? acc.sum / count : kNaN;
+                break;
+            case AggregationKind::Sum:
+                value = acc.sum;
+                break;
+            case AggregationKind::Count:
+                value = count;
+                break;
+            case AggregationKind::Last:
+                value = acc.last;
+                break;
+            case AggregationKind::Rate:
+                value = acc.rateSeries ? acc.rateSum : kNaN;
+                break;
+            case AggregationKind::Quantile:
+                if (!acc.sketch.empty()) {
+                    value = acc.sketch.quantile(agg.quantile);
+                } else if (!acc.values.empty()) {
+                    // Nearest-rank percentile.
+                    const double rank = std::ceil(agg.quantile * static_cast<double>(acc.values.size()));
+                    const std::size_t idx = rank < 1.0 ? 0 : static_cast<std::size_t>(rank) - 1;
+                    value = acc.values[std::min(idx, acc.values.size() - 1)];
+                }
+                break;
+            }
+            row_.values.push_back(value);
+        }
+        emit_(row_);
+    }
+
+    const QuerySpec& spec_;
+    const std::function<void(const QueryRow&)>& emit_;
+    bool streaming_ = true;
+    bool keepValues_ = false;
+    bool counterPass_ = false;
+    std::string source_;
+    std::string key_;
+    std::vector<Slice> slices_;
+    std::vector<double> scratch_;
+    std::unordered_map<std::string, SeriesState> series_;
+    std::map<std::pair<std::int64_t, std::string>, Accumulator> pending_;
+    QueryRow row_;
+};
+
+std::string formatValue(double value) {
+    if (std::isnan(value)) {
+        return {};
+    }
+    std::ostringstream out;
+    if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        out << static_cast<long long>(value);
+    } else {
+        out << std::fixed << std::setprecision(3) << value;
+    }
+    return out.str();
+}
+
+std::string csvField(const std::string& text) {
+    if (text.find_first_of(",\"\n") == std::string::npos) {
+        return text;
+    }
+    std::string out = "\"";
+    for (const char c : text) {
+        out += c;
+        if (c == '"') {
+            out += '"';
+        }
+    }
+    return out + "\"";
+}
+
+class TableFormatter : public QueryFormatter {
+public:
+    explicit TableFormatter(std::ostream& out)
+        : out_(out) {}
+
+    void begin(const QuerySpec& spec) override {
+        out_ << std::left << std::setw(19) << "time" << "  " << std::setw(32) << "group";
+        for (const auto& agg : spec.aggregations) {
+            out_ << "  " << std::right << std::setw(14) << agg.label;
+        }
+        out_ << std::left << '\n';
+    }
+
+    void row(const QueryRow& row) override {
+        out_ << std::left << std::setw(19) << formatTimestamp(row.bucketMs) << "  " << std::setw(32) << row.group;
+        for (const double value : row.values) {
+            const std::string text = formatValue(value);
+            out_ << "  " << std::right << std::setw(14) << (text.empty() ? "-" : text);
+        }
+        out_ << std::left << '\n';
+    }
+
+    void end() override {
+        out_.flush();
+    }
+
+private:
+    std::ostream& out_;
+};
+
+class CsvFormatter : public QueryFormatter {
+public:
+    explicit CsvFormatter(std::ostream& out)
+        : out_(out) {}
+
+    void begin(const QuerySpec& spec) override {
+        out_ << "time,timestamp_ms,group";
+        for (const auto& agg : spec.aggregations) {
+            out_ << ',' << agg.label;
+        }
+        out_ << '\n';
+    }
+
+    void row(const QueryRow& row) override {
+        out_ << formatTimestamp(row.bucketMs) << ',' << row.bucketMs << ',' << csvField(row.group);
+        for (const double value : row.values) {
+            out_ << ',' << formatValue(value);
+        }
+        out_ << '\n';
+    }
+
+    void end() override {
+        out_.flush();
+    }
+
+private:
+    std::ostream& out_;
+};
+
+class JsonFormatter : public QueryFormatter {
+public:
+    explicit JsonFormatter(std::ostream& out)
+        : out_(out) {}
+
+    void begin(const QuerySpec& spec) override {
+        for (const auto& agg : spec.aggregations) {
+            labels_.push_back(jsonEscape(agg.label));
+        }
+        out_ << '[';
+    }
+
+    void row(const QueryRow& row) override {
+        out_ << (first_ ? "\n" : ",\n");
+        first_ = false;
+        out_ << "{\"time\":\"" << formatTimestamp(row.bucketMs) << "\",\"timestamp_ms\":" << row.bucketMs
+             << ",\"group\":\"" << jsonEscape(row.group) << '"';
+        for (std::size_t i = 0; i < row.values.size() && i < labels_.size(); ++i) {
+            const std::string text = formatValue(row.values[i]);
+            out_ << ",\"" << labels_[i] << "\":" << (text.empty() ? "null" : text);
+        }
+        out_ << '}';
+    }
+
+    void end() override {
+        out_ << (first_ ? "]\n" : "\n]\n");
+        out_.flush();
+    }
+
+private:
+    std::ostream& out_;
+    std::vector<std::string> labels_;
+    bool first_ = true;
+};
+
+} // namespace
+
+std::string jsonEscape(const std::string& text) {
+    std::string out;
+    out.reserve(text.size() + 2);
+    for (const char c : text) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out;
+}
+
+Aggregation parseAggregation(const std::string& text) {
+    static const std::map<std::string, AggregationKind> simple = {
+        {"min", AggregationKind::Min},
+        {"max", AggregationKind::Max},
+        {"avg", AggregationKind::Avg},
+        {"sum", AggregationKind::Sum},
+        {"count", AggregationKind::Count},
+        {"last", AggregationKind::Last},
+        {"rate", AggregationKind::Rate},
+    };
+
+    Aggregation agg;
+    agg.label = text;
+    auto it = simple.find(text);
+    if (it != simple.end()) {
+        agg.kind = it->second;
+        return agg;
+    }
+
+    if (text.size() > 1 && text[0] == 'p') {
+        try {
+            std::size_t used = 0;
+            const double percent = std::stod(text.substr(1), &used);
+            if (used == text.size() - 1 && percent >= 0.0 && percent <= 100.0) {
+                agg.kind = AggregationKind::Quantile;
+                agg.quantile = percent / 100.0;
+                return agg;
+            }
+        } catch (...) {
+        }
+    }
+
+    throw std::runtime_error("unknown aggregation '" + text + "'");
+}
+
+GroupBy parseGroupBy(const std::string& text) {
+    if (text == "series") {
+        return GroupBy::Series;
+    }
+    if (text == "metric") {
+        return GroupBy::Metric;
+    }
+    if (text == "entity") {
+        return GroupBy::Entity;
+    }
+    if (text == "none") {
+        return GroupBy::None;
+    }
+    throw std::runtime_error("unknown group-by '" + text + "' (series, metric, entity, none)");
+}
+
+void parseMetricExpression(const std::string& text, QuerySpec& spec) {
+    const std::string prefix = "rate(";
+    if (text.rfind(prefix, 0) == 0 && text.size() > prefix.size() + 1 && text.back() == ')') {
+        spec.metric = text.substr(prefix.size(), text.size() - prefix.size() - 1);
+        spec.perSecond = true;
+    } else {
+        spec.metric = text;
+        spec.perSecond = false;
+    }
+}
+
+HistoryScanStats runQuery(const std::vector<std::string>& historyDirectories,
+                          const QuerySpec& spec,
+                          const std::function<void(const QueryRow&)>& emit) {
+    QueryEngine engine(spec, emit, historyDirectories.size() <= 1);
+    const auto select = [&spec](std::string_view name, std::string_view entity) {
+        return globMatch(spec.metric, name) && globMatch(spec.entity, entity);
+    };
+
+    HistoryScanStats total;
+    for (std::size_t source = 0; source < historyDirectories.size(); ++source) {
+        engine.setSource(source);
+        const auto plan = planTierScans(historyDirectories[source], spec.fromMs, spec.toMs, spec.bucketMs, spec.tier);
+        for (const auto& scan : plan) {
+            const HistoryReader reader(scan.directory);
+            const auto stats = reader.scan(scan.fromMs, scan.toMs, select, [&engine, &scan](const HistoryBlock& block) {
+                engine.consume(block, scan.fromMs, scan.toMs);
+            });
+            total.segmentsOpened += stats.segmentsOpened;
+            total.blocksRead += stats.blocksRead;
+            total.blocksSkipped += stats.blocksSkipped;
+        }
+    }
+    engine.finish();
+    return total;
+}
+
+std::unique_ptr<QueryFormatter> makeQueryFormatter(const std::string& format, std::ostream& out) {
+    if (format == "table") {
+        return std::make_unique<TableFormatter>(out);
+    }
+    if (format == "csv") {
+        return std::make_unique<CsvFormatter>(out);
+    }
+    if (format == "json") {
+        return std::make_unique<JsonFormatter>(out);
+    }
+    throw std::runtime_error("unknown output format '" + format + "' (table, csv, json)");
+}
+
+bool globMatch(std::string_view pattern, std::string_view text) {
+    std::size_t p = 0;
+    std::size_t t = 0;
+    std::size_t star = std::string_view::npos;
+    std::size_t resume = 0;
+    while (t < text.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+            ++p;
+            ++t;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = t;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            t = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+std::int64_t parseTimePoint(const std::string& text, std::int64_t nowMs) {
+    if (text.empty() || text == "now") {
+        return nowMs;
+    }
+    if (text[0] == '-' || text[0] == '+') {
+        const std::int64_t offsetMs = parseDurationMs(text.substr(1));
+        if (text[0] == '+' && offsetMs > std::numeric_limits<std::int64_t>::max() - nowMs) {
+            throw std::runtime_error("time out of range '" + text + "'");
+        }
+        return text[0] == '-' ? nowMs - offsetMs : nowMs + offsetMs;
+    }
+    if (std::all_of(text.begin(), text.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        // Epoch seconds, or milliseconds past 100000000000 (1973 in ms).
+        std::int64_t value = 0;
+        const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (ec != std::errc() || end != text.data() + text.size()) {
+            throw std::runtime_error("time out of range '" + text + "'");
+        }
+        return value > 100000000000LL ? value : value * 1000LL;
+    }
+
+    const std::time_t nowSeconds = static_cast<std::time_t>(nowMs / 1000);
+    std::tm tm {};
+    localtime_r(&nowSeconds, &tm);
+    tm.tm_sec = 0;
+
+    int year = 0;
+    int month = 0;
+    int day = 0;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    char sep = 0;
+    char trailing = 0;
+    if (std::sscanf(text.c_str(), "%d:%d:%d%c", &hour, &minute, &second, &trailing) == 3 ||
+        std::sscanf(text.c_str(), "%d:%d%c", &hour, &minute, &trailing) == 2) {
+        if (hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60) {
+            throw std::runtime_error("invalid time '" + text + "'");
+        }
+        tm.tm_hour = hour;
+        tm.tm_min = minute;
+        tm.tm_sec = second;
+    } else {
+        const int fields = std::sscanf(text.c_str(), "%d-%d-%d%c%d:%d:%d", &year, &month, &day, &sep, &hour, &minute, &second);
+        if ((fields != 3 && fields < 6) || month < 1 || month > 12 || day < 1 || day > 31 || hour < 0 || hour > 23 ||
+            minute < 0 || minute > 59 || second < 0 || second > 60) {
+            throw std::runtime_error("invalid time '" + text + "'");
+        }
+        tm.tm_year = year - 1900;
+        tm.tm_mon = month - 1;
+        tm.tm_mday = day;
+        tm.tm_hour = hour;
+        tm.tm_min = minute;
+        tm.tm_sec = second;
+    }
+    tm.tm_isdst = -1;
+
+    const std::time_t parsed = std::mktime(&tm);
+    if (parsed == static_cast<std::time_t>(-1)) {
+        throw std::runtime_error("invalid time '" + text + "'");
+    }
+    return static_cast<std::int64_t>(parsed) * 1000LL;
+}
+
+std::string formatTimestamp(std::int64_t timestampMs) {
+    const std::time_t seconds = static_cast<std::time_t>(timestampMs / 1000);
+    std::tm tm {};
+    localtime_r(&seconds, &tm);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+}
+
+} // namespace statio
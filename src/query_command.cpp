@@ -0,0 +1,62 @@
+#include "statio/commands.hpp"
+
+#include "statio/cli_options.hpp"
+#include "statio/query.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace statio {
+
+int runQueryCommand(const std::vector<std::string>& args) {
+    const CommandLine cli(args,
+                          {"history-dir", "metric", "entity", "from", "to", "agg", "bucket", "group-by", "format", "tier"},
+                          {"stats"});
+
+    const auto directories = splitList(cli.value("history-dir"));
+    if (directories.empty()) {
+        throw std::runtime_error("query requires --history-dir DIR[,DIR...]");
+    }
+
+    QuerySpec spec;
+    std::string metric = cli.value("metric");
+    if (metric.empty() && !cli.positional().empty()) {
+        metric = cli.positional().front();
+    }
+    if (metric.empty()) {
+        throw std::runtime_error("query requires a metric, e.g. --metric 'rate(cpu.steal)'");
+    }
+    parseMetricExpression(metric, spec);
+    spec.entity = cli.value("entity", "*");
+
+    const std::int64_t now = currentTimeMs();
+    spec.fromMs = parseTimePoint(cli.value("from", "-1h"), now);
+    spec.toMs = parseTimePoint(cli.value("to", "now"), now);
+    if (spec.toMs < spec.fromMs) {
+        throw std::runtime_error("--to is earlier than --from");
+    }
+    spec.bucketMs = cli.has("bucket") ? parseDurationMs(cli.value("bucket")) : 0;
+    spec.groupBy = parseGroupBy(cli.value("group-by", "series"));
+    spec.tier = cli.value("tier", "auto");
+    for (const auto& name : splitList(cli.value("agg", "min,avg,max"))) {
+        spec.aggregations.push_back(parseAggregation(name));
+    }
+    if (spec.aggregations.empty()) {
+        throw std::runtime_error("--agg needs at least one aggregation");
+    }
+
+    auto formatter = makeQueryFormatter(cli.value("format", "table"), std::cout);
+    formatter->begin(spec);
+    const auto stats = runQuery(directories, spec, [&formatter](const QueryRow& row) {
+        formatter->row(row);
+    });
+    formatter->end();
+
+    if (cli.has("stats")) {
+        std::cerr << "segments=" << stats.segmentsOpened << " blocks_read=" << stats.blocksRead
+                  << " blocks_skipped=" << stats.blocksSkipped << '\n';
+    }
+    return 0;
+}
+
+} // namespace statio
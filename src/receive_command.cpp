@@ -0,0 +1,200 @@
+#include "statio/commands.hpp"
+
+#include "statio/cli_options.hpp"
+#include "statio/history.hpp"
+#include "statio/query.hpp"
+#include "statio/wire.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+// [A-Za-z0-9._-], at most 255 bytes, and not "." or "..".
+bool isSafeHostName(const std::string& host) {
+    if (host.empty() || host.size() > 255 || host == "." || host == "..") {
+        return false;
+    }
+    return std::all_of(host.begin(), host.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) != 0 || c == '.' || c == '_' || c == '-';
+    });
+}
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+struct Sender {
+    int fd = -1;
+    std::string buffer;
+    SnapshotDecoder decoder;
+};
+
+} // namespace
+
+// Minimal stand-in for an aggregator: accepts pushing daemons, acks their
+// batches and optionally records every snapshot into DIR/<host>, which makes
+// delivery checkable with `statio query`. --ack-delay simulates a slow
+// receiver.
+int runReceiveCommand(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"listen", "history-dir", "ack-delay", "exit-after"}, {"quiet"});
+    const std::string address = cli.value("listen");
+    if (address.empty()) {
+        throw std::runtime_error("receive requires --listen HOST:PORT or unix:PATH");
+    }
+    const std::string directory = cli.value("history-dir");
+    const std::int64_t ackDelayMs = parseDurationMs(cli.value("ack-delay", "0"));
+    const std::int64_t exitAfter = cli.integer("exit-after", 0);
+    const bool quiet = cli.has("quiet");
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    const int listenFd = listenStream(address, 64);
+    if (!quiet) {
+        std::cerr << "statio receive: listening on " << address << '\n';
+    }
+
+    std::map<int, Sender> senders;
+    std::map<std::string, std::unique_ptr<HistoryWriter>> writers;
+    std::map<std::string, std::uint64_t> lastSequence; // per host, survives reconnects
+    std::vector<MetricSample> samples;
+    std::string frames;
+    std::string ack;
+    std::int64_t snapshots = 0;
+    std::uint64_t duplicates = 0;
+
+    while (!stopRequested && (exitAfter <= 0 || snapshots < exitAfter)) {
+        std::vector<pollfd> fds;
+        fds.push_back(pollfd{listenFd, POLLIN, 0});
+        for (const auto& [fd, sender] : senders) {
+            fds.push_back(pollfd{fd, POLLIN, 0});
+        }
+        if (::poll(fds.data(), fds.size(), 200) <= 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                senders[fd].fd = fd;
+            }
+        }
+
+        for (std::size_t i = 1; i < fds.size(); ++i) {
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+                continue;
+            }
+            Sender& sender = senders[fds[i].fd];
+            char chunk[65536];
+            const ssize_t n = ::recv(sender.fd, chunk, sizeof(chunk), 0);
+            bool open = n > 0;
+            if (open) {
+                sender.buffer.append(chunk, static_cast<std::size_t>(n));
+            }
+
+            try {
+                std::string_view view(sender.buffer);
+                std::string_view payload;
+                while (nextWireFrame(view, payload)) {
+                    if (wireFrameType(payload) != WireFrameType::Batch) {
+                        // Hello. The host name becomes a directory under
+                        // --dir, so it must stay one path component.
+                        if (sender.decoder.decode(payload) == WireFrameType::Hello &&
+                            !isSafeHostName(sender.decoder.host())) {
+                            throw std::runtime_error("refusing host name '" + sender.decoder.host() + "'");
+                        }
+                        continue;
+                    }
+                    frames.clear();
+                    const std::uint64_t sequence = unpackWireBatch(payload, frames);
+                    // Resent after a reconnect and already stored.
+                    std::uint64_t& last = lastSequence[sender.decoder.host()];
+                    const bool duplicate = sequence <= last;
+                    std::string_view inner(frames);
+                    while (nextWireFrame(inner, payload)) {
+                        if (sender.decoder.decode(payload) != WireFrameType::Snapshot || duplicate) {
+                            continue;
+                        }
+                        ++snapshots;
+                        const auto& series = sender.decoder.series();
+                        if (!quiet) {
+                            std::cout << formatTimestamp(sender.decoder.timestampMs()) << ' ' << sender.decoder.host()
+                                      << " batch " << sequence << ", " << series.size() << " series\n";
+                        }
+                        if (directory.empty()) {
+                            continue;
+                        }
+                        auto& writer = writers[sender.decoder.host()];
+                        if (!writer) {
+                            if (!isSafeHostName(sender.decoder.host())) {
+                                throw std::runtime_error("snapshot without a usable host name");
+                            }
+                            HistoryOptions options;
+                            options.directory = (std::filesystem::path(directory) / sender.decoder.host()).string();
+                            writer = std::make_unique<HistoryWriter>(options);
+                        }
+                        samples.resize(series.size());
+                        for (std::size_t s = 0; s < series.size(); ++s) {
+                            samples[s].name = series[s].name;
+                            samples[s].entity = series[s].entity;
+                            samples[s].kind = series[s].kind;
+                            samples[s].value = series[s].value;
+                        }
+                        writer->append(sender.decoder.timestampMs(), samples);
+                    }
+                    if (duplicate) {
+                        ++duplicates;
+                    }
+                    last = std::max(last, sequence);
+                    if (ackDelayMs > 0) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(ackDelayMs));
+                    }
+                    ack.clear();
+                    appendWireAck(ack, sequence);
+                    if (!sendAll(sender.fd, ack)) {
+                        open = false;
+                    }
+                }
+                sender.buffer.erase(0, sender.buffer.size() - view.size());
+            } catch (const std::exception& e) {
+                std::cerr << "statio receive: dropping connection: " << e.what() << '\n';
+                open = false;
+            }
+
+            if (!open) {
+                ::close(sender.fd);
+                senders.erase(fds[i].fd);
+            }
+        }
+    }
+
+    for (auto& [fd, sender] : senders) {
+        ::close(fd);
+    }
+    ::close(listenFd);
+    if (address.rfind("unix:", 0) == 0) {
+        ::unlink(address.substr(5).c_str());
+    }
+    if (!quiet) {
+        std::cerr << "statio receive: " << snapshots << " snapshots, " << duplicates << " duplicate batches\n";
+    }
+    return 0;
+}
+
+} // namespace statio
@@ -0,0 +1,296 @@
+#include "statio/rollup.hpp"
+
+#include "statio/cli_options.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace statio {
+namespace {
+
+constexpr const char* kTierPrefix = "tier-";
+constexpr std::size_t kRollupBlockRows = 360;
+constexpr std::int64_t kRollupSegmentBuckets = 8640;
+
+std::int64_t alignDown(std::int64_t value, std::int64_t step) {
+    std::int64_t aligned = value - value % step;
+    if (value < 0 && value % step != 0) {
+        aligned -= step;
+    }
+    return aligned;
+}
+
+std::int64_t alignUp(std::int64_t value, std::int64_t step) {
+    const std::int64_t down = alignDown(value, step);
+    return down == value ? value : down + step;
+}
+
+struct TierExtent {
+    TierScan scan;
+    bool empty = true;
+    std::int64_t firstMs = 0;
+    std::int64_t endMs = 0; // exclusive end of the last bucket
+};
+
+void planRange(const std::vector<TierExtent>& tiers,
+               std::size_t index,
+               std::int64_t fromMs,
+               std::int64_t toMs,
+               std::vector<TierScan>& out) {
+    if (fromMs > toMs) {
+        return;
+    }
+    const TierExtent& tier = tiers[index];
+    if (index == 0) {
+        out.push_back(TierScan{tier.scan.directory, 0, fromMs, toMs});
+        return;
+    }
+
+    const std::int64_t res = tier.scan.resolutionMs;
+    std::int64_t begin = alignUp(fromMs, res);
+    std::int64_t end = toMs == std::numeric_limits<std::int64_t>::max() ? toMs : alignDown(toMs + 1, res);
+    if (!tier.empty) {
+        begin = std::max(begin, tier.firstMs);
+        end = std::min(end, tier.endMs);
+    }
+    if (tier.empty || begin >= end) {
+        planRange(tiers, index - 1, fromMs, toMs, out);
+        return;
+    }
+
+    planRange(tiers, index - 1, fromMs, begin - 1, out);
+    out.push_back(TierScan{tier.scan.directory, res, begin, end - 1});
+    planRange(tiers, index - 1, end, toMs, out);
+}
+
+RollupCell cellFromRollup(const HistoryBlock& block, const HistoryBlock::Column& column, std::size_t row) {
+    RollupCell cell;
+    cell.kind = column.kind;
+    cell.min = column.min[row];
+    cell.max = column.max[row];
+    cell.sum = column.sum[row];
+    cell.count = static_cast<std::uint64_t>(column.count[row]);
+    cell.last = column.last[row];
+    cell.lastMs = block.timestamps[row];
+    cell.sketch = columnSketch(column, row);
+    return cell;
+}
+
+} // namespace
+
+std::vector<TierSpec> parseTiers(const std::string& text) {
+    std::vector<TierSpec> tiers;
+    if (text == "none") {
+        return tiers;
+    }
+    for (const auto& name : splitList(text)) {
+        const std::int64_t res = parseDurationMs(name);
+        if (res <= 0) {
+            throw std::runtime_error("tier resolution must be positive: " + name);
+        }
+        tiers.push_back(TierSpec{name, res, 0});
+    }
+    std::sort(tiers.begin(), tiers.end(), [](const TierSpec& a, const TierSpec& b) {
+        return a.resolutionMs < b.resolutionMs;
+    });
+    for (std::size_t i = 1; i < tiers.size(); ++i) {
+        if (tiers[i].resolutionMs % tiers[i - 1].resolutionMs != 0) {
+            throw std::runtime_error("tier " + tiers[i].name + " is not a multiple of " + tiers[i - 1].name);
+        }
+    }
+    return tiers;
+}
+
+void parseRetention(const std::string& text, RetentionPolicy& policy) {
+    for (const auto& item : splitList(text)) {
+        const auto eq = item.find('=');
+        if (eq == std::string::npos) {
+            throw std::runtime_error("retention entries look like tier=duration, got '" + item + "'");
+        }
+        const std::string name = item.substr(0, eq);
+        const std::int64_t keep = parseDurationMs(item.substr(eq + 1));
+        if (name == "raw") {
+            policy.rawMs = keep;
+            continue;
+        }
+        auto it = std::find_if(policy.tiers.begin(), policy.tiers.end(), [&name](const TierSpec& t) {
+            return t.name == name;
+        });
+        if (it == policy.tiers.end()) {
+            throw std::runtime_error("retention given for unknown tier '" + name + "'");
+        }
+        it->retentionMs = keep;
+    }
+}
+
+RetentionPolicy defaultRetentionPolicy() {
+    RetentionPolicy policy;
+    policy.tiers = parseTiers("10s,1m,1h");
+    parseRetention("raw=2d,10s=14d,1m=90d,1h=0", policy);
+    return policy;
+}
+
+std::string tierDirectory(const std::string& historyDirectory, const TierSpec& tier) {
+    return historyDirectory + "/" + kTierPrefix + tier.name;
+}
+
+std::vector<TierSpec> discoverTiers(const std::string& historyDirectory) {
+    std::vector<TierSpec> tiers;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(historyDirectory, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (!entry.is_directory() || name.rfind(kTierPrefix, 0) != 0) {
+            continue;
+        }
+        try {
+            const std::string tierName = name.substr(std::string(kTierPrefix).size());
+            const std::int64_t res = parseDurationMs(tierName);
+            if (res > 0) {
+                tiers.push_back(TierSpec{tierName, res, 0});
+            }
+        } catch (...) {
+        }
+    }
+    std::sort(tiers.begin(), tiers.end(), [](const TierSpec& a, const TierSpec& b) {
+        return a.resolutionMs < b.resolutionMs;
+    });
+    return tiers;
+}
+
+Compactor::Compactor(std::string historyDirectory, RetentionPolicy policy)
+    : historyDirectory_(std::move(historyDirectory)), policy_(std::move(policy)) {}
+
+CompactionStats Compactor::runOnce(std::int64_t nowMs) {
+    CompactionStats stats;
+    std::string source = historyDirectory_;
+    for (const auto& tier : policy_.tiers) {
+        stats.bucketsWritten += compactTier(source, tier);
+        source = tierDirectory(historyDirectory_, tier);
+    }
+
+    if (policy_.rawMs > 0) {
+        stats.segmentsRemoved += removeSegmentsBefore(historyDirectory_, nowMs - policy_.rawMs);
+    }
+    for (const auto& tier : policy_.tiers) {
+        if (tier.retentionMs > 0) {
+            stats.segmentsRemoved += removeSegmentsBefore(tierDirectory(historyDirectory_, tier), nowMs - tier.retentionMs);
+        }
+    }
+    return stats;
+}
+
+std::size_t Compactor::compactTier(const std::string& sourceDirectory, const TierSpec& tier) {
+    const HistoryReader source(sourceDirectory);
+    const HistoryRange sourceRange = source.range();
+    if (sourceRange.empty) {
+        return 0;
+    }
+
+    const std::string targetDirectory = tierDirectory(historyDirectory_, tier);
+    const std::int64_t res = tier.resolutionMs;
+    const HistoryRange targetRange = HistoryReader(targetDirectory).range();
+    std::int64_t start = targetRange.empty ? alignDown(sourceRange.firstMs, res) : targetRange.lastMs + res;
+    // A bucket is final once the source holds a sample at or past its end.
+    const std::int64_t end = alignDown(sourceRange.lastMs, res);
+    if (start >= end) {
+        return 0;
+    }
+
+    HistoryOptions options;
+    options.directory = targetDirectory;
+    options.blockRows = kRollupBlockRows;
+    options.segmentMs = res * kRollupSegmentBuckets;
+    RollupWriter writer(options, res);
+
+    std::size_t written = 0;
+    std::map<std::int64_t, std::map<SeriesKey, RollupCell>> buckets;
+    while (start < end) {
+        const std::int64_t chunkEnd = std::min(end, start + res * static_cast<std::int64_t>(kRollupBlockRows));
+        buckets.clear();
+
+        source.scan(start, chunkEnd - 1, nullptr, [&](const HistoryBlock& block) {
+            const std::int64_t* ts = block.timestamps;
+            const std::size_t lo = static_cast<std::size_t>(std::lower_bound(ts, ts + block.rows, start) - ts);
+            const std::size_t hi = static_cast<std::size_t>(std::lower_bound(ts, ts + block.rows, chunkEnd) - ts);
+
+            for (const auto& column : block.columns) {
+                const SeriesKey key{std::string(column.name), std::string(column.entity)};
+                std::int64_t currentBucket = std::numeric_limits<std::int64_t>::min();
+                RollupCell* cell = nullptr;
+                for (std::size_t i = lo; i < hi; ++i) {
+                    const std::int64_t bucket = alignDown(ts[i], res);
+                    if (bucket != currentBucket) {
+                        currentBucket = bucket;
+                        cell = &buckets[bucket][key];
+                        if (cell->count == 0) {
+                            cell->kind = column.kind;
+                        }
+                    }
+                    if (column.kind == MetricKind::Distribution && column.values != nullptr) {
+                        cell->addDistribution(ts[i], column.values[i], columnSketch(column, i));
+                    } else if (column.values != nullptr) {
+                        cell->add(ts[i], column.values[i]);
+                    } else if (column.count[i] > 0) {
+                        cell->merge(cellFromRollup(block, column, i));
+                    }
+                }
+            }
+        });
+
+        for (const auto& [bucket, cells] : buckets) {
+            writer.append(bucket, cells);
+            ++written;
+        }
+        start = chunkEnd;
+    }
+
+    writer.flush();
+    return written;
+}
+
+std::vector<TierScan> planTierScans(const std::string& historyDirectory,
+                                    std::int64_t fromMs,
+                                    std::int64_t toMs,
+                                    std::int64_t bucketMs,
+                                    const std::string& tier) {
+    const auto tiers = discoverTiers(historyDirectory);
+    if (tier == "raw") {
+        return {TierScan{historyDirectory, 0, fromMs, toMs}};
+    }
+    if (tier != "auto") {
+        for (const auto& t : tiers) {
+            if (t.name == tier) {
+                return {TierScan{tierDirectory(historyDirectory, t), t.resolutionMs, fromMs, toMs}};
+            }
+        }
+        throw std::runtime_error("no tier named '" + tier + "' in " + historyDirectory);
+    }
+
+    std::vector<TierExtent> eligible;
+    TierExtent raw;
+    raw.scan = TierScan{historyDirectory, 0, fromMs, toMs};
+    eligible.push_back(raw);
+    for (const auto& t : tiers) {
+        if (bucketMs > 0 && bucketMs % t.resolutionMs != 0) {
+            continue;
+        }
+        TierExtent extent;
+        extent.scan = TierScan{tierDirectory(historyDirectory, t), t.resolutionMs, 0, 0};
+        const HistoryRange range = HistoryReader(extent.scan.directory).range();
+        extent.empty = range.empty;
+        extent.firstMs = range.firstMs;
+        extent.endMs = range.lastMs + t.resolutionMs;
+        eligible.push_back(extent);
+    }
+
+    std::vector<TierScan> plan;
+    planRange(eligible, eligible.size() - 1, fromMs, toMs, plan);
+    return plan;
+}
+
+} // namespace statio
@@ -0,0 +1,839 @@
+#include "statio/rules.hpp"
+
+#include "statio/cli_options.hpp"
+#include "statio/query.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <spawn.h>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <utility>
+
+extern char** environ;
+
+namespace statio {
+namespace {
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+constexpr std::size_t kMaxStack = 64;
+constexpr std::size_t kMaxRing = 65536;
+
+enum class Op : std::uint8_t {
+    Const,
+    Load,
+    Rate,
+    Delta,
+    AvgOver,
+    MinOver,
+    MaxOver,
+    Neg,
+    Not,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Lt,
+    Le,
+    Gt,
+    Ge,
+    Eq,
+    Ne,
+    And,
+    Or,
+};
+
+const char* opName(Op op) {
+    switch (op) {
+    case Op::Const: return "const";
+    case Op::Load: return "load";
+    case Op::Rate: return "rate";
+    case Op::Delta: return "delta";
+    case Op::AvgOver: return "avg";
+    case Op::MinOver: return "min";
+    case Op::MaxOver: return "max";
+    case Op::Neg: return "neg";
+    case Op::Not: return "not";
+    case Op::Add: return "add";
+    case Op::Sub: return "sub";
+    case Op::Mul: return "mul";
+    case Op::Div: return "div";
+    case Op::Lt: return "lt";
+    case Op::Le: return "le";
+    case Op::Gt: return "gt";
+    case Op::Ge: return "ge";
+    case Op::Eq: return "eq";
+    case Op::Ne: return "ne";
+    case Op::And: return "and";
+    case Op::Or: return "or";
+    }
+    return "?";
+}
+
+struct Instruction {
+    Op op = Op::Const;
+    std::uint32_t ref = 0;
+    double constant = 0.0;
+    std::int64_t windowMs = 0;
+};
+
+// A metric the rule reads. Free references take the instance's entity.
+struct Reference {
+    std::string metric;
+    std::string entity;
+    bool pinned = false;
+    bool history = false; // read through a function, so it needs a ring
+    std::int64_t windowMs = 0;
+};
+
+struct CompiledRule {
+    RuleSpec spec;
+    std::vector<Instruction> code;
+    std::vector<Reference> refs;
+    std::size_t maxDepth = 0;
+    bool hasFreeRefs = false;
+};
+
+bool isIdentifierChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+}
+
+// Recursive-descent compiler emitting postfix bytecode:
+//   or    := and (("||" | "or") and)*
+//   and   := cmp (("&&" | "and") cmp)*
+//   cmp   := sum (("<" | "<=" | ">" | ">=" | "==" | "!=") sum)?
+//   sum   := prod (("+" | "-") prod)*
+//   prod  := unary (("*" | "/") unary)*
+//   unary := ("-" | "!" | "not") unary | primary
+//   primary := number | "(" or ")" | func "(" ref ["," duration] ")" | ref
+//   ref   := name ["{" [entity] "}"]
+class Compiler {
+public:
+    explicit Compiler(CompiledRule& rule)
+        : rule_(rule), text_(rule.spec.expression) {}
+
+    void compile() {
+        parseOr();
+        skipSpace();
+        if (pos_ != text_.size()) {
+            fail("unexpected '" + std::string(1, text_[pos_]) + "'");
+        }
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error("rule " + rule_.spec.name + ": " + message + " at column " + std::to_string(pos_ + 1));
+    }
+
+    void skipSpace() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+            ++pos_;
+        }
+    }
+
+    bool accept(std::string_view token) {
+        skipSpace();
+        if (text_.compare(pos_, token.size(), token) != 0) {
+            return false;
+        }
+        // Word operators must not swallow the start of a metric name.
+        const bool word = std::isalpha(static_cast<unsigned char>(token[0]));
+        if (word && pos_ + token.size() < text_.size() && isIdentifierChar(text_[pos_ + token.size()])) {
+            return false;
+        }
+        pos_ += token.size();
+        return true;
+    }
+
+    void expect(std::string_view token) {
+        if (!accept(token)) {
+            fail("expected '" + std::string(token) + "'");
+        }
+    }
+
+    void emit(Instruction instruction, int stackDelta) {
+        rule_.code.push_back(instruction);
+        depth_ += stackDelta;
+        rule_.maxDepth = std::max<std::size_t>(rule_.maxDepth, static_cast<std::size_t>(depth_));
+        if (rule_.maxDepth > kMaxStack) {
+            fail("expression is nested too deeply");
+        }
+    }
+
+    void emitBinary(Op op) {
+        emit(Instruction{op, 0, 0.0, 0}, -1);
+    }
+
+    void parseOr() {
+        parseAnd();
+        while (accept("||") || accept("or")) {
+            parseAnd();
+            emitBinary(Op::Or);
+        }
+    }
+
+    void parseAnd() {
+        parseComparison();
+        while (accept("&&") || accept("and")) {
+            parseComparison();
+            emitBinary(Op::And);
+        }
+    }
+
+    void parseComparison() {
+        parseSum();
+        static const std::pair<const char*, Op> operators[] = {
+            {"<=", Op::Le}, {">=", Op::Ge}, {"==", Op::Eq}, {"!=", Op::Ne}, {"<", Op::Lt}, {">", Op::Gt},
+        };
+        for (const auto& [token, op] : operators) {
+            if (accept(token)) {
+                parseSum();
+                emitBinary(op);
+                return;
+            }
+        }
+    }
+
+    void parseSum() {
+        parseProduct();
+        for (;;) {
+            if (accept("+")) {
+                parseProduct();
+                emitBinary(Op::Add);
+            } else if (accept("-")) {
+                parseProduct();
+                emitBinary(Op::Sub);
+            } else {
+                return;
+            }
+        }
+    }
+
+    void parseProduct() {
+        parseUnary();
+        for (;;) {
+            if (accept("*")) {
+                parseUnary();
+                emitBinary(Op::Mul);
+            } else if (accept("/")) {
+                parseUnary();
+                emitBinary(Op::Div);
+            } else {
+                return;
+            }
+        }
+    }
+
+    void parseUnary() {
+        if (accept("-")) {
+            parseUnary();
+            emit(Instruction{Op::Neg, 0, 0.0, 0}, 0);
+        } else if (accept("!") || accept("not")) {
+            parseUnary();
+            emit(Instruction{Op::Not, 0, 0.0, 0}, 0);
+        } else {
+            parsePrimary();
+        }
+    }
+
+    void parsePrimary() {
+        skipSpace();
+        if (pos_ >= text_.size()) {
+            fail("unexpected end of expression");
+        }
+        if (accept("(")) {
+            parseOr();
+            expect(")");
+            return;
+        }
+
+        const char c = text_[pos_];
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            const char* begin = text_.c_str() + pos_;
+            char* end = nullptr;
+            const double value = std::strtod(begin, &end);
+            if (end == begin) {
+                fail("invalid number");
+            }
+            pos_ += static_cast<std::size_t>(end - begin);
+            emit(Instruction{Op::Const, 0, value, 0}, 1);
+            return;
+        }
+        if (!std::isalpha(static_cast<unsigned char>(c)) && c != '_') {
+            fail("unexpected '" + std::string(1, c) + "'");
+        }
+
+        const std::string name = parseName();
+        static const std::map<std::string, Op> functions = {
+            {"rate", Op::Rate}, {"delta", Op::Delta}, {"avg", Op::AvgOver}, {"min", Op::MinOver}, {"max", Op::MaxOver},
+        };
+        const auto fn = functions.find(name);
+        if (fn != functions.end() && accept("(")) {
+            skipSpace();
+            const std::uint32_t ref = parseReference(parseName(), true);
+            std::int64_t windowMs = 0;
+            if (accept(",")) {
+                skipSpace();
+                const std::size_t start = pos_;
+                while (pos_ < text_.size() && std::isalnum(static_cast<unsigned char>(text_[pos_]))) {
+                    ++pos_;
+                }
+                try {
+                    windowMs = parseDurationMs(text_.substr(start, pos_ - start));
+                } catch (const std::exception&) {
+                    fail("invalid window");
+                }
+                if (windowMs <= 0) {
+                    fail("window must be positive");
+                }
+            }
+            expect(")");
+            Reference& reference = rule_.refs[ref];
+            reference.windowMs = std::max(reference.windowMs, windowMs);
+            emit(Instruction{fn->second, ref, 0.0, windowMs}, 1);
+            return;
+        }
+
+        emit(Instruction{Op::Load, parseReference(name, false), 0.0, 0}, 1);
+    }
+
+    std::string parseName() {
+        const std::size_t start = pos_;
+        while (pos_ < text_.size() && isIdentifierChar(text_[pos_])) {
+            ++pos_;
+        }
+        if (pos_ == start) {
+            fail("expected a metric name");
+        }
+        return text_.substr(start, pos_ - start);
+    }
+
+    std::uint32_t parseReference(const std::string& metric, bool history) {
+        Reference reference;
+        reference.metric = metric;
+        if (pos_ < text_.size() && text_[pos_] == '{') {
+            const std::size_t close = text_.find('}', pos_);
+            if (close == std::string::npos) {
+                fail("unterminated '{'");
+            }
+            reference.entity = text_.substr(pos_ + 1, close - pos_ - 1);
+            reference.pinned = true;
+            pos_ = close + 1;
+        }
+
+        auto it = std::find_if(rule_.refs.begin(), rule_.refs.end(), [&reference](const Reference& r) {
+            return r.metric == reference.metric && r.entity == reference.entity && r.pinned == reference.pinned;
+        });
+        if (it == rule_.refs.end()) {
+            rule_.refs.push_back(reference);
+            it = rule_.refs.end() - 1;
+        }
+        it->history = it->history || history;
+        rule_.hasFreeRefs = rule_.hasFreeRefs || !reference.pinned;
+        return static_cast<std::uint32_t>(it - rule_.refs.begin());
+    }
+
+    CompiledRule& rule_;
+    const std::string& text_;
+    std::size_t pos_ = 0;
+    int depth_ = 0;
+};
+
+// Latest value of one series plus, when a rule reads it through a function,
+// a fixed ring of its recent samples.
+struct Slot {
+    double value = kNaN;
+    std::uint64_t generation = 0; // observe() pass that last set `value`
+    bool discovered = false;      // seen in samples, not just referenced
+    std::vector<std::int64_t> ringMs;
+    std::vector<double> ringValues;
+    std::size_t head = 0; // next write position
+    std::size_t size = 0;
+
+    void reserveRing(std::size_t capacity) {
+        if (capacity <= ringMs.size()) {
+            return;
+        }
+        // Unroll the ring into the larger buffer, oldest first.
+        std::vector<std::int64_t> ms(capacity);
+        std::vector<double> values(capacity);
+        for (std::size_t i = 0; i < size; ++i) {
+            const std::size_t from = (head + ringMs.size() - size + i) % ringMs.size();
+            ms[i] = ringMs[from];
+            values[i] = ringValues[from];
+        }
+        ringMs = std::move(ms);
+        ringValues = std::move(values);
+        head = size % capacity;
+    }
+
+    void push(std::int64_t timestampMs, double x) {
+        if (ringMs.empty()) {
+            return;
+        }
+        ringMs[head] = timestampMs;
+        ringValues[head] = x;
+        head = (head + 1) % ringMs.size();
+        size = std::min(size + 1, ringMs.size());
+    }
+
+    // i = 0 is the newest sample.
+    std::int64_t msAt(std::size_t i) const { return ringMs[(head + ringMs.size() - 1 - i) % ringMs.size()]; }
+    double valueAt(std::size_t i) const { return ringValues[(head + ringMs.size() - 1 - i) % ringMs.size()]; }
+
+    // Number of samples inside the window (at least two for "since the
+    // previous sample" when windowMs is 0).
+    std::size_t samplesIn(std::int64_t nowMs, std::int64_t windowMs) const {
+        if (windowMs <= 0) {
+            return std::min<std::size_t>(size, 2);
+        }
+        std::size_t n = 0;
+        while (n < size && msAt(n) >= nowMs - windowMs) {
+            ++n;
+        }
+        return n;
+    }
+};
+
+struct Instance {
+    std::uint32_t rule = 0;
+    std::string entity;
+    std::vector<std::uint32_t> slots; // one per rule reference
+    std::int64_t pendingSinceMs = 0;
+    bool pending = false;
+    bool firing = false;
+};
+
+std::size_t ringCapacity(const Reference& reference, std::int64_t intervalMs) {
+    if (!reference.history) {
+        return 0;
+    }
+    const std::int64_t perWindow = reference.windowMs / std::max<std::int64_t>(intervalMs, 1);
+    return std::clamp<std::size_t>(static_cast<std::size_t>(perWindow) + 2, 2, kMaxRing);
+}
+
+double windowed(Op op, const Slot& slot, std::int64_t nowMs, std::int64_t windowMs) {
+    const std::size_t n = slot.samplesIn(nowMs, windowMs);
+    if (n == 0) {
+        return kNaN;
+    }
+    switch (op) {
+    case Op::Rate: {
+        if (n < 2) {
+            return kNaN;
+        }
+        // Counter-aware: a drop is a reset and counts from zero.
+        double increase = 0.0;
+        for (std::size_t i = 0; i + 1 < n; ++i) {
+            const double newer = slot.valueAt(i);
+            const double older = slot.valueAt(i + 1);
+            increase += newer >= older ? newer - older : newer;
+        }
+        const std::int64_t span = slot.msAt(0) - slot.msAt(n - 1);
+        return span > 0 ? increase * 1000.0 / static_cast<double>(span) : kNaN;
+    }
+    case Op::Delta:
+        return n < 2 ? kNaN : slot.valueAt(0) - slot.valueAt(n - 1);
+    case Op::AvgOver:
+    case Op::MinOver:
+    case Op::MaxOver: {
+        double acc = op == Op::AvgOver ? 0.0 : slot.valueAt(0);
+        for (std::size_t i = 0; i < n; ++i) {
+            const double x = slot.valueAt(i);
+            acc = op == Op::AvgOver ? acc + x : op == Op::MinOver ? std::min(acc, x) : std::max(acc, x);
+        }
+        return op == Op::AvgOver ? acc / static_cast<double>(n) : acc;
+    }
+    default:
+        return kNaN;
+    }
+}
+
+bool truthy(double x) {
+    return !std::isnan(x) && x != 0.0;
+}
+
+} // namespace
+
+std::vector<RuleSpec> parseRules(const std::string& text) {
+    std::vector<RuleSpec> rules;
+    std::set<std::string> names;
+    std::istringstream input(text);
+    std::string line;
+    for (int number = 1; std::getline(input, line); ++number) {
+        const auto hash = line.find('#');
+        if (hash != std::string::npos) {
+            line.erase(hash);
+        }
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        const std::string where = "rules line " + std::to_string(number) + ": ";
+        const auto colon = line.find(':');
+        if (colon == std::string::npos) {
+            throw std::runtime_error(where + "expected 'name: expression [for: duration]'");
+        }
+        RuleSpec rule;
+        rule.name = line.substr(0, colon);
+        rule.name.erase(0, rule.name.find_first_not_of(" \t"));
+        rule.name.erase(rule.name.find_last_not_of(" \t") + 1);
+        if (rule.name.empty() || !std::all_of(rule.name.begin(), rule.name.end(), [](char c) {
+                return isIdentifierChar(c) || c == '-';
+            })) {
+            throw std::runtime_error(where + "invalid rule name '" + rule.name + "'");
+        }
+        if (!names.insert(rule.name).second) {
+            throw std::runtime_error(where + "duplicate rule '" + rule.name + "'");
+        }
+
+        rule.expression = line.substr(colon + 1);
+        const auto forPos = rule.expression.rfind("for:");
+        if (forPos != std::string::npos && (forPos == 0 || std::isspace(static_cast<unsigned char>(rule.expression[forPos - 1])))) {
+            std::string duration = rule.expression.substr(forPos + 4);
+            duration.erase(0, duration.find_first_not_of(" \t"));
+            duration.erase(duration.find_last_not_of(" \t\r") + 1);
+            rule.forMs = parseDurationMs(duration);
+            rule.expression.erase(forPos);
+        }
+        rule.expression.erase(0, rule.expression.find_first_not_of(" \t"));
+        rule.expression.erase(rule.expression.find_last_not_of(" \t\r") + 1);
+        if (rule.expression.empty()) {
+            throw std::runtime_error(where + "rule '" + rule.name + "' has no expression");
+        }
+        rules.push_back(std::move(rule));
+    }
+    return rules;
+}
+
+std::vector<RuleSpec> loadRules(const std::string& path) {
+    std::ifstream input(path);
+    if (!input) {
+        throw std::runtime_error("cannot read rules file " + path);
+    }
+    std::ostringstream text;
+    text << input.rdbuf();
+    return parseRules(text.str());
+}
+
+std::string formatAlert(const AlertEvent& event) {
+    std::ostringstream out;
+    out << formatTimestamp(event.timestampMs) << ' ' << (event.firing ? "FIRING" : "RESOLVED") << ' '
+        << seriesLabel(event.rule, event.entity) << " value=" << event.value;
+    return out.str();
+}
+
+struct RuleEngine::Impl {
+    std::int64_t intervalMs = 0;
+    std::vector<CompiledRule> rules;
+    std::unordered_map<std::string, std::vector<std::uint32_t>> rulesByFreeMetric;
+    std::vector<Slot> slots;
+    std::unordered_map<std::string, std::uint32_t> slotIndex;
+    std::vector<Instance> instances;
+    std::set<std::pair<std::uint32_t, std::string>> instanceKeys;
+    std::uint64_t generation = 0;
+    std::string key;
+
+    std::uint32_t slotFor(std::string_view metric, std::string_view entity) {
+        key.assign(metric);
+        key += '\0';
+        key += entity;
+        auto it = slotIndex.find(key);
+        if (it == slotIndex.end()) {
+            it = slotIndex.emplace(key, static_cast<std::uint32_t>(slots.size())).first;
+            slots.emplace_back();
+        }
+        return it->second;
+    }
+
+    void addInstance(std::uint32_t rule, const std::string& entity) {
+        if (!instanceKeys.emplace(rule, entity).second) {
+            return;
+        }
+        Instance instance;
+        instance.rule = rule;
+        instance.entity = entity;
+        for (const auto& reference : rules[rule].refs) {
+            const std::uint32_t slot = slotFor(reference.metric, reference.pinned ? reference.entity : entity);
+            slots[slot].reserveRing(ringCapacity(reference, intervalMs));
+            instance.slots.push_back(slot);
+        }
+        instances.push_back(std::move(instance));
+    }
+
+    // `observed` is what the result hinges on: the left-hand side of the
+    // comparison that decided it. Each stack entry carries the observed
+    // value of its subexpression; && and || pass on the one of the operand
+    // that decided them.
+    double evaluate(const Instance& instance, std::int64_t nowMs, double& observed) const {
+        const CompiledRule& rule = rules[instance.rule];
+        double stack[kMaxStack];
+        double seen[kMaxStack];
+        std::size_t top = 0;
+        for (const auto& ins : rule.code) {
+            switch (ins.op) {
+            case Op::Const:
+                seen[top] = kNaN;
+                stack[top++] = ins.constant;
+                break;
+            case Op::Load: {
+                const Slot& slot = slots[instance.slots[ins.ref]];
+                seen[top] = kNaN;
+                stack[top++] = slot.generation == generation ? slot.value : kNaN;
+                break;
+            }
+            case Op::Rate:
+            case Op::Delta:
+            case Op::AvgOver:
+            case Op::MinOver:
+            case Op::MaxOver: {
+                const Slot& slot = slots[instance.slots[ins.ref]];
+                seen[top] = kNaN;
+                stack[top++] = slot.generation == generation ? windowed(ins.op, slot, nowMs, ins.windowMs) : kNaN;
+                break;
+            }
+            case Op::Neg:
+                stack[top - 1] = -stack[top - 1];
+                break;
+            case Op::Not:
+                stack[top - 1] = truthy(stack[top - 1]) ? 0.0 : 1.0;
+                break;
+            default: {
+                const double b = stack[--top];
+                const double a = stack[top - 1];
+                const double seenA = seen[top - 1];
+                const double seenB = seen[top];
+                double r = kNaN;
+                double s = kNaN;
+                switch (ins.op) {
+                case Op::Add: r = a + b; break;
+                case Op::Sub: r = a - b; break;
+                case Op::Mul: r = a * b; break;
+                case Op::Div: r = b != 0.0 ? a / b : kNaN; break;
+                case Op::Lt: r = a < b; s = a; break;
+                case Op::Le: r = a <= b; s = a; break;
+                case Op::Gt: r = a > b; s = a; break;
+                case Op::Ge: r = a >= b; s = a; break;
+                case Op::Eq: r = a == b; s = a; break;
+                case Op::Ne: r = !std::isnan(a) && !std::isnan(b) && a != b; s = a; break;
+                case Op::And:
+                    // True: both held, the left one is reported. False: the
+                    // first operand that failed.
+                    r = truthy(a) && truthy(b);
+                    s = truthy(a) ? (r != 0.0 && !std::isnan(seenA) ? seenA : seenB) : seenA;
+                    break;
+                case Op::Or:
+                    r = truthy(a) || truthy(b);
+                    s = truthy(a) ? seenA : seenB;
+                    break;
+                default: break;
+                }
+                stack[top - 1] = r;
+                seen[top - 1] = s;
+                break;
+            }
+            }
+        }
+        const double result = top > 0 ? stack[top - 1] : kNaN;
+        observed = top > 0 && !std::isnan(seen[top - 1]) ? seen[top - 1] : result;
+        return result;
+    }
+};
+
+RuleEngine::RuleEngine(const std::vector<RuleSpec>& rules, std::int64_t intervalMs)
+    : impl_(std::make_unique<Impl>()) {
+    impl_->intervalMs = intervalMs;
+    for (const auto& spec : rules) {
+        CompiledRule rule;
+        rule.spec = spec;
+        Compiler(rule).compile();
+        impl_->rules.push_back(std::move(rule));
+    }
+
+    for (std::uint32_t r = 0; r < impl_->rules.size(); ++r) {
+        const CompiledRule& rule = impl_->rules[r];
+        if (!rule.hasFreeRefs) {
+            impl_->addInstance(r, {});
+            continue;
+        }
+        std::set<std::string> metrics;
+        for (const auto& reference : rule.refs) {
+            if (!reference.pinned) {
+                metrics.insert(reference.metric);
+            }
+        }
+        for (const auto& metric : metrics) {
+            impl_->rulesByFreeMetric[metric].push_back(r);
+        }
+    }
+}
+
+RuleEngine::~RuleEngine() = default;
+
+void RuleEngine::observe(std::int64_t timestampMs,
+                         const std::vector<MetricSample>& samples,
+                         const std::function<void(const AlertEvent&)>& emit) {
+    Impl& impl = *impl_;
+    ++impl.generation;
+    for (const auto& sample : samples) {
+        const std::uint32_t index = impl.slotFor(sample.name, sample.entity);
+        if (!impl.slots[index].discovered) {
+            impl.slots[index].discovered = true;
+            const auto rules = impl.rulesByFreeMetric.find(sample.name);
+            if (rules != impl.rulesByFreeMetric.end()) {
+                for (const std::uint32_t r : rules->second) {
+                    impl.addInstance(r, sample.entity);
+                }
+            }
+        }
+        Slot& slot = impl.slots[index];
+        slot.value = sample.value;
+        slot.generation = impl.generation;
+        slot.push(timestampMs, sample.value);
+    }
+
+    for (auto& instance : impl.instances) {
+        double observed = kNaN;
+        const bool active = truthy(impl.evaluate(instance, timestampMs, observed));
+        const CompiledRule& rule = impl.rules[instance.rule];
+        if (!active) {
+            instance.pending = false;
+            if (instance.firing) {
+                instance.firing = false;
+                emit(AlertEvent{timestampMs, rule.spec.name, instance.entity, false, observed});
+            }
+            continue;
+        }
+        if (!instance.pending) {
+            instance.pending = true;
+            instance.pendingSinceMs = timestampMs;
+        }
+        if (!instance.firing && timestampMs - instance.pendingSinceMs >= rule.spec.forMs) {
+            instance.firing = true;
+            emit(AlertEvent{timestampMs, rule.spec.name, instance.entity, true, observed});
+        }
+    }
+}
+
+std::size_t RuleEngine::ruleCount() const {
+    return impl_->rules.size();
+}
+
+std::size_t RuleEngine::instanceCount() const {
+    return impl_->instances.size();
+}
+
+std::string RuleEngine::describe() const {
+    std::ostringstream out;
+    for (const auto& rule : impl_->rules) {
+        out << rule.spec.name;
+        if (rule.spec.forMs > 0) {
+            out << " (for " << rule.spec.forMs << " ms)";
+        }
+        out << ": " << rule.spec.expression << '\n';
+        for (std::size_t i = 0; i < rule.code.size(); ++i) {
+            const Instruction& ins = rule.code[i];
+            out << "  " << std::setw(3) << i << "  " << opName(ins.op);
+            if (ins.op == Op::Const) {
+                out << ' ' << ins.constant;
+            } else if (ins.op >= Op::Load && ins.op <= Op::MaxOver) {
+                const Reference& reference = rule.refs[ins.ref];
+                out << ' ' << reference.metric << (reference.pinned ? "{" + reference.entity + "}" : "{*}");
+                if (ins.windowMs > 0) {
+                    out << " window=" << ins.windowMs << "ms";
+                }
+            }
+            out << '\n';
+        }
+    }
+    return out.str();
+}
+
+AlertDispatcher::AlertDispatcher(bool toStdout)
+    : toStdout_(toStdout) {}
+
+AlertDispatcher::~AlertDispatcher() {
+    reapHooks();
+}
+
+void AlertDispatcher::setLogFile(const std::string& path) {
+    log_.open(path, std::ios::app);
+    if (!log_) {
+        throw std::runtime_error("cannot open alert log " + path);
+    }
+}
+
+void AlertDispatcher::setHook(std::string command) {
+    hook_ = std::move(command);
+}
+
+void AlertDispatcher::publish(const AlertEvent& event) {
+    publishLine(formatAlert(event));
+    if (!hook_.empty()) {
+        runHook(event);
+    }
+}
+
+void AlertDispatcher::publishLine(const std::string& line) {
+    if (toStdout_) {
+        std::cout << line << std::endl;
+    }
+    if (log_.is_open()) {
+        log_ << line << std::endl;
+    }
+}
+
+// Reaps the hooks that finished, and only those: other children of the
+// process belong to their own code.
+void AlertDispatcher::reapHooks() {
+    hooks_.erase(std::remove_if(hooks_.begin(), hooks_.end(),
+                                [](pid_t pid) { return waitpid(pid, nullptr, WNOHANG) != 0; }),
+                 hooks_.end());
+}
+
+void AlertDispatcher::runHook(const AlertEvent& event) {
+    reapHooks();
+
+    std::ostringstream value;
+    value << event.value;
+    std::vector<std::string> variables = {
+        "STATIO_ALERT_RULE=" + std::string(event.rule),
+        "STATIO_ALERT_ENTITY=" + std::string(event.entity),
+        std::string("STATIO_ALERT_STATE=") + (event.firing ? "firing" : "resolved"),
+        "STATIO_ALERT_VALUE=" + value.str(),
+        "STATIO_ALERT_TIME=" + std::to_string(event.timestampMs),
+    };
+    std::vector<char*> envp;
+    for (char** e = environ; e != nullptr && *e != nullptr; ++e) {
+        envp.push_back(*e);
+    }
+    for (auto& variable : variables) {
+        envp.push_back(variable.data());
+    }
+    envp.push_back(nullptr);
+
+    char shell[] = "/bin/sh";
+    char flag[] = "-c";
+    char* argv[] = {shell, flag, hook_.data(), nullptr};
+    pid_t pid = 0;
+    const int error = posix_spawn(&pid, shell, nullptr, nullptr, argv, envp.data());
+    if (error == ENOENT) {
+        std::cerr << "statio: cannot run alert hook: " << shell << " not found\n";
+    } else if (error != 0) {
+        std::cerr << "statio: cannot run alert hook " << hook_ << ": " << std::strerror(error) << '\n';
+    } else {
+        hooks_.push_back(pid);
+    }
+}
+
+} // namespace statio
@@ -0,0 +1,76 @@
+#include "statio/commands.hpp"
+
+#include "statio/cli_options.hpp"
+#include "statio/history.hpp"
+#include "statio/rules.hpp"
+#include "statio/system_info.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace statio {
+
+int runRulesCommand(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"bench", "iterations"}, {"quiet"});
+    if (cli.positional().empty()) {
+        throw std::runtime_error("rules requires a rules file");
+    }
+
+    std::vector<RuleSpec> rules = loadRules(cli.positional().front());
+    const std::int64_t copies = cli.integer("bench", 0);
+    if (copies <= 0) {
+        const RuleEngine engine(rules, 1000);
+        std::cout << engine.describe() << engine.ruleCount() << " rules compiled\n";
+        return 0;
+    }
+
+    // Replicates the rule set to measure evaluation cost against the
+    // current snapshot; timestamps advance 1 s per iteration.
+    const std::size_t original = rules.size();
+    for (std::int64_t c = 1; c < copies; ++c) {
+        for (std::size_t r = 0; r < original; ++r) {
+            RuleSpec copy = rules[r];
+            copy.name += "_" + std::to_string(c);
+            rules.push_back(std::move(copy));
+        }
+    }
+    std::vector<MetricSample> samples = flattenSnapshot(collectSystemSnapshot());
+    std::size_t events = 0;
+    const auto count = [&events](const AlertEvent&) { ++events; };
+    const std::int64_t iterations = std::max<std::int64_t>(cli.integer("iterations", 1000), 1);
+
+    // Mean nanoseconds of one observe() pass; timestamps advance 1 s each.
+    const auto measure = [&](RuleEngine& engine) {
+        std::int64_t now = currentTimeMs();
+        engine.observe(now, samples, count); // binds series and rule instances
+        const auto started = std::chrono::steady_clock::now();
+        for (std::int64_t i = 0; i < iterations; ++i) {
+            now += 1000;
+            engine.observe(now, samples, count);
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - started;
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+               static_cast<double>(iterations);
+    };
+
+    // Every pass looks up each sample's series slot whatever the rules are;
+    // an engine without rules measures that part alone.
+    RuleEngine empty({}, 1000);
+    const double lookupNs = measure(empty);
+    RuleEngine engine(rules, 1000);
+    events = 0;
+    const double perPass = measure(engine);
+    const double instances = static_cast<double>(std::max<std::size_t>(engine.instanceCount(), 1));
+
+    std::cout << "rules: " << engine.ruleCount() << '\n'
+              << "instances: " << engine.instanceCount() << '\n'
+              << "series per sample: " << samples.size() << '\n'
+              << "per sample: " << perPass / 1000.0 << " us (series lookup " << lookupNs / 1000.0 << " us)\n"
+              << "per instance: " << std::max(perPass - lookupNs, 0.0) / instances << " ns evaluation, "
+              << perPass / instances << " ns with the lookup shared out\n"
+              << "events: " << events << '\n';
+    return 0;
+}
+
+} // namespace statio
@@ -0,0 +1,204 @@
+#include "statio/schema.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+namespace statio {
+namespace {
+
+// Filled by LatencySampler and the daemon, not by a snapshot collector.
+constexpr MetricInfo kDistributions[] = {
+    {"disk.await_ms", "Mean time per completed disk request", "ms", MetricKind::Distribution, 0, "device"},
+    {"sched.delay_us", "Mean runqueue wait per timeslice", "us", MetricKind::Distribution, 0, "cpu"},
+    {"collector.latency_us", "Time to collect one snapshot", "us", MetricKind::Distribution, 0, "collector"},
+};
+
+template <typename Record>
+void catalogRecord(std::vector<MetricInfo>& out, const char* entityLabel) {
+    forEach(Schema<Record>::fields, [&](const auto& f) {
+        if (f.metric != nullptr) {
+            out.push_back({f.metric, f.help, f.unit, f.kind, f.sources != 0 ? f.sources : Schema<Record>::sources,
+                           entityLabel});
+        }
+    });
+    forEach(Schema<Record>::children, [&](const auto& c) {
+        using Child = typename std::decay_t<decltype(c)>::ChildType;
+        catalogRecord<Child>(out, Schema<Child>::entityLabel);
+    });
+}
+
+std::vector<MetricInfo> buildCatalog() {
+    std::vector<MetricInfo> catalog;
+    forEachSection([&catalog](const auto& s) {
+        using Value = typename std::decay_t<decltype(s)>::MemberType;
+        using Record = typename ListOf<Value>::Record;
+        if constexpr (ListOf<Value>::isList) {
+            catalogRecord<Record>(catalog, Schema<Record>::entityLabel);
+        } else {
+            catalogRecord<Record>(catalog, nullptr);
+        }
+    });
+    catalog.insert(catalog.end(), std::begin(kDistributions), std::end(kDistributions));
+    return catalog;
+}
+
+std::string familyName(const std::string& name) {
+    std::string family = "statio_";
+    for (const char ch : name) {
+        family += std::isalnum(static_cast<unsigned char>(ch)) != 0 ? ch : '_';
+    }
+    return family;
+}
+
+void appendNumber(std::string& out, double value) {
+    if (std::isnan(value)) {
+        out += "NaN";
+        return;
+    }
+    if (std::isinf(value)) {
+        out += value > 0 ? "+Inf" : "-Inf";
+        return;
+    }
+    appendExactNumber(out, value);
+}
+
+void appendLabelValue(std::string& out, const std::string& value) {
+    for (const char ch : value) {
+        if (ch == '\\' || ch == '"') {
+            out += '\\';
+            out += ch;
+        } else if (ch == '\n') {
+            out += "\\n";
+        } else {
+            out += ch;
+        }
+    }
+}
+
+// name{label="entity"[,quantile="q"]} value
+void appendSample(std::string& out,
+                  const std::string& name,
+                  const char* label,
+                  const std::string& entity,
+                  const char* quantile,
+                  double value) {
+    out += name;
+    if (!entity.empty() || quantile != nullptr) {
+        char separator = '{';
+        if (!entity.empty()) {
+            out += separator;
+            out += label;
+            out += "=\"";
+            appendLabelValue(out, entity);
+            out += '"';
+            separator = ',';
+        }
+        if (quantile != nullptr) {
+            out += separator;
+            out += "quantile=\"";
+            out += quantile;
+            out += '"';
+        }
+        out += '}';
+    }
+    out += ' ';
+    appendNumber(out, value);
+    out += '\n';
+}
+
+} // namespace
+
+const std::vector<MetricInfo>& metricCatalog() {
+    static const std::vector<MetricInfo> catalog = buildCatalog();
+    return catalog;
+}
+
+const MetricInfo* findMetric(std::string_view name) {
+    for (const auto& metric : metricCatalog()) {
+        if (name == metric.name) {
+            return &metric;
+        }
+    }
+    return nullptr;
+}
+
+std::string renderOpenMetrics(const std::vector<MetricSample>& samples) {
+    // Families must not interleave, so samples are grouped by name in the
+    // order the names first appear.
+    std::vector<std::string> order;
+    std::unordered_map<std::string, std::vector<const MetricSample*>> families;
+    for (const auto& sample : samples) {
+        auto& members = families[sample.name];
+        if (members.empty()) {
+            order.push_back(sample.name);
+        }
+        members.push_back(&sample);
+    }
+
+    std::string out;
+    for (const auto& name : order) {
+        const auto& members = families[name];
+        const MetricInfo* info = findMetric(name);
+        const MetricKind kind = members.front()->kind;
+        const std::string family = familyName(name);
+        const char* label = info != nullptr && info->entityLabel != nullptr ? info->entityLabel : "entity";
+        out += "# TYPE " + family +
+               (kind == MetricKind::Counter ? " counter\n" : kind == MetricKind::Distribution ? " summary\n" : " gauge\n");
+        if (info != nullptr) {
+            out += "# HELP " + family + ' ' + info->help;
+            if (info->unit[0] != '\0') {
+                out += std::string(" (") + info->unit + ')';
+            }
+            out += '\n';
+        }
+        for (const MetricSample* sample : members) {
+            if (kind == MetricKind::Counter) {
+                appendSample(out, family + "_total", label, sample->entity, nullptr, sample->value);
+            } else if (kind == MetricKind::Distribution) {
+                const QuantileSketch& sketch = sample->sketch;
+                if (!sketch.empty()) {
+                    appendSample(out, family, label, sample->entity, "0.5", sketch.quantile(0.5));
+                    appendSample(out, family, label, sample->entity, "0.9", sketch.quantile(0.9));
+                    appendSample(out, family, label, sample->entity, "0.99", sketch.quantile(0.99));
+                }
+                appendSample(out, family + "_sum", label, sample->entity, nullptr, sketch.sum());
+                appendSample(out, family + "_count", label, sample->entity, nullptr, static_cast<double>(sketch.count()));
+            } else {
+                appendSample(out, family, label, sample->entity, nullptr, sample->value);
+            }
+        }
+    }
+    out += "# EOF\n";
+    return out;
+}
+
+void appendExactNumber(std::string& out, double value) {
+    char number[32];
+    if (std::fabs(value) < 9007199254740992.0 && value == std::floor(value)) {
+        std::snprintf(number, sizeof(number), "%.0f", value);
+    } else {
+        std::snprintf(number, sizeof(number), "%.10g", value);
+    }
+    out += number;
+}
+
+std::string humanBytes(double bytes) {
+    constexpr const char* kUnits[] = {"B", "KB", "MB", "GB", "TB"};
+    std::size_t unit = 0;
+    while (bytes >= 1024.0 && unit + 1 < sizeof(kUnits) / sizeof(kUnits[0])) {
+        bytes /= 1024.0;
+        ++unit;
+    }
+    char text[32];
+    if (unit == 0) {
+        std::snprintf(text, sizeof(text), "%.0f B", bytes);
+    } else {
+        std::snprintf(text, sizeof(text), "%.2f %s", bytes, kUnits[unit]);
+    }
+    return text;
+}
+
+} // namespace statio
@@ -0,0 +1,285 @@
+#include "statio/sketch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace statio {
+namespace {
+
+constexpr std::uint8_t kEncodingVersion = 1;
+constexpr double kMinIndexable = 1e-9;
+
+void putVarint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void putDouble(std::string& out, double value) {
+    char raw[sizeof(double)];
+    std::memcpy(raw, &value, sizeof(raw));
+    out.append(raw, sizeof(raw));
+}
+
+class Decoder {
+public:
+    Decoder(const unsigned char* data, std::size_t size)
+        : cursor_(data), end_(data + size) {}
+
+    bool varint(std::uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && cursor_ < end_; shift += 7) {
+            const std::uint8_t byte = *cursor_++;
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool number(double& value) {
+        if (end_ - cursor_ < static_cast<std::ptrdiff_t>(sizeof(double))) {
+            return false;
+        }
+        std::memcpy(&value, cursor_, sizeof(double));
+        cursor_ += sizeof(double);
+        return true;
+    }
+
+    bool byte(std::uint8_t& value) {
+        if (cursor_ >= end_) {
+            return false;
+        }
+        value = *cursor_++;
+        return true;
+    }
+
+private:
+    const unsigned char* cursor_;
+    const unsigned char* end_;
+};
+
+std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+} // namespace
+
+void QuantileSketch::Store::add(std::int32_t index, std::uint64_t count, std::size_t maxBins) {
+    if (bins.empty()) {
+        offset = index;
+        bins.assign(1, count);
+        return;
+    }
+
+    const std::int32_t top = offset + static_cast<std::int32_t>(bins.size()) - 1;
+    const auto cap = static_cast<std::int32_t>(maxBins);
+    if (index > top) {
+        bins.resize(static_cast<std::size_t>(index - offset + 1), 0);
+        if (bins.size() > maxBins) {
+            // Collapse the lowest bins into the new lowest kept bin.
+            const std::size_t drop = bins.size() - maxBins;
+            std::uint64_t folded = 0;
+            for (std::size_t i = 0; i < drop; ++i) {
+                folded += bins[i];
+            }
+            bins.erase(bins.begin(), bins.begin() + static_cast<std::ptrdiff_t>(drop));
+            bins.front() += folded;
+            offset += static_cast<std::int32_t>(drop);
+        }
+    } else if (index < offset) {
+        index = std::max(index, top - cap + 1);
+        if (index < offset) {
+            bins.insert(bins.begin(), static_cast<std::size_t>(offset - index), 0);
+            offset = index;
+        }
+    }
+    bins[static_cast<std::size_t>(index - offset)] += count;
+}
+
+void QuantileSketch::Store::merge(const Store& other, std::size_t maxBins) {
+    for (std::size_t i = other.bins.size(); i > 0; --i) {
+        if (other.bins[i - 1] != 0) {
+            add(other.offset + static_cast<std::int32_t>(i - 1), other.bins[i - 1], maxBins);
+        }
+    }
+}
+
+std::uint64_t QuantileSketch::Store::total() const {
+    std::uint64_t sum = 0;
+    for (const auto c : bins) {
+        sum += c;
+    }
+    return sum;
+}
+
+QuantileSketch::QuantileSketch(double relativeAccuracy, std::size_t maxBins)
+    : accuracy_(relativeAccuracy),
+      gamma_((1.0 + relativeAccuracy) / (1.0 - relativeAccuracy)),
+      logGamma_(std::log(gamma_)),
+      maxBins_(std::max<std::size_t>(maxBins, 16)) {
+    if (!(relativeAccuracy > 0.0 && relativeAccuracy < 1.0)) {
+        throw std::invalid_argument("sketch accuracy must be in (0, 1)");
+    }
+}
+
+std::int32_t QuantileSketch::indexOf(double value) const {
+    return static_cast<std::int32_t>(std::ceil(std::log(value) / logGamma_));
+}
+
+double QuantileSketch::valueOf(std::int32_t index) const {
+    return 2.0 * std::pow(gamma_, index) / (gamma_ + 1.0);
+}
+
+void QuantileSketch::add(double value, std::uint64_t count) {
+    if (count == 0 || std::isnan(value)) {
+        return;
+    }
+
+    if (value > kMinIndexable) {
+        positive_.add(indexOf(value), count, maxBins_);
+    } else if (value < -kMinIndexable) {
+        negative_.add(indexOf(-value), count, maxBins_);
+    } else {
+        zeroCount_ += count;
+    }
+
+    if (count_ == 0) {
+        min_ = value;
+        max_ = value;
+    } else {
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+    count_ += count;
+    sum_ += value * static_cast<double>(count);
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+    if (other.empty()) {
+        return;
+    }
+    if (other.accuracy_ != accuracy_) {
+        throw std::invalid_argument("cannot merge sketches with different accuracy");
+    }
+
+    positive_.merge(other.positive_, maxBins_);
+    negative_.merge(other.negative_, maxBins_);
+    zeroCount_ += other.zeroCount_;
+    min_ = count_ == 0 ? other.min_ : std::min(min_, other.min_);
+    max_ = count_ == 0 ? other.max_ : std::max(max_, other.max_);
+    count_ += other.count_;
+    sum_ += other.sum_;
+}
+
+void QuantileSketch::clear() {
+    positive_ = Store{};
+    negative_ = Store{};
+    zeroCount_ = 0;
+    count_ = 0;
+    min_ = 0.0;
+    max_ = 0.0;
+    sum_ = 0.0;
+}
+
+double QuantileSketch::quantile(double q) const {
+    if (count_ == 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    q = std::clamp(q, 0.0, 1.0);
+    const double rank = q * static_cast<double>(count_ - 1);
+
+    double seen = 0.0;
+    double estimate = max_;
+    bool found = false;
+    for (std::size_t i = negative_.bins.size(); i > 0 && !found; --i) {
+        seen += static_cast<double>(negative_.bins[i - 1]);
+        if (seen > rank) {
+            estimate = -valueOf(negative_.offset + static_cast<std::int32_t>(i - 1));
+            found = true;
+        }
+    }
+    if (!found) {
+        seen += static_cast<double>(zeroCount_);
+        if (seen > rank) {
+            estimate = 0.0;
+            found = true;
+        }
+    }
+    for (std::size_t i = 0; i < positive_.bins.size() && !found; ++i) {
+        seen += static_cast<double>(positive_.bins[i]);
+        if (seen > rank) {
+            estimate = valueOf(positive_.offset + static_cast<std::int32_t>(i));
+            found = true;
+        }
+    }
+
+    return std::clamp(estimate, min_, max_);
+}
+
+void QuantileSketch::encode(std::string& out) const {
+    out.push_back(static_cast<char>(kEncodingVersion));
+    putDouble(out, accuracy_);
+    putDouble(out, min_);
+    putDouble(out, max_);
+    putDouble(out, sum_);
+    putVarint(out, zeroCount_);
+    for (const Store* store : {&positive_, &negative_}) {
+        putVarint(out, zigzag(store->offset));
+        putVarint(out, store->bins.size());
+        for (const auto c : store->bins) {
+            putVarint(out, c);
+        }
+    }
+}
+
+bool QuantileSketch::decode(const unsigned char* data, std::size_t size) {
+    clear();
+    Decoder in(data, size);
+
+    std::uint8_t version = 0;
+    double accuracy = 0.0;
+    if (!in.byte(version) || version != kEncodingVersion || !in.number(accuracy) ||
+        !(accuracy > 0.0 && accuracy < 1.0) || !in.number(min_) || !in.number(max_) || !in.number(sum_) ||
+        !in.varint(zeroCount_)) {
+        clear();
+        return false;
+    }
+    if (accuracy != accuracy_) {
+        accuracy_ = accuracy;
+        gamma_ = (1.0 + accuracy) / (1.0 - accuracy);
+        logGamma_ = std::log(gamma_);
+    }
+
+    for (Store* store : {&positive_, &negative_}) {
+        std::uint64_t offset = 0;
+        std::uint64_t bins = 0;
+        if (!in.varint(offset) || !in.varint(bins) || bins > maxBins_) {
+            clear();
+            return false;
+        }
+        store->offset = static_cast<std::int32_t>(unzigzag(offset));
+        store->bins.resize(static_cast<std::size_t>(bins));
+        for (auto& c : store->bins) {
+            if (!in.varint(c)) {
+                clear();
+                return false;
+            }
+        }
+    }
+
+    count_ = zeroCount_ + positive_.total() + negative_.total();
+    return true;
+}
+
+} // namespace statio
@@ -1,8 +1,12 @@
 #include "statio/system_info.hpp"
 
+#include "statio/schema.hpp"
+
 #include <algorithm>
 #include <array>
 #include <cctype>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <ifaddrs.h>
@@ -13,6 +17,7 @@
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <sys/stat.h>
 #include <sys/statvfs.h>
 #include <sys/sysinfo.h>
 #include <sys/utsname.h>
@@ -76,43 +81,185 @@ bool isUsefulMountPoint(const std::string& mountPoint) {
     return false;
 }
 
-CpuInfo collectCpuInfo() {
-    CpuInfo info;
-    info.logicalThreads = std::thread::hardware_concurrency();
+std::vector<CpuTimes> collectCpuTimes() {
+    std::vector<CpuTimes> times;
+    std::ifstream stat("/proc/stat");
+    if (!stat) {
+        return times;
+    }
 
-    std::ifstream cpuInfoFile("/proc/cpuinfo");
-    if (!cpuInfoFile) {
-        return info;
+    std::string line;
+    while (std::getline(stat, line)) {
+        if (line.rfind("cpu", 0) != 0) {
+            break;
+        }
+
+        std::istringstream fields(line);
+        CpuTimes t;
+        fields >> t.name >> t.user >> t.nice >> t.system >> t.idle >> t.iowait >> t.irq >> t.softirq >> t.steal;
+        if (!fields.fail()) {
+            times.push_back(t);
+        }
     }
 
+    return times;
+}
+
+// Interface names and byte counters from one read of /proc/net/dev:
+// two header lines, then "  name: rx_bytes packets ... tx_bytes ...".
+void readNetDevCounters(std::map<std::string, NetworkInfo>& byName) {
+    std::ifstream netDev("/proc/net/dev");
     std::string line;
-    while (std::getline(cpuInfoFile, line)) {
-        auto pos = line.find(':');
-        if (pos == std::string::npos) {
+    for (int header = 0; header < 2 && std::getline(netDev, line); ++header) {
+    }
+    while (std::getline(netDev, line)) {
+        const std::size_t colon = line.find(':');
+        if (colon == std::string::npos) {
             continue;
         }
+        const std::string name = trim(line.substr(0, colon));
+        std::istringstream fields(line.substr(colon + 1));
+        std::uint64_t values[9] = {};
+        for (auto& value : values) {
+            fields >> value;
+        }
+        auto& entry = byName[name];
+        entry.name = name;
+        entry.rxBytes = values[0];
+        entry.txBytes = values[8];
+    }
+}
 
-        std::string key = trim(line.substr(0, pos));
-        std::string value = trim(line.substr(pos + 1));
+void readLinkState(const std::string& name, NetworkInfo& entry) {
+    const std::string base = "/sys/class/net/" + name;
+    struct stat st {};
+    entry.physical = ::stat((base + "/device").c_str(), &st) == 0;
+    if (!entry.physical) {
+        return;
+    }
+    entry.linkUp = readFileFirstLine(base + "/operstate") == "up";
+    try {
+        const std::string speed = readFileFirstLine(base + "/speed");
+        if (!speed.empty()) {
+            entry.speedMbps = std::stoll(speed);
+        }
+        const std::string rxErrors = readFileFirstLine(base + "/statistics/rx_errors");
+        const std::string txErrors = readFileFirstLine(base + "/statistics/tx_errors");
+        const std::string carrier = readFileFirstLine(base + "/carrier_changes");
+        entry.errors = (rxErrors.empty() ? 0 : std::stoull(rxErrors)) + (txErrors.empty() ? 0 : std::stoull(txErrors));
+        entry.carrierChanges = carrier.empty() ? 0 : std::stoull(carrier);
+    } catch (...) {
+    }
+}
 
-        if (key == "model name" && info.model.empty()) {
-            info.model = value;
-        } else if (key == "cpu cores" && info.physicalCores == 0) {
-            try {
-                info.physicalCores = static_cast<unsigned int>(std::stoul(value));
-            } catch (...) {
+std::vector<NetworkInfo> collectNetworkInfo(unsigned sources) {
+    std::vector<NetworkInfo> list;
+    std::map<std::string, NetworkInfo> byName;
+
+    ifaddrs* ifAddrList = nullptr;
+    if ((sources & SourceNetAddresses) != 0 && getifaddrs(&ifAddrList) == 0) {
+        for (ifaddrs* it = ifAddrList; it != nullptr; it = it->ifa_next) {
+            if (!it->ifa_name) {
+                continue;
             }
-        } else if (key == "cpu MHz" && info.currentMHz <= 0.0) {
-            try {
-                info.currentMHz = std::stod(value);
-            } catch (...) {
+
+            std::string ifaceName = it->ifa_name;
+            auto& entry = byName[ifaceName];
+            entry.name = ifaceName;
+
+            if (!it->ifa_addr) {
+                continue;
+            }
+
+            const int family = it->ifa_addr->sa_family;
+            if (family == AF_INET) {
+                std::array<char, NI_MAXHOST> host{};
+                int rc = getnameinfo(it->ifa_addr,
+                                     sizeof(sockaddr_in),
+                                     host.data(),
+                                     static_cast<socklen_t>(host.size()),
+                                     nullptr,
+                                     0,
+                                     NI_NUMERICHOST);
+                if (rc == 0) {
+                    entry.ipv4 = host.data();
+                }
             }
         }
+        freeifaddrs(ifAddrList);
     }
 
-    return info;
+    // /proc/net/dev lists every interface with its counters in one read,
+    // instead of two sysfs files per interface.
+    if ((sources & (SourceNetCounters | SourceNetLink)) != 0 || byName.empty()) {
+        readNetDevCounters(byName);
+    }
+
+    for (auto& [name, entry] : byName) {
+        if ((sources & SourceNetAddresses) != 0) {
+            entry.mac = readFileFirstLine("/sys/class/net/" + name + "/address");
+        }
+        if ((sources & SourceNetLink) != 0) {
+            readLinkState(name, entry);
+        }
+        list.push_back(entry);
+    }
+
+    std::sort(list.begin(), list.end(), [](const NetworkInfo& a, const NetworkInfo& b) {
+        return a.name < b.name;
+    });
+
+    return list;
+}
+
+std::vector<GpuInfo> collectGpuInfo() {
+    std::vector<GpuInfo> gpus;
+
+    // Lightweight fallback: check DRM cards without external dependencies.
+    for (int i = 0; i < 8; ++i) {
+        const std::string base = "/sys/class/drm/card" + std::to_string(i);
+        std::ifstream probe(base + "/device/vendor");
+        if (!probe) {
+            continue;
+        }
+
+        std::string vendor;
+        std::getline(probe, vendor);
+        GpuInfo gpu;
+        gpu.detected = true;
+        gpu.adapter = "card" + std::to_string(i) + " vendor=" + trim(vendor);
+        gpus.push_back(gpu);
+    }
+
+    if (gpus.empty()) {
+        gpus.push_back(GpuInfo{"No GPU details (platform-specific collector needed)", false});
+    }
+
+    return gpus;
+}
+
+// The bracketed word of a sysfs choice file such as "always [madvise] never".
+std::string activeChoice(const std::string& path) {
+    const std::string line = readFileFirstLine(path);
+    const std::size_t open = line.find('[');
+    const std::size_t close = line.find(']', open);
+    if (open == std::string::npos || close == std::string::npos) {
+        return {};
+    }
+    return line.substr(open + 1, close - open - 1);
+}
+
+std::uint64_t readCounter(const std::string& path) {
+    try {
+        const std::string text = readFileFirstLine(path);
+        return text.empty() ? 0 : std::stoull(text);
+    } catch (...) {
+        return 0;
+    }
 }
 
+} // namespace
+
 MemoryInfo collectMemoryInfo() {
     MemoryInfo info;
 
@@ -149,40 +296,145 @@ MemoryInfo collectMemoryInfo() {
     return info;
 }
 
-OsInfo collectOsInfo() {
-    OsInfo info;
-    struct utsname uts {};
+HugePageInfo collectHugePageInfo() {
+    HugePageInfo info;
 
-    if (uname(&uts) == 0) {
-        info.kernel = uts.release;
-        info.architecture = uts.machine;
-        info.hostname = uts.nodename;
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+    while (std::getline(meminfo, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        std::uint64_t value = 0;
+        if (!(fields >> key >> value)) {
+            continue;
+        }
+        if (key == "HugePages_Total:") {
+            info.total = value;
+        } else if (key == "HugePages_Free:") {
+            info.free = value;
+        } else if (key == "HugePages_Rsvd:") {
+            info.reserved = value;
+        } else if (key == "HugePages_Surp:") {
+            info.surplus = value;
+        } else if (key == "Hugepagesize:") {
+            info.defaultPageKB = value;
+        } else if (key == "AnonHugePages:") {
+            info.anonHugeMB = value / 1024ULL;
+        }
+    }
+
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/kernel/mm/hugepages", ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind("hugepages-", 0) != 0) {
+            continue;
+        }
+        const std::string base = entry.path().string();
+        HugePagePool pool;
+        try {
+            pool.pageKB = std::stoull(name.substr(std::strlen("hugepages-")));
+        } catch (...) {
+            continue;
+        }
+        pool.total = readCounter(base + "/nr_hugepages");
+        pool.free = readCounter(base + "/free_hugepages");
+        pool.reserved = readCounter(base + "/resv_hugepages");
+        pool.surplus = readCounter(base + "/surplus_hugepages");
+        info.pools.push_back(pool);
+    }
+    std::sort(info.pools.begin(), info.pools.end(),
+              [](const HugePagePool& a, const HugePagePool& b) { return a.pageKB < b.pageKB; });
+
+    info.thpEnabled = activeChoice("/sys/kernel/mm/transparent_hugepage/enabled");
+    info.thpDefrag = activeChoice("/sys/kernel/mm/transparent_hugepage/defrag");
+
+    // "Node 0, zone   Normal   3988   2125 ..." with one count per order.
+    std::ifstream buddyinfo("/proc/buddyinfo");
+    while (std::getline(buddyinfo, line)) {
+        const std::size_t zone = line.find("zone");
+        if (zone == std::string::npos) {
+            continue;
+        }
+        std::istringstream fields(line.substr(zone + 4));
+        std::string zoneName;
+        fields >> zoneName;
+        std::uint64_t count = 0;
+        for (std::size_t order = 0; fields >> count; ++order) {
+            if (order >= info.freeBlocks.size()) {
+                info.freeBlocks.resize(order + 1, 0);
+            }
+            info.freeBlocks[order] += count;
+        }
+    }
+    const auto pageKB = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE)) / 1024ULL;
+    std::uint64_t freeKB = 0;
+    std::uint64_t free2MKB = 0;
+    for (std::size_t order = 0; order < info.freeBlocks.size(); ++order) {
+        const std::uint64_t blockKB = pageKB << order;
+        freeKB += info.freeBlocks[order] * blockKB;
+        if (blockKB >= 2048) {
+            free2MKB += info.freeBlocks[order] * blockKB;
+        }
+    }
+    info.freeMB = freeKB / 1024ULL;
+    info.free2MBlockMB = free2MKB / 1024ULL;
+    return info;
+}
+
+CpuInfo collectCpuInfo(unsigned sources) {
+    CpuInfo info;
+    info.logicalThreads = std::thread::hardware_concurrency();
+    if ((sources & SourceCpuTimes) != 0) {
+        info.times = collectCpuTimes();
+    }
+    if ((sources & SourceCpuInfo) == 0) {
+        return info;
+    }
+
+    std::ifstream cpuInfoFile("/proc/cpuinfo");
+    if (!cpuInfoFile) {
+        return info;
     }
 
-    std::ifstream osRelease("/etc/os-release");
     std::string line;
-    while (std::getline(osRelease, line)) {
-        auto pos = line.find('=');
+    while (std::getline(cpuInfoFile, line)) {
+        auto pos = line.find(':');
         if (pos == std::string::npos) {
             continue;
         }
 
-        std::string key = line.substr(0, pos);
-        std::string value = line.substr(pos + 1);
-        if (!value.empty() && value.front() == '"' && value.back() == '"') {
-            value = value.substr(1, value.size() - 2);
-        }
+        std::string key = trim(line.substr(0, pos));
+        std::string value = trim(line.substr(pos + 1));
 
-        if (key == "PRETTY_NAME") {
-            info.distro = value;
-        } else if (key == "VERSION_ID") {
-            info.version = value;
+        if (key == "model name" && info.model.empty()) {
+            info.model = value;
+        } else if (key == "cpu cores" && info.physicalCores == 0) {
+            try {
+                info.physicalCores = static_cast<unsigned int>(std::stoul(value));
+            } catch (...) {
+            }
+        } else if (key == "cpu MHz" && info.currentMHz <= 0.0) {
+            try {
+                info.currentMHz = std::stod(value);
+            } catch (...) {
+            }
+        } else if ((key == "flags" || key == "Features") && info.flags.empty()) {
+            std::istringstream words(value);
+            std::string flag;
+            while (words >> flag) {
+                info.flags.push_back(flag);
+            }
+            std::sort(info.flags.begin(), info.flags.end());
         }
     }
 
     return info;
 }
 
+bool cpuHasFlag(const CpuInfo& cpu, const std::string& flag) {
+    return std::binary_search(cpu.flags.begin(), cpu.flags.end(), flag);
+}
+
 std::vector<DiskInfo> collectDiskInfo() {
     std::vector<DiskInfo> disks;
     std::ifstream mounts("/proc/mounts");
@@ -234,6 +486,7 @@ std::vector<DiskInfo> collectDiskInfo() {
         DiskInfo d;
         d.mountPoint = mountPoint;
         d.filesystem = fsType;
+        d.device = source;
         d.totalGB = bytesToGB(stat.f_blocks * stat.f_frsize);
         d.freeGB = bytesToGB(stat.f_bavail * stat.f_frsize);
         disks.push_back(d);
@@ -246,107 +499,61 @@ std::vector<DiskInfo> collectDiskInfo() {
     return disks;
 }
 
-std::vector<NetworkInfo> collectNetworkInfo() {
-    std::vector<NetworkInfo> list;
-    std::map<std::string, NetworkInfo> byName;
+OsInfo collectOsInfo() {
+    OsInfo info;
+    struct utsname uts {};
 
-    ifaddrs* ifAddrList = nullptr;
-    if (getifaddrs(&ifAddrList) != 0) {
-        return list;
+    if (uname(&uts) == 0) {
+        info.kernel = uts.release;
+        info.architecture = uts.machine;
+        info.hostname = uts.nodename;
     }
 
-    for (ifaddrs* it = ifAddrList; it != nullptr; it = it->ifa_next) {
-        if (!it->ifa_name) {
-            continue;
-        }
-
-        std::string ifaceName = it->ifa_name;
-        auto& entry = byName[ifaceName];
-        entry.name = ifaceName;
-
-        if (!it->ifa_addr) {
+    std::ifstream osRelease("/etc/os-release");
+    std::string line;
+    while (std::getline(osRelease, line)) {
+        auto pos = line.find('=');
+        if (pos == std::string::npos) {
             continue;
         }
 
-        const int family = it->ifa_addr->sa_family;
-        if (family == AF_INET) {
-            std::array<char, NI_MAXHOST> host{};
-            int rc = getnameinfo(it->ifa_addr,
-                                 sizeof(sockaddr_in),
-                                 host.data(),
-                                 static_cast<socklen_t>(host.size()),
-                                 nullptr,
-                                 0,
-                                 NI_NUMERICHOST);
-            if (rc == 0) {
-                entry.ipv4 = host.data();
-            }
+        std::string key = line.substr(0, pos);
+        std::string value = line.substr(pos + 1);
+        if (!value.empty() && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1, value.size() - 2);
         }
-    }
-    freeifaddrs(ifAddrList);
-
-    for (auto& [name, entry] : byName) {
-        entry.mac = readFileFirstLine("/sys/class/net/" + name + "/address");
 
-        std::string rx = readFileFirstLine("/sys/class/net/" + name + "/statistics/rx_bytes");
-        std::string tx = readFileFirstLine("/sys/class/net/" + name + "/statistics/tx_bytes");
-
-        try {
-            if (!rx.empty()) {
-                entry.rxBytes = std::stoull(rx);
-            }
-            if (!tx.empty()) {
-                entry.txBytes = std::stoull(tx);
-            }
-        } catch (...) {
+        if (key == "PRETTY_NAME") {
+            info.distro = value;
+        } else if (key == "VERSION_ID") {
+            info.version = value;
         }
-
-        list.push_back(entry);
     }
 
-    std::sort(list.begin(), list.end(), [](const NetworkInfo& a, const NetworkInfo& b) {
-        return a.name < b.name;
-    });
-
-    return list;
+    return info;
 }
 
-std::vector<GpuInfo> collectGpuInfo() {
-    std::vector<GpuInfo> gpus;
-
-    // Lightweight fallback: check DRM cards without external dependencies.
-    for (int i = 0; i < 8; ++i) {
-        const std::string base = "/sys/class/drm/card" + std::to_string(i);
-        std::ifstream probe(base + "/device/vendor");
-        if (!probe) {
-            continue;
-        }
-
-        std::string vendor;
-        std::getline(probe, vendor);
-        GpuInfo gpu;
-        gpu.detected = true;
-        gpu.adapter = "card" + std::to_string(i) + " vendor=" + trim(vendor);
-        gpus.push_back(gpu);
+SystemSnapshot collectSystemSnapshot(unsigned sources) {
+    SystemSnapshot snapshot;
+    snapshot.cpu = collectCpuInfo(sources);
+    if ((sources & SourceMemory) != 0) {
+        snapshot.memory = collectMemoryInfo();
     }
-
-    if (gpus.empty()) {
-        gpus.push_back(GpuInfo{"No GPU details (platform-specific collector needed)", false});
+    if ((sources & SourceHugePages) != 0) {
+        snapshot.hugepages = collectHugePageInfo();
+    }
+    if ((sources & SourceOs) != 0) {
+        snapshot.os = collectOsInfo();
+    }
+    if ((sources & SourceDisks) != 0) {
+        snapshot.disks = collectDiskInfo();
+    }
+    if ((sources & (SourceNetCounters | SourceNetLink | SourceNetAddresses)) != 0) {
+        snapshot.network = collectNetworkInfo(sources);
+    }
+    if ((sources & SourceGpus) != 0) {
+        snapshot.gpus = collectGpuInfo();
     }
-
-    return gpus;
-}
-
-} // namespace
-
-SystemSnapshot collectSystemSnapshot() {
-    SystemSnapshot snapshot;
-    snapshot.cpu = collectCpuInfo();
-    snapshot.memory = collectMemoryInfo();
-    snapshot.os = collectOsInfo();
-    snapshot.disks = collectDiskInfo();
-    snapshot.network = collectNetworkInfo();
-    snapshot.gpus = collectGpuInfo();
     return snapshot;
 }
 
@@ -355,55 +562,36 @@ std::string renderReport(const SystemSnapshot& snapshot) {
     out << "Statio v0.1 - Hardware/OS Diagnostic Report\n";
     out << "==========================================\n\n";
 
-    out << "[OS]\n";
-    out << "Distro: " << (snapshot.os.distro.empty() ? "N/A" : snapshot.os.distro) << '\n';
-    out << "Version: " << (snapshot.os.version.empty() ? "N/A" : snapshot.os.version) << '\n';
-    out << "Kernel: " << (snapshot.os.kernel.empty() ? "N/A" : snapshot.os.kernel) << '\n';
-    out << "Arch: " << (snapshot.os.architecture.empty() ? "N/A" : snapshot.os.architecture) << '\n';
-    out << "Host: " << (snapshot.os.hostname.empty() ? "N/A" : snapshot.os.hostname) << "\n\n";
-
-    out << "[CPU]\n";
-    out << "Model: " << (snapshot.cpu.model.empty() ? "N/A" : snapshot.cpu.model) << '\n';
-    out << "Physical cores: " << snapshot.cpu.physicalCores << '\n';
-    out << "Logical threads: " << snapshot.cpu.logicalThreads << '\n';
-    out << "Current MHz: " << std::fixed << std::setprecision(2) << snapshot.cpu.currentMHz << "\n\n";
-
-    out << "[Memory]\n";
-    out << "Total RAM: " << snapshot.memory.totalMB << " MB\n";
-    out << "Free RAM: " << snapshot.memory.freeMB << " MB\n";
-    out << "Available RAM*: " << snapshot.memory.availableMB << " MB\n";
-    out << "Total Swap: " << snapshot.memory.swapTotalMB << " MB\n";
-    out << "Free Swap: " << snapshot.memory.swapFreeMB << " MB\n\n";
-
-    out << "[Disks]\n";
-    for (const auto& d : snapshot.disks) {
-        out << d.mountPoint << " (" << d.filesystem << ") total=" << d.totalGB << "GB free=" << d.freeGB << "GB\n";
-    }
-    if (snapshot.disks.empty()) {
-        out << "No mounted disks detected\n";
-    }
-    out << '\n';
-
-    out << "[Network]\n";
-    for (const auto& n : snapshot.network) {
-        out << n.name
-            << " ipv4=" << (n.ipv4.empty() ? "N/A" : n.ipv4)
-            << " mac=" << (n.mac.empty() ? "N/A" : n.mac)
-            << " rx=" << n.rxBytes
-            << " tx=" << n.txBytes
-            << '\n';
-    }
-    if (snapshot.network.empty()) {
-        out << "No network interfaces detected\n";
+    // The report keeps its own order: huge pages follow memory.
+    std::string sections;
+    for (const char* key : {"os", "cpu", "memory", "hugepages", "disks", "network", "gpus"}) {
+        forEachSection([&](const auto& section) {
+            if (std::strcmp(section.key, key) == 0) {
+                appendReportSection(sections, section, snapshot);
+                sections += '\n';
+            }
+        });
     }
-    out << '\n';
-
-    out << "[GPU]\n";
-    for (const auto& g : snapshot.gpus) {
-        out << g.adapter << '\n';
+    out << sections;
+
+    if (!snapshot.distributions.empty()) {
+        out << std::fixed << std::setprecision(2);
+        out << "[Latency]\n";
+        for (const auto& d : snapshot.distributions) {
+            out << d.name;
+            if (!d.entity.empty()) {
+                out << '{' << d.entity << '}';
+            }
+            out << " n=" << d.sketch.count()
+                << " p50=" << d.sketch.quantile(0.5)
+                << " p99=" << d.sketch.quantile(0.99)
+                << " max=" << d.sketch.max()
+                << '\n';
+        }
+        out << '\n';
     }
 
-    out << "\n*Available RAM approximation uses free + buffer memory.\n";
+    out << "*Available RAM approximation uses free + buffer memory.\n";
 
     return out.str();
 }
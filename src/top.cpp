@@ -0,0 +1,408 @@
+#include "statio/top.hpp"
+
+#include "statio/proc_scan.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+// Runs of unchanged cells shorter than this between two changes are
+// rewritten rather than skipped: a cursor move costs about as many bytes.
+constexpr int kMaxBridge = 6;
+
+std::int64_t steadyMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+const char* styleSequence(CellStyle style) {
+    switch (style) {
+    case CellStyle::Bold:
+        return "\x1b[0;1m";
+    case CellStyle::Dim:
+        return "\x1b[0;2m";
+    case CellStyle::Inverse:
+        return "\x1b[0;7m";
+    case CellStyle::Green:
+        return "\x1b[0;32m";
+    case CellStyle::Yellow:
+        return "\x1b[0;33m";
+    case CellStyle::Red:
+        return "\x1b[0;31m";
+    case CellStyle::Normal:
+        break;
+    }
+    return "\x1b[0m";
+}
+
+void moveCursor(std::string& out, int row, int col) {
+    char sequence[32];
+    const int n = std::snprintf(sequence, sizeof(sequence), "\x1b[%d;%dH", row + 1, col + 1);
+    out.append(sequence, static_cast<std::size_t>(n));
+}
+
+// Reads the whole of a procfs file through `fd` into `buffer`, growing it
+// until one pread() returns short. Returns the length, or -1.
+ssize_t preadAll(int fd, std::string& buffer) {
+    for (;;) {
+        const ssize_t n = ::pread(fd, buffer.data(), buffer.size(), 0);
+        if (n < 0 || static_cast<std::size_t>(n) < buffer.size()) {
+            return n;
+        }
+        buffer.resize(buffer.size() * 2);
+    }
+}
+
+std::uint64_t meminfoKB(const char* text, const char* key) {
+    const char* p = std::strstr(text, key);
+    return p ? std::strtoull(p + std::strlen(key), nullptr, 10) : 0;
+}
+
+} // namespace
+
+void ScreenBuffer::resize(int rows, int cols) {
+    rows_ = std::max(rows, 0);
+    cols_ = std::max(cols, 0);
+    const auto cells = static_cast<std::size_t>(rows_) * static_cast<std::size_t>(cols_);
+    frame_.assign(cells, Cell{});
+    shown_.assign(cells, Cell{});
+    repaint_ = true;
+}
+
+void ScreenBuffer::clear() {
+    std::fill(frame_.begin(), frame_.end(), Cell{});
+}
+
+void ScreenBuffer::text(int row, int col, std::string_view text, CellStyle style) {
+    if (row < 0 || row >= rows_ || col >= cols_) {
+        return;
+    }
+    Cell* cells = frame_.data() + static_cast<std::size_t>(row) * static_cast<std::size_t>(cols_);
+    for (const char ch : text) {
+        if (col >= cols_) {
+            break;
+        }
+        if (col >= 0) {
+            cells[col].ch = ch >= ' ' && ch <= '~' ? ch : '?';
+            cells[col].style = style;
+        }
+        ++col;
+    }
+}
+
+void ScreenBuffer::fill(int row, int col, CellStyle style) {
+    if (row < 0 || row >= rows_) {
+        return;
+    }
+    Cell* cells = frame_.data() + static_cast<std::size_t>(row) * static_cast<std::size_t>(cols_);
+    for (int c = std::max(col, 0); c < cols_; ++c) {
+        cells[c].style = style;
+    }
+}
+
+std::size_t ScreenBuffer::flush(std::string& out) {
+    if (repaint_) {
+        out += "\x1b[0m\x1b[2J";
+        std::fill(shown_.begin(), shown_.end(), Cell{});
+        repaint_ = false;
+    }
+    std::size_t changed = 0;
+    bool styleKnown = false;
+    CellStyle current = CellStyle::Normal;
+    for (int row = 0; row < rows_; ++row) {
+        const std::size_t base = static_cast<std::size_t>(row) * static_cast<std::size_t>(cols_);
+        int cursor = -1; // column the terminal cursor sits at on this row, -1 when elsewhere
+        for (int col = 0; col < cols_; ++col) {
+            const Cell& want = frame_[base + col];
+            if (want == shown_[base + col]) {
+                continue;
+            }
+            if (cursor >= 0 && col > cursor && col - cursor <= kMaxBridge) {
+                // Rewrite the short unchanged run instead of moving over it.
+                for (int c = cursor; c < col; ++c) {
+                    const Cell& same = frame_[base + c];
+                    if (same.style != current) {
+                        out += styleSequence(same.style);
+                        current = same.style;
+                    }
+                    out += same.ch;
+                }
+            } else if (cursor != col) {
+                moveCursor(out, row, col);
+            }
+            if (!styleKnown || want.style != current) {
+                out += styleSequence(want.style);
+                current = want.style;
+                styleKnown = true;
+            }
+            out += want.ch;
+            shown_[base + col] = want;
+            ++changed;
+            // Writing the last column leaves the cursor in the pending-wrap
+            // state, so its position is not worth relying on.
+            cursor = col + 1 < cols_ ? col + 1 : -1;
+        }
+    }
+    return changed;
+}
+
+ProcessTable::ProcessTable(IoBackend io) : reader_(io, 1024), buffer_(1024, '\0') {
+    const long ticks = ::sysconf(_SC_CLK_TCK);
+    if (ticks > 0) {
+        ticksPerSecond_ = static_cast<double>(ticks);
+    }
+    const long page = ::sysconf(_SC_PAGESIZE);
+    if (page > 0) {
+        pageKB_ = static_cast<std::uint64_t>(page) / 1024;
+    }
+    // Leave most of the descriptor limit to the rest of the process; busy
+    // hosts with more processes than this fall back to open/read/close.
+    rlimit limit {};
+    maxOpen_ = 256;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        maxOpen_ = limit.rlim_cur > 64 ? static_cast<std::size_t>(limit.rlim_cur / 2) : 0;
+    }
+    procFd_ = ::open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (procFd_ < 0) {
+        throw std::runtime_error(std::string("cannot open /proc: ") + std::strerror(errno));
+    }
+}
+
+ProcessTable::~ProcessTable() {
+    ::close(procFd_);
+}
+
+void ProcessTable::release(Tracked& tracked) {
+    if (tracked.slot != BatchReader::npos) {
+        reader_.remove(tracked.slot);
+        tracked.slot = BatchReader::npos;
+    }
+}
+
+bool ProcessTable::parseStat(std::string_view text, ProcessSample& out, std::uint64_t& ticks) const {
+    ProcStat stat;
+    if (!parseProcStat(text, stat)) {
+        return false;
+    }
+    out.name.assign(stat.name);
+    out.state = stat.state;
+    ticks = stat.ticks;
+    out.threads = stat.threads;
+    out.rssKB = stat.rssPages * pageKB_;
+    return true;
+}
+
+// Opens and reads /proc/<pid>/stat outside the batch, keeping the descriptor
+// for the next batch.
+bool ProcessTable::readOnce(int pid, Tracked& tracked, ProcessSample& out, std::uint64_t& ticks) {
+    char path[32];
+    std::snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const ssize_t n = preadAll(fd, buffer_);
+    if (n <= 0 || !parseStat(std::string_view(buffer_.data(), static_cast<std::size_t>(n)), out, ticks)) {
+        ::close(fd);
+        return false;
+    }
+    tracked.slot = reader_.adopt(fd);
+    return true;
+}
+
+void ProcessTable::record(Tracked& tracked, ProcessSample& row, std::uint64_t ticks, double seconds) {
+    row.cpuPct = !tracked.fresh && seconds > 0.0 && ticks >= tracked.ticks
+                     ? static_cast<double>(ticks - tracked.ticks) / ticksPerSecond_ / seconds * 100.0
+                     : 0.0;
+    tracked.ticks = ticks;
+    tracked.generation = generation_;
+    tracked.fresh = false;
+    rows_.push_back(row);
+}
+
+const std::vector<ProcessSample>& ProcessTable::sample() {
+    const std::int64_t nowMs = steadyMs();
+    const double seconds = lastMs_ != 0 ? static_cast<double>(nowMs - lastMs_) / 1000.0 : 0.0;
+    lastMs_ = nowMs;
+    ++generation_;
+    rows_.clear();
+
+    pids_.clear();
+    listPids(procFd_, pids_);
+
+    // Every held descriptor is read in one batch; new processes are read
+    // one by one and join the batch from the next sample on, while the
+    // descriptor budget lasts.
+    reader_.read();
+    overflow_.clear();
+    ProcessSample row;
+    for (const int pid : pids_) {
+        auto it = tracked_.try_emplace(pid).first;
+        Tracked& tracked = it->second;
+        std::uint64_t ticks = 0;
+        bool ok = tracked.slot != BatchReader::npos && reader_.error(tracked.slot) == 0 &&
+                  parseStat(reader_.data(tracked.slot), row, ticks);
+        if (!ok && tracked.slot != BatchReader::npos) {
+            // The process behind the held descriptor exited; the pid now
+            // belongs to a new one.
+            release(tracked);
+            tracked.fresh = true;
+        }
+        if (!ok && reader_.size() >= maxOpen_) {
+            overflow_.push_back(pid);
+            continue;
+        }
+        if (!ok) {
+            ok = readOnce(pid, tracked, row, ticks);
+        }
+        if (!ok) {
+            tracked_.erase(it); // gone between the listing and the read
+            continue;
+        }
+        row.pid = pid;
+        record(tracked, row, ticks, seconds);
+    }
+
+    // The rest are opened, read and closed again on every sample.
+    if (!overflow_.empty()) {
+        if (!scanner_) {
+            scanner_ = std::make_unique<ProcScanner>();
+        }
+        scanner_->read(overflow_, scanned_);
+        for (std::size_t i = 0; i < scanned_.size(); ++i) {
+            row.pid = scanned_.pid[i];
+            row.name.assign(scanned_.nameOf(i));
+            row.state = scanned_.state[i];
+            row.threads = scanned_.threads[i];
+            row.rssKB = scanned_.rssKB[i];
+            record(tracked_[row.pid], row, scanned_.ticks[i], seconds);
+        }
+    }
+
+    for (auto it = tracked_.begin(); it != tracked_.end();) {
+        if (it->second.generation != generation_) {
+            release(it->second);
+            it = tracked_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return rows_;
+}
+
+TopSampler::TopSampler(IoBackend io) : counters_(BurstAll, io), buffer_(4096, '\0') {
+    meminfoFd_ = ::open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    loadavgFd_ = ::open("/proc/loadavg", O_RDONLY | O_CLOEXEC);
+}
+
+TopSampler::~TopSampler() {
+    if (meminfoFd_ >= 0) {
+        ::close(meminfoFd_);
+    }
+    if (loadavgFd_ >= 0) {
+        ::close(loadavgFd_);
+    }
+}
+
+bool TopSampler::readFile(int fd) {
+    if (fd < 0) {
+        return false;
+    }
+    const ssize_t n = preadAll(fd, buffer_);
+    if (n < 0) {
+        return false;
+    }
+    buffer_[static_cast<std::size_t>(n)] = '\0'; // preadAll leaves at least one spare byte
+    return true;
+}
+
+void TopSampler::readMemory(TopFrame& frame) {
+    if (!readFile(meminfoFd_)) {
+        return;
+    }
+    frame.memTotalKB = meminfoKB(buffer_.c_str(), "MemTotal:");
+    frame.memAvailableKB = meminfoKB(buffer_.c_str(), "MemAvailable:");
+    frame.swapTotalKB = meminfoKB(buffer_.c_str(), "SwapTotal:");
+    frame.swapFreeKB = meminfoKB(buffer_.c_str(), "SwapFree:");
+}
+
+void TopSampler::readLoad(TopFrame& frame) {
+    if (readFile(loadavgFd_)) {
+        std::sscanf(buffer_.c_str(), "%lf %lf %lf", &frame.loadAvg[0], &frame.loadAvg[1], &frame.loadAvg[2]);
+    }
+}
+
+void TopSampler::sample(TopFrame& frame) {
+    const std::int64_t nowMs = steadyMs();
+    counters_.sample(values_);
+    while (series_.size() < counters_.seriesCount()) {
+        series_.push_back(counters_.describe(series_.size()));
+    }
+    values_.resize(series_.size(), std::nan(""));
+    const double seconds = previousMs_ != 0 ? static_cast<double>(nowMs - previousMs_) / 1000.0 : 0.0;
+    previousMs_ = nowMs;
+
+    // NaN when either side is missing: a slot that appeared this time or
+    // an entity that disappeared.
+    auto delta = [this](std::size_t slot) {
+        return slot < previous_.size() ? values_[slot] - previous_[slot] : std::nan("");
+    };
+    auto rate = [&](std::size_t slot) {
+        const double d = delta(slot);
+        return seconds > 0.0 && std::isfinite(d) && d >= 0.0 ? d / seconds : 0.0;
+    };
+
+    frame.seconds = seconds;
+    frame.coreBusy.clear();
+    frame.disks.clear();
+    frame.network.clear();
+    frame.cpuBusy = 0.0;
+    for (std::size_t slot = 0; slot < series_.size();) {
+        const MetricSample& series = series_[slot];
+        if (series.name == "cpu.user") {
+            // user nice system idle iowait irq softirq steal
+            double total = 0.0;
+            for (std::size_t i = 0; i < 8; ++i) {
+                total += delta(slot + i);
+            }
+            const double idle = delta(slot + 3) + delta(slot + 4);
+            const double busy = std::isfinite(total) && total > 0.0 ? std::clamp(1.0 - idle / total, 0.0, 1.0) : 0.0;
+            if (series.entity == "cpu") {
+                frame.cpuBusy = busy;
+            } else if (!std::isnan(values_[slot])) {
+                frame.coreBusy.push_back(busy);
+            }
+            slot += 8;
+        } else if (series.name == "network.rx_bytes") {
+            if (series.entity != "lo" && !std::isnan(values_[slot])) {
+                frame.network.push_back(TopFrame::NetRate{series.entity, rate(slot), rate(slot + 1)});
+            }
+            slot += 2;
+        } else if (series.name == "disk.reads") {
+            if (!std::isnan(values_[slot])) {
+                frame.disks.push_back(TopFrame::DiskRate{series.entity, rate(slot + 2), rate(slot + 3),
+                                                         std::min(rate(slot + 4) / 1000.0, 1.0)});
+            }
+            slot += 5;
+        } else {
+            ++slot;
+        }
+    }
+    previous_.swap(values_);
+
+    readMemory(frame);
+    readLoad(frame);
+}
+
+} // namespace statio
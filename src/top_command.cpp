@@ -0,0 +1,492 @@
+#include "statio/commands.hpp"
+
+#include "statio/cli_options.hpp"
+#include "statio/top.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+constexpr std::int64_t kMinIntervalMs = 100;      // 10 Hz
+constexpr std::int64_t kProcessRefreshMs = 1000;  // the process list never refreshes faster
+constexpr int kCoreCellWidth = 24;
+constexpr int kMaxDeviceRows = 4;
+constexpr int kMinRows = 12;
+constexpr int kMinCols = 60;
+
+volatile std::sig_atomic_t stopRequested = 0;
+volatile std::sig_atomic_t resized = 1;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+void onResize(int) {
+    resized = 1;
+}
+
+std::int64_t steadyMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+enum class SortKey { Cpu, Memory, Pid, Name };
+
+struct TopView {
+    SortKey sort = SortKey::Cpu;
+    bool reverse = false;
+    double selfCpuPct = 0.0;
+    std::string hostname;
+    std::string clock;
+    std::int64_t intervalMs = 1000;
+};
+
+SortKey parseSortKey(const std::string& name) {
+    if (name == "cpu") {
+        return SortKey::Cpu;
+    }
+    if (name == "mem" || name == "memory") {
+        return SortKey::Memory;
+    }
+    if (name == "pid") {
+        return SortKey::Pid;
+    }
+    if (name == "name") {
+        return SortKey::Name;
+    }
+    throw std::runtime_error("unknown sort key '" + name + "' (cpu, mem, pid, name)");
+}
+
+const char* sortKeyName(SortKey key) {
+    switch (key) {
+    case SortKey::Memory:
+        return "mem";
+    case SortKey::Pid:
+        return "pid";
+    case SortKey::Name:
+        return "name";
+    case SortKey::Cpu:
+        break;
+    }
+    return "cpu";
+}
+
+// Raw input and the alternate screen while attached to a terminal; both are
+// undone on destruction so an exception still leaves a usable shell.
+class Terminal {
+public:
+    explicit Terminal(bool interactive) : interactive_(interactive) {
+        if (!interactive_) {
+            return;
+        }
+        if (::tcgetattr(STDIN_FILENO, &saved_) == 0) {
+            termios raw = saved_;
+            raw.c_lflag &= static_cast<tcflag_t>(~(ICANON | ECHO));
+            raw.c_cc[VMIN] = 0;
+            raw.c_cc[VTIME] = 0;
+            restore_ = ::tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+        }
+        write("\x1b[?1049h\x1b[?25l");
+    }
+
+    ~Terminal() {
+        if (interactive_) {
+            write("\x1b[0m\x1b[?25h\x1b[?1049l");
+        }
+        if (restore_) {
+            ::tcsetattr(STDIN_FILENO, TCSANOW, &saved_);
+        }
+    }
+
+    Terminal(const Terminal&) = delete;
+    Terminal& operator=(const Terminal&) = delete;
+
+    // Rows and columns of the terminal; $LINES/$COLUMNS or 24x80 when stdout
+    // is not one.
+    void size(int& rows, int& cols) const {
+        winsize window {};
+        if (::ioctl(STDOUT_FILENO, TIOCGWINSZ, &window) == 0 && window.ws_row > 0 && window.ws_col > 0) {
+            rows = window.ws_row;
+            cols = window.ws_col;
+            return;
+        }
+        const char* lines = std::getenv("LINES");
+        const char* columns = std::getenv("COLUMNS");
+        rows = lines ? std::atoi(lines) : 0;
+        cols = columns ? std::atoi(columns) : 0;
+        rows = rows > 0 ? rows : 24;
+        cols = cols > 0 ? cols : 80;
+    }
+
+    void write(const std::string& bytes) const {
+        std::size_t done = 0;
+        while (done < bytes.size()) {
+            const ssize_t n = ::write(STDOUT_FILENO, bytes.data() + done, bytes.size() - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                throw std::runtime_error("cannot write to the terminal");
+            }
+            done += static_cast<std::size_t>(n);
+        }
+    }
+
+private:
+    bool interactive_;
+    bool restore_ = false;
+    termios saved_ {};
+};
+
+// "812K", "3.4M", "12G": bytes scaled by 1024, three significant digits.
+std::string formatBytes(double bytes) {
+    static const char units[] = {'B', 'K', 'M', 'G', 'T', 'P'};
+    std::size_t unit = 0;
+    while (bytes >= 999.5 && unit + 1 < sizeof(units)) {
+        bytes /= 1024.0;
+        ++unit;
+    }
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), unit > 0 && bytes < 9.95 ? "%.1f%c" : "%.0f%c", bytes, units[unit]);
+    return buffer;
+}
+
+CellStyle loadStyle(double fraction) {
+    return fraction >= 0.8 ? CellStyle::Red : fraction >= 0.5 ? CellStyle::Yellow : CellStyle::Green;
+}
+
+// "[|||||     ]" in `width` cells.
+void drawBar(ScreenBuffer& screen, int row, int col, int width, double fraction) {
+    if (width < 3) {
+        return;
+    }
+    const int inner = width - 2;
+    const int filled = static_cast<int>(std::lround(std::clamp(fraction, 0.0, 1.0) * inner));
+    screen.text(row, col, "[", CellStyle::Dim);
+    screen.text(row, col + 1, std::string(static_cast<std::size_t>(filled), '|'), loadStyle(fraction));
+    screen.text(row, col + width - 1, "]", CellStyle::Dim);
+}
+
+void drawHeader(ScreenBuffer& screen, const TopFrame& frame, const TopView& view) {
+    char left[160];
+    std::snprintf(left, sizeof(left), "statio top - %s  load %.2f %.2f %.2f  cpu %3.0f%%  self %.1f%%",
+                  view.hostname.c_str(), frame.loadAvg[0], frame.loadAvg[1], frame.loadAvg[2],
+                  frame.cpuBusy * 100.0, view.selfCpuPct);
+    screen.text(0, 0, left, CellStyle::Bold);
+    screen.text(0, screen.cols() - static_cast<int>(view.clock.size()), view.clock);
+}
+
+int drawCores(ScreenBuffer& screen, int row, const TopFrame& frame) {
+    const int cores = static_cast<int>(frame.coreBusy.size());
+    if (cores == 0) {
+        return row;
+    }
+    const int columns = std::max(1, std::min(cores, screen.cols() / kCoreCellWidth));
+    const int cellWidth = screen.cols() / columns;
+    const int labelWidth = static_cast<int>(std::to_string(cores - 1).size());
+    const int lines = (cores + columns - 1) / columns;
+    for (int i = 0; i < cores; ++i) {
+        // Column-major, like the numbering of cores in most tools.
+        const int r = row + i % lines;
+        const int c = (i / lines) * cellWidth;
+        char label[16];
+        std::snprintf(label, sizeof(label), "%*d", labelWidth, i);
+        screen.text(r, c, label, CellStyle::Dim);
+        char pct[8];
+        std::snprintf(pct, sizeof(pct), "%3.0f%%", frame.coreBusy[static_cast<std::size_t>(i)] * 100.0);
+        const int barWidth = cellWidth - labelWidth - 1 - 5 - 1;
+        drawBar(screen, r, c + labelWidth + 1, barWidth, frame.coreBusy[static_cast<std::size_t>(i)]);
+        screen.text(r, c + labelWidth + 1 + barWidth + 1, pct);
+    }
+    return row + lines;
+}
+
+void drawUsage(ScreenBuffer& screen, int row, int col, int width, const char* label, std::uint64_t usedKB,
+               std::uint64_t totalKB) {
+    const std::string amount = formatBytes(static_cast<double>(usedKB) * 1024.0) + "/" +
+                               formatBytes(static_cast<double>(totalKB) * 1024.0);
+    screen.text(row, col, label, CellStyle::Dim);
+    const int barWidth = width - 4 - static_cast<int>(amount.size()) - 2;
+    drawBar(screen, row, col + 4, barWidth,
+            totalKB > 0 ? static_cast<double>(usedKB) / static_cast<double>(totalKB) : 0.0);
+    screen.text(row, col + 4 + barWidth + 1, amount);
+}
+
+int drawDevices(ScreenBuffer& screen, int row, const TopFrame& frame) {
+    const int half = screen.cols() / 2;
+    const int lines = std::min(kMaxDeviceRows, static_cast<int>(std::max(frame.disks.size(), frame.network.size())));
+    for (int i = 0; i < lines; ++i) {
+        char text[128];
+        if (static_cast<std::size_t>(i) < frame.disks.size()) {
+            const auto& disk = frame.disks[static_cast<std::size_t>(i)];
+            std::snprintf(text, sizeof(text), "%-8.8s r %6s/s  w %6s/s %4.0f%%", disk.name.c_str(),
+                          formatBytes(disk.readBytes).c_str(), formatBytes(disk.writeBytes).c_str(),
+                          disk.busy * 100.0);
+            screen.text(row + i, 0, "disk", CellStyle::Dim);
+            screen.text(row + i, 5, text, disk.busy >= 0.8 ? CellStyle::Red : CellStyle::Normal);
+        }
+        if (static_cast<std::size_t>(i) < frame.network.size()) {
+            const auto& net = frame.network[static_cast<std::size_t>(i)];
+            std::snprintf(text, sizeof(text), "%-10.10s rx %6s/s  tx %6s/s", net.name.c_str(),
+                          formatBytes(net.rxBytes).c_str(), formatBytes(net.txBytes).c_str());
+            screen.text(row + i, half, "net", CellStyle::Dim);
+            screen.text(row + i, half + 4, text);
+        }
+    }
+    return row + lines;
+}
+
+void sortProcesses(std::vector<const ProcessSample*>& order, std::size_t visible, const TopView& view) {
+    auto before = [&view](const ProcessSample* a, const ProcessSample* b) {
+        bool less = false;
+        bool greater = false;
+        switch (view.sort) {
+        case SortKey::Cpu: // busiest first
+            less = a->cpuPct > b->cpuPct;
+            greater = a->cpuPct < b->cpuPct;
+            break;
+        case SortKey::Memory:
+            less = a->rssKB > b->rssKB;
+            greater = a->rssKB < b->rssKB;
+            break;
+        case SortKey::Name:
+            less = a->name < b->name;
+            greater = b->name < a->name;
+            break;
+        case SortKey::Pid:
+            break;
+        }
+        if (less != greater) {
+            return view.reverse ? greater : less;
+        }
+        return view.reverse ? a->pid > b->pid : a->pid < b->pid;
+    };
+    visible = std::min(visible, order.size());
+    std::partial_sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(visible), order.end(), before);
+}
+
+void drawProcesses(ScreenBuffer& screen, int row, const std::vector<ProcessSample>& processes,
+                   std::vector<const ProcessSample*>& order, const TopView& view) {
+    const int last = screen.rows() - 1; // the footer
+    if (row >= last) {
+        return;
+    }
+    static const struct {
+        SortKey key;
+        int col;
+        const char* title;
+    } columns[] = {{SortKey::Pid, 0, "    PID"}, {SortKey::Cpu, 10, " CPU%"}, {SortKey::Memory, 16, "     RSS"},
+                   {SortKey::Name, 31, "COMMAND"}};
+    screen.fill(row, 0, CellStyle::Inverse);
+    screen.text(row, 8, "S", CellStyle::Inverse);
+    screen.text(row, 26, " THR", CellStyle::Inverse);
+    for (const auto& column : columns) {
+        screen.text(row, column.col, column.title, column.key == view.sort ? CellStyle::Bold : CellStyle::Inverse);
+    }
+    ++row;
+
+    order.clear();
+    for (const auto& process : processes) {
+        order.push_back(&process);
+    }
+    const auto visible = static_cast<std::size_t>(last - row);
+    sortProcesses(order, visible, view);
+    for (std::size_t i = 0; i < visible && i < order.size(); ++i, ++row) {
+        const ProcessSample& process = *order[i];
+        char text[96];
+        std::snprintf(text, sizeof(text), "%7d %c %5.1f %8s %4u %s", process.pid, process.state, process.cpuPct,
+                      formatBytes(static_cast<double>(process.rssKB) * 1024.0).c_str(), process.threads,
+                      process.name.c_str());
+        screen.text(row, 0, text, process.state == 'R' ? CellStyle::Bold : CellStyle::Normal);
+    }
+}
+
+void drawFooter(ScreenBuffer& screen, const TopView& view) {
+    char text[128];
+    std::snprintf(text, sizeof(text), "q quit  c cpu  m mem  p pid  n name  r reverse    sort %s%s  every %.1fs",
+                  sortKeyName(view.sort), view.reverse ? " (reversed)" : "",
+                  static_cast<double>(view.intervalMs) / 1000.0);
+    const int row = screen.rows() - 1;
+    screen.fill(row, 0, CellStyle::Inverse);
+    screen.text(row, 0, text, CellStyle::Inverse);
+}
+
+void draw(ScreenBuffer& screen, const TopFrame& frame, const std::vector<ProcessSample>& processes,
+          std::vector<const ProcessSample*>& order, const TopView& view) {
+    screen.clear();
+    if (screen.rows() < kMinRows || screen.cols() < kMinCols) {
+        screen.text(0, 0, "terminal too small for statio top");
+        return;
+    }
+    drawHeader(screen, frame, view);
+    int row = drawCores(screen, 2, frame) + 1;
+    const int half = screen.cols() / 2;
+    drawUsage(screen, row, 0, half - 2, "mem", frame.memTotalKB - std::min(frame.memAvailableKB, frame.memTotalKB),
+              frame.memTotalKB);
+    drawUsage(screen, row, half, screen.cols() - half, "swp",
+              frame.swapTotalKB - std::min(frame.swapFreeKB, frame.swapTotalKB), frame.swapTotalKB);
+    row = drawDevices(screen, row + 1, frame) + 1;
+    drawProcesses(screen, row, processes, order, view);
+    drawFooter(screen, view);
+}
+
+void handleKey(char key, TopView& view, bool& quit) {
+    switch (key) {
+    case 'q':
+        quit = true;
+        break;
+    case 'c':
+        view.sort = SortKey::Cpu;
+        break;
+    case 'm':
+        view.sort = SortKey::Memory;
+        break;
+    case 'p':
+        view.sort = SortKey::Pid;
+        break;
+    case 'n':
+        view.sort = SortKey::Name;
+        break;
+    case 'r':
+        view.reverse = !view.reverse;
+        break;
+    default:
+        break; // including the tails of escape sequences
+    }
+}
+
+double cpuSeconds() {
+    rusage usage {};
+    ::getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+std::string wallClock() {
+    const std::time_t now = std::time(nullptr);
+    std::tm local {};
+    ::localtime_r(&now, &local);
+    char buffer[16];
+    std::strftime(buffer, sizeof(buffer), "%H:%M:%S", &local);
+    return buffer;
+}
+
+std::string localHostName() {
+    char name[256] = {};
+    if (::gethostname(name, sizeof(name) - 1) != 0 || name[0] == '\0') {
+        return "localhost";
+    }
+    return name;
+}
+
+} // namespace
+
+int runTopCommand(const std::vector<std::string>& args) {
+    const CommandLine cli(args, {"interval", "sort", "samples", "io"});
+    TopView view;
+    view.intervalMs = parseDurationMs(cli.value("interval", "1s"));
+    if (view.intervalMs < kMinIntervalMs) {
+        throw std::runtime_error("--interval must be at least 100ms");
+    }
+    view.sort = parseSortKey(cli.value("sort", "cpu"));
+    const std::int64_t maxSamples = cli.integer("samples", 0);
+    if (maxSamples < 0) {
+        throw std::runtime_error("--samples must not be negative");
+    }
+    const IoBackend io = parseIoBackend(cli.value("io", "pread"));
+    view.hostname = localHostName();
+
+    // Without a terminal on both ends (e.g. `statio top --samples 3 > log`)
+    // the frames are still written, but no keys are read.
+    const bool interactive = ::isatty(STDIN_FILENO) && ::isatty(STDOUT_FILENO);
+    TopSampler sampler(io);
+    ProcessTable processes(io);
+    ScreenBuffer screen;
+    TopFrame frame;
+    std::vector<const ProcessSample*> order;
+    std::string out;
+
+    stopRequested = 0;
+    resized = 1;
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGHUP, requestStop);
+    std::signal(SIGWINCH, onResize);
+    Terminal terminal(interactive);
+
+    // The first pass only primes the counters; rates need two samples.
+    sampler.sample(frame);
+    processes.sample();
+    std::int64_t nextSampleMs = steadyMs() + std::min<std::int64_t>(view.intervalMs, 250);
+    std::int64_t nextProcessMs = nextSampleMs;
+    std::int64_t lastSampleMs = steadyMs();
+    double lastCpuSeconds = cpuSeconds();
+    std::int64_t samples = 0;
+    bool quit = false;
+
+    while (!quit && stopRequested == 0) {
+        const std::int64_t now = steadyMs();
+        if (now >= nextSampleMs) {
+            sampler.sample(frame);
+            if (now >= nextProcessMs) {
+                processes.sample();
+                nextProcessMs = now + std::max(view.intervalMs, kProcessRefreshMs);
+            }
+            const double cpu = cpuSeconds();
+            view.selfCpuPct = (cpu - lastCpuSeconds) / (static_cast<double>(now - lastSampleMs) / 1000.0) * 100.0;
+            lastCpuSeconds = cpu;
+            lastSampleMs = now;
+            view.clock = wallClock();
+            nextSampleMs = now + view.intervalMs;
+            ++samples;
+        }
+        if (resized != 0) {
+            resized = 0;
+            int rows = 0;
+            int cols = 0;
+            terminal.size(rows, cols);
+            screen.resize(rows, cols);
+        }
+        // Drawing the whole frame is cheap; only the cells that differ from
+        // the last one reach the terminal.
+        draw(screen, frame, processes.rows(), order, view);
+        out.clear();
+        screen.flush(out);
+        if (!out.empty()) {
+            terminal.write(out);
+        }
+        if (maxSamples > 0 && samples >= maxSamples) {
+            break;
+        }
+
+        pollfd input {STDIN_FILENO, POLLIN, 0};
+        const int timeout = static_cast<int>(std::max<std::int64_t>(0, nextSampleMs - steadyMs()));
+        if (::poll(&input, interactive ? 1 : 0, timeout) > 0) {
+            char keys[64];
+            const ssize_t n = ::read(STDIN_FILENO, keys, sizeof(keys));
+            for (ssize_t i = 0; i < n; ++i) {
+                handleKey(keys[i], view, quit);
+            }
+        }
+    }
+    if (!interactive) {
+        terminal.write("\x1b[0m\n");
+    }
+    return 0;
+}
+
+} // namespace statio
@@ -0,0 +1,489 @@
+#include "statio/wire.hpp"
+
+#include "statio/lz.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace statio {
+namespace {
+
+void putVarint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void putString(std::string& out, std::string_view text) {
+    putVarint(out, text.size());
+    out.append(text);
+}
+
+std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+std::uint64_t doubleBits(double value) {
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+class Reader {
+public:
+    explicit Reader(std::string_view data) : data_(data) {}
+
+    std::uint8_t byte() {
+        need(1);
+        return static_cast<std::uint8_t>(data_[pos_++]);
+    }
+
+    std::uint64_t varint() {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const std::uint8_t b = byte();
+            value |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("malformed varint in wire frame");
+    }
+
+    std::string_view string() {
+        const std::uint64_t length = varint();
+        need(length);
+        const std::string_view text = data_.substr(pos_, static_cast<std::size_t>(length));
+        pos_ += static_cast<std::size_t>(length);
+        return text;
+    }
+
+    std::size_t offset() const { return pos_; }
+
+private:
+    void need(std::uint64_t bytes) const {
+        if (bytes > data_.size() - pos_) {
+            throw std::runtime_error("truncated wire frame");
+        }
+    }
+
+    std::string_view data_;
+    std::size_t pos_ = 0;
+};
+
+// Reserves the frame header and returns its offset; finishFrame fills it in.
+std::size_t beginFrame(std::string& out, WireFrameType type) {
+    const std::size_t start = out.size();
+    out.append(kWireHeaderBytes, '\0');
+    out.push_back(static_cast<char>(type));
+    return start;
+}
+
+void finishFrame(std::string& out, std::size_t start) {
+    const std::uint32_t magic = kWireMagic;
+    const std::uint32_t length = static_cast<std::uint32_t>(out.size() - start - kWireHeaderBytes);
+    std::memcpy(&out[start], &magic, sizeof(magic));
+    std::memcpy(&out[start + 4], &length, sizeof(length));
+}
+
+constexpr const char* kUnixPrefix = "unix:";
+
+bool isUnixAddress(const std::string& address) {
+    return address.rfind(kUnixPrefix, 0) == 0;
+}
+
+sockaddr_un unixAddress(const std::string& address) {
+    const std::string path = address.substr(std::strlen(kUnixPrefix));
+    sockaddr_un un {};
+    un.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(un.sun_path)) {
+        throw std::runtime_error("bad unix socket path: " + address);
+    }
+    std::memcpy(un.sun_path, path.c_str(), path.size() + 1);
+    return un;
+}
+
+std::int64_t steadyMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// connect() on a blocking descriptor that waits at most `timeoutMs` (< 0:
+// as long as the kernel does) and stops once `cancelled` says so. False
+// with errno set on failure; the descriptor is left blocking.
+bool connectWithin(int fd, const sockaddr* address, socklen_t length, std::int64_t timeoutMs,
+                   const std::function<bool()>& cancelled) {
+    if (timeoutMs < 0 && !cancelled) {
+        return ::connect(fd, address, length) == 0;
+    }
+    const int flags = ::fcntl(fd, F_GETFL);
+    ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int error = ::connect(fd, address, length) == 0 ? 0 : errno;
+    const std::int64_t deadlineMs = timeoutMs < 0 ? -1 : steadyMs() + timeoutMs;
+    while (error == EINPROGRESS || error == EINTR) {
+        if (cancelled && cancelled()) {
+            error = ECANCELED;
+            break;
+        }
+        std::int64_t waitMs = 100;
+        if (deadlineMs >= 0) {
+            waitMs = std::min(waitMs, deadlineMs - steadyMs());
+            if (waitMs <= 0) {
+                error = ETIMEDOUT;
+                break;
+            }
+        }
+        pollfd pending {fd, POLLOUT, 0};
+        const int ready = ::poll(&pending, 1, static_cast<int>(waitMs));
+        if (ready < 0 && errno != EINTR) {
+            error = errno;
+            break;
+        }
+        if (ready > 0) {
+            socklen_t size = sizeof(error);
+            if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) != 0) {
+                error = errno;
+            }
+            break;
+        }
+    }
+    ::fcntl(fd, F_SETFL, flags);
+    errno = error;
+    return error == 0;
+}
+
+addrinfo* resolve(const std::string& address, bool passive) {
+    const auto colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        throw std::runtime_error("expected HOST:PORT, got " + address);
+    }
+    std::string host = address.substr(0, colon);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    const std::string port = address.substr(colon + 1);
+
+    addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    const int rc = ::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+    if (rc != 0) {
+        throw std::runtime_error("cannot resolve " + address + ": " + ::gai_strerror(rc));
+    }
+    return result;
+}
+
+} // namespace
+
+void SnapshotEncoder::hello(const std::string& host, std::string& out) const {
+    const std::size_t start = beginFrame(out, WireFrameType::Hello);
+    putString(out, host);
+    finishFrame(out, start);
+}
+
+void SnapshotEncoder::reset() {
+    ids_.clear();
+    bits_.clear();
+    lastMs_ = 0;
+    full_ = true;
+}
+
+void SnapshotEncoder::encode(std::int64_t timestampMs, const std::vector<MetricSample>& samples, std::string& out) {
+    const std::size_t start = beginFrame(out, WireFrameType::Snapshot);
+    out.push_back(full_ ? 1 : 0);
+    putVarint(out, zigzag(timestampMs - lastMs_));
+    lastMs_ = timestampMs;
+    full_ = false;
+
+    // Ids of the samples in this snapshot; new series are defined up front.
+    std::vector<std::uint32_t>& ids = order_;
+    ids.clear();
+    std::string definitions;
+    std::uint64_t added = 0;
+    for (const auto& sample : samples) {
+        key_.assign(sample.name);
+        key_ += '\0';
+        key_ += sample.entity;
+        auto it = ids_.find(key_);
+        if (it == ids_.end()) {
+            const auto id = static_cast<std::uint32_t>(bits_.size());
+            it = ids_.emplace(key_, id).first;
+            bits_.push_back(0);
+            putVarint(definitions, id);
+            definitions.push_back(static_cast<char>(sample.kind));
+            putString(definitions, sample.name);
+            putString(definitions, sample.entity);
+            ++added;
+        }
+        ids.push_back(it->second);
+    }
+    putVarint(out, added);
+    out += definitions;
+
+    // Changed values in ascending id order so the gaps stay small.
+    std::vector<std::pair<std::uint32_t, std::uint64_t>>& changed = changed_;
+    changed.clear();
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        const std::uint64_t bits = doubleBits(samples[i].value);
+        std::uint64_t& previous = bits_[ids[i]];
+        if (bits != previous) {
+            changed.emplace_back(ids[i], bits ^ previous);
+            previous = bits;
+        }
+    }
+    std::sort(changed.begin(), changed.end());
+    putVarint(out, changed.size());
+    std::uint32_t lastId = 0;
+    for (const auto& [id, delta] : changed) {
+        putVarint(out, id - lastId);
+        putVarint(out, delta);
+        lastId = id;
+    }
+    finishFrame(out, start);
+}
+
+WireFrameType SnapshotDecoder::decode(std::string_view payload) {
+    Reader in(payload);
+    const auto type = static_cast<WireFrameType>(in.byte());
+    if (type == WireFrameType::Hello) {
+        host_ = std::string(in.string());
+        return type;
+    }
+    if (type != WireFrameType::Snapshot) {
+        throw std::runtime_error("unknown wire frame type " + std::to_string(static_cast<int>(type)));
+    }
+
+    full_ = in.byte() != 0;
+    if (full_) {
+        series_.clear();
+        timestampMs_ = 0;
+    }
+    timestampMs_ += unzigzag(in.varint());
+
+    added_.clear();
+    const std::uint64_t added = in.varint();
+    for (std::uint64_t i = 0; i < added; ++i) {
+        const std::uint64_t id = in.varint();
+        if (id != series_.size()) {
+            throw std::runtime_error("wire series ids out of order");
+        }
+        WireSeries series;
+        series.kind = static_cast<MetricKind>(in.byte());
+        series.name = std::string(in.string());
+        series.entity = std::string(in.string());
+        series_.push_back(std::move(series));
+        added_.push_back(static_cast<std::uint32_t>(id));
+    }
+
+    changed_.clear();
+    const std::uint64_t changed = in.varint();
+    std::uint64_t id = 0;
+    for (std::uint64_t i = 0; i < changed; ++i) {
+        id += in.varint();
+        if (id >= series_.size()) {
+            throw std::runtime_error("wire value for an undefined series");
+        }
+        WireSeries& series = series_[static_cast<std::size_t>(id)];
+        series.bits ^= in.varint();
+        std::memcpy(&series.value, &series.bits, sizeof(series.value));
+        changed_.push_back(static_cast<std::uint32_t>(id));
+    }
+    return type;
+}
+
+void appendWireBatch(std::string& out, std::uint64_t sequence, std::string_view frames, WireCodec codec) {
+    const std::size_t start = beginFrame(out, WireFrameType::Batch);
+    putVarint(out, sequence);
+    out.push_back(static_cast<char>(codec));
+    putVarint(out, frames.size());
+    if (codec == WireCodec::Lz) {
+        lzCompress(frames, out);
+    } else {
+        out.append(frames);
+    }
+    finishFrame(out, start);
+}
+
+std::uint64_t unpackWireBatch(std::string_view payload, std::string& frames) {
+    Reader in(payload);
+    if (static_cast<WireFrameType>(in.byte()) != WireFrameType::Batch) {
+        throw std::runtime_error("not a batch frame");
+    }
+    const std::uint64_t sequence = in.varint();
+    const auto codec = static_cast<WireCodec>(in.byte());
+    const std::uint64_t rawSize = in.varint();
+    if (rawSize > kWireMaxPayload) {
+        throw std::runtime_error("oversized batch");
+    }
+    const std::string_view body = payload.substr(in.offset());
+    if (codec == WireCodec::Lz) {
+        lzDecompress(body, static_cast<std::size_t>(rawSize), frames);
+    } else if (codec == WireCodec::None && body.size() == rawSize) {
+        frames.append(body);
+    } else {
+        throw std::runtime_error("unknown batch codec or size");
+    }
+    return sequence;
+}
+
+void appendWireAck(std::string& out, std::uint64_t sequence) {
+    const std::size_t start = beginFrame(out, WireFrameType::Ack);
+    putVarint(out, sequence);
+    finishFrame(out, start);
+}
+
+std::uint64_t parseWireAck(std::string_view payload) {
+    Reader in(payload);
+    if (static_cast<WireFrameType>(in.byte()) != WireFrameType::Ack) {
+        throw std::runtime_error("expected an ack frame");
+    }
+    return in.varint();
+}
+
+WireFrameType wireFrameType(std::string_view payload) {
+    if (payload.empty()) {
+        throw std::runtime_error("empty wire frame");
+    }
+    return static_cast<WireFrameType>(payload[0]);
+}
+
+bool nextWireFrame(std::string_view& buffer, std::string_view& payload) {
+    if (buffer.size() < kWireHeaderBytes) {
+        return false;
+    }
+    std::uint32_t magic = 0;
+    std::uint32_t length = 0;
+    std::memcpy(&magic, buffer.data(), sizeof(magic));
+    std::memcpy(&length, buffer.data() + 4, sizeof(length));
+    if (magic != kWireMagic) {
+        throw std::runtime_error("bad wire frame magic");
+    }
+    if (length == 0 || length > kWireMaxPayload) {
+        throw std::runtime_error("bad wire frame length " + std::to_string(length));
+    }
+    if (buffer.size() - kWireHeaderBytes < length) {
+        return false;
+    }
+    payload = buffer.substr(kWireHeaderBytes, length);
+    buffer.remove_prefix(kWireHeaderBytes + length);
+    return true;
+}
+
+int connectStream(const std::string& address) {
+    return connectStream(address, -1);
+}
+
+int connectStream(const std::string& address, std::int64_t timeoutMs, const std::function<bool()>& cancelled) {
+    if (isUnixAddress(address)) {
+        const sockaddr_un un = unixAddress(address);
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || !connectWithin(fd, reinterpret_cast<const sockaddr*>(&un), sizeof(un), timeoutMs, cancelled)) {
+            const int error = errno;
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            throw std::runtime_error("cannot connect to " + address + ": " + std::strerror(error));
+        }
+        return fd;
+    }
+
+    addrinfo* result = resolve(address, false);
+    int lastError = 0;
+    int fd = -1;
+    for (addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            lastError = errno;
+            continue;
+        }
+        if (connectWithin(fd, ai->ai_addr, ai->ai_addrlen, timeoutMs, cancelled)) {
+            break;
+        }
+        lastError = errno;
+        ::close(fd);
+        fd = -1;
+    }
+    ::freeaddrinfo(result);
+    if (fd < 0) {
+        throw std::runtime_error("cannot connect to " + address + ": " + std::strerror(lastError));
+    }
+    const int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+int listenStream(const std::string& address, int backlog) {
+    if (isUnixAddress(address)) {
+        const sockaddr_un un = unixAddress(address);
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("socket failed: ") + std::strerror(errno));
+        }
+        ::unlink(un.sun_path);
+        if (::bind(fd, reinterpret_cast<const sockaddr*>(&un), sizeof(un)) != 0 || ::listen(fd, backlog) != 0) {
+            const int error = errno;
+            ::close(fd);
+            throw std::runtime_error("cannot listen on " + address + ": " + std::strerror(error));
+        }
+        return fd;
+    }
+
+    addrinfo* result = resolve(address, true);
+    int lastError = 0;
+    int fd = -1;
+    for (addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            lastError = errno;
+            continue;
+        }
+        const int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (::bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && ::listen(fd, backlog) == 0) {
+            break;
+        }
+        lastError = errno;
+        ::close(fd);
+        fd = -1;
+    }
+    ::freeaddrinfo(result);
+    if (fd < 0) {
+        throw std::runtime_error("cannot listen on " + address + ": " + std::strerror(lastError));
+    }
+    return fd;
+}
+
+bool sendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(static_cast<std::size_t>(n));
+    }
+    return true;
+}
+
+} // namespace statio
@@ -9,9 +9,10 @@ import json
 import os
 import platform
 import socket
+import struct
 import time
 from pathlib import Path
-from typing import Any, Dict, List, Optional, Tuple
+from typing import Any, Dict, Iterator, List, Optional, Tuple
 
 
 def _read_first_line(path: str) -> str:
@@ -232,6 +233,92 @@ def collect_snapshot() -> Dict[str, object]:
     }
 
 
+def default_socket_path() -> str:
+    """Same lookup as the daemon: $STATIO_SOCKET, $XDG_RUNTIME_DIR/statio.sock, /tmp/statio-<uid>.sock."""
+    path = os.environ.get("STATIO_SOCKET")
+    if path:
+        return path
+    runtime = os.environ.get("XDG_RUNTIME_DIR")
+    if runtime:
+        return os.path.join(runtime, "statio.sock")
+    return f"/tmp/statio-{os.getuid()}.sock"
+
+
+# A snapshot older than this many daemon intervals comes from a stalled
+# sampler (kApiStaleIntervals in statio/api.hpp).
+STALE_INTERVALS = 3
+
+
+def _connect_daemon(sock: socket.socket, path: str) -> None:
+    """Connects to the API socket, trusting only a daemon run by this user or root."""
+    sock.connect(path)
+    _, uid, _ = struct.unpack("3i", sock.getsockopt(socket.SOL_SOCKET, socket.SO_PEERCRED, struct.calcsize("3i")))
+    if uid not in (os.getuid(), 0):
+        raise ConnectionError(f"{path} is served by uid {uid}")
+
+
+def _read_exact(sock: socket.socket, size: int) -> bytes:
+    data = b""
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError("daemon closed the connection")
+        data += chunk
+    return data
+
+
+def daemon_request(path: str, request: str, timeout: float = 2.0) -> Optional[bytes]:
+    """Sends one request to a running statio daemon; None when none answers.
+
+    Responses are framed as u32 length, u8 status (0 ok), body.
+    """
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+            sock.settimeout(timeout)
+            _connect_daemon(sock, path)
+            sock.sendall(request.encode("utf-8") + b"\n")
+            length, status = struct.unpack("<IB", _read_exact(sock, 5))
+            body = _read_exact(sock, length)
+    except (OSError, ConnectionError):
+        return None
+    return body if status == 0 else None
+
+
+def daemon_snapshot(path: str) -> Optional[Dict[str, object]]:
+    body = daemon_request(path, "snapshot")
+    if body is None:
+        return None
+    try:
+        snapshot = json.loads(body)
+    except ValueError:
+        return None
+    interval_ms = snapshot.get("interval_ms", 0)
+    if interval_ms <= 0 or time.time() * 1000 - snapshot.get("timestamp_ms", 0) > STALE_INTERVALS * interval_ms:
+        return None  # a stalled daemon: collect locally instead
+    return snapshot
+
+
+def daemon_watch(path: str, fields: str, every: float = 0.0) -> Iterator[Dict[str, object]]:
+    """Yields field-level diffs from a running daemon (the API's `watch` request).
+
+    The first diff holds every selected field; later ones only those that
+    changed, with None for a field that disappeared.
+    """
+    request = f"watch {fields}" + (f" --every {int(every * 1000)}ms" if every > 0 else "")
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        _connect_daemon(sock, path)
+        sock.sendall(request.encode("utf-8") + b"\n")
+        while True:
+            try:
+                length, status = struct.unpack("<IB", _read_exact(sock, 5))
+            except ConnectionError:
+                return
+            body = _read_exact(sock, length)
+            if status != 0:
+                raise RuntimeError(body.decode("utf-8", "replace"))
+            yield json.loads(body)
+
+
 def _load_plugin_module(plugin_path: Path) -> Tuple[str, Optional[Any], Optional[str]]:
     module_name = f"statio_plugin_{plugin_path.stem}"
     try:
@@ -308,8 +395,13 @@ def print_human(snapshot: Dict[str, object]) -> None:
             print(f"- {name}: {message}")
 
 
-def build_snapshot_with_plugins(plugins_dir: Path, enable_plugins: bool) -> Dict[str, object]:
-    snapshot = collect_snapshot()
+def build_snapshot_with_plugins(
+    plugins_dir: Path, enable_plugins: bool, socket_path: Optional[str] = None
+) -> Dict[str, object]:
+    # A running daemon already holds a fresh snapshot; collect only without one.
+    snapshot = daemon_snapshot(socket_path) if socket_path else None
+    if snapshot is None:
+        snapshot = collect_snapshot()
     snapshot["plugins"] = {}
     snapshot["plugin_errors"] = {}
 
@@ -332,12 +424,38 @@ def main() -> int:
         default=str(Path(__file__).resolve().parent / "plugins"),
         help="Directory that contains Python plugins (*.py)",
     )
+    parser.add_argument(
+        "--socket",
+        default=default_socket_path(),
+        help="API socket of a running statio daemon, used when one answers",
+    )
+    parser.add_argument("--local", action="store_true", help="Always collect locally, never ask a daemon")
+    parser.add_argument(
+        "--diff",
+        metavar="FIELDS",
+        help="Stream changed fields from the daemon, e.g. 'cpu,memory.available_mb' (rate: --watch)",
+    )
     args = parser.parse_args()
 
+    if args.diff:
+        try:
+            for diff in daemon_watch(args.socket, args.diff, args.watch):
+                print(json.dumps(diff, separators=(",", ":"), ensure_ascii=False), flush=True)
+        except KeyboardInterrupt:
+            return 0
+        except (OSError, RuntimeError) as exc:
+            print(f"statio_py: {exc}")
+            return 1
+        return 0
+
     plugins_dir = Path(args.plugins_dir)
 
     def emit() -> None:
-        snapshot = build_snapshot_with_plugins(plugins_dir=plugins_dir, enable_plugins=not args.no_plugins)
+        snapshot = build_snapshot_with_plugins(
+            plugins_dir=plugins_dir,
+            enable_plugins=not args.no_plugins,
+            socket_path=None if args.local else args.socket,
+        )
         if args.json:
             if args.pretty:
                 print(json.dumps(snapshot, indent=2, ensure_ascii=False))